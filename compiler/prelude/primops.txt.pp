@@ -2895,6 +2895,15 @@ primop  ThreadStatusOp "threadStatus#" GenPrimOp
    out_of_line = True
    has_side_effects = True
 
+primop  SetThreadPriorityOp "setThreadPriority#" GenPrimOp
+   ThreadId# -> Int# -> State# RealWorld -> State# RealWorld
+   { Set the scheduling priority of a thread: 0 is high, 1 normal and 2
+     low.  Larger values are taken as low.  The new priority takes effect
+     the next time the thread is put on a run queue. }
+   with
+   out_of_line = True
+   has_side_effects = True
+
 ------------------------------------------------------------------------
 section "Weak pointers"
 ------------------------------------------------------------------------
@@ -137,6 +137,9 @@ typedef struct GCDetails_ {
   uint64_t compact_bytes;
     // Total amount of slop (wasted memory)
   uint64_t slop_bytes;
+    // Free slots in the blocks of small pinned objects, i.e. memory held
+    // by pinned blocks that is not used by live objects.
+  uint64_t pinned_slop_bytes;
     // Total amount of memory in use by the RTS
   uint64_t mem_in_use_bytes;
     // Total amount of data copied during this GC
@@ -176,6 +179,8 @@ typedef struct _RTSStats {
   uint64_t max_compact_bytes;
     // Maximum slop
   uint64_t max_slop_bytes;
+    // Maximum pinned slop
+  uint64_t max_pinned_slop_bytes;
     // Maximum memory in use by the RTS
   uint64_t max_mem_in_use_bytes;
     // Sum of live bytes across all major GCs.  Divided by major_gcs
@@ -189,6 +194,13 @@ typedef struct _RTSStats {
   uint64_t cumulative_par_max_copied_bytes;
     // Sum of par_balanced_copied_byes across all parallel GCs.
   uint64_t cumulative_par_balanced_copied_bytes;
+    // Free memory that the GC has decided to return to the OS, but that
+    // the background decommit thread (+RTS --decommit-rate) has not
+    // returned yet.
+  uint64_t pending_decommit_bytes;
+    // Blocks of the oldest generation that a +RTS -w major GC has marked
+    // but that have not been swept yet.
+  uint64_t sweep_debt_bytes;
 
   // -----------------------------------
   // Cumulative stats about time use
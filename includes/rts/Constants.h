@@ -307,6 +307,24 @@
  */
 #define TSO_ALLOC_LIMIT 256
 
+/*
+ * The thread is runnable but off the run queue, in its Capability's
+ * deque of threads that idle Capabilities may steal (see
+ * Note [Stealing threads] in rts/Schedule.c).
+ */
+#define TSO_STEALABLE 512
+
+/*
+ * Values for the tso->priority field: each Capability has a run queue
+ * for each priority, and runs the threads of a higher priority first
+ * (see Note [Thread priorities] in rts/Schedule.c).  These must match
+ * the constructors of GHC.Conc.Sync.ThreadPriority.
+ */
+#define TSO_PRIORITY_HIGH   0
+#define TSO_PRIORITY_NORMAL 1
+#define TSO_PRIORITY_LOW    2
+#define TSO_PRIORITIES      3
+
 /*
  * The number of times we spin in a spin lock before yielding (see
  * #3758).  To tune this value, use the benchmark in #3758: run the
@@ -182,12 +182,29 @@
 
 #define EVENT_USER_BINARY_MSG              181
 
+#define EVENT_BLOCK_CACHE_STATS            182 /* (hits, misses,
+                                                   flushed_blocks) */
+#define EVENT_NURSERY_SIZE                 183 /* (nursery_bytes,
+                                                   alloc_rate_bytes) */
+#define EVENT_HEAP_LARGE_OBJECTS           184 /* (heap_capset, generation,
+                                                   objects, bytes,
+                                                   promoted_objects,
+                                                   promoted_bytes) */
+#define EVENT_GC_PACE                      185 /* (heap_capset, generation,
+                                                   predicted_pause_ns,
+                                                   old_size_bytes,
+                                                   new_size_bytes) */
+#define EVENT_CAP_THREAD_STEALS            186 /* (published, reclaimed,
+                                                   stolen) */
+#define EVENT_THREAD_PRIORITY_STATS        187 /* (priority, runs,
+                                                   boosts) */
+
 /*
  * The highest event code +1 that ghc itself emits. Note that some event
  * ranges higher than this are reserved but not currently emitted by ghc.
  * This must match the size of the EventDesc[] array in EventLog.c
  */
-#define NUM_GHC_EVENT_TAGS        182
+#define NUM_GHC_EVENT_TAGS        188
 
 #if 0  /* DEPRECATED EVENTS: */
 /* we don't actually need to record the thread, it's implicit */
@@ -41,11 +41,14 @@ typedef struct _GC_FLAGS {
     uint32_t     initialStkSize;     /* in *words* */
     uint32_t     stkChunkSize;       /* in *words* */
     uint32_t     stkChunkBufferSize; /* in *words* */
+    uint32_t     stkSplitSize;       /* in *words*, 0 = off */
 
     uint32_t     maxHeapSize;        /* in *blocks* */
     uint32_t     minAllocAreaSize;   /* in *blocks* */
+    bool minAllocAreaSizeAuto;       /* size each nursery by allocation rate */
     uint32_t     largeAllocLim;      /* in *blocks* */
     uint32_t     nurseryChunkSize;   /* in *blocks* */
+    uint32_t     blockCacheSize;     /* in *blocks* */
     uint32_t     minOldGenSize;      /* in *blocks* */
     uint32_t     heapSizeSuggestion; /* in *blocks* */
     bool heapSizeSuggestionAuto;
@@ -60,6 +63,8 @@ typedef struct _GC_FLAGS {
 
     bool sweep;		/* use "mostly mark-sweep" instead of copying
                                  * for the oldest generation */
+    bool concurrentMark;        /* mark the oldest generation concurrently
+                                 * with the mutator (implies sweep) */
     bool ringBell;
 
     Time    idleGCDelayTime;    /* units: TIME_RESOLUTION */
@@ -67,7 +72,32 @@ typedef struct _GC_FLAGS {
 
     Time    longGCSync;         /* units: TIME_RESOLUTION */
 
+    Time    pauseTarget;        /* units: TIME_RESOLUTION, 0 = none */
+
     StgWord heapBase;           /* address to ask the OS for memory */
+    bool hugePages;             /* back the heap with huge pages */
+
+    uint32_t decommitRate;      /* in *blocks* per second, 0 = off */
+    uint32_t decommitTarget;    /* in *blocks*, 0 = none */
+
+    uint32_t prefetchDepth;     /* pointers to prefetch ahead of the
+                                 * scavenger, 0 = off */
+
+    bool cardTable;             /* remember writes to old MUT_VARs, MVARs
+                                 * and TVARs in a card table */
+
+    uint32_t pretenureThreshold; /* % of survivors that must be promoted
+                                  * for a constructor to be pretenured,
+                                  * 0 = off */
+
+    bool finalizerThread;       /* run C finalizers on an OS thread of
+                                 * their own */
+
+    bool eagerSelectors;        /* evaluate selector thunks in the GC
+                                 * however deeply they are nested */
+
+    uint32_t staticRootsInterval; /* walk the static objects at one major
+                                   * GC in this many, 0 = at every one */
 
     StgWord allocLimitGrace;    /* units: *blocks*
                                  * After an AllocationLimitExceeded
@@ -177,6 +207,10 @@ typedef struct _TRACE_FLAGS {
 typedef struct _CONCURRENT_FLAGS {
     Time ctxtSwitchTime;         /* units: TIME_RESOLUTION */
     int ctxtSwitchTicks;         /* derived */
+    uint32_t starvationLimit;    /* run a waiting lower-priority thread
+                                    after this many higher-priority ones
+                                    (0 == never) */
+    bool threadUsage;            /* count the time each thread runs */
 } CONCURRENT_FLAGS;
 
 /*
@@ -240,8 +274,17 @@ typedef struct _PAR_FLAGS {
                                   * GC (default: use all nNodes). */
 
   bool           setAffinity;    /* force thread affinity with CPUs */
+
+  uint32_t       loadBalance;    /* how idle capabilities get threads:
+                                  * one of LOAD_BALANCE_* */
+  Time           idleSpin;       /* longest an idle worker spins before
+                                  * sleeping, units: TIME_RESOLUTION */
 } PAR_FLAGS;
 
+#define LOAD_BALANCE_PUSH   0
+#define LOAD_BALANCE_STEAL  1
+#define LOAD_BALANCE_HYBRID 2
+
 /* See Note [Synchronization of flags and base APIs] */
 typedef struct _TICKY_FLAGS {
     bool showTickyStats;
@@ -46,6 +46,17 @@ int     rts_getThreadId                  (StgPtr tso);
 void    rts_enableThreadAllocationLimit  (StgPtr tso);
 void    rts_disableThreadAllocationLimit (StgPtr tso);
 
+// How much a thread has allocated and run (see Note [Thread usage] in
+// rts/Schedule.c).  GHC.Conc.ThreadUsage gets the layout with hsc2hs.
+typedef struct ThreadUsage_ {
+    StgWord64 id;
+    StgWord64 allocated;    // bytes
+    StgWord64 run_time;     // nanoseconds, with +RTS --thread-usage
+} ThreadUsage;
+
+void    rts_getThreadUsage  (StgPtr tso, ThreadUsage *usage);
+StgWord rts_listThreadUsage (ThreadUsage *usage, StgWord n);
+
 #if !defined(mingw32_HOST_OS)
 pid_t  forkProcess     (HsStablePtr *entry);
 #else
@@ -70,6 +70,19 @@
  * programs that use large amounts of memory (e.g. #7762, #5086).
  */
 
+/* -----------------------------------------------------------------------------
+ * Card table (+RTS --card-table).  On 64-bit platforms each block
+ * descriptor has one byte for each card of its block; there is no room
+ * for them on 32-bit platforms.
+ */
+
+#if SIZEOF_VOID_P == 8
+#define BLOCK_CARDS        8
+#define CARD_SHIFT         (BLOCK_SHIFT - 3)
+#define CARD_SIZE_W        ((1 << CARD_SHIFT) / sizeof(W_))
+#define CARD_OF(p)         (((W_)(p) & BLOCK_MASK) >> CARD_SHIFT)
+#endif
+
 /* -----------------------------------------------------------------------------
  * Block descriptor.  This structure *must* be the right length, so we
  * can do pointer arithmetic on pointers to it.
@@ -118,7 +131,9 @@ typedef struct bdescr_ {
                                // (if group head, 0 otherwise)
 
 #if SIZEOF_VOID_P == 8
-    StgWord32 _padding[3];
+    StgWord8  cards[BLOCK_CARDS]; // dirty cards of a BF_CARDS block, see
+                                  // Note [Card table] in rts/sm/CardTable.c
+    StgWord32 _padding[1];
 #else
     StgWord32 _padding[0];
 #endif
@@ -145,6 +160,8 @@ typedef struct bdescr_ {
 #define BF_MARKED    8
 /* Block is executable */
 #define BF_EXEC      32
+/* Block holds small pinned objects in fixed-size slots */
+#define BF_SLOTTED   16
 /* Block contains only a small amount of live data */
 #define BF_FRAGMENTED 64
 /* we know about this block (for finding leaks) */
@@ -153,6 +170,8 @@ typedef struct bdescr_ {
 #define BF_SWEPT     256
 /* Block is part of a Compact */
 #define BF_COMPACT   512
+/* Block holds only MUT_VARs, MVARs and TVARs, and uses the card table */
+#define BF_CARDS     1024
 /* Maximum flag value (do not define anything higher than this!) */
 #define BF_FLAG_MAX  (1 << 15)
 
@@ -92,6 +92,13 @@ typedef struct generation_ {
     memcount       n_large_words;       // no. of words used by large objs
     memcount       n_new_large_words;   // words of new large objects
                                         // (for doYouWantToGC())
+    memcount       n_pinned_free_words; // free slots in pinned size-class
+                                        // blocks, as of the last GC
+    memcount       n_promoted_large_objects; // large objects promoted into
+    memcount       n_promoted_large_words;   // this gen by the last GC
+    memcount       n_unswept_blocks;    // blocks at the front of blocks
+                                        // not swept yet (see Note [Lazy
+                                        // sweeping] in rts/sm/Sweep.c)
 
     bdescr *       compact_objects;     // compact objects chain
                                         // the second block in each compact is
@@ -153,10 +160,10 @@ typedef struct generation_ {
     bdescr *     live_compact_objects;  // live compact objs after GC (d-link)
     memcount     n_live_compact_blocks; // size (not count) of above
 
-    bdescr *     bitmap;                // bitmap for compacting collection
+    bdescr *     bitmap;                // bitmap for compacting collection,
+                                        // kept after GC until swept
 
     StgTSO *     old_threads;
-    StgWeak *    old_weak_ptr_list;
 } generation;
 
 extern generation * generations;
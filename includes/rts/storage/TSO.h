@@ -128,6 +128,9 @@ typedef struct StgTSO_ {
     StgThreadID             id;
     StgWord32               saved_errno;
     StgWord32               dirty;          /* non-zero => dirty */
+    StgWord32               priority;       // Values defined in Constants.h;
+                                            // its own word, like dirty, so
+                                            // that any thread may set it
     struct InCall_*         bound;
     struct Capability_*     cap;
 
@@ -160,6 +163,15 @@ typedef struct StgTSO_ {
      */
     StgInt64  alloc_limit;     /* in bytes */
 
+    /*
+     * The bytes the thread has allocated and the time it has spent
+     * running on a capability, for rts_getThreadUsage().  See Note
+     * [Thread usage] in rts/Schedule.c.  Like alloc_limit, use only
+     * PK_Word64/ASSIGN_Word64 to get/set them in C code.
+     */
+    StgWord64 allocated;       /* in bytes */
+    StgWord64 run_time;        /* units: TIME_RESOLUTION */
+
     /*
      * sum of the sizes of all stack chunks (in words), used to decide
      * whether to throw the StackOverflow exception when the stack
@@ -49,6 +49,11 @@ module GHC.Conc
         , ThreadStatus(..), BlockReason(..)
         , threadStatus
         , threadCapability
+        , ThreadPriority(..)
+        , setThreadPriority
+        , ThreadUsage(..)
+        , threadUsage
+        , listThreadUsage
 
         , newStablePtrPrimMVar, PrimMVar
 
@@ -58,6 +58,11 @@ module GHC.Conc.Sync
         , ThreadStatus(..), BlockReason(..)
         , threadStatus
         , threadCapability
+        , ThreadPriority(..)
+        , setThreadPriority
+        , ThreadUsage(..)
+        , threadUsage
+        , listThreadUsage
 
         , newStablePtrPrimMVar, PrimMVar
 
@@ -101,6 +106,7 @@ import Data.Typeable
 import Data.Maybe
 
 import GHC.Base
+import GHC.Conc.ThreadUsage
 import {-# SOURCE #-} GHC.IO.Handle ( hFlush )
 import {-# SOURCE #-} GHC.IO.Handle.FD ( stdout )
 import GHC.Int
@@ -111,6 +117,7 @@ import GHC.Exception
 import qualified GHC.Foreign
 import GHC.IORef
 import GHC.MVar
+import GHC.Num          ( Num(..) )
 import GHC.Ptr
 import GHC.Real         ( fromIntegral )
 import GHC.Show         ( Show(..), showParen, showString )
@@ -595,6 +602,68 @@ threadCapability (ThreadId t) = IO $ \s ->
    case threadStatus# t s of
      (# s', _, cap#, locked# #) -> (# s', (I# cap#, isTrue# (locked# /=# 0#)) #)
 
+-- | The scheduling priority of a thread.  A capability always runs its
+-- runnable threads of a higher priority before those of a lower one,
+-- except that a thread that has waited too long for threads of higher
+-- priority is run anyway (@+RTS --starvation-limit@).
+--
+-- @since 4.14.0.0
+data ThreadPriority
+  = HighPriority
+  | NormalPriority
+        -- ^the priority of the main thread, and the default
+  | LowPriority
+  deriving ( Eq, Ord, Show )
+
+-- | Set the scheduling priority of a thread.  A thread created by
+-- 'forkIO' or 'forkOn' starts with the priority of the thread that
+-- created it.  If the thread is already waiting to run, the new priority
+-- takes effect from the next time it is scheduled.
+--
+-- @since 4.14.0.0
+setThreadPriority :: ThreadId -> ThreadPriority -> IO ()
+setThreadPriority (ThreadId t) prio = IO $ \s ->
+   case setThreadPriority# t (prio_num prio) s of s1 -> (# s1, () #)
+   where
+        -- NB. keep these in sync with includes/rts/Constants.h
+     prio_num HighPriority   = 0#
+     prio_num NormalPriority = 1#
+     prio_num LowPriority    = 2#
+
+-- | How much the given thread has allocated and run.  For a thread
+-- that is running now, this doesn't include its current time slice.
+--
+-- @since 4.14.0.0
+threadUsage :: ThreadId -> IO ThreadUsage
+threadUsage (ThreadId t) =
+  allocaBytes sizeofThreadUsage $ \p -> do
+    rts_getThreadUsage t p
+    peekThreadUsage p
+
+-- | How much each thread that hasn't finished has allocated and run.
+-- This is for monitoring: the threads are in no particular order.
+--
+-- @since 4.14.0.0
+listThreadUsage :: IO [ThreadUsage]
+listThreadUsage = go 64
+  where
+    go n = allocaBytes (n * sizeofThreadUsage) $ \p -> do
+      m <- fromIntegral <$> rts_listThreadUsage p (fromIntegral n)
+      if m > n then go (m * 2) else peekAll p 0 m
+
+    peekAll p i m
+      | i == m    = return []
+      | otherwise = do
+          u  <- peekThreadUsage (p `plusPtr` (i * sizeofThreadUsage))
+          us <- peekAll p (i + 1) m
+          return (u : us)
+
+foreign import ccall unsafe "rts_getThreadUsage"
+  rts_getThreadUsage :: ThreadId# -> Ptr ThreadUsage -> IO ()
+
+foreign import ccall unsafe "rts_listThreadUsage"
+  rts_listThreadUsage :: Ptr ThreadUsage -> Word -> IO Word
+
 -- | Make a weak pointer to a 'ThreadId'.  It can be important to do
 -- this if you want to hold a reference to a 'ThreadId' while still
 -- allowing the thread to receive the @BlockedIndefinitely@ family of
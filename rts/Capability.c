@@ -24,6 +24,7 @@
 #include "Sparks.h"
 #include "Trace.h"
 #include "sm/GC.h" // for gcWorkerThread()
+#include "sm/Storage.h" // for PINNED_SIZE_CLASSES
 #include "STM.h"
 #include "RtsUtils.h"
 #include "sm/OSMem.h"
@@ -66,6 +67,12 @@ uint32_t n_numa_nodes;
 // Map logical NUMA node to OS node numbers
 uint32_t numa_map[MAX_NUMA_NODES];
 
+#if defined(THREADED_RTS)
+// The size of a Capability's deque of stealable threads; see
+// Note [Stealing threads] in Schedule.c
+#define STEALABLE_THREADS 64
+#endif
+
 /* Let foreign code get the current Capability -- assuming there is one!
  * This is useful for unsafe foreign calls because they are called with
  * the current Capability held, but they are not passed it. For example,
@@ -243,16 +250,22 @@ popReturningTask (Capability *cap)
 static void
 initCapability (Capability *cap, uint32_t i)
 {
-    uint32_t g;
+    uint32_t g, n;
 
     cap->no = i;
     cap->node = capNoToNumaNode(i);
     cap->in_haskell        = false;
+    cap->run_start         = 0;
     cap->idle              = 0;
     cap->disabled          = false;
 
-    cap->run_queue_hd      = END_TSO_QUEUE;
-    cap->run_queue_tl      = END_TSO_QUEUE;
+    for (n = 0; n < TSO_PRIORITIES; n++) {
+        cap->run_queue_hd[n]     = END_TSO_QUEUE;
+        cap->run_queue_tl[n]     = END_TSO_QUEUE;
+        cap->run_queue_passed[n] = 0;
+        cap->priority_runs[n]    = 0;
+        cap->priority_boosts[n]  = 0;
+    }
     cap->n_run_queue       = 0;
 
 #if defined(THREADED_RTS)
@@ -274,11 +287,24 @@ initCapability (Capability *cap, uint32_t i)
     cap->spark_stats.converted  = 0;
     cap->spark_stats.gcd        = 0;
     cap->spark_stats.fizzled    = 0;
+    cap->stealable          = newWSDeque(STEALABLE_THREADS);
+    cap->threads_published  = 0;
+    cap->threads_reclaimed  = 0;
+    cap->threads_stolen     = 0;
+    cap->idle_wait_avg      = RtsFlags.ParFlags.idleSpin / 2;
+    cap->idle_wakeups       = 0;
+    cap->idle_parks         = 0;
+    cap->idle_unparks       = 0;
+    cap->idle_wake_latency  = 0;
 #if !defined(mingw32_HOST_OS)
     cap->io_manager_control_wr_fd = -1;
 #endif
 #endif
     cap->total_allocated        = 0;
+    cap->nursery_quota          = 1;
+    cap->nursery_chunks         = 0;
+    cap->nursery_alloc_rate     = 0;
+    cap->nursery_alloc_mark     = 0;
 
     cap->f.stgEagerBlackholeInfo = (W_)&__stg_EAGER_BLACKHOLE_info;
     cap->f.stgGCEnter1     = (StgFunPtr)__stg_gc_enter_1;
@@ -304,6 +330,18 @@ initCapability (Capability *cap, uint32_t i)
     cap->context_switch = 0;
     cap->pinned_object_block = NULL;
     cap->pinned_object_blocks = NULL;
+    cap->pinned_class_blocks = stgCallocBytes(PINNED_SIZE_CLASSES,
+                                              sizeof(bdescr *),
+                                              "initCapability");
+    cap->pinned_reuse = stgCallocBytes(PINNED_SIZE_CLASSES,
+                                       sizeof(bdescr *),
+                                       "initCapability");
+    for (n = 0; n < BLOCK_CACHE_MAX_GROUP; n++) {
+        cap->block_cache[n] = NULL;
+    }
+    cap->block_cache_blocks = 0;
+    cap->block_cache_hits = 0;
+    cap->block_cache_misses = 0;
 
 #if defined(PROFILING)
     cap->r.rCCCS = CCS_SYSTEM;
@@ -473,7 +511,7 @@ void interruptAllCapabilities(void)
 
 #if defined(THREADED_RTS)
 static void
-giveCapabilityToTask (Capability *cap USED_IF_DEBUG, Task *task)
+giveCapabilityToTask (Capability *cap, Task *task)
 {
     ASSERT_LOCK_HELD(&cap->lock);
     ASSERT(task->cap == cap);
@@ -483,10 +521,15 @@ giveCapabilityToTask (Capability *cap USED_IF_DEBUG, Task *task)
     ACQUIRE_LOCK(&task->lock);
     if (task->wakeup == false) {
         task->wakeup = true;
+        task->woken_at = NSToTime(getMonotonicNSec());
         // the wakeup flag is needed because signalCondition() doesn't
         // flag the condition if the thread is already running, but we want
-        // it to be sticky.
-        signalCondition(&task->cond);
+        // it to be sticky.  A spinning Task will see the flag without
+        // the signal: see Note [Idle spinning].
+        if (!task->spinning) {
+            signalCondition(&task->cond);
+            cap->idle_unparks++;
+        }
     }
     RELEASE_LOCK(&task->lock);
 }
@@ -543,7 +586,7 @@ releaseCapability_ (Capability* cap,
     // give this Capability to the appropriate Task.
     if (!emptyRunQueue(cap) && peekRunQueue(cap)->bound) {
         // Make sure we're not about to try to wake ourselves up
-        // ASSERT(task != cap->run_queue_hd->bound);
+        // ASSERT(task != peekRunQueue(cap)->bound);
         // assertion is false: in schedule() we force a yield after
         // ThreadBlocked, but the thread may be back on the run queue
         // by now.
@@ -641,15 +684,118 @@ enqueueWorker (Capability* cap USED_IF_THREADS)
 
 #if defined(THREADED_RTS)
 
+/* Note [Idle spinning]
+   ~~~~~~~~~~~~~~~~~~~~
+
+   An idle worker sleeps on task->cond until giveCapabilityToTask()
+   hands it a Capability.  Waking it costs a futex wake, and then the
+   OS takes a while to run the thread again, and for a server that
+   goes idle and gets a new request a moment later, this is a good
+   part of its latency.  So before it goes to sleep, an idle worker
+   spins for a while (idleSpin()), watching task->wakeup.  While it
+   does so task->spinning is set, and giveCapabilityToTask() sets
+   task->wakeup without a signal.  task->spinning only changes with
+   task->lock held, and the worker checks task->wakeup again under the
+   lock before it sleeps, so no wakeup is lost.
+
+   Spinning wastes a CPU if no work comes, so the spin is adaptive.
+   Each Capability keeps a smoothed time that its workers waited
+   before they were woken (cap->idle_wait_avg, from task->woken_at).
+   A worker spins for twice that, up to +RTS --idle-spin, and not at
+   all if workers usually wait longer than --idle-spin, so a program
+   that is mostly idle doesn't spin.  Samples are clamped to twice
+   --idle-spin so that a long idle spell is soon forgotten.
+
+   Each Capability counts the workers woken and how many of them had
+   gone to sleep, the signals sent (unparks), and the total time from
+   the wakeup to the worker running.  +RTS -s shows these.
+*/
+
+static Time
+idleSpinBudget (Capability *cap)
+{
+    const Time max = RtsFlags.ParFlags.idleSpin;
+    const Time avg = cap->idle_wait_avg;   // no lock: just a hint
+
+    if (max == 0 || avg > max) {
+        return 0;
+    }
+    return stg_min(max, avg * 2);
+}
+
+static void
+idleSpin (Task *task)
+{
+    Time budget, deadline;
+    uint32_t i;
+
+    budget = idleSpinBudget(task->cap);
+    if (budget == 0) {
+        return;
+    }
+
+    ACQUIRE_LOCK(&task->lock);
+    if (task->wakeup) {
+        RELEASE_LOCK(&task->lock);
+        return;
+    }
+    task->spinning = true;
+    RELEASE_LOCK(&task->lock);
+
+    deadline = NSToTime(getMonotonicNSec()) + budget;
+    for (i = 1; !*(volatile bool *)&task->wakeup; i++) {
+        busy_wait_nop();
+        if (i % 64 == 0 && NSToTime(getMonotonicNSec()) >= deadline) {
+            break;
+        }
+    }
+    // the caller clears task->spinning with task->lock held
+}
+
+static void
+idleWoken (Capability *cap, Time wait_start, Time woken_at, bool parked)
+{
+    const Time max = RtsFlags.ParFlags.idleSpin;
+    Time waited;
+
+    ASSERT_LOCK_HELD(&cap->lock);
+
+    cap->idle_wakeups++;
+    if (parked) {
+        cap->idle_parks++;
+    }
+    if (woken_at == 0) {
+        return;
+    }
+    cap->idle_wake_latency += NSToTime(getMonotonicNSec()) - woken_at;
+    if (max != 0) {
+        waited = stg_min(woken_at - wait_start, max * 2);
+        cap->idle_wait_avg = (cap->idle_wait_avg * 3 + waited) / 4;
+    }
+}
+
 static Capability * waitForWorkerCapability (Task *task)
 {
     Capability *cap;
+    Time wait_start = NSToTime(getMonotonicNSec());
+    Time woken_at = 0;
+    bool parked = false;
 
     for (;;) {
+        // See Note [Idle spinning]
+        idleSpin(task);
+
         ACQUIRE_LOCK(&task->lock);
         // task->lock held, cap->lock not held
-        if (!task->wakeup) waitCondition(&task->cond, &task->lock);
+        task->spinning = false;
+        if (!task->wakeup) {
+            waitCondition(&task->cond, &task->lock);
+            parked = true;
+        }
         cap = task->cap;
+        if (task->wakeup) {
+            woken_at = task->woken_at;
+        }
         task->wakeup = false;
         RELEASE_LOCK(&task->lock);
 
@@ -686,6 +832,7 @@ static Capability * waitForWorkerCapability (Task *task)
         }
 
         cap->running_task = task;
+        idleWoken(cap, wait_start, woken_at, parked);
         RELEASE_LOCK(&cap->lock);
         break;
     }
@@ -861,6 +1008,8 @@ yieldCapability (Capability** pCap, Task *task, bool gcAllowed)
                 gcWorkerThread(cap);
                 traceEventGcEnd(cap);
                 traceSparkCounters(cap);
+                traceCapThreadSteals(cap);
+                traceCapPriorityStats(cap);
                 // See Note [migrated bound threads 2]
                 if (task->cap == cap) {
                     return true;
@@ -1094,6 +1243,8 @@ shutdownCapability (Capability *cap USED_IF_THREADS,
         }
 
         traceSparkCounters(cap);
+        traceCapThreadSteals(cap);
+        traceCapPriorityStats(cap);
         RELEASE_LOCK(&cap->lock);
         break;
     }
@@ -1125,8 +1276,11 @@ freeCapability (Capability *cap)
 {
     stgFree(cap->mut_lists);
     stgFree(cap->saved_mut_lists);
+    stgFree(cap->pinned_class_blocks);
+    stgFree(cap->pinned_reuse);
 #if defined(THREADED_RTS)
     freeSparkPool(cap->sparks);
+    freeWSDeque(cap->stealable);
 #endif
     traceCapsetRemoveCap(CAPSET_OSPROCESS_DEFAULT, cap->no);
     traceCapsetRemoveCap(CAPSET_CLOCKDOMAIN_DEFAULT, cap->no);
@@ -1162,14 +1316,17 @@ markCapability (evac_fn evac, void *user, Capability *cap,
                 bool no_mark_sparks USED_IF_THREADS)
 {
     InCall *incall;
+    uint32_t i;
 
     // Each GC thread is responsible for following roots from the
     // Capability of the same number.  There will usually be the same
     // or fewer Capabilities as GC threads, but just in case there
     // are more, we mark every Capability whose number is the GC
     // thread's index plus a multiple of the number of GC threads.
-    evac(user, (StgClosure **)(void *)&cap->run_queue_hd);
-    evac(user, (StgClosure **)(void *)&cap->run_queue_tl);
+    for (i = 0; i < TSO_PRIORITIES; i++) {
+        evac(user, (StgClosure **)(void *)&cap->run_queue_hd[i]);
+        evac(user, (StgClosure **)(void *)&cap->run_queue_tl[i]);
+    }
 #if defined(THREADED_RTS)
     evac(user, (StgClosure **)(void *)&cap->inbox);
 #endif
@@ -21,6 +21,7 @@
 #pragma once
 
 #include "sm/GC.h" // for evac_fn
+#include "sm/BlockAlloc.h" // for BLOCK_CACHE_MAX_GROUP
 #include "Task.h"
 #include "Sparks.h"
 
@@ -54,19 +55,35 @@ struct Capability_ {
     // catching unsafe call-ins.
     bool in_haskell;
 
+    // When the thread running here started running, with
+    // +RTS --thread-usage.  See Note [Thread usage] in Schedule.c.
+    Time run_start;
+
     // Has there been any activity on this Capability since the last GC?
     uint32_t idle;
 
     bool disabled;
 
-    // The run queue.  The Task owning this Capability has exclusive
-    // access to its run queue, so can wake up threads without
+    // The run queues, one for each thread priority (see Note [Thread
+    // priorities] in Schedule.c); n_run_queue counts the threads on
+    // all of them.  The Task owning this Capability has exclusive
+    // access to its run queues, so can wake up threads without
     // taking a lock, and the common path through the scheduler is
     // also lock-free.
-    StgTSO *run_queue_hd;
-    StgTSO *run_queue_tl;
+    StgTSO *run_queue_hd[TSO_PRIORITIES];
+    StgTSO *run_queue_tl[TSO_PRIORITIES];
     uint32_t n_run_queue;
 
+    // For each priority, the number of threads of a higher priority
+    // that have been run since a thread of this one has been waiting
+    uint32_t run_queue_passed[TSO_PRIORITIES];
+
+    // Stats on thread priorities: the threads run from each run
+    // queue, and how many of those ran ahead of a higher priority to
+    // avoid starving
+    W_ priority_runs[TSO_PRIORITIES];
+    W_ priority_boosts[TSO_PRIORITIES];
+
     // Tasks currently making safe foreign calls.  Doubly-linked.
     // When returning, a task first acquires the Capability before
     // removing itself from this list, so that the GC can find all
@@ -89,6 +106,22 @@ struct Capability_ {
     // full pinned object blocks allocated since the last GC
     bdescr *pinned_object_blocks;
 
+    // For small pinned objects: the block being filled for each size
+    // class, and the blocks with free slots found by the GC, chained
+    // through their headers.  Both indexed by size class.
+    // See Note [Pinned size classes] in sm/Storage.c
+    bdescr **pinned_class_blocks;
+    bdescr **pinned_reuse;
+
+    // Free block groups of 1..BLOCK_CACHE_MAX_GROUP blocks, indexed by
+    // group size - 1, so that allocate() and friends don't have to take
+    // sm_mutex for every block.  Emptied at each GC.
+    // See Note [Capability block cache] in sm/BlockAlloc.c
+    bdescr *block_cache[BLOCK_CACHE_MAX_GROUP];
+    uint32_t block_cache_blocks;    // total blocks in block_cache
+    W_ block_cache_hits;            // since the last GC
+    W_ block_cache_misses;          // since the last GC
+
     // per-capability weak pointer list associated with nursery (older
     // lists stored in generation object)
     StgWeak *weak_ptr_list_hd;
@@ -112,6 +145,14 @@ struct Capability_ {
     // See Note [allocation accounting] in Storage.c
     W_ total_allocated;
 
+    // Nursery chunks this cap may take before borrowing from the
+    // other caps, and the number taken since the last GC (+RTS -Aauto).
+    // See Note [Adaptive nursery sizing] in Storage.c
+    W_ nursery_quota;
+    W_ nursery_chunks;
+    W_ nursery_alloc_rate;   // smoothed words allocated per GC
+    W_ nursery_alloc_mark;   // total_allocated at the last GC
+
 #if defined(THREADED_RTS)
     // Worker Tasks waiting in the wings.  Singly-linked.
     Task *spare_workers;
@@ -121,7 +162,6 @@ struct Capability_ {
     //    running_task
     //    returning_tasks_{hd,tl}
     //    wakeup_queue
-    //    inbox
     //    putMVars
     Mutex lock;
 
@@ -135,7 +175,7 @@ struct Capability_ {
     uint32_t n_returning_tasks;
 
     // Messages, or END_TSO_QUEUE.
-    // Locks required: cap->lock
+    // Locks required: none; see Note [Capability inbox] in Messages.c
     Message *inbox;
 
     // putMVars are really messages, but they're allocated with malloc() so they
@@ -146,6 +186,24 @@ struct Capability_ {
 
     // Stats on spark creation/conversion
     SparkCounters spark_stats;
+
+    // Runnable threads taken off the run queue so that idle
+    // Capabilities can steal them.  See Note [Stealing threads] in
+    // Schedule.c.
+    WSDeque *stealable;
+
+    // Stats on thread stealing
+    W_ threads_published;
+    W_ threads_reclaimed;
+    W_ threads_stolen;
+
+    // Idle workers waiting for this Capability: see Note [Idle
+    // spinning] in Capability.c.  Locks required: cap->lock
+    Time idle_wait_avg;         // smoothed time until a worker is woken
+    W_ idle_wakeups;            // workers woken ...
+    W_ idle_parks;              // ... of which had gone to sleep
+    W_ idle_unparks;            // Tasks woken with signalCondition()
+    Time idle_wake_latency;     // total time from wakeup to running
 #if !defined(mingw32_HOST_OS)
     // IO manager for this cap
     int io_manager_control_wr_fd;
@@ -194,8 +252,10 @@ struct Capability_ {
 // Task is bound, its thread has just blocked, and it may have been
 // moved to another Capability.
 #define ASSERT_PARTIAL_CAPABILITY_INVARIANTS(cap,task)                  \
-  ASSERT(cap->run_queue_hd == END_TSO_QUEUE ?                           \
-            cap->run_queue_tl == END_TSO_QUEUE && cap->n_run_queue == 0 \
+  ASSERT(cap->n_run_queue == 0 ?                                        \
+            cap->run_queue_hd[TSO_PRIORITY_HIGH] == END_TSO_QUEUE &&    \
+            cap->run_queue_hd[TSO_PRIORITY_NORMAL] == END_TSO_QUEUE &&  \
+            cap->run_queue_hd[TSO_PRIORITY_LOW] == END_TSO_QUEUE        \
          : 1);                                                          \
   ASSERT(cap->suspended_ccalls == NULL ? cap->n_suspended_ccalls == 0 : 1); \
   ASSERT(myTask() == task);                                             \
@@ -423,7 +483,16 @@ recordClosureMutated (Capability *cap, StgClosure *p)
 {
     bdescr *bd;
     bd = Bdescr((StgPtr)p);
-    if (bd->gen_no != 0) recordMutableCap(p,cap,bd->gen_no);
+    if (bd->gen_no != 0) {
+#if defined(BLOCK_CARDS)
+        // With +RTS --card-table; see Note [Card table] in sm/CardTable.c
+        if (bd->flags & BF_CARDS) {
+            bd->cards[CARD_OF(p)] = 1;
+            return;
+        }
+#endif
+        recordMutableCap(p,cap,bd->gen_no);
+    }
 }
 
 
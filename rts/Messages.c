@@ -21,9 +21,40 @@
 
 #if defined(THREADED_RTS)
 
+/* Note [Capability inbox]
+   ~~~~~~~~~~~~~~~~~~~~~~~
+
+   Each Capability has an inbox of messages from the others (wakeups,
+   throwTos and blackhole blocks).  Many Capabilities may send to one,
+   but only its owner takes messages out, so the inbox is a lock-free
+   stack linked through msg->link:
+
+     - sendMessage() pushes a message with a CAS on cap->inbox;
+
+     - scheduleProcessInbox() takes the whole stack at once with an
+       xchg, and executes the batch.  As before, the messages of a
+       batch are executed newest first.
+
+   The one thing the lock is still needed for is to make sure that the
+   Capability looks at a non-empty inbox, even if it is going idle.
+   The owner only goes idle after checking that the inbox is empty with
+   cap->lock held (releaseCapability_()), so it is enough for a sender
+   that pushes onto an empty inbox to take cap->lock after the push,
+   and either wake up the Capability, if it is idle, or interrupt it.
+   A sender that pushes onto a non-empty inbox has nothing to do: the
+   sender of the message underneath it has done this or is about to,
+   and the owner hasn't taken that message yet.  So under heavy
+   traffic most messages cost a single CAS, and the owner is
+   interrupted once for each batch rather than for each message.
+
+   cap->putMVars (from hs_try_putmvar()) are malloc()ed, not heap
+   objects, so they don't go on the inbox, and are still protected by
+   cap->lock.
+*/
+
 void sendMessage(Capability *from_cap, Capability *to_cap, Message *msg)
 {
-    ACQUIRE_LOCK(&to_cap->lock);
+    Message *head;
 
 #if defined(DEBUG)
     {
@@ -38,11 +69,21 @@ void sendMessage(Capability *from_cap, Capability *to_cap, Message *msg)
     }
 #endif
 
-    msg->link = to_cap->inbox;
-    to_cap->inbox = msg;
-
     recordClosureMutated(from_cap,(StgClosure*)msg);
 
+    // See Note [Capability inbox]
+    do {
+        head = (Message *)VOLATILE_LOAD(&to_cap->inbox);
+        msg->link = head;
+    } while (cas((StgVolatilePtr)&to_cap->inbox, (StgWord)head,
+                 (StgWord)msg) != (StgWord)head);
+
+    if (head != (Message*)END_TSO_QUEUE) {
+        return;
+    }
+
+    ACQUIRE_LOCK(&to_cap->lock);
+
     if (to_cap->running_task == NULL) {
         to_cap->running_task = myTask();
             // precond for releaseCapability_()
@@ -214,6 +255,8 @@ loop:
         owner = (StgTSO*)p;
 
 #if defined(THREADED_RTS)
+        // see Note [Stealing threads] in Schedule.c
+        reclaimThread(cap, owner);
         if (owner->cap != cap) {
             sendMessage(cap, owner->cap, (Message*)msg);
             debugTraceCap(DEBUG_sched, cap, "forwarding message to cap %d",
@@ -282,6 +325,7 @@ loop:
         ASSERT(owner != END_TSO_QUEUE);
 
 #if defined(THREADED_RTS)
+        reclaimThread(cap, owner);
         if (owner->cap != cap) {
             sendMessage(cap, owner->cap, (Message*)msg);
             debugTraceCap(DEBUG_sched, cap, "forwarding message to cap %d",
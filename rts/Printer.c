@@ -681,10 +681,6 @@ void printWeakLists()
         for (StgWeak *weak = gen->weak_ptr_list; weak; weak = weak->link) {
             printClosure((StgClosure*)weak);
         }
-        debugBelch("Generation %d old weaks:\n", gen_idx);
-        for (StgWeak *weak = gen->old_weak_ptr_list; weak; weak = weak->link) {
-            printClosure((StgClosure*)weak);
-        }
     }
 
     debugBelch("=========================\n");
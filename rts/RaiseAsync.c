@@ -259,6 +259,12 @@ check_target:
     traceThreadStatus(DEBUG_sched, target);
 #endif
 
+#if defined(THREADED_RTS)
+    // target may be waiting to be stolen; see Note [Stealing threads]
+    // in Schedule.c
+    reclaimThread(cap, target);
+#endif
+
     target_cap = target->cap;
     if (target->cap != cap) {
         throwToSendMsg(cap, target_cap, msg);
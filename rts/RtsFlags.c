@@ -142,10 +142,17 @@ void initRtsFlagsDefaults(void)
     RtsFlags.GcFlags.initialStkSize     = 1024 / sizeof(W_);
     RtsFlags.GcFlags.stkChunkSize       = (32 * 1024) / sizeof(W_);
     RtsFlags.GcFlags.stkChunkBufferSize = (1 * 1024) / sizeof(W_);
+    RtsFlags.GcFlags.stkSplitSize       = 0;
 
     RtsFlags.GcFlags.minAllocAreaSize   = (1024 * 1024)       / BLOCK_SIZE;
+    RtsFlags.GcFlags.minAllocAreaSizeAuto = false;
     RtsFlags.GcFlags.largeAllocLim      = 0; /* defaults to minAllocAreasize */
     RtsFlags.GcFlags.nurseryChunkSize   = 0;
+#if defined(THREADED_RTS)
+    RtsFlags.GcFlags.blockCacheSize     = (256 * 1024) / BLOCK_SIZE;
+#else
+    RtsFlags.GcFlags.blockCacheSize     = 0;
+#endif
     RtsFlags.GcFlags.minOldGenSize      = (1024 * 1024)       / BLOCK_SIZE;
     RtsFlags.GcFlags.maxHeapSize        = 0;    /* off by default */
     RtsFlags.GcFlags.heapLimitGrace     = (1024 * 1024);
@@ -158,6 +165,7 @@ void initRtsFlagsDefaults(void)
     RtsFlags.GcFlags.compact            = false;
     RtsFlags.GcFlags.compactThreshold   = 30.0;
     RtsFlags.GcFlags.sweep              = false;
+    RtsFlags.GcFlags.concurrentMark     = false;
     RtsFlags.GcFlags.idleGCDelayTime    = USToTime(300000); // 300ms
 #if defined(THREADED_RTS)
     RtsFlags.GcFlags.doIdleGC           = true;
@@ -165,11 +173,21 @@ void initRtsFlagsDefaults(void)
     RtsFlags.GcFlags.doIdleGC           = false;
 #endif
     RtsFlags.GcFlags.heapBase           = 0;   /* means don't care */
+    RtsFlags.GcFlags.hugePages          = false;
+    RtsFlags.GcFlags.decommitRate       = 0;   /* decommit during GC */
+    RtsFlags.GcFlags.decommitTarget     = 0;   /* none */
+    RtsFlags.GcFlags.prefetchDepth      = 0;   /* no prefetching */
+    RtsFlags.GcFlags.cardTable          = false;
+    RtsFlags.GcFlags.pretenureThreshold = 0;   /* no pretenuring */
+    RtsFlags.GcFlags.finalizerThread    = false;
+    RtsFlags.GcFlags.eagerSelectors     = false;
+    RtsFlags.GcFlags.staticRootsInterval = 0;  /* walk at every major GC */
     RtsFlags.GcFlags.allocLimitGrace    = (100*1024) / BLOCK_SIZE;
     RtsFlags.GcFlags.numa               = false;
     RtsFlags.GcFlags.numaMask           = 1;
     RtsFlags.GcFlags.ringBell           = false;
     RtsFlags.GcFlags.longGCSync         = 0; /* detection turned off */
+    RtsFlags.GcFlags.pauseTarget        = 0; /* no target */
 
     RtsFlags.DebugFlags.scheduler       = false;
     RtsFlags.DebugFlags.interpreter     = false;
@@ -229,6 +247,8 @@ void initRtsFlagsDefaults(void)
     RtsFlags.MiscFlags.tickInterval     = DEFAULT_TICK_INTERVAL;
 #endif
     RtsFlags.ConcFlags.ctxtSwitchTime   = USToTime(20000); // 20ms
+    RtsFlags.ConcFlags.starvationLimit  = 16;
+    RtsFlags.ConcFlags.threadUsage      = false;
 
     RtsFlags.MiscFlags.install_signal_handlers = true;
     RtsFlags.MiscFlags.install_seh_handlers    = true;
@@ -249,6 +269,8 @@ void initRtsFlagsDefaults(void)
     RtsFlags.ParFlags.parGcNoSyncWithIdle   = 0;
     RtsFlags.ParFlags.parGcThreads      = 0; /* defaults to -N */
     RtsFlags.ParFlags.setAffinity       = 0;
+    RtsFlags.ParFlags.loadBalance       = LOAD_BALANCE_PUSH;
+    RtsFlags.ParFlags.idleSpin          = USToTime(20);
 #endif
 
 #if defined(THREADED_RTS)
@@ -281,20 +303,61 @@ usage_text[] = {
 "  -ki<size> Sets the initial thread stack size (default 1k)  Egs: -ki4k -ki2m",
 "  -kc<size> Sets the stack chunk size (default 32k)",
 "  -kb<size> Sets the stack chunk buffer size (default 1k)",
+"  -kw<size> Split a stack chunk deeper than <size> when its thread is",
+"            descheduled, so the GC can skip the deep part (default: off)",
 "",
 "  -A<size>  Sets the minimum allocation area size (default 1m) Egs: -A20m -A10k",
+"  -Aauto    Size each capability's allocation area by its allocation rate,",
+"            sharing the -A<size> of all capabilities between them",
 "  -AL<size> Sets the amount of large-object memory that can be allocated",
 "            before a GC is triggered (default: the value of -A)",
 "  -F<n>     Sets the collecting threshold for old generations as a factor of",
 "            the live data in that generation the last time it was collected",
 "            (default: 2.0)",
+"  -xP<time> Size the allocation area and the generations to keep GC pauses",
+"            under <time> seconds (or milliseconds with an ms suffix)",
 "  -n<size>  Allocation area chunk size (0 = disabled, default: 0)",
+#if defined(THREADED_RTS)
+"  --block-cache=<size>",
+"            Size of the per-capability cache of free blocks",
+"            (0 = disabled, default: 256k)",
+#endif
 "  -O<size>  Sets the minimum size of the old generation (default 1M)",
 "  -M<size>  Sets the maximum heap size (default unlimited)  Egs: -M256k -M1G",
 "  -H<size>  Sets the minimum heap size (default 0M)   Egs: -H24m  -H1G",
 "  -xb<addr> Sets the address from which a suitable start for the heap memory",
 "            will be searched from. This is useful if the default address",
 "            clashes with some third-party library.",
+"  -xH       Ask the OS to back the heap with transparent huge pages",
+#if defined(THREADED_RTS)
+"  --decommit-rate=<size>",
+"            Return free memory to the OS from a background thread, at",
+"            most <size> per second (0 = during GC, default: 0)",
+#endif
+"  --decommit-target=<size>",
+"            Return free memory to the OS until the heap is no larger",
+"            than <size> (default: none)",
+"  --gc-prefetch=<n>",
+"            Prefetch the objects <n> pointers ahead of the scavenger",
+"            during GC (0 = off, max 64, default: 0)",
+"  --card-table",
+"            Remember writes to old mutable variables (IORef, MVar, TVar)",
+"            in a card table instead of the mutable list",
+"  --pretenure[=<n>]",
+"            Copy constructors of which at least <n>% of the survivors",
+"            are promoted straight to the old generation (default: 80)",
+#if defined(THREADED_RTS)
+"  --finalizer-thread",
+"            Run C finalizers (e.g. of ForeignPtrs) on an OS thread of",
+"            their own",
+#endif
+"  --eager-selectors",
+"            Evaluate selector thunks during GC however deeply they are",
+"            nested",
+"  --cache-static-roots[=<n>]",
+"            Walk the static objects to find the live CAFs at only one",
+"            major GC in <n>, and keep the CAFs found alive in between",
+"            (default: 8)",
 "  -m<n>     Minimum % of heap which must be available (default 3%)",
 "  -G<n>     Number of generations (default: 2)",
 "  -c<n>     Use in-place compaction instead of copying in the oldest generation",
@@ -304,6 +367,8 @@ usage_text[] = {
 "           (the default is to use copying)",
 "  -w       Use mark-region for the oldest generation (experimental)",
 #if defined(THREADED_RTS)
+"  -xn      Mark the oldest generation concurrently with the program;",
+"           implies -w (experimental)",
 "  -I<sec>  Perform full GC after <sec> idle time (default: 0.3, 0 == off)",
 #endif
 "",
@@ -385,6 +450,11 @@ usage_text[] = {
 "  -C<secs>  Context-switch interval in seconds.",
 "            0 or no argument means switch as often as possible.",
 "            Default: 0.02 sec.",
+"  --starvation-limit=<n>",
+"            Run a thread waiting behind threads of a higher priority",
+"            once <n> of them have run (0 == never, default: 16)",
+"  --thread-usage",
+"            Count the time that each thread runs (see GHC.Conc.threadUsage)",
 "  -V<secs>  Master tick interval in seconds (0 == disable timer).",
 "            This sets the resolution for -C and the heap profile timer -i,",
 "            and is the frequency of time profile samples.",
@@ -428,6 +498,13 @@ usage_text[] = {
 "  -qn<n>    Use <n> threads for parallel GC (defaults to value of -N)",
 "  -qa       Use the OS to set thread affinity (experimental)",
 "  -qm       Don't automatically migrate threads between CPUs",
+"  --load-balance=<push|steal|hybrid>",
+"            How idle CPUs get threads: pushed by busy ones, stolen from",
+"            busy ones, or both (default: push)",
+"  --idle-spin=<n>",
+"            Let an idle worker spin for up to <n> microseconds before it",
+"            sleeps, if it is usually woken that soon (0 == never,",
+"            default: 20)",
 "  -qi<n>    If a processor has been idle for the last <n> GCs, do not",
 "            wake it up for a non-load-balancing parallel GC.",
 "            (0 disables,  default: 0)",
@@ -966,6 +1043,144 @@ error = true;
                       }
                   }
 #endif
+                  else if (!strncmp("block-cache=", &rts_argv[arg][2], 12)) {
+                      OPTION_UNSAFE;
+                      THREADED_BUILD_ONLY(
+                          RtsFlags.GcFlags.blockCacheSize
+                              = decodeSize(rts_argv[arg], 14, 0, HS_INT_MAX)
+                                  / BLOCK_SIZE;
+                          );
+                      break;
+                  }
+                  else if (!strncmp("decommit-rate=",
+                                    &rts_argv[arg][2], 14)) {
+                      OPTION_UNSAFE;
+                      THREADED_BUILD_ONLY(
+                          StgWord64 rate
+                              = decodeSize(rts_argv[arg], 16, 0, HS_INT_MAX);
+                          // less than a block a second would round down
+                          // to 0, which means decommitting during GC
+                          if (rate != 0 && rate < BLOCK_SIZE) {
+                              bad_option( rts_argv[arg] );
+                          }
+                          RtsFlags.GcFlags.decommitRate = rate / BLOCK_SIZE;
+                          );
+                      break;
+                  }
+                  else if (!strncmp("decommit-target=",
+                                    &rts_argv[arg][2], 16)) {
+                      OPTION_UNSAFE;
+                      RtsFlags.GcFlags.decommitTarget
+                          = decodeSize(rts_argv[arg], 18, 0, HS_INT_MAX)
+                              / BLOCK_SIZE;
+                      break;
+                  }
+                  else if (!strncmp("gc-prefetch=",
+                                    &rts_argv[arg][2], 12)) {
+                      OPTION_UNSAFE;
+                      RtsFlags.GcFlags.prefetchDepth
+                          = strtol(rts_argv[arg]+14, (char **) NULL, 10);
+                      if (RtsFlags.GcFlags.prefetchDepth > 64) {
+                          errorBelch("%s: at most 64 pointers can be "
+                                     "prefetched", rts_argv[arg]);
+                          error = true;
+                      }
+                      break;
+                  }
+                  else if (strequal("card-table", &rts_argv[arg][2])) {
+                      OPTION_UNSAFE;
+                      RtsFlags.GcFlags.cardTable = true;
+                      break;
+                  }
+                  else if (!strncmp("pretenure", &rts_argv[arg][2], 9)) {
+                      OPTION_UNSAFE;
+                      if (rts_argv[arg][11] == '\0') {
+                          RtsFlags.GcFlags.pretenureThreshold = 80;
+                      } else if (rts_argv[arg][11] == '=') {
+                          RtsFlags.GcFlags.pretenureThreshold
+                              = strtol(rts_argv[arg]+12, (char **) NULL, 10);
+                          if (RtsFlags.GcFlags.pretenureThreshold < 1 ||
+                              RtsFlags.GcFlags.pretenureThreshold > 100) {
+                              errorBelch("%s: the threshold must be between "
+                                         "1 and 100", rts_argv[arg]);
+                              error = true;
+                          }
+                      } else {
+                          bad_option( rts_argv[arg] );
+                      }
+                      break;
+                  }
+                  else if (strequal("finalizer-thread", &rts_argv[arg][2])) {
+                      OPTION_UNSAFE;
+                      THREADED_BUILD_ONLY(
+                          RtsFlags.GcFlags.finalizerThread = true;
+                          );
+                      break;
+                  }
+                  else if (!strncmp("load-balance=", &rts_argv[arg][2], 13)) {
+                      OPTION_UNSAFE;
+                      THREADED_BUILD_ONLY(
+                          const char *how = &rts_argv[arg][15];
+                          if (strequal("push", how)) {
+                              RtsFlags.ParFlags.loadBalance = LOAD_BALANCE_PUSH;
+                          } else if (strequal("steal", how)) {
+                              RtsFlags.ParFlags.loadBalance = LOAD_BALANCE_STEAL;
+                          } else if (strequal("hybrid", how)) {
+                              RtsFlags.ParFlags.loadBalance = LOAD_BALANCE_HYBRID;
+                          } else {
+                              bad_option( rts_argv[arg] );
+                          }
+                          );
+                      break;
+                  }
+                  else if (!strncmp("idle-spin=", &rts_argv[arg][2], 10)) {
+                      OPTION_UNSAFE;
+                      THREADED_BUILD_ONLY(
+                          char *end;
+                          long us = strtol(rts_argv[arg]+12, &end, 10);
+                          if (end == rts_argv[arg]+12 || *end != '\0' ||
+                              us < 0) {
+                              bad_option( rts_argv[arg] );
+                          }
+                          RtsFlags.ParFlags.idleSpin = USToTime(us);
+                          );
+                      break;
+                  }
+                  else if (strequal("eager-selectors", &rts_argv[arg][2])) {
+                      OPTION_UNSAFE;
+                      RtsFlags.GcFlags.eagerSelectors = true;
+                      break;
+                  }
+                  else if (!strncmp("cache-static-roots",
+                                    &rts_argv[arg][2], 18)) {
+                      OPTION_UNSAFE;
+                      if (rts_argv[arg][20] == '\0') {
+                          RtsFlags.GcFlags.staticRootsInterval = 8;
+                      } else if (rts_argv[arg][20] == '=') {
+                          RtsFlags.GcFlags.staticRootsInterval
+                              = strtol(rts_argv[arg]+21, (char **) NULL, 10);
+                          if (RtsFlags.GcFlags.staticRootsInterval < 1) {
+                              errorBelch("%s: the interval must be at "
+                                         "least 1", rts_argv[arg]);
+                              error = true;
+                          }
+                      } else {
+                          bad_option( rts_argv[arg] );
+                      }
+                      break;
+                  }
+                  else if (!strncmp("starvation-limit=",
+                                    &rts_argv[arg][2], 17)) {
+                      OPTION_SAFE;
+                      RtsFlags.ConcFlags.starvationLimit
+                          = strtol(rts_argv[arg]+19, (char **) NULL, 10);
+                      break;
+                  }
+                  else if (strequal("thread-usage", &rts_argv[arg][2])) {
+                      OPTION_SAFE;
+                      RtsFlags.ConcFlags.threadUsage = true;
+                      break;
+                  }
                   else if (!strncmp("long-gc-sync=", &rts_argv[arg][2], 13)) {
                       OPTION_SAFE;
                       if (rts_argv[arg][2] == '\0') {
@@ -988,6 +1203,8 @@ error = true;
                       RtsFlags.GcFlags.largeAllocLim
                           = decodeSize(rts_argv[arg], 3, 2*BLOCK_SIZE,
                                        HS_INT_MAX) / BLOCK_SIZE;
+                  } else if (strequal("auto", &rts_argv[arg][2])) {
+                      RtsFlags.GcFlags.minAllocAreaSizeAuto = true;
                   } else {
                       // minimum two blocks in the nursery, so that we have one
                       // to grab for allocate().
@@ -1058,6 +1275,11 @@ error = true;
                       decodeSize(rts_argv[arg], 3, sizeof(W_), HS_WORD_MAX)
                       / sizeof(W_);
                   break;
+                case 'w':
+                  RtsFlags.GcFlags.stkSplitSize =
+                      decodeSize(rts_argv[arg], 3, sizeof(W_), HS_WORD_MAX)
+                      / sizeof(W_);
+                  break;
                 case 'i':
                   RtsFlags.GcFlags.initialStkSize =
                       decodeSize(rts_argv[arg], 3, sizeof(W_), HS_WORD_MAX)
@@ -1507,6 +1729,38 @@ error = true;
                     }
                     break;
 
+                case 'P': /* GC pause target */
+                    OPTION_UNSAFE;
+                    {
+                        char *end;
+                        double t = strtod(rts_argv[arg]+3, &end);
+                        if (strequal(end, "ms")) {
+                            t /= 1000;
+                        } else if (*end != '\0') {
+                            bad_option( rts_argv[arg] );
+                        }
+                        if (end == rts_argv[arg]+3 || t <= 0) {
+                            bad_option( rts_argv[arg] );
+                        }
+                        RtsFlags.GcFlags.pauseTarget = fsecondsToTime(t);
+                    }
+                    break;
+
+                case 'H': /* back the heap with huge pages */
+                    OPTION_UNSAFE;
+                    RtsFlags.GcFlags.hugePages = true;
+                    unchecked_arg_start++;
+                    goto check_rest;
+
+                case 'n': /* concurrent mark of the oldest generation */
+                    OPTION_UNSAFE;
+                    THREADED_BUILD_ONLY(
+                        RtsFlags.GcFlags.concurrentMark = true;
+                        RtsFlags.GcFlags.sweep = true;
+                        );
+                    unchecked_arg_start++;
+                    goto check_rest;
+
 #if defined(x86_64_HOST_ARCH)
                 case 'p': /* linkerAlwaysPic */
                     OPTION_UNSAFE;
@@ -1681,6 +1935,15 @@ static void normaliseRtsOpts (void)
         RtsFlags.GcFlags.nurseryChunkSize = (4*1024*1024) / BLOCK_SIZE;
     }
 
+    // -Aauto hands out the allocation area in chunks, so that it can be
+    // divided unevenly between the capabilities.  See Note [Adaptive
+    // nursery sizing] in Storage.c.
+    if (RtsFlags.GcFlags.minAllocAreaSizeAuto &&
+        RtsFlags.GcFlags.nurseryChunkSize == 0) {
+        RtsFlags.GcFlags.nurseryChunkSize =
+            stg_max(2, RtsFlags.GcFlags.minAllocAreaSize / 8);
+    }
+
     if (RtsFlags.ParFlags.parGcLoadBalancingGen == ~0u) {
         StgWord alloc_area_bytes
             = RtsFlags.GcFlags.minAllocAreaSize * BLOCK_SIZE;
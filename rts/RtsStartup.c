@@ -243,6 +243,9 @@ hs_init_ghc(int *argc, char **argv[], RtsConfig rts_config)
     /* initialize the storage manager */
     initStorage();
 
+    /* start the thread that runs C finalizers, if there is to be one */
+    startFinalizerThread();
+
     /* initialise the stable pointer table */
     initStablePtrTable();
 
@@ -391,6 +394,11 @@ hs_exit_(bool wait_foreign)
     /* stop all running tasks */
     exitScheduler(wait_foreign);
 
+    /* the finalizer thread may stop with C finalizers still pending,
+       from the last GC or from the batches it didn't get to */
+    stopFinalizerThread();
+    runSomeFinalizers(true);
+
     /* run C finalizers for all active weak pointers */
     for (i = 0; i < n_capabilities; i++) {
         runAllCFinalizers(capabilities[i]->weak_ptr_list_hd);
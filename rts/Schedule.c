@@ -28,6 +28,9 @@
 #include "Weak.h"
 #include "sm/GC.h" // waitForGcThreads, releaseGCThreads, N
 #include "sm/GCThread.h"
+#include "sm/Decommit.h"
+#include "sm/NonMoving.h"
+#include "sm/Sweep.h"
 #include "Sparks.h"
 #include "Capability.h"
 #include "Task.h"
@@ -140,6 +143,8 @@ static void scheduleProcessInbox(Capability **cap);
 static void scheduleDetectDeadlock (Capability **pcap, Task *task);
 static void schedulePushWork(Capability *cap, Task *task);
 #if defined(THREADED_RTS)
+static void schedulePublishWork(Capability *cap, Task *task);
+static void scheduleStealThread(Capability *cap);
 static void scheduleActivateSpark(Capability *cap);
 #endif
 static void schedulePostRunThread(Capability *cap, StgTSO *t);
@@ -159,6 +164,52 @@ static void deleteAllThreads (void);
 static void deleteThread_(StgTSO *tso);
 #endif
 
+/* Note [Thread usage]
+   ~~~~~~~~~~~~~~~~~~~
+
+   rts_getThreadUsage() and rts_listThreadUsage() (GHC.Conc.threadUsage
+   and listThreadUsage) report how much each thread has allocated and
+   how long it has run, so that a program can find its busy threads
+   without an eventlog.  The scheduler keeps the totals in the TSO and
+   adds to them each time the thread stops running:
+
+     - tso->allocated: the allocation of a thread is already counted
+       down in tso->alloc_limit (its allocation counter), so schedule()
+       adds how far that went down while the thread ran.  Since
+       setThreadAllocationCounter# moves alloc_limit, it adds the jump
+       to tso->allocated to cancel it out.
+
+     - tso->run_time: with +RTS --thread-usage, the time from when the
+       thread started running on the Capability (cap->run_start) to
+       when it stopped.  A safe foreign call stops the clock in
+       suspendThread() and starts it again in resumeThread(), so the
+       time spent in the call isn't counted; the Capability may run
+       other threads meanwhile.  This is elapsed time, not the CPU time
+       of the OS thread.  Reading the clock costs a little on every
+       context switch and safe foreign call, hence the flag.
+
+   The totals of a running thread don't include its current time
+   slice.
+*/
+
+STATIC_INLINE void
+startRunTime (Capability *cap)
+{
+    if (RtsFlags.ConcFlags.threadUsage) {
+        cap->run_start = NSToTime(getMonotonicNSec());
+    }
+}
+
+STATIC_INLINE void
+stopRunTime (Capability *cap, StgTSO *tso)
+{
+    if (RtsFlags.ConcFlags.threadUsage) {
+        ASSIGN_Word64((W_*)&(tso->run_time),
+                      PK_Word64((W_*)&(tso->run_time))
+                      + (NSToTime(getMonotonicNSec()) - cap->run_start));
+    }
+}
+
 /* ---------------------------------------------------------------------------
    Main scheduling loop.
 
@@ -180,7 +231,9 @@ schedule (Capability *initialCapability, Task *task)
   Capability *cap;
   StgThreadReturnCode ret;
   uint32_t prev_what_next;
+  uint32_t prio;
   bool ready_to_gc;
+  StgInt64 alloc_start;
 
   cap = initialCapability;
 
@@ -277,6 +330,9 @@ schedule (Capability *initialCapability, Task *task)
     /* work pushing, currently relevant only for THREADED_RTS:
        (pushes threads, wakes up idle capabilities for stealing) */
     schedulePushWork(cap,task);
+#if defined(THREADED_RTS)
+    schedulePublishWork(cap,task);
+#endif
 
     scheduleDetectDeadlock(&cap,task);
 
@@ -304,7 +360,8 @@ schedule (Capability *initialCapability, Task *task)
     //
     // Get a thread to run
     //
-    t = popRunQueue(cap);
+    prio = nextRunQueue(cap);
+    t = popRunQueueFrom(cap, prio);
 
     // Sanity check the thread we're about to run.  This can be
     // expensive if there is lots of thread switching going on...
@@ -380,6 +437,9 @@ schedule (Capability *initialCapability, Task *task)
         cap->context_switch = 1;
     }
 
+    // See Note [Thread priorities]
+    countRunQueueTurn(cap, prio);
+
 run_thread:
 
     // CurrentTSO is the thread to run. It might be different if we
@@ -438,6 +498,10 @@ run_thread:
 
     traceEventRunThread(cap, t);
 
+    // See Note [Thread usage]
+    alloc_start = PK_Int64((W_*)&(t->alloc_limit));
+    startRunTime(cap);
+
     switch (prev_what_next) {
 
     case ThreadKilled:
@@ -474,6 +538,11 @@ run_thread:
     // don't want it set when not running a Haskell thread.
     cap->r.rCurrentTSO = NULL;
 
+    stopRunTime(cap, t);
+    ASSIGN_Word64((W_*)&(t->allocated),
+                  PK_Word64((W_*)&(t->allocated))
+                  + (alloc_start - PK_Int64((W_*)&(t->alloc_limit))));
+
     // And save the current errno in this thread.
     // XXX: possibly bogus for SMP because this thread might already
     // be running again, see code below.
@@ -514,6 +583,11 @@ run_thread:
 
     ready_to_gc = false;
 
+    // See Note [Stack watermarks] in Threads.c
+    if (ret == HeapOverflow || ret == ThreadYielding) {
+        threadStackSplit(cap, t);
+    }
+
     switch (ret) {
     case HeapOverflow:
         ready_to_gc = scheduleHandleHeapOverflow(cap,t);
@@ -556,18 +630,59 @@ run_thread:
  * Run queue operations
  * -------------------------------------------------------------------------- */
 
+/* Note [Thread priorities]
+   ~~~~~~~~~~~~~~~~~~~~~~~~
+
+   Each thread has one of TSO_PRIORITIES priorities in tso->priority,
+   set with setThreadPriority# (GHC.Conc.setThreadPriority).  Threads
+   start at TSO_PRIORITY_NORMAL, and forkIO/forkOn give the new thread
+   the priority of its parent.
+
+   A Capability has a run queue for each priority, and the next thread
+   to run comes from the queue of the highest priority that has any
+   (nextRunQueue()), so a busy high-priority thread isn't held up by the
+   threads of a lower priority.  To keep those from starving, each
+   queue counts the threads that have been run from higher queues while
+   it waited (cap->run_queue_passed[]); once that reaches
+   --starvation-limit, the queue gets the next turn whatever is waiting
+   above it.  With --starvation-limit=0 the order is strict.
+
+   Any thread may set the priority of any other, so tso->priority is
+   just a word, and the run queue a thread is on is not changed when
+   its priority is: the new priority takes effect the next time the
+   thread is put on a run queue.  Hence removeFromRunQueue() finds the
+   queue of a thread by looking for it, not from tso->priority.
+
+   Each Capability counts the threads it ran from each queue and how
+   many of those ran ahead of a higher queue (cap->priority_runs[] and
+   cap->priority_boosts[]), and posts them as
+   EVENT_THREAD_PRIORITY_STATS alongside its spark counters, once any
+   thread of a priority other than normal has run.  These counters and
+   run_queue_passed[] are updated by countRunQueueTurn() once schedule()
+   knows that it is going to run the thread, since it puts a thread
+   bound to another Task back on the run queue.
+*/
+
 static void
 removeFromRunQueue (Capability *cap, StgTSO *tso)
 {
+    uint32_t p;
+
+    // tso->priority may have changed since tso was queued, so look
+    // for the queue that it is at the end of, if it is.
     if (tso->block_info.prev == END_TSO_QUEUE) {
-        ASSERT(cap->run_queue_hd == tso);
-        cap->run_queue_hd = tso->_link;
+        for (p = 0; cap->run_queue_hd[p] != tso; p++) {
+            ASSERT(p < TSO_PRIORITIES - 1);
+        }
+        cap->run_queue_hd[p] = tso->_link;
     } else {
         setTSOLink(cap, tso->block_info.prev, tso->_link);
     }
     if (tso->_link == END_TSO_QUEUE) {
-        ASSERT(cap->run_queue_tl == tso);
-        cap->run_queue_tl = tso->block_info.prev;
+        for (p = 0; cap->run_queue_tl[p] != tso; p++) {
+            ASSERT(p < TSO_PRIORITIES - 1);
+        }
+        cap->run_queue_tl[p] = tso->block_info.prev;
     } else {
         setTSOPrev(cap, tso->_link, tso->block_info.prev);
     }
@@ -584,6 +699,82 @@ promoteInRunQueue (Capability *cap, StgTSO *tso)
     pushOnRunQueue(cap, tso);
 }
 
+/* -----------------------------------------------------------------------------
+ * Stealing threads
+ * -------------------------------------------------------------------------- */
+
+/* Note [Stealing threads]
+   ~~~~~~~~~~~~~~~~~~~~~~~
+
+   By default a busy Capability shares its run queue by pushing threads
+   to the Capabilities that are free at that moment (schedulePushWork()).
+   A Capability that becomes idle a moment later gets nothing until the
+   busy one goes round its scheduler loop again.  With
+   --load-balance=steal (or hybrid, which pushes first) the idle
+   Capability takes the threads itself instead.
+
+   The run queue is a doubly-linked list that only the owner of the
+   Capability may touch, so other Capabilities can't steal from it
+   directly.  Instead, each time round the scheduler loop a busy
+   Capability moves its spare threads - all but the one it is about to
+   run - off the run queue into cap->stealable, a WSDeque like the spark
+   pool, and marks them TSO_STEALABLE (schedulePublishWork()).  A
+   Capability with nothing to run steals the oldest of them from the
+   first other Capability that has any (scheduleStealThread()), and
+   sets tso->cap to itself before clearing TSO_STEALABLE.  The thief
+   posts EVENT_MIGRATE_THREAD for it as migrateThread() does, but on its
+   own Capability, which is the only eventlog buffer it may write to.
+
+   The owner takes back the threads nobody stole
+   (reclaimStealableThreads()) the next time round its loop, before it
+   publishes again, so a thread waits at most one time slice in the
+   deque and the order of the run queue is kept.  Bound and locked
+   threads are never published.
+
+   A thread in the deque is runnable but not on any run queue, and
+   anything else that relies on tso->cap == cap to own a runnable
+   thread - throwTo() and messageBlackHole() - calls reclaimThread()
+   first.  If a steal of the thread is in flight, that waits for the
+   thief to set tso->cap, so the caller sees the thread on one
+   Capability or the other.
+
+   The GC doesn't know about the deques: scheduleDoGC() empties them
+   all, with every Capability stopped, before collecting.  Each
+   Capability posts its counts of published, reclaimed and stolen
+   threads as EVENT_CAP_THREAD_STEALS alongside its spark counters.
+*/
+
+#if defined(THREADED_RTS)
+void
+reclaimStealableThreads (Capability *cap)
+{
+    StgTSO *t;
+
+    while ((t = popWSDeque(cap->stealable)) != NULL) {
+        t->flags &= ~TSO_STEALABLE;
+        // we pop the newest first, so this restores the original order
+        pushOnRunQueue(cap, t);
+        cap->threads_reclaimed++;
+    }
+}
+
+void
+reclaimThread (Capability *cap, StgTSO *tso)
+{
+    if (tso->cap != cap || (tso->flags & TSO_STEALABLE) == 0) {
+        return;
+    }
+    reclaimStealableThreads(cap);
+    // if it is still marked, another Capability has just stolen it:
+    // wait until it has set tso->cap
+    while ((Capability *)VOLATILE_LOAD(&tso->cap) == cap &&
+           (((volatile StgTSO *)tso)->flags & TSO_STEALABLE)) {
+        busy_wait_nop();
+    }
+    load_load_barrier();
+}
+#endif
+
 /* ----------------------------------------------------------------------------
  * Setting up the scheduler loop
  * ------------------------------------------------------------------------- */
@@ -614,6 +805,8 @@ scheduleFindWork (Capability **pcap)
     scheduleCheckBlockedThreads(*pcap);
 
 #if defined(THREADED_RTS)
+    reclaimStealableThreads(*pcap);
+    if (emptyRunQueue(*pcap)) { scheduleStealThread(*pcap); }
     if (emptyRunQueue(*pcap)) { scheduleActivateSpark(*pcap); }
 #endif
 }
@@ -702,12 +895,15 @@ schedulePushWork(Capability *cap USED_IF_THREADS,
 #if defined(THREADED_RTS)
 
     Capability *free_caps[n_capabilities], *cap0;
-    uint32_t i, n_wanted_caps, n_free_caps;
+    uint32_t i, p, n_wanted_caps, n_free_caps;
 
     uint32_t spare_threads = cap->n_run_queue > 0 ? cap->n_run_queue - 1 : 0;
 
-    // migration can be turned off with +RTS -qm
-    if (!RtsFlags.ParFlags.migrate) {
+    // migration can be turned off with +RTS -qm, and with
+    // --load-balance=steal other capabilities take our spare threads
+    // themselves (see schedulePublishWork())
+    if (!RtsFlags.ParFlags.migrate ||
+        RtsFlags.ParFlags.loadBalance == LOAD_BALANCE_STEAL) {
         spare_threads = 0;
     }
 
@@ -773,58 +969,62 @@ schedulePushWork(Capability *cap USED_IF_THREADS,
         // The number of threads we have left.
         uint32_t n = cap->n_run_queue;
 
-        // prev = the previous thread on this cap's run queue
-        prev = END_TSO_QUEUE;
+        // We're going to walk through the run queues, highest priority
+        // first, migrating threads to other capabilities until we have
+        // only keep_threads left.  We might encounter a thread that
+        // cannot be migrated, in which case we add it to the current run
+        // queue and decrement keep_threads.
+        for (p = 0, i = 0; p < TSO_PRIORITIES && n > keep_threads; p++) {
 
-        // We're going to walk through the run queue, migrating threads to other
-        // capabilities until we have only keep_threads left.  We might
-        // encounter a thread that cannot be migrated, in which case we add it
-        // to the current run queue and decrement keep_threads.
-        for (t = cap->run_queue_hd, i = 0;
-             t != END_TSO_QUEUE && n > keep_threads;
-             t = next)
-        {
-            next = t->_link;
-            t->_link = END_TSO_QUEUE;
-
-            // Should we keep this thread?
-            if (t->bound == task->incall // don't move my bound thread
-                || tsoLocked(t) // don't move a locked thread
-                ) {
-                if (prev == END_TSO_QUEUE) {
-                    cap->run_queue_hd = t;
-                } else {
-                    setTSOLink(cap, prev, t);
+            // prev = the previous thread on this cap's run queue
+            prev = END_TSO_QUEUE;
+
+            for (t = cap->run_queue_hd[p];
+                 t != END_TSO_QUEUE && n > keep_threads;
+                 t = next)
+            {
+                next = t->_link;
+                t->_link = END_TSO_QUEUE;
+
+                // Should we keep this thread?
+                if (t->bound == task->incall // don't move my bound thread
+                    || tsoLocked(t) // don't move a locked thread
+                    ) {
+                    if (prev == END_TSO_QUEUE) {
+                        cap->run_queue_hd[p] = t;
+                    } else {
+                        setTSOLink(cap, prev, t);
+                    }
+                    setTSOPrev(cap, t, prev);
+                    prev = t;
+                    if (keep_threads > 0) keep_threads--;
                 }
-                setTSOPrev(cap, t, prev);
-                prev = t;
-                if (keep_threads > 0) keep_threads--;
-            }
 
-            // Or migrate it?
-            else {
-                appendToRunQueue(free_caps[i],t);
-                traceEventMigrateThread (cap, t, free_caps[i]->no);
+                // Or migrate it?
+                else {
+                    appendToRunQueue(free_caps[i],t);
+                    traceEventMigrateThread (cap, t, free_caps[i]->no);
 
-                if (t->bound) { t->bound->task->cap = free_caps[i]; }
-                t->cap = free_caps[i];
-                n--; // we have one fewer threads now
-                i++; // move on to the next free_cap
-                if (i == n_free_caps) i = 0;
+                    if (t->bound) { t->bound->task->cap = free_caps[i]; }
+                    t->cap = free_caps[i];
+                    n--; // we have one fewer threads now
+                    i++; // move on to the next free_cap
+                    if (i == n_free_caps) i = 0;
+                }
             }
-        }
 
-        // Join up the beginning of the queue (prev)
-        // with the rest of the queue (t)
-        if (t == END_TSO_QUEUE) {
-            cap->run_queue_tl = prev;
-        } else {
-            setTSOPrev(cap, t, prev);
-        }
-        if (prev == END_TSO_QUEUE) {
-            cap->run_queue_hd = t;
-        } else {
-            setTSOLink(cap, prev, t);
+            // Join up the beginning of the queue (prev)
+            // with the rest of the queue (t)
+            if (t == END_TSO_QUEUE) {
+                cap->run_queue_tl[p] = prev;
+            } else {
+                setTSOPrev(cap, t, prev);
+            }
+            if (prev == END_TSO_QUEUE) {
+                cap->run_queue_hd[p] = t;
+            } else {
+                setTSOLink(cap, prev, t);
+            }
         }
         cap->n_run_queue = n;
 
@@ -848,6 +1048,131 @@ schedulePushWork(Capability *cap USED_IF_THREADS,
 
 }
 
+#if defined(THREADED_RTS)
+/* -----------------------------------------------------------------------------
+ * schedulePublishWork()
+ *
+ * Offer our spare threads to idle Capabilities, and wake them up to
+ * take them.  See Note [Stealing threads].
+ * -------------------------------------------------------------------------- */
+
+static void
+schedulePublishWork(Capability *cap, Task *task)
+{
+    Capability *cap0;
+    StgTSO *t, *next, *first;
+    uint32_t i, p, n_wanted, n_published, n_woken;
+
+    if (RtsFlags.ParFlags.loadBalance == LOAD_BALANCE_PUSH
+        || !RtsFlags.ParFlags.migrate
+        || cap->disabled
+        || n_capabilities == 1
+        || cap->n_run_queue < 2) {
+        return;
+    }
+
+    // Keep the thread we are about to run, and publish at most one
+    // thread for each other Capability, highest priority first.
+    n_wanted = stg_min(cap->n_run_queue - 1, enabled_capabilities - 1);
+    n_published = 0;
+    first = peekRunQueue(cap);
+
+    for (p = 0; p < TSO_PRIORITIES && n_published < n_wanted; p++) {
+        for (t = cap->run_queue_hd[p];
+             t != END_TSO_QUEUE && n_published < n_wanted;
+             t = next)
+        {
+            next = t->_link;
+            if (t == first || t->bound != NULL || tsoLocked(t)) {
+                continue;
+            }
+            removeFromRunQueue(cap, t);
+            t->flags |= TSO_STEALABLE;
+            if (!pushWSDeque(cap->stealable, t)) {
+                // full: leave the rest where they are
+                t->flags &= ~TSO_STEALABLE;
+                appendToRunQueue(cap, t);
+                n_wanted = n_published;
+                break;
+            }
+            n_published++;
+        }
+    }
+
+    if (n_published == 0) {
+        return;
+    }
+    cap->threads_published += n_published;
+
+    debugTrace(DEBUG_sched, "cap %d: published %d threads for stealing",
+               cap->no, n_published);
+
+    // Wake up as many idle capabilities, as schedulePushWork() does.
+    for (i = (cap->no + 1) % n_capabilities, n_woken = 0;
+         n_woken < n_published && i != cap->no;
+         i = (i + 1) % n_capabilities) {
+        cap0 = capabilities[i];
+        if (!cap0->disabled && tryGrabCapability(cap0,task)) {
+            if (!emptyRunQueue(cap0)
+                || cap0->n_returning_tasks != 0
+                || !emptyInbox(cap0)) {
+                // it has some work of its own
+                releaseCapability(cap0);
+            } else {
+                task->cap = cap0;
+                releaseAndWakeupCapability(cap0);
+                n_woken++;
+            }
+        }
+    }
+    task->cap = cap; // reset to point to our Capability.
+}
+
+/* -----------------------------------------------------------------------------
+ * scheduleStealThread()
+ *
+ * Our run queue is empty: steal a thread that another Capability has
+ * published.  See Note [Stealing threads].
+ * -------------------------------------------------------------------------- */
+
+static void
+scheduleStealThread(Capability *cap)
+{
+    Capability *victim;
+    StgTSO *t;
+    uint32_t i;
+
+    if (RtsFlags.ParFlags.loadBalance == LOAD_BALANCE_PUSH
+        || cap->disabled) {
+        return;
+    }
+
+    for (i = (cap->no + 1) % n_capabilities;
+         i != cap->no;
+         i = (i + 1) % n_capabilities) {
+        victim = capabilities[i];
+        if (looksEmptyWSDeque(victim->stealable)) {
+            continue;
+        }
+        t = stealWSDeque(victim->stealable);
+        if (t != NULL) {
+            t->cap = cap;
+            // the victim may be waiting for this in reclaimThread()
+            write_barrier();
+            t->flags &= ~TSO_STEALABLE;
+            // The event can only go in our own buffer, since the
+            // victim's belongs to whoever owns the victim.
+            traceEventMigrateThread(cap, t, cap->no);
+            appendToRunQueue(cap, t);
+            cap->threads_stolen++;
+            debugTrace(DEBUG_sched, "cap %d: stole thread %lu from cap %d",
+                       cap->no, (unsigned long)t->id, victim->no);
+            return;
+        }
+    }
+}
+#endif
+
 /* ----------------------------------------------------------------------------
  * Start any pending signal handlers
  * ------------------------------------------------------------------------- */
@@ -995,25 +1320,25 @@ scheduleProcessInbox (Capability **pcap USED_IF_THREADS)
             cap = *pcap;
         }
 
-        // don't use a blocking acquire; if the lock is held by
-        // another thread then just carry on.  This seems to avoid
-        // getting stuck in a message ping-pong situation with other
-        // processors.  We'll check the inbox again later anyway.
-        //
-        // We should really use a more efficient queue data structure
-        // here.  The trickiness is that we must ensure a Capability
-        // never goes idle if the inbox is non-empty, which is why we
-        // use cap->lock (cap->lock is released as the last thing
-        // before going idle; see Capability.c:releaseCapability()).
-        r = TRY_ACQUIRE_LOCK(&cap->lock);
-        if (r != 0) return;
-
-        m = cap->inbox;
-        p = cap->putMVars;
-        cap->inbox = (Message*)END_TSO_QUEUE;
-        cap->putMVars = NULL;
-
-        RELEASE_LOCK(&cap->lock);
+        // Take all the messages at once; see Note [Capability inbox]
+        // in Messages.c.
+        m = (Message*)xchg((StgPtr)&cap->inbox, (StgWord)END_TSO_QUEUE);
+
+        p = NULL;
+        if (cap->putMVars != NULL) {
+            // don't use a blocking acquire; if the lock is held by
+            // another thread then just carry on.  This seems to avoid
+            // getting stuck in a ping-pong situation with other
+            // processors.  We'll check again later anyway.
+            r = TRY_ACQUIRE_LOCK(&cap->lock);
+            if (r == 0) {
+                p = cap->putMVars;
+                cap->putMVars = NULL;
+                RELEASE_LOCK(&cap->lock);
+            } else if (m == (Message*)END_TSO_QUEUE) {
+                return;
+            }
+        }
 
         while (m != (Message*)END_TSO_QUEUE) {
             next = m->link;
@@ -1141,7 +1466,7 @@ scheduleHandleHeapOverflow( Capability *cap, StgTSO *t )
                                                // nursery has only one
                                                // block.
 
-            bd = allocGroupOnNode_lock(cap->node,blocks);
+            bd = allocGroupCap(cap,blocks);
             cap->r.rNursery->n_blocks += blocks;
 
             // link the new group after CurrentNursery
@@ -1540,6 +1865,10 @@ scheduleDoGC (Capability **pcap, Task *task USED_IF_THREADS,
     // Figure out which generation we are collecting, so that we can
     // decide whether this is a parallel GC or not.
     collect_gen = calcNeeded(force_major || heap_census, NULL);
+    if (RtsFlags.GcFlags.concurrentMark && !(force_major || heap_census)) {
+        // See Note [Concurrent mark] in sm/NonMoving.c
+        collect_gen = nonMovingCollectGen(collect_gen);
+    }
     major_gc = (collect_gen == RtsFlags.GcFlags.generations-1);
 
 #if defined(THREADED_RTS)
@@ -1743,6 +2072,15 @@ scheduleDoGC (Capability **pcap, Task *task USED_IF_THREADS,
     IF_DEBUG(scheduler, printAllThreads());
 
 delete_threads_and_gc:
+#if defined(THREADED_RTS)
+    // The GC doesn't know about the threads waiting to be stolen, so
+    // put them back on their run queues.  No race here since all Caps
+    // are stopped.  See Note [Stealing threads].
+    for (i = 0; i < n_capabilities; i++) {
+        reclaimStealableThreads(capabilities[i]);
+    }
+#endif
+
     /*
      * We now have all the capabilities; if we're in an interrupting
      * state, then we should take the opportunity to delete all the
@@ -1812,6 +2150,8 @@ delete_threads_and_gc:
     }
 
     traceSparkCounters(cap);
+    traceCapThreadSteals(cap);
+    traceCapPriorityStats(cap);
 
     switch (recent_activity) {
     case ACTIVITY_INACTIVE:
@@ -1965,6 +2305,9 @@ forkProcess(HsStablePtr *entry
     stopAllCapabilities(&cap, task);
 #endif
 
+    // the finalizer thread must not be in the middle of a batch
+    stopFinalizerThread();
+
     // no funny business: hold locks while we fork, otherwise if some
     // other thread is holding a lock when the fork happens, the data
     // structure protected by the lock will forever be in an
@@ -2011,6 +2354,8 @@ forkProcess(HsStablePtr *entry
             RELEASE_LOCK(&capabilities[i]->lock);
         }
 
+        startFinalizerThread();
+
         boundTaskExiting(task);
 
         // just return the pid
@@ -2075,6 +2420,9 @@ forkProcess(HsStablePtr *entry
             // exist.
             truncateRunQueue(cap);
             cap->n_run_queue = 0;
+#if defined(THREADED_RTS)
+            discardElements(cap->stealable);
+#endif
 
             // Any suspended C-calling Tasks are no more, their OS threads
             // don't exist now:
@@ -2112,6 +2460,15 @@ forkProcess(HsStablePtr *entry
         initTimer();
         startTimer();
 
+        // The decommit thread is gone too, and so is the concurrent
+        // marker along with any mark it was in the middle of.  The
+        // sweeper and finalizer threads pick up where the parent's
+        // left off.
+        startDecommitThread();
+        startNonMovingThread();
+        startSweepThread();
+        startFinalizerThread();
+
         // TODO: need to trace various other things in the child
         // like startup event, capabilities, process info etc
         traceTaskCreate(task, cap);
@@ -2386,6 +2743,7 @@ suspendThread (StgRegTable *reg, bool interruptible)
   tso = cap->r.rCurrentTSO;
 
   traceEventStopThread(cap, tso, THREAD_SUSPENDED_FOREIGN_CALL, 0);
+  stopRunTime(cap, tso);
 
   // XXX this might not be necessary --SDM
   tso->what_next = ThreadRunGHC;
@@ -2456,6 +2814,7 @@ resumeThread (void *task_)
     tso->_link = END_TSO_QUEUE; // no write barrier reqd
 
     traceEventRunThread(cap, tso);
+    startRunTime(cap);
 
     /* Reset blocking status */
     tso->why_blocked  = NotBlocked;
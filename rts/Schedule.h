@@ -119,7 +119,7 @@ void resurrectThreads (StgTSO *);
 
 /* END_TSO_QUEUE and friends now defined in includes/stg/MiscClosures.h */
 
-/* Add a thread to the end of the run queue.
+/* Add a thread to the end of the run queue for its priority.
  * NOTE: tso->link should be END_TSO_QUEUE before calling this macro.
  * ASSUMES: cap->running_task is the current task.
  */
@@ -129,19 +129,23 @@ appendToRunQueue (Capability *cap, StgTSO *tso);
 EXTERN_INLINE void
 appendToRunQueue (Capability *cap, StgTSO *tso)
 {
+    uint32_t p = tso->priority;
+
     ASSERT(tso->_link == END_TSO_QUEUE);
-    if (cap->run_queue_hd == END_TSO_QUEUE) {
-        cap->run_queue_hd = tso;
+    ASSERT(p < TSO_PRIORITIES);
+    if (cap->run_queue_hd[p] == END_TSO_QUEUE) {
+        cap->run_queue_hd[p] = tso;
         tso->block_info.prev = END_TSO_QUEUE;
+        cap->run_queue_passed[p] = 0;
     } else {
-        setTSOLink(cap, cap->run_queue_tl, tso);
-        setTSOPrev(cap, tso, cap->run_queue_tl);
+        setTSOLink(cap, cap->run_queue_tl[p], tso);
+        setTSOPrev(cap, tso, cap->run_queue_tl[p]);
     }
-    cap->run_queue_tl = tso;
+    cap->run_queue_tl[p] = tso;
     cap->n_run_queue++;
 }
 
-/* Push a thread on the beginning of the run queue.
+/* Push a thread on the beginning of the run queue for its priority.
  * ASSUMES: cap->running_task is the current task.
  */
 EXTERN_INLINE void
@@ -150,46 +154,121 @@ pushOnRunQueue (Capability *cap, StgTSO *tso);
 EXTERN_INLINE void
 pushOnRunQueue (Capability *cap, StgTSO *tso)
 {
-    setTSOLink(cap, tso, cap->run_queue_hd);
+    uint32_t p = tso->priority;
+
+    ASSERT(p < TSO_PRIORITIES);
+    setTSOLink(cap, tso, cap->run_queue_hd[p]);
     tso->block_info.prev = END_TSO_QUEUE;
-    if (cap->run_queue_hd != END_TSO_QUEUE) {
-        setTSOPrev(cap, cap->run_queue_hd, tso);
+    if (cap->run_queue_hd[p] != END_TSO_QUEUE) {
+        setTSOPrev(cap, cap->run_queue_hd[p], tso);
+    } else {
+        cap->run_queue_passed[p] = 0;
     }
-    cap->run_queue_hd = tso;
-    if (cap->run_queue_tl == END_TSO_QUEUE) {
-        cap->run_queue_tl = tso;
+    cap->run_queue_hd[p] = tso;
+    if (cap->run_queue_tl[p] == END_TSO_QUEUE) {
+        cap->run_queue_tl[p] = tso;
     }
     cap->n_run_queue++;
 }
 
-/* Pop the first thread off the runnable queue.
+/* The run queue that the next thread to run comes from: the one of
+ * the highest priority that has threads, unless the threads of a lower
+ * priority have waited too long.  See Note [Thread priorities] in
+ * Schedule.c.
+ */
+INLINE_HEADER uint32_t
+nextRunQueue (Capability *cap)
+{
+    const uint32_t limit = RtsFlags.ConcFlags.starvationLimit;
+    uint32_t p;
+
+    if (limit != 0) {
+        for (p = TSO_PRIORITIES - 1; p > 0; p--) {
+            if (cap->run_queue_hd[p] != END_TSO_QUEUE &&
+                cap->run_queue_passed[p] >= limit) {
+                return p;
+            }
+        }
+    }
+    for (p = 0; p < TSO_PRIORITIES - 1; p++) {
+        if (cap->run_queue_hd[p] != END_TSO_QUEUE) {
+            break;
+        }
+    }
+    return p;
+}
+
+/* Pop the first thread off run queue p, which must not be empty.
  */
 INLINE_HEADER StgTSO *
-popRunQueue (Capability *cap)
+popRunQueueFrom (Capability *cap, uint32_t p)
 {
     ASSERT(cap->n_run_queue != 0);
-    StgTSO *t = cap->run_queue_hd;
+    StgTSO *t = cap->run_queue_hd[p];
     ASSERT(t != END_TSO_QUEUE);
-    cap->run_queue_hd = t->_link;
+    cap->run_queue_hd[p] = t->_link;
     if (t->_link != END_TSO_QUEUE) {
         t->_link->block_info.prev = END_TSO_QUEUE;
     }
     t->_link = END_TSO_QUEUE; // no write barrier req'd
-    if (cap->run_queue_hd == END_TSO_QUEUE) {
-        cap->run_queue_tl = END_TSO_QUEUE;
+    if (cap->run_queue_hd[p] == END_TSO_QUEUE) {
+        cap->run_queue_tl[p] = END_TSO_QUEUE;
     }
     cap->n_run_queue--;
     return t;
 }
 
+/* Pop the next thread to run off the run queues.
+ */
+INLINE_HEADER StgTSO *
+popRunQueue (Capability *cap)
+{
+    return popRunQueueFrom(cap, nextRunQueue(cap));
+}
+
+/* Count a turn of run queue p, whose thread schedule() is about to run.
+ * This is not done in popRunQueue(), since schedule() may put the
+ * thread back or migrate it rather than run it.
+ */
+INLINE_HEADER void
+countRunQueueTurn (Capability *cap, uint32_t p)
+{
+    uint32_t q;
+
+    cap->priority_runs[p]++;
+    for (q = 0; q < p; q++) {
+        if (cap->run_queue_hd[q] != END_TSO_QUEUE) {
+            cap->priority_boosts[p]++;
+            break;
+        }
+    }
+    cap->run_queue_passed[p] = 0;
+    for (q = p + 1; q < TSO_PRIORITIES; q++) {
+        cap->run_queue_passed[q]++;
+    }
+}
+
 INLINE_HEADER StgTSO *
 peekRunQueue (Capability *cap)
 {
-    return cap->run_queue_hd;
+    return cap->run_queue_hd[nextRunQueue(cap)];
 }
 
 void promoteInRunQueue (Capability *cap, StgTSO *tso);
 
+#if defined(THREADED_RTS)
+/* Put the threads that cap offered for stealing back on its run queue.
+ * Called by the owner of cap, or with all Capabilities held.
+ */
+void reclaimStealableThreads (Capability *cap);
+
+/* Make sure that tso is not waiting to be stolen from cap: afterwards
+ * it is either on cap's run queue, or tso->cap is the Capability that
+ * stole it.  Called by the owner of cap.
+ */
+void reclaimThread (Capability *cap, StgTSO *tso);
+#endif
+
 /* Add a thread to the end of the blocked queue.
  */
 #if !defined(THREADED_RTS)
@@ -223,8 +302,12 @@ emptyRunQueue(Capability *cap)
 INLINE_HEADER void
 truncateRunQueue(Capability *cap)
 {
-    cap->run_queue_hd = END_TSO_QUEUE;
-    cap->run_queue_tl = END_TSO_QUEUE;
+    uint32_t p;
+
+    for (p = 0; p < TSO_PRIORITIES; p++) {
+        cap->run_queue_hd[p] = END_TSO_QUEUE;
+        cap->run_queue_tl[p] = END_TSO_QUEUE;
+    }
     cap->n_run_queue = 0;
 }
 
@@ -18,9 +18,13 @@
 #include "sm/Storage.h"
 #include "sm/GCThread.h"
 #include "sm/BlockAlloc.h"
+#include "sm/Decommit.h"
+#include "sm/OSMem.h"
 
 // for spin/yield counters
 #include "sm/GC.h"
+#include "sm/Pacing.h"
+#include "sm/StaticRoots.h"
 #include "ThreadPaused.h"
 #include "Messages.h"
 
@@ -154,6 +158,7 @@ initStats0(void)
         .max_large_objects_bytes = 0,
         .max_compact_bytes = 0,
         .max_slop_bytes = 0,
+        .max_pinned_slop_bytes = 0,
         .max_mem_in_use_bytes = 0,
         .cumulative_live_bytes = 0,
         .copied_bytes = 0,
@@ -183,6 +188,7 @@ initStats0(void)
             .large_objects_bytes = 0,
             .compact_bytes = 0,
             .slop_bytes = 0,
+            .pinned_slop_bytes = 0,
             .mem_in_use_bytes = 0,
             .copied_bytes = 0,
             .par_max_copied_bytes = 0,
@@ -315,6 +321,44 @@ stat_startGC (Capability *cap, gc_thread *gct)
     updateNurseriesStats();
 }
 
+/* -----------------------------------------------------------------------------
+   Post EVENT_HEAP_LARGE_OBJECTS for each generation: its large
+   objects, and those that the last GC promoted into it by relinking
+   them (evacuate_large()).  Counting the objects means walking the
+   lists, so only when we are tracing GC.
+   -------------------------------------------------------------------------- */
+
+static void
+traceLargeObjects (Capability *cap)
+{
+    uint32_t g;
+    bdescr *bd;
+    W_ objects, words;
+
+    if (!RTS_UNLIKELY(TRACE_gc)) {
+        return;
+    }
+
+    for (g = 0; g < RtsFlags.GcFlags.generations; g++) {
+        generation *gen = &generations[g];
+        objects = 0;
+        words = 0;
+        for (bd = gen->large_objects; bd != NULL; bd = bd->link) {
+            // pinned objects, large or small, are left out: the
+            // blocks of small ones are on the list too
+            if (!(bd->flags & BF_PINNED)) {
+                objects++;
+                words += bd->free - bd->start;
+            }
+        }
+        traceEventHeapLargeObjects(cap, CAPSET_HEAP_DEFAULT, g,
+                                   objects, words * sizeof(W_),
+                                   gen->n_promoted_large_objects,
+                                   gen->n_promoted_large_words
+                                       * sizeof(W_));
+    }
+}
+
 /* -----------------------------------------------------------------------------
    Called at the end of each GC
    -------------------------------------------------------------------------- */
@@ -343,6 +387,7 @@ stat_endGC (Capability *cap, gc_thread *gct, W_ live, W_ copied, W_ slop,
     stats.gc.large_objects_bytes = calcTotalLargeObjectsW() * sizeof(W_);
     stats.gc.compact_bytes = calcTotalCompactW() * sizeof(W_);
     stats.gc.slop_bytes = slop * sizeof(W_);
+    stats.gc.pinned_slop_bytes = calcTotalPinnedSlopW() * sizeof(W_);
     stats.gc.mem_in_use_bytes = mblocks_allocated * MBLOCK_SIZE;
     stats.gc.copied_bytes = copied * sizeof(W_);
     stats.gc.par_max_copied_bytes = par_max_copied * sizeof(W_);
@@ -353,7 +398,8 @@ stat_endGC (Capability *cap, gc_thread *gct, W_ live, W_ copied, W_ slop,
         rtsConfig.gcDoneHook != NULL;
 
     if (stats_enabled
-      || RtsFlags.ProfFlags.doHeapProfile) // heap profiling needs GC_tot_time
+      || RtsFlags.ProfFlags.doHeapProfile // heap profiling needs GC_tot_time
+      || pacing) // and -xP needs the pause
     {
         // We only update the times when stats are explicitly enabled since
         // getProcessTimes (e.g. requiring a system call) can be expensive on
@@ -399,6 +445,9 @@ stat_endGC (Capability *cap, gc_thread *gct, W_ live, W_ copied, W_ slop,
     stats.gc_cpu_ns += stats.gc.cpu_ns;
     stats.gc_elapsed_ns += stats.gc.elapsed_ns;
 
+    // See Note [GC pause target] in sm/Pacing.c
+    pacerEndGC(cap, gen, stats.gc.copied_bytes, stats.gc.elapsed_ns);
+
     if (gen == RtsFlags.GcFlags.generations-1) { // major GC?
         stats.major_gcs++;
         if (stats.gc.live_bytes > stats.max_live_bytes) {
@@ -413,6 +462,9 @@ stat_endGC (Capability *cap, gc_thread *gct, W_ live, W_ copied, W_ slop,
         if (stats.gc.slop_bytes > stats.max_slop_bytes) {
             stats.max_slop_bytes = stats.gc.slop_bytes;
         }
+        if (stats.gc.pinned_slop_bytes > stats.max_pinned_slop_bytes) {
+            stats.max_pinned_slop_bytes = stats.gc.pinned_slop_bytes;
+        }
         stats.cumulative_live_bytes += stats.gc.live_bytes;
     }
 
@@ -457,6 +509,8 @@ stat_endGC (Capability *cap, gc_thread *gct, W_ live, W_ copied, W_ slop,
                                stats.gc.live_bytes);
         }
 
+        traceLargeObjects(cap);
+
         // -------------------------------------------------
         // Print GC stats to stdout or a file (+RTS -S/-s)
 
@@ -685,11 +739,68 @@ static void report_summary(const RTSSummaryStats* sum)
     showStgWord64(stats.max_slop_bytes, temp, true/*commas*/);
     statsPrintf("%16s bytes maximum slop\n", temp);
 
+    if (stats.max_pinned_slop_bytes > 0) {
+        showStgWord64(stats.max_pinned_slop_bytes, temp, true/*commas*/);
+        statsPrintf("%16s bytes maximum pinned slop\n", temp);
+    }
+
     statsPrintf("%16" FMT_Word64 " MB total memory in use (%"
-                FMT_Word64 " MB lost due to fragmentation)\n\n",
+                FMT_Word64 " MB lost due to fragmentation)\n",
                 stats.max_live_bytes  / (1024 * 1024),
                 sum->fragmentation_bytes / (1024 * 1024));
 
+    if (sum->free_bytes > 0) {
+        statsPrintf("%16" FMT_Word64 " MB free in the block allocator "
+                    "(largest free group %" FMT_Word64 " KB)\n",
+                    sum->free_bytes / (1024 * 1024),
+                    sum->largest_free_bytes / 1024);
+    }
+
+    if (RtsFlags.GcFlags.hugePages) {
+        statsPrintf("%16" FMT_Word64 " MB of the heap in huge pages "
+                    "(%.1f%% coverage)\n",
+                    sum->hugepage_bytes / (1024 * 1024),
+                    sum->hugepage_percent * 100);
+    }
+
+    if (RtsFlags.GcFlags.numa) {
+        uint32_t n;
+        for (n = 0; n < n_numa_nodes; n++) {
+            statsPrintf("%16" FMT_Word64 " GC to-space blocks on NUMA node %"
+                        FMT_Word32 "\n",
+                        sum->numa_gc_blocks[n], n);
+        }
+        showStgWord64(sum->numa_remote_copied_bytes, temp, true/*commas*/);
+        statsPrintf("%16s bytes copied to their own node by remote GC threads\n",
+                    temp);
+    }
+
+    if (RtsFlags.GcFlags.cardTable) {
+        statsPrintf("%15.3fs GC time scanning mutable lists\n",
+                    TimeToSecondsDbl(sum->mut_list_ns));
+        statsPrintf("%15.3fs GC time scanning card blocks\n",
+                    TimeToSecondsDbl(sum->card_scan_ns));
+    }
+
+    // See Note [Static root cache] in StaticRoots.c
+    if (RtsFlags.GcFlags.staticRootsInterval > 1) {
+        statsPrintf("%15.3fs GC time on static objects and CAFs\n",
+                    TimeToSecondsDbl(sum->static_ns));
+        statsPrintf("%16" FMT_Word64 " major GCs used the cached CAFs\n",
+                    sum->static_walks_skipped);
+    }
+
+    // See Note [Eager selector evaluation] in Evac.c
+    if (sum->selectors_eliminated + sum->selectors_left > 0) {
+        showStgWord64(sum->selectors_eliminated, temp, true/*commas*/);
+        statsPrintf("%16s selector thunks evaluated by the GC\n", temp);
+        showStgWord64(sum->selectors_left, temp, true/*commas*/);
+        statsPrintf("%16s selector thunks copied unevaluated\n", temp);
+        showStgWord64(sum->inds_removed, temp, true/*commas*/);
+        statsPrintf("%16s indirections removed\n", temp);
+    }
+    statsPrintf("\n");
+
     /* Print garbage collections in each gen */
     statsPrintf("                                     Tot time (elapsed)  Avg pause  Max pause\n");
     for (g = 0; g < RtsFlags.GcFlags.generations; g++) {
@@ -709,12 +820,39 @@ static void report_summary(const RTSSummaryStats* sum)
 
     statsPrintf("\n");
 
+    if (sum->pretenured_sites > 0) {
+        uint32_t i;
+        statsPrintf("  Pretenured constructors: %" FMT_Word32 "\n",
+                    sum->pretenured_sites);
+        for (i = 0; i < sum->pretenured_sites &&
+                    i < PRETENURE_REPORT_SITES; i++) {
+            const PretenureReport *site = &sum->pretenure_report[i];
+            showStgWord64(site->pretenured, temp, true/*commas*/);
+            statsPrintf("  %16s copied straight to gen 1 (%3.0f%% promoted"
+                        " before): %s\n",
+                        temp,
+                        site->survived == 0 ? 0 :
+                            (double)site->promoted * 100 / site->survived,
+                        site->name);
+        }
+        statsPrintf("\n");
+    }
+
 #if defined(THREADED_RTS)
     if (RtsFlags.ParFlags.parGcEnabled && sum->work_balance > 0) {
         // See Note [Work Balance]
         statsPrintf("  Parallel GC work balance: "
-                    "%.2f%% (serial 0%%, perfect 100%%)\n\n",
+                    "%.2f%% (serial 0%%, perfect 100%%)\n",
                     sum->work_balance * 100);
+        statsPrintf("  Parallel GC scavenge balance: "
+                    "%.2f%% (serial 0%%, perfect 100%%)\n",
+                    sum->scav_balance * 100);
+        if (sum->split_arrays > 0) {
+            statsPrintf("  Large arrays split: %" FMT_Word64
+                        " (%" FMT_Word64 " ranges stolen)\n",
+                        sum->split_arrays, sum->stolen_ranges);
+        }
+        statsPrintf("\n");
     }
 
     statsPrintf("  TASKS: %d "
@@ -730,6 +868,15 @@ static void report_summary(const RTSSummaryStats* sum)
                 sum->sparks.converted, sum->sparks.overflowed,
                 sum->sparks.dud, sum->sparks.gcd,
                 sum->sparks.fizzled);
+
+    if (sum->idle_wakeups > 0) {
+        // See Note [Idle spinning] in Capability.c
+        statsPrintf("  IDLE WORKERS: %" FMT_Word64 " woken (%" FMT_Word64
+                    " parked, %" FMT_Word64 " unparks), "
+                    "%.2fus average wake latency\n\n",
+                    sum->idle_wakeups, sum->idle_parks, sum->idle_unparks,
+                    TimeToSecondsDbl(sum->idle_wake_latency) * 1e6);
+    }
 #endif
 
     statsPrintf("  INIT    time  %7.3fs  (%7.3fs elapsed)\n",
@@ -929,6 +1076,8 @@ static void report_machine_readable (const RTSSummaryStats * sum)
             stats.max_large_objects_bytes);
     MR_STAT("max_compact_bytes", FMT_Word64, stats.max_compact_bytes);
     MR_STAT("max_slop_bytes", FMT_Word64, stats.max_slop_bytes);
+    MR_STAT("max_pinned_slop_bytes", FMT_Word64,
+            stats.max_pinned_slop_bytes);
     // This duplicates, except for unit, peak_megabytes_allocated above
     MR_STAT("max_mem_in_use_bytes", FMT_Word64, stats.max_mem_in_use_bytes);
     MR_STAT("cumulative_live_bytes", FMT_Word64, stats.cumulative_live_bytes);
@@ -945,6 +1094,38 @@ static void report_machine_readable (const RTSSummaryStats * sum)
     MR_STAT("gc_wall_percent", "f", sum->gc_cpu_percent);
 #endif
     MR_STAT("fragmentation_bytes", FMT_Word64, sum->fragmentation_bytes);
+    MR_STAT("free_bytes", FMT_Word64, sum->free_bytes);
+    MR_STAT("largest_free_bytes", FMT_Word64, sum->largest_free_bytes);
+    if (RtsFlags.GcFlags.numa) {
+        uint32_t n;
+        for (n = 0; n < n_numa_nodes; n++) {
+            statsPrintf(" ,(\"numa_node_%" FMT_Word32 "_gc_blocks\", \"%"
+                        FMT_Word64 "\")\n", n, sum->numa_gc_blocks[n]);
+        }
+        MR_STAT("numa_remote_copied_bytes", FMT_Word64,
+                sum->numa_remote_copied_bytes);
+    }
+    if (RtsFlags.GcFlags.pretenureThreshold != 0) {
+        MR_STAT("pretenured_sites", FMT_Word32, sum->pretenured_sites);
+    }
+    if (RtsFlags.GcFlags.cardTable) {
+        MR_STAT("mut_list_scan_seconds", "f",
+                TimeToSecondsDbl(sum->mut_list_ns));
+        MR_STAT("card_scan_seconds", "f",
+                TimeToSecondsDbl(sum->card_scan_ns));
+    }
+    if (RtsFlags.GcFlags.staticRootsInterval > 1) {
+        MR_STAT("static_seconds", "f", TimeToSecondsDbl(sum->static_ns));
+        MR_STAT("static_walks_skipped", FMT_Word64,
+                sum->static_walks_skipped);
+    }
+    MR_STAT("selectors_eliminated", FMT_Word64, sum->selectors_eliminated);
+    MR_STAT("selectors_left", FMT_Word64, sum->selectors_left);
+    MR_STAT("indirections_removed", FMT_Word64, sum->inds_removed);
+    if (RtsFlags.GcFlags.hugePages) {
+        MR_STAT("hugepage_bytes", FMT_Word64, sum->hugepage_bytes);
+        MR_STAT("hugepage_percent", "f", sum->hugepage_percent);
+    }
     // average_bytes_used is done above
     MR_STAT("alloc_rate", FMT_Word64, sum->alloc_rate);
     MR_STAT("productivity_cpu_percent", "f", sum->productivity_cpu_percent);
@@ -962,6 +1143,14 @@ static void report_machine_readable (const RTSSummaryStats * sum)
     MR_STAT("sparks_gcd", FMT_Word, sum->sparks.gcd);
     MR_STAT("sparks_fizzled", FMT_Word, sum->sparks.fizzled);
     MR_STAT("work_balance", "f", sum->work_balance);
+    MR_STAT("scav_balance", "f", sum->scav_balance);
+    MR_STAT("split_arrays", FMT_Word64, sum->split_arrays);
+    MR_STAT("stolen_ranges", FMT_Word64, sum->stolen_ranges);
+    MR_STAT("idle_wakeups", FMT_Word64, sum->idle_wakeups);
+    MR_STAT("idle_parks", FMT_Word64, sum->idle_parks);
+    MR_STAT("idle_unparks", FMT_Word64, sum->idle_unparks);
+    MR_STAT("idle_wake_latency_ns", FMT_Word64,
+            (StgWord64)TimeToNS(sum->idle_wake_latency));
 
     // next, globals (other than internal counters)
     MR_STAT("n_capabilities", FMT_Word32, n_capabilities);
@@ -1167,6 +1356,13 @@ stat_exit (void)
                   capabilities[i]->spark_stats.converted;
                 sum.sparks.gcd       += capabilities[i]->spark_stats.gcd;
                 sum.sparks.fizzled   += capabilities[i]->spark_stats.fizzled;
+                sum.idle_wakeups     += capabilities[i]->idle_wakeups;
+                sum.idle_parks       += capabilities[i]->idle_parks;
+                sum.idle_unparks     += capabilities[i]->idle_unparks;
+                sum.idle_wake_latency+= capabilities[i]->idle_wake_latency;
+            }
+            if (sum.idle_wakeups > 0) {
+                sum.idle_wake_latency /= sum.idle_wakeups;
             }
 
             sum.sparks_count = sum.sparks.created
@@ -1182,6 +1378,17 @@ stat_exit (void)
                 sum.work_balance = 0;
             }
 
+            // See Note [Splitting large arrays] in Scav.c
+            if (RtsFlags.ParFlags.parGcEnabled && gc_par_scanned_words > 0) {
+                sum.scav_balance =
+                    (double)gc_par_balanced_scanned_words
+                    / (double)gc_par_scanned_words;
+            } else {
+                sum.scav_balance = 0;
+            }
+            sum.split_arrays = gc_split_arrays;
+            sum.stolen_ranges = gc_stolen_ranges;
+
 
     #else // THREADED_RTS
             sum.gc_cpu_percent     = stats.gc_cpu_ns
@@ -1197,6 +1404,46 @@ stat_exit (void)
                          - hw_alloc_blocks * BLOCK_SIZE_W)
                 / (uint64_t)sizeof(W_);
 
+            {
+                FreeSpaceStats fs;
+                ACQUIRE_SM_LOCK;
+                getFreeSpaceStats(&fs);
+                RELEASE_SM_LOCK;
+                sum.free_bytes = (uint64_t)fs.free_blocks * BLOCK_SIZE;
+                sum.largest_free_bytes = (uint64_t)fs.largest_free * BLOCK_SIZE;
+            }
+
+            if (RtsFlags.GcFlags.numa) {
+                uint32_t n;
+                for (n = 0; n < n_numa_nodes; n++) {
+                    sum.numa_gc_blocks[n] = gc_to_blocks_by_node[n];
+                }
+                sum.numa_remote_copied_bytes =
+                    (uint64_t)gc_remote_copied_words * sizeof(W_);
+            }
+
+            if (RtsFlags.GcFlags.cardTable) {
+                sum.mut_list_ns = gc_mut_list_time;
+                sum.card_scan_ns = gc_card_scan_time;
+            }
+
+            sum.pretenured_sites =
+                pretenureReport(sum.pretenure_report, PRETENURE_REPORT_SITES);
+
+            sum.static_ns = gc_static_time;
+            sum.static_walks_skipped = static_walks_skipped;
+
+            sum.selectors_eliminated = gc_selectors_eliminated;
+            sum.selectors_left = gc_selectors_left;
+            sum.inds_removed = gc_inds_removed;
+
+            if (RtsFlags.GcFlags.hugePages) {
+                W_ heap_bytes = mblocks_allocated * MBLOCK_SIZE;
+                sum.hugepage_bytes = osHugePageBytes();
+                sum.hugepage_percent = heap_bytes == 0 ? 0 :
+                    (double)sum.hugepage_bytes / (double)heap_bytes;
+            }
+
             sum.average_bytes_used = stats.major_gcs == 0 ? 0 :
                  stats.cumulative_live_bytes/stats.major_gcs,
 
@@ -1422,7 +1669,7 @@ Parallel garbage collector counters:
 void
 statDescribeGens(void)
 {
-  uint32_t g, mut, lge, compacts, i;
+  uint32_t g, mut, lge, compacts, i, c;
   W_ gen_slop;
   W_ tot_live, tot_slop;
   W_ gen_live, gen_blocks;
@@ -1462,6 +1709,13 @@ statDescribeGens(void)
               gen_live   += bd->free - bd->start;
               gen_blocks += bd->blocks;
           }
+          for (c = 0; c < PINNED_SIZE_CLASSES; c++) {
+              bd = capabilities[i]->pinned_class_blocks[c];
+              if (bd != NULL) {
+                  gen_live   += bd->free - bd->start;
+                  gen_blocks += bd->blocks;
+              }
+          }
 
           gen_live   += gcThreadLiveWords(i,g);
           gen_blocks += gcThreadLiveBlocks(i,g);
@@ -1503,6 +1757,7 @@ void getRTSStats( RTSStats *s )
 {
     Time current_elapsed = 0;
     Time current_cpu = 0;
+    uint32_t g;
 
     *s = stats;
 
@@ -1513,6 +1768,14 @@ void getRTSStats( RTSStats *s )
     s->mutator_cpu_ns = current_cpu - end_init_cpu - stats.gc_cpu_ns;
     s->mutator_elapsed_ns = current_elapsed - end_init_elapsed -
         stats.gc_elapsed_ns;
+
+    s->pending_decommit_bytes = (uint64_t)pending_decommit_mblocks * MBLOCK_SIZE;
+
+    s->sweep_debt_bytes = 0;
+    for (g = 0; g < RtsFlags.GcFlags.generations; g++) {
+        s->sweep_debt_bytes +=
+            (uint64_t)generations[g].n_unswept_blocks * BLOCK_SIZE;
+    }
 }
 
 /* -----------------------------------------------------------------------------
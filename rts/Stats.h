@@ -10,6 +10,7 @@
 
 #include "GetTime.h"
 #include "sm/GC.h"
+#include "sm/Pretenure.h"
 #include "Sparks.h"
 
 #include "BeginPrivate.h"
@@ -100,11 +101,38 @@ typedef struct RTSSummaryStats_ {
     uint64_t sparks_count;
     SparkCounters sparks;
     double work_balance;
+    double scav_balance;         // the same for scavenged words
+    uint64_t split_arrays;       // large arrays split for stealing
+    uint64_t stolen_ranges;      // ... and ranges of them stolen
+    uint64_t idle_wakeups;       // idle workers woken ...
+    uint64_t idle_parks;         // ... of which had gone to sleep
+    uint64_t idle_unparks;       // sleeping Tasks signalled
+    Time idle_wake_latency;      // average from wakeup to running
 #else // THREADED_RTS
     double gc_cpu_percent;
     double gc_elapsed_percent;
 #endif
     uint64_t fragmentation_bytes;
+    uint64_t free_bytes;         // on the block allocator's free lists
+    uint64_t largest_free_bytes; // in the largest free block group
+    uint64_t hugepage_bytes;     // only with +RTS -xH
+    double hugepage_percent;
+    // only with +RTS --numa
+    uint64_t numa_gc_blocks[MAX_NUMA_NODES]; // to-space blocks per node
+    uint64_t numa_remote_copied_bytes;
+    // only with +RTS --card-table, summed over the GC threads
+    Time mut_list_ns;            // scavenging the mutable lists
+    Time card_scan_ns;           // scanning the card blocks
+    // only with +RTS --pretenure, the sites pretenured at some point
+    uint32_t pretenured_sites;
+    PretenureReport pretenure_report[PRETENURE_REPORT_SITES];
+    // see Note [Static root cache] in StaticRoots.c
+    Time static_ns;              // static objects and CAFs
+    uint64_t static_walks_skipped; // major GCs that used the cache
+    // see Note [Eager selector evaluation] in Evac.c
+    uint64_t selectors_eliminated; // THUNK_SELECTORs evaluated by the GC
+    uint64_t selectors_left;     // ... and copied unevaluated
+    uint64_t inds_removed;       // indirections short-cut by evacuate()
     uint64_t average_bytes_used; // This is not shown in the '+RTS -s' report
     uint64_t alloc_rate;
     double productivity_cpu_percent;
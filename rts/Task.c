@@ -222,6 +222,8 @@ newTask (bool worker)
     initMutex(&task->lock);
     task->id = 0;
     task->wakeup = false;
+    task->spinning = false;
+    task->woken_at = 0;
     task->node = 0;
 #endif
 
@@ -128,6 +128,16 @@ typedef struct Task_ {
     // that signalling a condition variable doesn't do anything if the
     // thread is already running, but we want it to be sticky.
     bool wakeup;
+
+    // See Note [Idle spinning] in Capability.c.  Both protected by
+    // task->lock.
+
+    // true while an idle worker spins waiting for task->wakeup rather
+    // than sleeping on task->cond
+    bool spinning;
+
+    // when task->wakeup was set, for the wake latency in +RTS -s
+    Time woken_at;
 #endif
 
     // If the task owns a Capability, task->cap points to it.  (occasionally a
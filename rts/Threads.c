@@ -99,6 +99,7 @@ createThread(Capability *cap, W_ size)
     tso->bq = (StgBlockingQueue *)END_TSO_QUEUE;
     tso->flags = 0;
     tso->dirty = 1;
+    tso->priority = TSO_PRIORITY_NORMAL;
     tso->_link = END_TSO_QUEUE;
 
     tso->saved_errno = 0;
@@ -109,6 +110,8 @@ createThread(Capability *cap, W_ size)
     tso->tot_stack_size = stack->stack_size;
 
     ASSIGN_Int64((W_*)&(tso->alloc_limit), 0);
+    ASSIGN_Word64((W_*)&(tso->allocated), 0);
+    ASSIGN_Word64((W_*)&(tso->run_time), 0);
 
     tso->trec = NO_TREC;
 
@@ -180,6 +183,62 @@ void rts_disableThreadAllocationLimit(StgPtr tso)
     ((StgTSO *)tso)->flags &= ~TSO_ALLOC_LIMIT;
 }
 
+/* ---------------------------------------------------------------------------
+ * How much threads have allocated and run: see Note [Thread usage] in
+ * Schedule.c.  The caller must hold a Capability (call these with an
+ * unsafe foreign call), so that the GC can't move the threads.
+ * ------------------------------------------------------------------------ */
+
+void
+rts_getThreadUsage (StgPtr tso_, ThreadUsage *usage)
+{
+    StgTSO *tso = (StgTSO *)tso_;
+
+    usage->id        = tso->id;
+    usage->allocated = PK_Word64((W_*)&(tso->allocated));
+    usage->run_time  = TimeToNS(PK_Word64((W_*)&(tso->run_time)));
+}
+
+// Fill in usage[] for up to n live threads, and return the number of
+// live threads, which may be more than n.
+StgWord
+rts_listThreadUsage (ThreadUsage *usage, StgWord n)
+{
+    StgTSO *t;
+    StgWord i = 0;
+    uint32_t g;
+
+    ACQUIRE_LOCK(&sched_mutex);
+    for (g = 0; g < RtsFlags.GcFlags.generations; g++) {
+        for (t = generations[g].threads; t != END_TSO_QUEUE;
+             t = t->global_link) {
+            if (t->what_next == ThreadComplete ||
+                t->what_next == ThreadKilled) {
+                continue;
+            }
+            if (i < n) {
+                rts_getThreadUsage((StgPtr)t, &usage[i]);
+            }
+            i++;
+        }
+    }
+    RELEASE_LOCK(&sched_mutex);
+    return i;
+}
+
+/* ---------------------------------------------------------------------------
+ * Setting the priority of a thread: see Note [Thread priorities] in
+ * Schedule.c.  Any thread may set the priority of any other, so this
+ * only writes tso->priority; a thread that is on a run queue already
+ * stays there until it is next scheduled.
+ * ------------------------------------------------------------------------ */
+
+void
+setThreadPriority (StgTSO *tso, StgWord priority)
+{
+    tso->priority = stg_min(priority, TSO_PRIORITIES - 1);
+}
+
 /* -----------------------------------------------------------------------------
    Remove a thread from a queue.
    Fails fatally if the TSO is not on the queue.
@@ -503,97 +562,19 @@ isThreadBound(StgTSO* tso USED_IF_THREADS)
 }
 
 /* -----------------------------------------------------------------------------
-   Stack overflow
-
-   If the thread has reached its maximum stack size, then raise the
-   StackOverflow exception in the offending thread.  Otherwise
-   relocate the TSO into a larger chunk of memory and adjust its stack
-   size appropriately.
+   Start a new stack chunk of chunk_size words for a thread, moving the
+   frames at the top of its current chunk (up to +RTS -kb of them) into
+   it, and linking the new chunk to the old one with an underflow frame.
    -------------------------------------------------------------------------- */
 
-void
-threadStackOverflow (Capability *cap, StgTSO *tso)
+static void
+newStackChunk (Capability *cap, StgTSO *tso, W_ chunk_size)
 {
     StgStack *new_stack, *old_stack;
     StgUnderflowFrame *frame;
-    W_ chunk_size;
-
-    IF_DEBUG(sanity,checkTSO(tso));
-
-    if (RtsFlags.GcFlags.maxStkSize > 0
-        && tso->tot_stack_size >= RtsFlags.GcFlags.maxStkSize) {
-        // #3677: In a stack overflow situation, stack squeezing may
-        // reduce the stack size, but we don't know whether it has been
-        // reduced enough for the stack check to succeed if we try
-        // again.  Fortunately stack squeezing is idempotent, so all we
-        // need to do is record whether *any* squeezing happened.  If we
-        // are at the stack's absolute -K limit, and stack squeezing
-        // happened, then we try running the thread again.  The
-        // TSO_SQUEEZED flag is set by threadPaused() to tell us whether
-        // squeezing happened or not.
-        if (tso->flags & TSO_SQUEEZED) {
-            return;
-        }
-
-        debugTrace(DEBUG_gc,
-                   "threadStackOverflow of TSO %ld (%p): stack too large (now %ld; max is %ld)",
-                   (long)tso->id, tso, (long)tso->stackobj->stack_size,
-                   RtsFlags.GcFlags.maxStkSize);
-        IF_DEBUG(gc,
-                 /* If we're debugging, just print out the top of the stack */
-                 printStackChunk(tso->stackobj->sp,
-                                 stg_min(tso->stackobj->stack + tso->stackobj->stack_size,
-                                         tso->stackobj->sp+64)));
-
-        // Note [Throw to self when masked], also #767 and #8303.
-        throwToSelf(cap, tso, (StgClosure *)stackOverflow_closure);
-        return;
-    }
-
-
-    // We also want to avoid enlarging the stack if squeezing has
-    // already released some of it.  However, we don't want to get into
-    // a pathological situation where a thread has a nearly full stack
-    // (near its current limit, but not near the absolute -K limit),
-    // keeps allocating a little bit, squeezing removes a little bit,
-    // and then it runs again.  So to avoid this, if we squeezed *and*
-    // there is still less than BLOCK_SIZE_W words free, then we enlarge
-    // the stack anyway.
-    //
-    // NB: This reasoning only applies if the stack has been squeezed;
-    // if no squeezing has occurred, then BLOCK_SIZE_W free space does
-    // not mean there is enough stack to run; the thread may have
-    // requested a large amount of stack (see below).  If the amount
-    // we squeezed is not enough to run the thread, we'll come back
-    // here (no squeezing will have occurred and thus we'll enlarge the
-    // stack.)
-    if ((tso->flags & TSO_SQUEEZED) &&
-        ((W_)(tso->stackobj->sp - tso->stackobj->stack) >= BLOCK_SIZE_W)) {
-        return;
-    }
 
     old_stack = tso->stackobj;
 
-    // If we used less than half of the previous stack chunk, then we
-    // must have failed a stack check for a large amount of stack.  In
-    // this case we allocate a double-sized chunk to try to
-    // accommodate the large stack request.  If that also fails, the
-    // next chunk will be 4x normal size, and so on.
-    //
-    // It would be better to have the mutator tell us how much stack
-    // was needed, as we do with heap allocations, but this works for
-    // now.
-    //
-    if (old_stack->sp > old_stack->stack + old_stack->stack_size / 2)
-    {
-        chunk_size = stg_max(2 * (old_stack->stack_size + sizeofW(StgStack)),
-                             RtsFlags.GcFlags.stkChunkSize);
-    }
-    else
-    {
-        chunk_size = RtsFlags.GcFlags.stkChunkSize;
-    }
-
     debugTraceCap(DEBUG_sched, cap,
                   "allocating new stack chunk of size %d bytes",
                   chunk_size * sizeof(W_));
@@ -683,11 +664,168 @@ threadStackOverflow (Capability *cap, StgTSO *tso)
 
     // we're about to run it, better mark it dirty
     dirty_STACK(cap, new_stack);
+}
+
+/* -----------------------------------------------------------------------------
+   Stack overflow
+
+   If the thread has reached its maximum stack size, then raise the
+   StackOverflow exception in the offending thread.  Otherwise
+   relocate the TSO into a larger chunk of memory and adjust its stack
+   size appropriately.
+   -------------------------------------------------------------------------- */
+
+void
+threadStackOverflow (Capability *cap, StgTSO *tso)
+{
+    StgStack *old_stack;
+    W_ chunk_size;
+
+    IF_DEBUG(sanity,checkTSO(tso));
+
+    if (RtsFlags.GcFlags.maxStkSize > 0
+        && tso->tot_stack_size >= RtsFlags.GcFlags.maxStkSize) {
+        // #3677: In a stack overflow situation, stack squeezing may
+        // reduce the stack size, but we don't know whether it has been
+        // reduced enough for the stack check to succeed if we try
+        // again.  Fortunately stack squeezing is idempotent, so all we
+        // need to do is record whether *any* squeezing happened.  If we
+        // are at the stack's absolute -K limit, and stack squeezing
+        // happened, then we try running the thread again.  The
+        // TSO_SQUEEZED flag is set by threadPaused() to tell us whether
+        // squeezing happened or not.
+        if (tso->flags & TSO_SQUEEZED) {
+            return;
+        }
+
+        debugTrace(DEBUG_gc,
+                   "threadStackOverflow of TSO %ld (%p): stack too large (now %ld; max is %ld)",
+                   (long)tso->id, tso, (long)tso->stackobj->stack_size,
+                   RtsFlags.GcFlags.maxStkSize);
+        IF_DEBUG(gc,
+                 /* If we're debugging, just print out the top of the stack */
+                 printStackChunk(tso->stackobj->sp,
+                                 stg_min(tso->stackobj->stack + tso->stackobj->stack_size,
+                                         tso->stackobj->sp+64)));
+
+        // Note [Throw to self when masked], also #767 and #8303.
+        throwToSelf(cap, tso, (StgClosure *)stackOverflow_closure);
+        return;
+    }
+
+
+    // We also want to avoid enlarging the stack if squeezing has
+    // already released some of it.  However, we don't want to get into
+    // a pathological situation where a thread has a nearly full stack
+    // (near its current limit, but not near the absolute -K limit),
+    // keeps allocating a little bit, squeezing removes a little bit,
+    // and then it runs again.  So to avoid this, if we squeezed *and*
+    // there is still less than BLOCK_SIZE_W words free, then we enlarge
+    // the stack anyway.
+    //
+    // NB: This reasoning only applies if the stack has been squeezed;
+    // if no squeezing has occurred, then BLOCK_SIZE_W free space does
+    // not mean there is enough stack to run; the thread may have
+    // requested a large amount of stack (see below).  If the amount
+    // we squeezed is not enough to run the thread, we'll come back
+    // here (no squeezing will have occurred and thus we'll enlarge the
+    // stack.)
+    if ((tso->flags & TSO_SQUEEZED) &&
+        ((W_)(tso->stackobj->sp - tso->stackobj->stack) >= BLOCK_SIZE_W)) {
+        return;
+    }
+
+    old_stack = tso->stackobj;
+
+    // If we used less than half of the previous stack chunk, then we
+    // must have failed a stack check for a large amount of stack.  In
+    // this case we allocate a double-sized chunk to try to
+    // accommodate the large stack request.  If that also fails, the
+    // next chunk will be 4x normal size, and so on.
+    //
+    // It would be better to have the mutator tell us how much stack
+    // was needed, as we do with heap allocations, but this works for
+    // now.
+    //
+    if (old_stack->sp > old_stack->stack + old_stack->stack_size / 2)
+    {
+        chunk_size = stg_max(2 * (old_stack->stack_size + sizeofW(StgStack)),
+                             RtsFlags.GcFlags.stkChunkSize);
+    }
+    else
+    {
+        chunk_size = RtsFlags.GcFlags.stkChunkSize;
+    }
+
+    newStackChunk(cap, tso, chunk_size);
 
     IF_DEBUG(sanity,checkTSO(tso));
     // IF_DEBUG(scheduler,printTSO(new_tso));
 }
 
+/* -----------------------------------------------------------------------------
+   Stack splitting
+
+   Note [Stack watermarks]
+   ~~~~~~~~~~~~~~~~~~~~~~~
+
+   A thread's stack only has to be scanned by a minor GC if it has been
+   written since the last GC, which is what the dirty flag of each
+   STACK chunk records.  But the chunk the thread is running on is
+   always dirty, so a thread with a deep recursion in a big chunk (one
+   grown by threadStackOverflow() to fit a large frame, or a thread
+   that has run for a long time without overflowing) has the whole of
+   that chunk scanned at every GC, although only the few frames at the
+   top have changed.
+
+   With +RTS -kw<size>, when a thread returns to the scheduler to GC or
+   to yield and the chunk it is running on holds more than <size>
+   words of stack, threadStackSplit() starts a new chunk, just as a
+   stack overflow would: the top frames (up to -kb of them) move to the
+   new chunk, and the deep frames stay behind in the old one, under an
+   underflow frame.  The boundary between the chunks is the watermark:
+   the old chunk is scavenged by the next GC, which leaves it clean, and
+   from then on it is skipped until the thread returns into it through
+   the underflow frame (threadStackUnderflow()), which marks it dirty
+   again.  No code has to check the watermark, since the underflow
+   frame is the return barrier.
+
+   The split costs an allocation of a stack chunk and a copy of at most
+   -kb words, and only happens to a thread whose chunk has grown past
+   <size> since the last split, so the threshold should be several
+   times -kb.  We don't split a stack that is at its -K limit.
+   -------------------------------------------------------------------------- */
+
+void
+threadStackSplit (Capability *cap, StgTSO *tso)
+{
+    StgStack *stack = tso->stackobj;
+    W_ used;
+
+    if (RtsFlags.GcFlags.stkSplitSize == 0) {
+        return;
+    }
+
+    used = stack->stack + stack->stack_size - stack->sp;
+    if (used < (W_)RtsFlags.GcFlags.stkSplitSize
+               + RtsFlags.GcFlags.stkChunkBufferSize) {
+        return;
+    }
+
+    if (RtsFlags.GcFlags.maxStkSize > 0
+        && tso->tot_stack_size + RtsFlags.GcFlags.stkChunkSize
+               >= RtsFlags.GcFlags.maxStkSize) {
+        return;
+    }
+
+    debugTraceCap(DEBUG_sched, cap,
+                  "splitting stack of thread %lu at %" FMT_Word " words",
+                  (unsigned long)tso->id, used);
+
+    newStackChunk(cap, tso, RtsFlags.GcFlags.stkChunkSize);
+
+    IF_DEBUG(sanity,checkTSO(tso));
+}
 
 
 /* ---------------------------------------------------------------------------
@@ -912,7 +1050,7 @@ void
 printAllThreads(void)
 {
   StgTSO *t, *next;
-  uint32_t i, g;
+  uint32_t i, g, p;
   Capability *cap;
 
   debugBelch("all threads:\n");
@@ -920,8 +1058,10 @@ printAllThreads(void)
   for (i = 0; i < n_capabilities; i++) {
       cap = capabilities[i];
       debugBelch("threads on capability %d:\n", cap->no);
-      for (t = cap->run_queue_hd; t != END_TSO_QUEUE; t = t->_link) {
-          printThreadStatus(t);
+      for (p = 0; p < TSO_PRIORITIES; p++) {
+          for (t = cap->run_queue_hd[p]; t != END_TSO_QUEUE; t = t->_link) {
+              printThreadStatus(t);
+          }
       }
   }
 
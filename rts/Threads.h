@@ -36,8 +36,11 @@ bool removeThreadFromDeQueue   (Capability *cap, StgTSO **head, StgTSO **tail, S
 
 StgBool isThreadBound (StgTSO* tso);
 
+void setThreadPriority (StgTSO *tso, StgWord priority);
+
 // Overfow/underflow
 void threadStackOverflow  (Capability *cap, StgTSO *tso);
+void threadStackSplit     (Capability *cap, StgTSO *tso);
 W_   threadStackUnderflow (Capability *cap, StgTSO *tso);
 
 bool performTryPutMVar(Capability *cap, StgMVar *mvar, StgClosure *value);
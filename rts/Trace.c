@@ -375,6 +375,102 @@ void traceEventGcStats_  (Capability *cap,
     }
 }
 
+void traceEventBlockCacheStats_ (Capability *cap,
+                                 W_          hits,
+                                 W_          misses,
+                                 W_          flushed_blocks)
+{
+#if defined(DEBUG)
+    if (RtsFlags.TraceFlags.tracing == TRACE_STDERR) {
+        /* no stderr equivalent for these ones */
+    } else
+#endif
+    {
+        postEventBlockCacheStats(cap, hits, misses, flushed_blocks);
+    }
+}
+
+void traceEventNurserySize_ (Capability *cap,
+                             W_          nursery_bytes,
+                             W_          alloc_rate_bytes)
+{
+#if defined(DEBUG)
+    if (RtsFlags.TraceFlags.tracing == TRACE_STDERR) {
+        /* no stderr equivalent for these ones */
+    } else
+#endif
+    {
+        postEventNurserySize(cap, nursery_bytes, alloc_rate_bytes);
+    }
+}
+
+void traceEventHeapLargeObjects_ (Capability *cap,
+                                  CapsetID    heap_capset,
+                                  uint32_t    gen,
+                                  W_          objects,
+                                  W_          bytes,
+                                  W_          promoted_objects,
+                                  W_          promoted_bytes)
+{
+#if defined(DEBUG)
+    if (RtsFlags.TraceFlags.tracing == TRACE_STDERR) {
+        /* no stderr equivalent for these ones */
+    } else
+#endif
+    {
+        postEventHeapLargeObjects(cap, heap_capset, gen, objects, bytes,
+                                  promoted_objects, promoted_bytes);
+    }
+}
+
+void traceEventGcPace_ (Capability *cap,
+                        CapsetID    heap_capset,
+                        uint32_t    gen,
+                        StgWord64   predicted_pause_ns,
+                        W_          old_size_bytes,
+                        W_          new_size_bytes)
+{
+#if defined(DEBUG)
+    if (RtsFlags.TraceFlags.tracing == TRACE_STDERR) {
+        /* no stderr equivalent for these ones */
+    } else
+#endif
+    {
+        postEventGcPace(cap, heap_capset, gen, predicted_pause_ns,
+                        old_size_bytes, new_size_bytes);
+    }
+}
+
+void traceEventCapThreadSteals_ (Capability *cap,
+                                 W_          published,
+                                 W_          reclaimed,
+                                 W_          stolen)
+{
+#if defined(DEBUG)
+    if (RtsFlags.TraceFlags.tracing == TRACE_STDERR) {
+        /* no stderr equivalent for these ones */
+    } else
+#endif
+    {
+        postEventCapThreadSteals(cap, published, reclaimed, stolen);
+    }
+}
+
+void traceEventThreadPriorityStats_ (Capability *cap,
+                                     uint32_t    priority,
+                                     W_          runs,
+                                     W_          boosts)
+{
+#if defined(DEBUG)
+    if (RtsFlags.TraceFlags.tracing == TRACE_STDERR) {
+        /* no stderr equivalent for these ones */
+    } else
+#endif
+    {
+        postEventThreadPriorityStats(cap, priority, runs, boosts);
+    }
+}
+
 void traceCapEvent_ (Capability   *cap,
                      EventTypeNum  tag)
 {
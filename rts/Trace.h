@@ -154,6 +154,40 @@ void traceEventGcStats_  (Capability *cap,
                           W_        par_tot_copied,
                           W_        par_balanced_copied);
 
+void traceEventBlockCacheStats_ (Capability *cap,
+                                 W_          hits,
+                                 W_          misses,
+                                 W_          flushed_blocks);
+
+void traceEventNurserySize_ (Capability *cap,
+                             W_          nursery_bytes,
+                             W_          alloc_rate_bytes);
+
+void traceEventHeapLargeObjects_ (Capability *cap,
+                                  CapsetID    heap_capset,
+                                  uint32_t    gen,
+                                  W_          objects,
+                                  W_          bytes,
+                                  W_          promoted_objects,
+                                  W_          promoted_bytes);
+
+void traceEventGcPace_ (Capability *cap,
+                        CapsetID    heap_capset,
+                        uint32_t    gen,
+                        StgWord64   predicted_pause_ns,
+                        W_          old_size_bytes,
+                        W_          new_size_bytes);
+
+void traceEventCapThreadSteals_ (Capability *cap,
+                                 W_          published,
+                                 W_          reclaimed,
+                                 W_          stolen);
+
+void traceEventThreadPriorityStats_ (Capability *cap,
+                                     uint32_t    priority,
+                                     W_          runs,
+                                     W_          boosts);
+
 /*
  * Record a spark event
  */
@@ -314,6 +348,19 @@ void flushTrace(void);
                            par_n_threads, par_max_copied, \
                            par_tot_copied, par_balanced_copied) /* nothing */
 #define traceHeapEvent(cap, tag, heap_capset, info1) /* nothing */
+#define traceEventBlockCacheStats_(cap, hits, misses, \
+                                   flushed_blocks) /* nothing */
+#define traceEventNurserySize_(cap, nursery_bytes, \
+                               alloc_rate_bytes) /* nothing */
+#define traceEventHeapLargeObjects_(cap, heap_capset, gen, \
+                                    objects, bytes, promoted_objects, \
+                                    promoted_bytes) /* nothing */
+#define traceEventGcPace_(cap, heap_capset, gen, predicted_pause_ns, \
+                          old_size_bytes, new_size_bytes) /* nothing */
+#define traceEventCapThreadSteals_(cap, published, reclaimed, \
+                                   stolen) /* nothing */
+#define traceEventThreadPriorityStats_(cap, priority, runs, \
+                                       boosts) /* nothing */
 #define traceEventHeapInfo_(heap_capset, gens, \
                             maxHeapSize, allocAreaSize, \
                             mblockSize, blockSize) /* nothing */
@@ -694,6 +741,82 @@ INLINE_HEADER void traceEventGcStats(Capability *cap            STG_UNUSED,
                        par_tot_copied, par_balanced_copied);
 }
 
+INLINE_HEADER void traceEventBlockCacheStats(Capability *cap     STG_UNUSED,
+                                             W_        hits     STG_UNUSED,
+                                             W_        misses   STG_UNUSED,
+                                             W_        flushed_blocks STG_UNUSED)
+{
+    if (RTS_UNLIKELY(TRACE_gc)) {
+        traceEventBlockCacheStats_(cap, hits, misses, flushed_blocks);
+    }
+}
+
+INLINE_HEADER void traceEventNurserySize(Capability *cap     STG_UNUSED,
+                                         W_        nursery_bytes STG_UNUSED,
+                                         W_        alloc_rate_bytes STG_UNUSED)
+{
+    if (RTS_UNLIKELY(TRACE_gc)) {
+        traceEventNurserySize_(cap, nursery_bytes, alloc_rate_bytes);
+    }
+}
+
+INLINE_HEADER void traceEventHeapLargeObjects(Capability *cap     STG_UNUSED,
+                                              CapsetID  heap_capset STG_UNUSED,
+                                              uint32_t  gen       STG_UNUSED,
+                                              W_        objects   STG_UNUSED,
+                                              W_        bytes     STG_UNUSED,
+                                              W_        promoted_objects STG_UNUSED,
+                                              W_        promoted_bytes STG_UNUSED)
+{
+    if (RTS_UNLIKELY(TRACE_gc)) {
+        traceEventHeapLargeObjects_(cap, heap_capset, gen, objects, bytes,
+                                    promoted_objects, promoted_bytes);
+    }
+}
+
+INLINE_HEADER void traceEventGcPace(Capability *cap       STG_UNUSED,
+                                    CapsetID  heap_capset STG_UNUSED,
+                                    uint32_t  gen         STG_UNUSED,
+                                    StgWord64 predicted_pause_ns STG_UNUSED,
+                                    W_        old_size_bytes STG_UNUSED,
+                                    W_        new_size_bytes STG_UNUSED)
+{
+    if (RTS_UNLIKELY(TRACE_gc)) {
+        traceEventGcPace_(cap, heap_capset, gen, predicted_pause_ns,
+                          old_size_bytes, new_size_bytes);
+    }
+}
+
+INLINE_HEADER void traceCapThreadSteals(Capability *cap STG_UNUSED)
+{
+#if defined(THREADED_RTS)
+    if (RTS_UNLIKELY(TRACE_sched) &&
+        RtsFlags.ParFlags.loadBalance != LOAD_BALANCE_PUSH) {
+        traceEventCapThreadSteals_(cap, cap->threads_published,
+                                   cap->threads_reclaimed,
+                                   cap->threads_stolen);
+    }
+#endif
+}
+
+// Only posted once threads of a priority other than normal have run;
+// see Note [Thread priorities] in Schedule.c
+INLINE_HEADER void traceCapPriorityStats(Capability *cap STG_UNUSED)
+{
+    uint32_t p;
+
+    if (RTS_UNLIKELY(TRACE_sched) &&
+        (cap->priority_runs[TSO_PRIORITY_HIGH] != 0 ||
+         cap->priority_runs[TSO_PRIORITY_LOW] != 0)) {
+        for (p = 0; p < TSO_PRIORITIES; p++) {
+            if (cap->priority_runs[p] != 0) {
+                traceEventThreadPriorityStats_(cap, p, cap->priority_runs[p],
+                                               cap->priority_boosts[p]);
+            }
+        }
+    }
+}
+
 INLINE_HEADER void traceEventHeapInfo(CapsetID    heap_capset   STG_UNUSED,
                                       uint32_t  gens          STG_UNUSED,
                                       W_        maxHeapSize   STG_UNUSED,
@@ -23,6 +23,12 @@ static StgWeak *finalizer_list = NULL;
 // Count of the above list.
 static uint32_t n_finalizers = 0;
 
+// non-zero if a thread is already in runSomeFinalizers(). This
+// protects the globals finalizer_list and n_finalizers.
+static volatile StgWord finalizer_lock = 0;
+
+static void wakeFinalizerThread (void);
+
 void
 runCFinalizers(StgCFinalizerList *list)
 {
@@ -93,10 +99,6 @@ scheduleFinalizers(Capability *cap, StgWeak *list)
     StgWord size;
     uint32_t n, i;
 
-    ASSERT(n_finalizers == 0);
-
-    finalizer_list = list;
-
     // Traverse the list and
     //  * count the number of Haskell finalizers
     //  * overwrite all the weak pointers with DEAD_WEAK
@@ -130,7 +132,20 @@ scheduleFinalizers(Capability *cap, StgWeak *list)
         SET_HDR(w, &stg_DEAD_WEAK_info, w->header.prof.ccs);
     }
 
+    // The finalizer thread may still be in runSomeFinalizers(), with
+    // nothing left to do.
+    while (cas(&finalizer_lock, 0, 1) != 0) {
+        yieldThread();
+    }
+    ASSERT(n_finalizers == 0);
+    finalizer_list = list;
     n_finalizers = i;
+    write_barrier();
+    finalizer_lock = 0;
+
+    if (i > 0) {
+        wakeFinalizerThread();
+    }
 
     // No Haskell finalizers to run?
     if (n == 0) return;
@@ -199,6 +214,19 @@ scheduleFinalizers(Capability *cap, StgWeak *list)
    call to doIdleGCWork() in the scheduler loop, but I haven't found
    that necessary so far.
 
+   5. With +RTS --finalizer-thread, run them on an OS thread of their
+      own, which scheduleFinalizers() wakes up after each GC.
+      + reduces pause to 0, and finalizers run as soon as possible
+      + the capabilities are left to run Haskell code
+      - the finalizers run in parallel with the program, even with -N1
+
+   The finalizer thread runs the finalizers a batch at a time, taking
+   finalizer_lock for each batch, so a GC that has to finish them off
+   (doIdleGCWork() runs them all before each GC) doesn't wait long.
+   Capabilities leave the finalizers to the thread until then.  The
+   thread has a Task of its own, so that rts_lock() still catches a
+   finalizer that calls back into Haskell.
+
    -------------------------------------------------------------------------- */
 
 // Run this many finalizers before returning from
@@ -207,9 +235,21 @@ scheduleFinalizers(Capability *cap, StgWeak *list)
 // available.
 static const int32_t finalizer_chunk = 100;
 
-// non-zero if a thread is already in runSomeFinalizers(). This
-// protects the globals finalizer_list and n_finalizers.
-static volatile StgWord finalizer_lock = 0;
+#if defined(THREADED_RTS)
+
+static Mutex      finalizer_mutex;
+static Condition  finalizer_cond;
+static OSThreadId finalizer_thread;
+
+// All protected by finalizer_mutex; finalizer_stop and
+// finalizer_running are also read without it.
+static volatile bool finalizer_stop = false;
+static volatile bool finalizer_running = false;
+static bool finalizer_wakeup = false;
+
+#endif
+
+static bool runFinalizers (bool all);
 
 //
 // Run some C finalizers.  Returns true if there's more work to do.
@@ -219,10 +259,35 @@ bool runSomeFinalizers(bool all)
     if (n_finalizers == 0)
         return false;
 
+#if defined(THREADED_RTS)
+    // leave them to the finalizer thread, unless they must all be run
+    // now
+    if (finalizer_running && !all)
+        return false;
+#endif
+
+    return runFinalizers(all);
+}
+
+static bool runFinalizers(bool all)
+{
     if (cas(&finalizer_lock, 0, 1) != 0) {
-        // another capability is doing the work, it's safe to say
-        // there's nothing to do, because the thread already in
-        // runSomeFinalizers() will call in again.
+        if (!all) {
+            // another capability is doing the work, it's safe to say
+            // there's nothing to do, because the thread already in
+            // runSomeFinalizers() will call in again.
+            return false;
+        }
+        // the finalizer thread is in the middle of a batch, and we
+        // can't leave any for later
+        do {
+            yieldThread();
+        } while (cas(&finalizer_lock, 0, 1) != 0);
+    }
+
+    if (n_finalizers == 0) {
+        // someone else has run them all
+        finalizer_lock = 0;
         return false;
     }
 
@@ -256,3 +321,105 @@ bool runSomeFinalizers(bool all)
 
     return n_finalizers != 0;
 }
+
+#if defined(THREADED_RTS)
+
+static void *
+finalizerThread (void *arg STG_UNUSED)
+{
+    // for task->running_finalizers
+    getTask();
+
+    ACQUIRE_LOCK(&finalizer_mutex);
+    while (!finalizer_stop) {
+        if (!finalizer_wakeup) {
+            waitCondition(&finalizer_cond, &finalizer_mutex);
+            continue;
+        }
+        finalizer_wakeup = false;
+        RELEASE_LOCK(&finalizer_mutex);
+
+        while (!finalizer_stop && runFinalizers(false)) {}
+
+        ACQUIRE_LOCK(&finalizer_mutex);
+    }
+    RELEASE_LOCK(&finalizer_mutex);
+
+    freeMyTask();
+
+    ACQUIRE_LOCK(&finalizer_mutex);
+    finalizer_running = false;
+    broadcastCondition(&finalizer_cond);
+    RELEASE_LOCK(&finalizer_mutex);
+    return NULL;
+}
+
+#endif /* THREADED_RTS */
+
+// Called from hs_init_ghc(), and again after forkProcess(): in the
+// parent, which stops it for the fork, and in the child, where the
+// thread does not survive the fork.
+void
+startFinalizerThread (void)
+{
+#if defined(THREADED_RTS)
+    finalizer_running = false;
+    finalizer_stop = false;
+    finalizer_wakeup = false;
+
+    if (!RtsFlags.GcFlags.finalizerThread) {
+        return;
+    }
+
+    initMutex(&finalizer_mutex);
+    initCondition(&finalizer_cond);
+
+    if (createOSThread(&finalizer_thread, "ghc_finalizer",
+                       finalizerThread, NULL) != 0) {
+        sysErrorBelch("warning: could not start the finalizer thread; "
+                      "running C finalizers on idle capabilities instead");
+        closeCondition(&finalizer_cond);
+        closeMutex(&finalizer_mutex);
+        return;
+    }
+    finalizer_running = true;
+
+    // there may be finalizers left from before a fork
+    wakeFinalizerThread();
+#endif
+}
+
+void
+stopFinalizerThread (void)
+{
+#if defined(THREADED_RTS)
+    if (!finalizer_running) {
+        return;
+    }
+
+    ACQUIRE_LOCK(&finalizer_mutex);
+    finalizer_stop = true;
+    broadcastCondition(&finalizer_cond);
+    while (finalizer_running) {
+        waitCondition(&finalizer_cond, &finalizer_mutex);
+    }
+    RELEASE_LOCK(&finalizer_mutex);
+
+    closeCondition(&finalizer_cond);
+    closeMutex(&finalizer_mutex);
+#endif
+}
+
+static void
+wakeFinalizerThread (void)
+{
+#if defined(THREADED_RTS)
+    if (!finalizer_running) {
+        return;
+    }
+    ACQUIRE_LOCK(&finalizer_mutex);
+    finalizer_wakeup = true;
+    signalCondition(&finalizer_cond);
+    RELEASE_LOCK(&finalizer_mutex);
+#endif
+}
@@ -20,5 +20,7 @@ void runAllCFinalizers(StgWeak *w);
 void scheduleFinalizers(Capability *cap, StgWeak *w);
 void markWeakList(void);
 bool runSomeFinalizers(bool all);
+void startFinalizerThread(void);
+void stopFinalizerThread(void);
 
 #include "EndPrivate.h"
@@ -106,7 +106,13 @@ char *EventDesc[] = {
   [EVENT_HEAP_PROF_SAMPLE_END]    = "End of heap profile sample",
   [EVENT_HEAP_PROF_SAMPLE_STRING] = "Heap profile string sample",
   [EVENT_HEAP_PROF_SAMPLE_COST_CENTRE] = "Heap profile cost-centre sample",
-  [EVENT_USER_BINARY_MSG]     = "User binary message"
+  [EVENT_USER_BINARY_MSG]     = "User binary message",
+  [EVENT_BLOCK_CACHE_STATS]   = "Capability block cache statistics",
+  [EVENT_NURSERY_SIZE]        = "Capability nursery size",
+  [EVENT_HEAP_LARGE_OBJECTS]  = "Large objects of a generation",
+  [EVENT_GC_PACE]             = "GC pacing decision",
+  [EVENT_CAP_THREAD_STEALS]   = "Capability thread stealing statistics",
+  [EVENT_THREAD_PRIORITY_STATS] = "Capability thread priority statistics"
 };
 
 // Event type.
@@ -441,6 +447,38 @@ init_event_types(void)
             eventTypes[t].size = EVENT_SIZE_DYNAMIC;
             break;
 
+        case EVENT_BLOCK_CACHE_STATS: // (hits, misses, flushed_blocks)
+            eventTypes[t].size = sizeof(StgWord64) * 3;
+            break;
+
+        case EVENT_NURSERY_SIZE: // (nursery_bytes, alloc_rate_bytes)
+            eventTypes[t].size = sizeof(StgWord64) * 2;
+            break;
+
+        case EVENT_HEAP_LARGE_OBJECTS: // (heap_capset, generation,
+                                       //  objects, bytes,
+                                       //  promoted_objects, promoted_bytes)
+            eventTypes[t].size = sizeof(EventCapsetID)
+                               + sizeof(StgWord16)
+                               + sizeof(StgWord64) * 4;
+            break;
+
+        case EVENT_GC_PACE:     // (heap_capset, generation,
+                                //  predicted_pause_ns,
+                                //  old_size_bytes, new_size_bytes)
+            eventTypes[t].size = sizeof(EventCapsetID)
+                               + sizeof(StgWord16)
+                               + sizeof(StgWord64) * 3;
+            break;
+
+        case EVENT_CAP_THREAD_STEALS: // (published, reclaimed, stolen)
+            eventTypes[t].size = sizeof(StgWord64) * 3;
+            break;
+
+        case EVENT_THREAD_PRIORITY_STATS: // (priority, runs, boosts)
+            eventTypes[t].size = sizeof(StgWord16) + sizeof(StgWord64) * 2;
+            break;
+
         default:
             continue; /* ignore deprecated events */
         }
@@ -955,6 +993,106 @@ void postEventGcStats  (Capability    *cap,
     postWord64(eb, par_balanced_copied);
 }
 
+void postEventBlockCacheStats (Capability *cap,
+                               W_          hits,
+                               W_          misses,
+                               W_          flushed_blocks)
+{
+    EventsBuf *eb = &capEventBuf[cap->no];
+    ensureRoomForEvent(eb, EVENT_BLOCK_CACHE_STATS);
+
+    postEventHeader(eb, EVENT_BLOCK_CACHE_STATS);
+    /* EVENT_BLOCK_CACHE_STATS (hits, misses, flushed_blocks) */
+    postWord64(eb, hits);
+    postWord64(eb, misses);
+    postWord64(eb, flushed_blocks);
+}
+
+void postEventNurserySize (Capability *cap,
+                           W_          nursery_bytes,
+                           W_          alloc_rate_bytes)
+{
+    EventsBuf *eb = &capEventBuf[cap->no];
+    ensureRoomForEvent(eb, EVENT_NURSERY_SIZE);
+
+    postEventHeader(eb, EVENT_NURSERY_SIZE);
+    /* EVENT_NURSERY_SIZE (nursery_bytes, alloc_rate_bytes) */
+    postWord64(eb, nursery_bytes);
+    postWord64(eb, alloc_rate_bytes);
+}
+
+void postEventHeapLargeObjects (Capability    *cap,
+                                EventCapsetID  heap_capset,
+                                uint32_t       gen,
+                                W_             objects,
+                                W_             bytes,
+                                W_             promoted_objects,
+                                W_             promoted_bytes)
+{
+    EventsBuf *eb = &capEventBuf[cap->no];
+    ensureRoomForEvent(eb, EVENT_HEAP_LARGE_OBJECTS);
+
+    postEventHeader(eb, EVENT_HEAP_LARGE_OBJECTS);
+    /* EVENT_HEAP_LARGE_OBJECTS (heap_capset, generation, objects, bytes,
+                                 promoted_objects, promoted_bytes) */
+    postCapsetID(eb, heap_capset);
+    postWord16(eb, gen);
+    postWord64(eb, objects);
+    postWord64(eb, bytes);
+    postWord64(eb, promoted_objects);
+    postWord64(eb, promoted_bytes);
+}
+
+void postEventGcPace (Capability    *cap,
+                      EventCapsetID  heap_capset,
+                      uint32_t       gen,
+                      StgWord64      predicted_pause_ns,
+                      W_             old_size_bytes,
+                      W_             new_size_bytes)
+{
+    EventsBuf *eb = &capEventBuf[cap->no];
+    ensureRoomForEvent(eb, EVENT_GC_PACE);
+
+    postEventHeader(eb, EVENT_GC_PACE);
+    /* EVENT_GC_PACE (heap_capset, generation, predicted_pause_ns,
+                      old_size_bytes, new_size_bytes) */
+    postCapsetID(eb, heap_capset);
+    postWord16(eb, gen);
+    postWord64(eb, predicted_pause_ns);
+    postWord64(eb, old_size_bytes);
+    postWord64(eb, new_size_bytes);
+}
+
+void postEventCapThreadSteals (Capability *cap,
+                               W_          published,
+                               W_          reclaimed,
+                               W_          stolen)
+{
+    EventsBuf *eb = &capEventBuf[cap->no];
+    ensureRoomForEvent(eb, EVENT_CAP_THREAD_STEALS);
+
+    postEventHeader(eb, EVENT_CAP_THREAD_STEALS);
+    /* EVENT_CAP_THREAD_STEALS (published, reclaimed, stolen) */
+    postWord64(eb, published);
+    postWord64(eb, reclaimed);
+    postWord64(eb, stolen);
+}
+
+void postEventThreadPriorityStats (Capability *cap,
+                                   uint32_t    priority,
+                                   W_          runs,
+                                   W_          boosts)
+{
+    EventsBuf *eb = &capEventBuf[cap->no];
+    ensureRoomForEvent(eb, EVENT_THREAD_PRIORITY_STATS);
+
+    postEventHeader(eb, EVENT_THREAD_PRIORITY_STATS);
+    /* EVENT_THREAD_PRIORITY_STATS (priority, runs, boosts) */
+    postWord16(eb, priority);
+    postWord64(eb, runs);
+    postWord64(eb, boosts);
+}
+
 void postTaskCreateEvent (EventTaskId taskId,
                           EventCapNo capno,
                           EventKernelThreadId tid)
@@ -127,6 +127,40 @@ void postEventGcStats  (Capability    *cap,
                         W_           par_tot_copied,
                         W_           par_balanced_copied);
 
+void postEventBlockCacheStats (Capability *cap,
+                               W_          hits,
+                               W_          misses,
+                               W_          flushed_blocks);
+
+void postEventNurserySize (Capability *cap,
+                           W_          nursery_bytes,
+                           W_          alloc_rate_bytes);
+
+void postEventHeapLargeObjects (Capability    *cap,
+                                EventCapsetID  heap_capset,
+                                uint32_t       gen,
+                                W_             objects,
+                                W_             bytes,
+                                W_             promoted_objects,
+                                W_             promoted_bytes);
+
+void postEventGcPace (Capability    *cap,
+                      EventCapsetID  heap_capset,
+                      uint32_t       gen,
+                      StgWord64      predicted_pause_ns,
+                      W_             old_size_bytes,
+                      W_             new_size_bytes);
+
+void postEventCapThreadSteals (Capability *cap,
+                               W_          published,
+                               W_          reclaimed,
+                               W_          stolen);
+
+void postEventThreadPriorityStats (Capability *cap,
+                                   uint32_t    priority,
+                                   W_          runs,
+                                   W_          boosts);
+
 void postTaskCreateEvent (EventTaskId taskId,
                           EventCapNo cap,
                           EventKernelThreadId tid);
@@ -77,6 +77,14 @@ static void *next_request = 0;
 void osMemInit(void)
 {
     next_request = (void *)RtsFlags.GcFlags.heapBase;
+
+#if !defined(MADV_HUGEPAGE)
+    if (RtsFlags.GcFlags.hugePages) {
+        errorBelch("warning: huge pages (-xH) are not supported on this "
+                   "platform, ignoring");
+        RtsFlags.GcFlags.hugePages = false;
+    }
+#endif
 }
 
 /* -----------------------------------------------------------------------------
@@ -165,6 +173,11 @@ post_mmap_madvise(int operation, W_ size, void *ret)
         madvise(ret, size, MADV_WILLNEED);
 # if defined(MADV_DODUMP)
         madvise(ret, size, MADV_DODUMP);
+# endif
+# if defined(MADV_HUGEPAGE)
+        if (RtsFlags.GcFlags.hugePages) {
+            madvise(ret, size, MADV_HUGEPAGE);
+        }
 # endif
     } else {
         madvise(ret, size, MADV_DONTNEED);
@@ -471,38 +484,78 @@ void setExecutable (void *p, W_ len, bool exec)
 
 #if defined(USE_LARGE_ADDRESS_SPACE)
 
+/* Note [Huge page backed heap]
+   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+   With +RTS -xH we want the kernel to back the heap with transparent
+   huge pages.  THP only works for naturally aligned HUGE_PAGE_SIZE
+   regions of a single mapping with MADV_HUGEPAGE set, and a huge page
+   is split as soon as part of it is unmapped, remapped or
+   mprotect()ed.  The usual scheme of reserving PROT_NONE address space
+   and committing megablocks into it with mmap(MAP_FIXED) creates a new
+   mapping for every commit, and megablocks are only half a huge page,
+   so it defeats THP.
+
+   So in huge page mode we instead reserve the whole heap readable and
+   writable with MAP_NORESERVE, aligned to HUGE_PAGE_SIZE and with
+   MADV_HUGEPAGE set, and let the kernel populate it on first touch.
+   osCommitMemory() then has nothing to do, and decommitting is just
+   madvise(), which doesn't change the mapping.  decommitMBlocks() in
+   MBlock.c only decommits whole huge pages, so a huge page is never
+   split by returning half of it to the OS.
+
+   The downside is that the reservation counts towards the commit
+   limit if the system is configured with vm.overcommit_memory=2; in
+   that case osReserveHeapMemory() will end up with a smaller heap.
+*/
+
 static void *
 osTryReserveHeapMemory (W_ len, void *hint)
 {
     void *base, *top;
     void *start, *end;
+    W_ align;
 
     ASSERT((len & ~MBLOCK_MASK) == len);
 
-    /* We try to allocate len + MBLOCK_SIZE,
-       because we need memory which is MBLOCK_SIZE aligned,
+    /* We try to allocate len + align,
+       because we need memory which is aligned to MBLOCK_SIZE (or to
+       HUGE_PAGE_SIZE in huge page mode),
        and then we discard what we don't need */
 
-    base = my_mmap(hint, len + MBLOCK_SIZE, MEM_RESERVE);
-    if (base == NULL)
-        return NULL;
+#if defined(MADV_HUGEPAGE)
+    if (RtsFlags.GcFlags.hugePages) {
+        // See Note [Huge page backed heap]
+        align = HUGE_PAGE_SIZE;
+        base = mmap(hint, len + align, PROT_READ | PROT_WRITE,
+                    MAP_NORESERVE | MAP_ANON | MAP_PRIVATE, -1, 0);
+        if (base == MAP_FAILED)
+            return NULL;
+    } else
+#endif
+    {
+        align = MBLOCK_SIZE;
+        base = my_mmap(hint, len + align, MEM_RESERVE);
+        if (base == NULL)
+            return NULL;
+    }
 
-    top = (void*)((W_)base + len + MBLOCK_SIZE);
+    top = (void*)((W_)base + len + align);
+    start = (void*)roundUpToAlign((W_)base, align);
+    end = (void*)((W_)start + len);
 
-    if (((W_)base & MBLOCK_MASK) != 0) {
-        start = MBLOCK_ROUND_UP(base);
-        end = MBLOCK_ROUND_DOWN(top);
-        ASSERT(((W_)end - (W_)start) == len);
+    if (start != base && munmap(base, (W_)start-(W_)base) < 0) {
+        sysErrorBelch("unable to release slop before heap");
+    }
+    if (munmap(end, (W_)top-(W_)end) < 0) {
+        sysErrorBelch("unable to release slop after heap");
+    }
 
-        if (munmap(base, (W_)start-(W_)base) < 0) {
-            sysErrorBelch("unable to release slop before heap");
-        }
-        if (munmap(end, (W_)top-(W_)end) < 0) {
-            sysErrorBelch("unable to release slop after heap");
-        }
-    } else {
-        start = base;
+#if defined(MADV_HUGEPAGE)
+    if (RtsFlags.GcFlags.hugePages && madvise(start, len, MADV_HUGEPAGE) < 0) {
+        sysErrorBelch("warning: unable to enable huge pages for the heap");
     }
+#endif
 
     return start;
 }
@@ -596,6 +649,18 @@ void *osReserveHeapMemory(void *startAddressPtr, W_ *len)
 
 void osCommitMemory(void *at, W_ size)
 {
+    if (RtsFlags.GcFlags.hugePages) {
+        // The heap is already mapped; see Note [Huge page backed heap].
+        // osDecommitMemory() makes the memory inaccessible in the DEBUG
+        // RTS, so undo that.
+#if defined(DEBUG)
+        if (mprotect(at, size, PROT_READ | PROT_WRITE) < 0) {
+            barf("Unable to commit %" FMT_Word " bytes of memory", size);
+        }
+#endif
+        return;
+    }
+
     void *r = my_mmap(at, size, MEM_COMMIT);
     if (r == NULL) {
         barf("Unable to commit %" FMT_Word " bytes of memory", size);
@@ -653,6 +718,38 @@ void osReleaseHeapMemory(void)
 
 #endif
 
+W_ osHugePageBytes(void)
+{
+#if defined(USE_LARGE_ADDRESS_SPACE) && defined(linux_HOST_OS)
+    // Sum the AnonHugePages of every mapping within the heap.  The heap
+    // is a single mapping in huge page mode, unless the DEBUG RTS has
+    // mprotect()ed parts of it.
+    FILE *f;
+    char line[4096];
+    unsigned long lo, hi, kb;
+    bool in_heap = false;
+    W_ bytes = 0;
+
+    f = fopen("/proc/self/smaps", "r");
+    if (f == NULL) {
+        return 0;
+    }
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (sscanf(line, "%lx-%lx ", &lo, &hi) == 2) {
+            in_heap = hi > mblock_address_space.begin
+                   && lo < mblock_address_space.end;
+        } else if (in_heap &&
+                   sscanf(line, "AnonHugePages: %lu kB", &kb) == 1) {
+            bytes += (W_)kb * 1024;
+        }
+    }
+    fclose(f);
+    return bytes;
+#else
+    return 0;
+#endif
+}
+
 bool osBuiltWithNumaSupport(void)
 {
 #if HAVE_LIBNUMA
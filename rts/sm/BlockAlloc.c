@@ -22,6 +22,8 @@
 #include "RtsUtils.h"
 #include "BlockAlloc.h"
 #include "OSMem.h"
+#include "Capability.h"
+#include "Trace.h"
 
 #include <string.h>
 
@@ -82,22 +84,37 @@ static void  initMBlock(void *mblock, uint32_t node);
   coalesce in O(1) time.  Every free bgroup must have its head and tail
   bdescrs initialised, the rest don't matter.
 
-  We keep the free list in buckets, using a heap-sort strategy.
-  Bucket N contains blocks with sizes 2^N - 2^(N+1)-1.  The list of
-  blocks in each bucket is doubly-linked, so that if a block is
-  coalesced we can easily remove it from its current free list.
-
-  To allocate a new block of size S, grab a block from bucket
-  log2ceiling(S) (i.e. log2() rounded up), in which all blocks are at
-  least as big as S, and split it if necessary.  If there are no
-  blocks in that bucket, look at bigger buckets until a block is found
-  Allocation is therefore O(logN) time.
+  We keep the free list in size classes, indexed in two levels (this
+  is the scheme used by TLSF, "Two-Level Segregated Fit").  The first
+  level splits sizes by powers of two: first-level class N contains
+  blocks with sizes 2^N - 2^(N+1)-1.  The second level splits each of
+  those ranges into FREE_LIST_SL_COUNT equally sized sub-ranges, so a
+  size class covers at most 2^N/FREE_LIST_SL_COUNT different sizes (and
+  the small classes, where 2^N <= FREE_LIST_SL_COUNT, hold exactly one
+  size each).  The list of blocks in each class is doubly-linked, so
+  that if a block is coalesced we can easily remove it from its
+  current free list.
+
+  Alongside the lists we keep a bitmap of the non-empty first-level
+  classes, and for each first-level class a bitmap of its non-empty
+  second-level classes.  Both are updated whenever a list becomes
+  empty or non-empty.
+
+  To allocate a new block of size S, first look at the head of the
+  class containing S, which often fits.  Otherwise round S up to the
+  next class boundary, so that every block in that class and above is
+  at least as big as S, and find the first non-empty class from there
+  with a find-first-set on the second-level bitmap, falling back to a
+  find-first-set on the first-level bitmap.  Split the block we find
+  if necessary.  Allocation is therefore O(1), and the block we use is
+  at most one size class larger than the best fit.
 
   To free a block:
     - coalesce it with neighbours.
     - remove coalesced neighbour(s) from free list(s)
-    - add the new (coalesced) block to the front of the appropriate
-      bucket, given by log2(S) where S is the size of the block.
+    - add the new (coalesced) block to the front of the list for its
+      size class, given by size_class(S) where S is the size of the
+      block.
 
   Free is O(1).
 
@@ -145,22 +162,35 @@ static void  initMBlock(void *mblock, uint32_t node);
 
   --------------------------------------------------------------------------- */
 
-// free_list[i] contains blocks that are at least size 2^i, and at
-// most size 2^(i+1) - 1.
+// First-level class i contains blocks that are at least size 2^i, and
+// at most size 2^(i+1) - 1.  Each first-level class is divided into
+// FREE_LIST_SL_COUNT second-level classes, and free_list[c] is the list
+// for size class c = i * FREE_LIST_SL_COUNT + j.
 //
-// To find the free list in which to place a block, use log_2(size).
-// To find a free block of the right size, use log_2_ceil(size).
+// To find the free list in which to place a block, use size_class(size).
+// To find a free block of the right size, use size_class_ceil(size) and
+// find_free_class().
 //
-// The largest free list (free_list[NUM_FREE_LISTS-1]) needs to contain sizes
+// The largest first-level class (NUM_FREE_LISTS-1) needs to contain sizes
 // from half a megablock up to (but not including) a full megablock.
 
 #define NUM_FREE_LISTS (MBLOCK_SHIFT-BLOCK_SHIFT)
 
+#define FREE_LIST_SL_SHIFT 3
+#define FREE_LIST_SL_COUNT (1 << FREE_LIST_SL_SHIFT)
+#define NUM_SIZE_CLASSES   (NUM_FREE_LISTS * FREE_LIST_SL_COUNT)
+
 // In THREADED_RTS mode, the free list is protected by sm_mutex.
 
-static bdescr *free_list[MAX_NUMA_NODES][NUM_FREE_LISTS];
+static bdescr *free_list[MAX_NUMA_NODES][NUM_SIZE_CLASSES];
 static bdescr *free_mblock_list[MAX_NUMA_NODES];
 
+// Bit i of free_list_fl[node] is set iff some second-level class of
+// first-level class i is non-empty; bit j of free_list_sl[node][i] is
+// set iff free_list[node][i * FREE_LIST_SL_COUNT + j] is non-empty.
+static uint32_t free_list_fl[MAX_NUMA_NODES];
+static uint8_t  free_list_sl[MAX_NUMA_NODES][NUM_FREE_LISTS];
+
 W_ n_alloc_blocks;   // currently allocated blocks
 W_ hw_alloc_blocks;  // high-water allocated blocks
 
@@ -174,9 +204,13 @@ void initBlockAllocator(void)
 {
     uint32_t i, node;
     for (node = 0; node < MAX_NUMA_NODES; node++) {
-        for (i=0; i < NUM_FREE_LISTS; i++) {
+        for (i=0; i < NUM_SIZE_CLASSES; i++) {
             free_list[node][i] = NULL;
         }
+        for (i=0; i < NUM_FREE_LISTS; i++) {
+            free_list_sl[node][i] = 0;
+        }
+        free_list_fl[node] = 0;
         free_mblock_list[node] = NULL;
         n_alloc_blocks_by_node[node] = 0;
     }
@@ -261,34 +295,113 @@ log_2(W_ n)
 #endif
 }
 
-// log base 2 (ceiling), needs to support up to (2^NUM_FREE_LISTS)-1
+// count trailing zeros, n must be non-zero
 STATIC_INLINE uint32_t
-log_2_ceil(W_ n)
+ctz_32(uint32_t n)
 {
-    ASSERT(n > 0 && n < (1<<NUM_FREE_LISTS));
+    ASSERT(n != 0);
 #if defined(__GNUC__)
-    uint32_t r = log_2(n);
-    return (n & (n-1)) ? r+1 : r;
+    return __builtin_ctz(n);
 #else
-    W_ i, x;
-    x = 1;
-    for (i=0; i < MAX_FREE_LIST; i++) {
-        if (x >= n) return i;
-        x = x << 1;
+    uint32_t i;
+    for (i = 0; (n & 1) == 0; i++) {
+        n = n >> 1;
     }
-    return MAX_FREE_LIST;
+    return i;
 #endif
 }
 
+// The size class that a free group of n blocks lives in.
+STATIC_INLINE uint32_t
+size_class(W_ n)
+{
+    uint32_t fl, sl;
+
+    fl = log_2(n);
+    if (fl < FREE_LIST_SL_SHIFT) {
+        sl = n - ((W_)1 << fl);
+    } else {
+        sl = (n >> (fl - FREE_LIST_SL_SHIFT)) & (FREE_LIST_SL_COUNT - 1);
+    }
+    return fl * FREE_LIST_SL_COUNT + sl;
+}
+
+// The smallest group size in size class c.
+STATIC_INLINE W_
+size_class_min(uint32_t c)
+{
+    uint32_t fl, sl;
+
+    fl = c / FREE_LIST_SL_COUNT;
+    sl = c % FREE_LIST_SL_COUNT;
+    if (fl < FREE_LIST_SL_SHIFT) {
+        return ((W_)1 << fl) + sl;
+    } else {
+        return (W_)(FREE_LIST_SL_COUNT + sl) << (fl - FREE_LIST_SL_SHIFT);
+    }
+}
+
+// The smallest size class in which every group has at least n blocks.
+// May return NUM_SIZE_CLASSES if there is no such class.
+STATIC_INLINE uint32_t
+size_class_ceil(W_ n)
+{
+    uint32_t c = size_class(n);
+    return size_class_min(c) == n ? c : c + 1;
+}
+
+// The first non-empty size class at or above c, or NUM_SIZE_CLASSES if
+// there is none.
+STATIC_INLINE uint32_t
+find_free_class(uint32_t node, uint32_t c)
+{
+    uint32_t fl, sl, map;
+
+    if (c >= NUM_SIZE_CLASSES) return NUM_SIZE_CLASSES;
+
+    fl = c / FREE_LIST_SL_COUNT;
+    sl = c % FREE_LIST_SL_COUNT;
+
+    map = free_list_sl[node][fl] & (~0u << sl);
+    if (map == 0) {
+        map = free_list_fl[node] & (~0u << (fl + 1));
+        if (map == 0) return NUM_SIZE_CLASSES;
+        fl = ctz_32(map);
+        map = free_list_sl[node][fl];
+    }
+    return fl * FREE_LIST_SL_COUNT + ctz_32(map);
+}
+
 STATIC_INLINE void
 free_list_insert (uint32_t node, bdescr *bd)
 {
-    uint32_t ln;
+    uint32_t c;
 
     ASSERT(bd->blocks < BLOCKS_PER_MBLOCK);
-    ln = log_2(bd->blocks);
+    c = size_class(bd->blocks);
 
-    dbl_link_onto(bd, &free_list[node][ln]);
+    dbl_link_onto(bd, &free_list[node][c]);
+    free_list_sl[node][c / FREE_LIST_SL_COUNT] |=
+        1 << (c % FREE_LIST_SL_COUNT);
+    free_list_fl[node] |= 1 << (c / FREE_LIST_SL_COUNT);
+}
+
+// bd->blocks must still be the size the group was inserted with.
+STATIC_INLINE void
+free_list_remove (uint32_t node, bdescr *bd)
+{
+    uint32_t c;
+
+    c = size_class(bd->blocks);
+    dbl_link_remove(bd, &free_list[node][c]);
+
+    if (free_list[node][c] == NULL) {
+        free_list_sl[node][c / FREE_LIST_SL_COUNT] &=
+            ~(1 << (c % FREE_LIST_SL_COUNT));
+        if (free_list_sl[node][c / FREE_LIST_SL_COUNT] == 0) {
+            free_list_fl[node] &= ~(1 << (c / FREE_LIST_SL_COUNT));
+        }
+    }
 }
 
 // After splitting a group, the last block of each group must have a
@@ -310,18 +423,17 @@ setup_tail (bdescr *bd)
 // Take a free block group bd, and split off a group of size n from
 // it.  Adjust the free list as necessary, and return the new group.
 static bdescr *
-split_free_block (bdescr *bd, uint32_t node, W_ n, uint32_t ln)
+split_free_block (bdescr *bd, uint32_t node, W_ n)
 {
     bdescr *fg; // free group
 
     ASSERT(bd->blocks > n);
-    dbl_link_remove(bd, &free_list[node][ln]);
+    free_list_remove(node, bd);
     fg = bd + bd->blocks - n; // take n blocks off the end
     fg->blocks = n;
     bd->blocks -= n;
     setup_tail(bd);
-    ln = log_2(bd->blocks);
-    dbl_link_onto(bd, &free_list[node][ln]);
+    free_list_insert(node, bd);
     return fg;
 }
 
@@ -388,7 +500,7 @@ bdescr *
 allocGroupOnNode (uint32_t node, W_ n)
 {
     bdescr *bd, *rem;
-    StgWord ln;
+    uint32_t c;
 
     if (n == 0) barf("allocGroup: requested zero blocks");
 
@@ -410,13 +522,16 @@ allocGroupOnNode (uint32_t node, W_ n)
 
     recordAllocatedBlocks(node, n);
 
-    ln = log_2_ceil(n);
-
-    while (ln < NUM_FREE_LISTS && free_list[node][ln] == NULL) {
-        ln++;
+    // The head of the class containing n is often big enough; if not,
+    // take the first group from the classes that are all big enough.
+    c = size_class(n);
+    bd = free_list[node][c];
+    if (bd == NULL || bd->blocks < n) {
+        c = find_free_class(node, size_class_ceil(n));
+        bd = NULL;
     }
 
-    if (ln == NUM_FREE_LISTS) {
+    if (c == NUM_SIZE_CLASSES) {
 #if 0  /* useful for debugging fragmentation */
         if ((W_)mblocks_allocated * BLOCKS_PER_MBLOCK * BLOCK_SIZE_W
              - (W_)((n_alloc_blocks - n) * BLOCK_SIZE_W) > (2*1024*1024)/sizeof(W_)) {
@@ -437,16 +552,18 @@ allocGroupOnNode (uint32_t node, W_ n)
         goto finish;
     }
 
-    bd = free_list[node][ln];
+    if (bd == NULL) {
+        bd = free_list[node][c];
+    }
 
     if (bd->blocks == n)                // exactly the right size!
     {
-        dbl_link_remove(bd, &free_list[node][ln]);
+        free_list_remove(node, bd);
         initGroup(bd);
     }
     else if (bd->blocks >  n)            // block too big...
     {
-        bd = split_free_block(bd, node, n, ln);
+        bd = split_free_block(bd, node, n);
         ASSERT(bd->blocks == n);
         initGroup(bd);
     }
@@ -500,31 +617,26 @@ bdescr* allocGroup (W_ n)
 bdescr* allocLargeChunkOnNode (uint32_t node, W_ min, W_ max)
 {
     bdescr *bd;
-    StgWord ln, lnmax;
+    uint32_t c;
 
     if (min >= BLOCKS_PER_MBLOCK) {
         return allocGroupOnNode(node,max);
     }
 
-    ln = log_2_ceil(min);
-    lnmax = log_2_ceil(max);
-
-    while (ln < NUM_FREE_LISTS && ln < lnmax && free_list[node][ln] == NULL) {
-        ln++;
-    }
-    if (ln == NUM_FREE_LISTS || ln == lnmax) {
+    c = find_free_class(node, size_class_ceil(min));
+    if (c >= size_class_ceil(max)) {
         return allocGroupOnNode(node,max);
     }
-    bd = free_list[node][ln];
+    bd = free_list[node][c];
 
     if (bd->blocks <= max)              // exactly the right size!
     {
-        dbl_link_remove(bd, &free_list[node][ln]);
+        free_list_remove(node, bd);
         initGroup(bd);
     }
     else   // block too big...
     {
-        bd = split_free_block(bd, node, max, ln);
+        bd = split_free_block(bd, node, max);
         ASSERT(bd->blocks == max);
         initGroup(bd);
     }
@@ -581,6 +693,141 @@ allocBlockOnNode_lock(uint32_t node)
     return bd;
 }
 
+/* -----------------------------------------------------------------------------
+   Per-capability block cache
+   -------------------------------------------------------------------------- */
+
+/* Note [Capability block cache]
+   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+   The mutator takes blocks from the block allocator when its nursery
+   runs out (allocate(), allocatePinned()), for large objects, and in
+   scheduleHandleHeapOverflow().  Each of these used to take sm_mutex
+   for every group, and with many capabilities allocating at once the
+   lock becomes a point of contention.
+
+   So each Capability keeps a small cache of free groups of up to
+   BLOCK_CACHE_MAX_GROUP blocks, one list per group size
+   (cap->block_cache[n-1], linked through bd->link).  When the list
+   for the requested size is empty, we take sm_mutex once, allocate a
+   chunk of up to half of the cache (+RTS --block-cache) with
+   allocLargeChunkOnNode(), and carve it into groups of the requested
+   size.  If the rest of the cache is full of groups of other sizes, we
+   give those back first, so a Capability whose allocation pattern
+   changes doesn't end up bypassing its cache.
+
+   Cached blocks are counted as allocated (n_alloc_blocks), but they
+   are not on any list that the GC or memInventory() knows about, so
+   GarbageCollect() returns every cache to the free list with
+   flushBlockCache() before doing anything else.  That also lets
+   freeGroup() coalesce them again, so the caches don't fragment the
+   heap in the long run.
+
+   A cache is only touched by the Task that owns its Capability, or by
+   the GC when all Capabilities are stopped, so it needs no locking of
+   its own.  recordMutableCap() doesn't use it, because it may be
+   called on a Capability we don't own (see performPendingThrowTos()).
+
+   The hit and miss counts since the last GC are emitted as
+   EVENT_BLOCK_CACHE_STATS when the cache is flushed.
+*/
+
+STATIC_INLINE void
+cacheGroup (Capability *cap, bdescr *bd, W_ n)
+{
+    bd->blocks = n;
+    initGroup(bd);
+    bd->link = cap->block_cache[n-1];
+    cap->block_cache[n-1] = bd;
+    cap->block_cache_blocks += n;
+}
+
+// Return all the cached groups to the free list.  Requires sm_mutex.
+static W_
+drainBlockCache (Capability *cap)
+{
+    W_ flushed;
+    uint32_t i;
+
+    flushed = cap->block_cache_blocks;
+    for (i = 0; i < BLOCK_CACHE_MAX_GROUP; i++) {
+        freeChain(cap->block_cache[i]);
+        cap->block_cache[i] = NULL;
+    }
+    cap->block_cache_blocks = 0;
+    return flushed;
+}
+
+bdescr *
+allocGroupCap (Capability *cap, W_ n)
+{
+    bdescr *bd;
+    W_ size, batch, blocks, i;
+
+    size = RtsFlags.GcFlags.blockCacheSize;
+
+    if (n > BLOCK_CACHE_MAX_GROUP || size < 2*n) {
+        return allocGroupOnNode_lock(cap->node, n);
+    }
+
+    bd = cap->block_cache[n-1];
+    if (bd != NULL) {
+        cap->block_cache_hits++;
+        goto finish;
+    }
+
+    cap->block_cache_misses++;
+
+    // The chunk must come from a single megablock, otherwise we can't
+    // carve it up.
+    batch = stg_min(size / 2, BLOCKS_PER_MBLOCK - 1);
+    batch = stg_max(batch, n);
+
+    ACQUIRE_SM_LOCK;
+    if (cap->block_cache_blocks + batch > size) {
+        drainBlockCache(cap);
+    }
+    bd = allocLargeChunkOnNode(cap->node, n, batch);
+    // We have to hold the lock until the new groups are set up,
+    // because freeGroup() looks at the bdescrs of neighbouring groups
+    // when coalescing.
+    blocks = bd->blocks;
+    for (i = 0; i + n <= blocks; i += n) {
+        cacheGroup(cap, bd + i, n);
+    }
+    if (i < blocks) {
+        // the leftover is smaller than n, so it has a list of its own
+        cacheGroup(cap, bd + i, blocks - i);
+    }
+    RELEASE_SM_LOCK;
+
+    bd = cap->block_cache[n-1];
+
+finish:
+    cap->block_cache[n-1] = bd->link;
+    cap->block_cache_blocks -= n;
+    bd->link = NULL;
+    return bd;
+}
+
+// Empty the cache of a Capability and emit its statistics.  Called by
+// the GC, with sm_mutex held.
+void
+flushBlockCache (Capability *cap)
+{
+    W_ flushed;
+
+    ASSERT_SM_LOCK();
+
+    flushed = drainBlockCache(cap);
+    if (cap->block_cache_hits != 0 || cap->block_cache_misses != 0) {
+        traceEventBlockCacheStats(cap, cap->block_cache_hits,
+                                  cap->block_cache_misses, flushed);
+    }
+    cap->block_cache_hits = 0;
+    cap->block_cache_misses = 0;
+}
+
 /* -----------------------------------------------------------------------------
    De-Allocation
    -------------------------------------------------------------------------- */
@@ -642,7 +889,6 @@ free_mega_group (bdescr *mg)
 void
 freeGroup(bdescr *p)
 {
-  StgWord ln;
   uint32_t node;
 
   // not true in multithreaded GC:
@@ -683,8 +929,7 @@ freeGroup(bdescr *p)
       if (next <= LAST_BDESCR(MBLOCK_ROUND_DOWN(p)) && next->free == (P_)-1)
       {
           p->blocks += next->blocks;
-          ln = log_2(next->blocks);
-          dbl_link_remove(next, &free_list[node][ln]);
+          free_list_remove(node, next);
           if (p->blocks == BLOCKS_PER_MBLOCK)
           {
               free_mega_group(p);
@@ -703,8 +948,7 @@ freeGroup(bdescr *p)
 
       if (prev->free == (P_)-1)
       {
-          ln = log_2(prev->blocks);
-          dbl_link_remove(prev, &free_list[node][ln]);
+          free_list_remove(node, prev);
           prev->blocks += p->blocks;
           if (prev->blocks >= BLOCKS_PER_MBLOCK)
           {
@@ -804,10 +1048,54 @@ countAllocdBlocks(bdescr *bd)
     return n;
 }
 
-void returnMemoryToOS(uint32_t n /* megablocks */)
+// Summarise the free lists: how much is free, how big the largest free
+// group is, and how the free blocks are distributed by group size.
+// Free mblock groups are counted like countFreeList() does, and all go
+// in the last bucket of the histogram.  The caller must hold the SM
+// lock, or otherwise know that nobody is using the block allocator.
+void
+getFreeSpaceStats (FreeSpaceStats *stats)
 {
     bdescr *bd;
-    uint32_t node;
+    W_ blocks;
+    uint32_t c, i, node;
+
+    stats->free_blocks = 0;
+    stats->largest_free = 0;
+    stats->free_groups = 0;
+    for (i = 0; i < FREE_SPACE_BUCKETS; i++) {
+        stats->histogram[i] = 0;
+    }
+
+    for (node = 0; node < n_numa_nodes; node++) {
+        for (c = 0; c < NUM_SIZE_CLASSES; c++) {
+            for (bd = free_list[node][c]; bd != NULL; bd = bd->link) {
+                stats->free_blocks += bd->blocks;
+                stats->free_groups++;
+                stats->histogram[c / FREE_LIST_SL_COUNT] += bd->blocks;
+                if (bd->blocks > stats->largest_free) {
+                    stats->largest_free = bd->blocks;
+                }
+            }
+        }
+        for (bd = free_mblock_list[node]; bd != NULL; bd = bd->link) {
+            blocks = BLOCKS_PER_MBLOCK * BLOCKS_TO_MBLOCKS(bd->blocks);
+            stats->free_blocks += blocks;
+            stats->free_groups++;
+            stats->histogram[FREE_SPACE_BUCKETS-1] += blocks;
+            if (blocks > stats->largest_free) {
+                stats->largest_free = blocks;
+            }
+        }
+    }
+}
+
+// Returns the number of megablocks actually returned, which is less than
+// n if there aren't enough free megablocks.
+uint32_t returnMemoryToOS(uint32_t n /* megablocks */)
+{
+    bdescr *bd;
+    uint32_t node, wanted = n;
     StgWord size;
 
     // ToDo: not fair, we free all the memory starting with node 0.
@@ -848,6 +1136,8 @@ void returnMemoryToOS(uint32_t n /* megablocks */)
                        n);
         }
     );
+
+    return wanted - n;
 }
 
 /* -----------------------------------------------------------------------------
@@ -872,24 +1162,29 @@ void
 checkFreeListSanity(void)
 {
     bdescr *bd, *prev;
-    StgWord ln, min;
-    uint32_t node;
+    uint32_t c, node;
 
     for (node = 0; node < n_numa_nodes; node++) {
-        min = 1;
-        for (ln = 0; ln < NUM_FREE_LISTS; ln++) {
+        for (c = 0; c < NUM_SIZE_CLASSES; c++) {
             IF_DEBUG(block_alloc,
-                     debugBelch("free block list [%" FMT_Word "]:\n", ln));
+                     debugBelch("free block list [%" FMT_Word32 "]:\n", c));
+
+            // the bitmaps must agree with the lists
+            ASSERT(((free_list_sl[node][c / FREE_LIST_SL_COUNT]
+                     >> (c % FREE_LIST_SL_COUNT)) & 1)
+                   == (free_list[node][c] != NULL));
+            ASSERT(((free_list_fl[node] >> (c / FREE_LIST_SL_COUNT)) & 1)
+                   == (free_list_sl[node][c / FREE_LIST_SL_COUNT] != 0));
 
             prev = NULL;
-            for (bd = free_list[node][ln]; bd != NULL; prev = bd, bd = bd->link)
+            for (bd = free_list[node][c]; bd != NULL; prev = bd, bd = bd->link)
             {
                 IF_DEBUG(block_alloc,
                          debugBelch("group at %p, length %ld blocks\n",
                                     bd->start, (long)bd->blocks));
                 ASSERT(bd->free == (P_)-1);
                 ASSERT(bd->blocks > 0 && bd->blocks < BLOCKS_PER_MBLOCK);
-                ASSERT(bd->blocks >= min && bd->blocks <= (min*2 - 1));
+                ASSERT(size_class(bd->blocks) == c);
                 ASSERT(bd->link != bd); // catch easy loops
                 ASSERT(bd->node == node);
 
@@ -909,7 +1204,6 @@ checkFreeListSanity(void)
                     }
                 }
             }
-            min = min << 1;
         }
 
         prev = NULL;
@@ -947,12 +1241,11 @@ countFreeList(void)
 {
   bdescr *bd;
   W_ total_blocks = 0;
-  StgWord ln;
-  uint32_t node;
+  uint32_t c, node;
 
   for (node = 0; node < n_numa_nodes; node++) {
-      for (ln=0; ln < NUM_FREE_LISTS; ln++) {
-          for (bd = free_list[node][ln]; bd != NULL; bd = bd->link) {
+      for (c=0; c < NUM_SIZE_CLASSES; c++) {
+          for (bd = free_list[node][c]; bd != NULL; bd = bd->link) {
               total_blocks += bd->blocks;
           }
       }
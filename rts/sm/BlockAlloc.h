@@ -13,11 +13,42 @@
 bdescr *allocLargeChunk (W_ min, W_ max);
 bdescr *allocLargeChunkOnNode (uint32_t node, W_ min, W_ max);
 
+/* Per-capability block cache --------------------------------------------- */
+
+// Groups of up to this many blocks are served from the Capability's
+// cache; see Note [Capability block cache] in BlockAlloc.c
+#define BLOCK_CACHE_MAX_GROUP 8
+
+bdescr *allocGroupCap   (Capability *cap, W_ n);
+void    flushBlockCache (Capability *cap);
+
+INLINE_HEADER bdescr *allocBlockCap (Capability *cap)
+{
+    return allocGroupCap(cap, 1);
+}
+
+/* Fragmentation ---------------------------------------------------------- */
+
+// One histogram bucket per power of two below an mblock, and one more
+// for free mblock groups.
+#define FREE_SPACE_BUCKETS (MBLOCK_SHIFT - BLOCK_SHIFT + 1)
+
+typedef struct {
+    W_ free_blocks;     // total blocks on the free lists
+    W_ free_groups;     // number of free groups
+    W_ largest_free;    // blocks in the largest free group
+    W_ histogram[FREE_SPACE_BUCKETS];
+        // free blocks in groups of 2^i .. 2^(i+1)-1 blocks; the last
+        // bucket is free mblock groups
+} FreeSpaceStats;
+
+void getFreeSpaceStats (FreeSpaceStats *stats);
+
 /* Debugging  -------------------------------------------------------------- */
 
 extern W_ countBlocks       (bdescr *bd);
 extern W_ countAllocdBlocks (bdescr *bd);
-extern void returnMemoryToOS(uint32_t n);
+extern uint32_t returnMemoryToOS(uint32_t n);
 
 #if defined(DEBUG)
 void checkFreeListSanity(void);
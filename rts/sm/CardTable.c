@@ -0,0 +1,180 @@
+/* -----------------------------------------------------------------------------
+ *
+ * (c) The GHC Team 2019
+ *
+ * Card table for old MUT_VARs, MVARs and TVARs.
+ *
+ * Documentation on the architecture of the Storage Manager can be
+ * found in the online commentary:
+ *
+ *   https://gitlab.haskell.org/ghc/ghc/wikis/commentary/rts/storage
+ *
+ * ---------------------------------------------------------------------------*/
+
+#include "PosixSource.h"
+#include "Rts.h"
+
+#include "RtsUtils.h"
+#include "CardTable.h"
+
+#include <string.h> // for memcpy()
+
+/* Note [Card table]
+   ~~~~~~~~~~~~~~~~~
+
+   The write barrier for MUT_VARs, MVARs and TVARs (dirty_MUT_VAR() and
+   friends) puts an object in an old generation on the mutable list the
+   first time it is written after a GC.  A program that keeps a large
+   number of IORefs in the old generation and writes to many of them
+   between GCs puts millions of entries on the mutable lists, and
+   scavenge_mutable_list() then dominates the time of a minor GC.
+
+   With +RTS --card-table the GC copies the MUT_VARs, MVARs and TVARs
+   that it promotes to an old generation into blocks of their own,
+   flagged BF_CARDS (see copy_mut() in Evac.c).  Each block has
+   BLOCK_CARDS cards, with a byte for each in the block descriptor.
+   recordClosureMutated() marks the card of an object in a BF_CARDS
+   block instead of putting the object on the mutable list.  Marking a
+   card is a plain byte store, so capabilities need no synchronisation
+   to do it.
+
+   At a minor GC, after its mutable lists, each GC thread claims card
+   blocks of the older generations and scans them (scavenge_card_blocks()
+   in Scav.c).  A BF_CARDS block holds nothing but those three kinds of
+   fixed-size object, none of which is ever overwritten, so the scan can
+   walk the block from the start.  (An ordinary block can't be walked
+   like that outside GC: an updated thunk leaves slop behind it.)  The
+   scan scavenges the dirty objects in the dirty cards, and marks the
+   card again for any that still point into a younger generation.  The
+   GC itself still uses the mutable list for the objects it promotes
+   that point into a younger generation.
+
+   So that a minor GC doesn't have to walk gen->blocks to find them, the
+   BF_CARDS blocks of each generation are listed in an array here.  The
+   GC records the blocks it fills in collect_gct_blocks(), in a second
+   array that commitCardBlocks() appends to the first at the end of the
+   GC, since other GC threads may still be scanning the first.  When a
+   generation is collected its list is emptied.  A copying collection
+   frees the blocks; a marking collection (-c, -w) keeps them but clears
+   BF_CARDS, since other objects may be compacted into them, and swept
+   blocks contain dead objects that must not be scavenged.  Objects left
+   in those blocks go back to the mutable list.
+
+   The cards live in the padding of the block descriptor, so the card
+   table is only available on 64-bit platforms.  It is also turned off
+   by -xn, because the concurrent marker finds out which objects have
+   been written to from the mutable lists.
+
+   +RTS -s shows the time the GC threads spend on the mutable lists and
+   on the card blocks.
+*/
+
+typedef struct card_index_ {
+    bdescr **blocks;            // the BF_CARDS blocks of the generation
+    W_       n_blocks;
+    W_       size;
+    bdescr **new_blocks;        // ... and those filled by the current GC
+    W_       n_new_blocks;
+    W_       new_size;
+    volatile StgWord next;      // next entry of blocks to scan
+} card_index;
+
+// one for each generation
+static card_index *card_indices = NULL;
+
+// Card blocks handed out by claimCardBlocks() at a time
+#define CARD_CLAIM 16
+
+void
+initCardTable (void)
+{
+    if (!RtsFlags.GcFlags.cardTable) {
+        return;
+    }
+    card_indices = stgCallocBytes(RtsFlags.GcFlags.generations,
+                                  sizeof(card_index), "initCardTable");
+}
+
+void
+freeCardTable (void)
+{
+    uint32_t g;
+
+    if (card_indices == NULL) {
+        return;
+    }
+    for (g = 0; g < RtsFlags.GcFlags.generations; g++) {
+        stgFree(card_indices[g].blocks);
+        stgFree(card_indices[g].new_blocks);
+    }
+    stgFree(card_indices);
+    card_indices = NULL;
+}
+
+void
+resetCardBlocks (generation *gen)
+{
+    if (card_indices == NULL) {
+        return;
+    }
+    card_indices[gen->no].n_blocks = 0;
+    card_indices[gen->no].next = 0;
+}
+
+void
+addCardBlock (generation *gen, bdescr *bd)
+{
+    card_index *idx = &card_indices[gen->no];
+
+    if (idx->n_new_blocks == idx->new_size) {
+        idx->new_size = stg_max(64, idx->new_size * 2);
+        idx->new_blocks = stgReallocBytes(idx->new_blocks,
+                                          idx->new_size * sizeof(bdescr *),
+                                          "addCardBlock");
+    }
+    idx->new_blocks[idx->n_new_blocks++] = bd;
+}
+
+void
+commitCardBlocks (void)
+{
+    card_index *idx;
+    uint32_t g;
+
+    if (card_indices == NULL) {
+        return;
+    }
+
+    for (g = 0; g < RtsFlags.GcFlags.generations; g++) {
+        idx = &card_indices[g];
+        if (idx->n_blocks + idx->n_new_blocks > idx->size) {
+            idx->size = stg_max(idx->size * 2,
+                                idx->n_blocks + idx->n_new_blocks);
+            idx->blocks = stgReallocBytes(idx->blocks,
+                                          idx->size * sizeof(bdescr *),
+                                          "commitCardBlocks");
+        }
+        memcpy(&idx->blocks[idx->n_blocks], idx->new_blocks,
+               idx->n_new_blocks * sizeof(bdescr *));
+        idx->n_blocks += idx->n_new_blocks;
+        idx->n_new_blocks = 0;
+        idx->next = 0;
+    }
+}
+
+bdescr **
+claimCardBlocks (generation *gen, W_ *n)
+{
+    card_index *idx = &card_indices[gen->no];
+    W_ i;
+
+    if (idx->next >= idx->n_blocks) {
+        return NULL;
+    }
+    i = atomic_inc(&idx->next, CARD_CLAIM) - CARD_CLAIM;
+    if (i >= idx->n_blocks) {
+        return NULL;
+    }
+    *n = stg_min(CARD_CLAIM, idx->n_blocks - i);
+    return &idx->blocks[i];
+}
@@ -0,0 +1,36 @@
+/* -----------------------------------------------------------------------------
+ *
+ * (c) The GHC Team 2019
+ *
+ * Card table for old MUT_VARs, MVARs and TVARs.
+ *
+ * Documentation on the architecture of the Storage Manager can be
+ * found in the online commentary:
+ *
+ *   https://gitlab.haskell.org/ghc/ghc/wikis/commentary/rts/storage
+ *
+ * ---------------------------------------------------------------------------*/
+
+#pragma once
+
+#include "BeginPrivate.h"
+
+void initCardTable (void);
+void freeCardTable (void);
+
+// Forget the card blocks of a generation that is about to be collected.
+void resetCardBlocks (generation *gen);
+
+// Record a card block that the GC has filled.  The caller must hold
+// gen->sync.
+void addCardBlock (generation *gen, bdescr *bd);
+
+// Make the card blocks recorded during this GC visible to the next
+// one.  Called at the end of GC.
+void commitCardBlocks (void);
+
+// Claim some of the card blocks of gen to scan; returns NULL when
+// there are none left.  Any number of GC threads may call this.
+bdescr **claimCardBlocks (generation *gen, W_ *n);
+
+#include "EndPrivate.h"
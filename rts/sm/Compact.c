@@ -70,6 +70,80 @@
    if we throw away some of the tags).
    ------------------------------------------------------------------------- */
 
+#if defined(THREADED_RTS)
+/* ----------------------------------------------------------------------------
+   Region summaries for parallel compaction
+
+   See Note [Parallel compaction].  Each block of the compacted
+   generation has a summary, which says where its live objects go.
+   ------------------------------------------------------------------------- */
+
+#define COMPACT_CHUNK_W 16
+#define COMPACT_CHUNKS  (BLOCK_SIZE_W / COMPACT_CHUNK_W)
+
+typedef struct {
+    bdescr   *bd;
+    StgPtr    dest;          // where the first live object goes
+    StgPtr    split;         // the first object that doesn't fit after
+                             // dest, or NULL
+    StgPtr    dest2;         // where split goes
+    StgWord   live;          // live words in the block
+    StgWord   split_live;    // live words before split
+    StgWord16 prefix[COMPACT_CHUNKS]; // live words in the objects that
+                                      // start before each chunk
+} compact_region;
+
+static compact_region *regions = NULL;
+static StgWord *regions_bitmap;
+
+// True while thread() should update each pointer with its new address
+// straight away, rather than add it to the object's chain.
+static bool compact_forwarding = false;
+
+// The blocks of the compacted generation have consecutive slices of
+// its bitmap, in the same order as the regions.
+STATIC_INLINE compact_region *
+region_of (bdescr *bd)
+{
+    return &regions[(bd->u.bitmap - regions_bitmap) /
+                    (BLOCK_SIZE_W / BITS_IN(W_))];
+}
+
+// Live words in the region before the object at q.
+STATIC_INLINE StgWord
+live_before (compact_region *r, StgPtr q)
+{
+    bdescr *bd = r->bd;
+    StgWord off, live, size;
+    StgPtr p;
+
+    off = q - bd->start;
+    live = r->prefix[off / COMPACT_CHUNK_W];
+    for (p = bd->start + off - off % COMPACT_CHUNK_W; p < q; ) {
+        if (is_marked(p, bd)) {
+            size = closure_sizeW((StgClosure *)p);
+            live += size;
+            p += size;
+        } else {
+            p++;
+        }
+    }
+    return live;
+}
+
+STATIC_INLINE StgPtr
+forward_addr (StgPtr q, bdescr *bd)
+{
+    compact_region *r = region_of(bd);
+    StgWord live = live_before(r, q);
+
+    if (r->split != NULL && q >= r->split) {
+        return r->dest2 + (live - r->split_live);
+    }
+    return r->dest + live;
+}
+#endif
+
 STATIC_INLINE void
 thread (StgClosure **p)
 {
@@ -90,6 +164,13 @@ thread (StgClosure **p)
 
         if (bd->flags & BF_MARKED)
         {
+#if defined(THREADED_RTS)
+            if (compact_forwarding) {
+                *p = (StgClosure *)((StgWord)forward_addr(q, bd)
+                                    + GET_CLOSURE_TAG(q0));
+                return;
+            }
+#endif
             iptr = *q;
             switch (GET_CLOSURE_TAG((StgClosure *)iptr))
             {
@@ -460,16 +541,14 @@ thread_TSO (StgTSO *tso)
 
 
 static void
-update_fwd_large( bdescr *bd )
+thread_large( bdescr *bd )
 {
-  StgPtr p;
-  const StgInfoTable* info;
-
-  for (; bd != NULL; bd = bd->link) {
+    StgPtr p;
+    const StgInfoTable* info;
 
     // nothing to do in a pinned block; it might not even have an object
     // at the beginning.
-    if (bd->flags & BF_PINNED) continue;
+    if (bd->flags & BF_PINNED) return;
 
     p = bd->start;
     info  = get_itbl((StgClosure *)p);
@@ -479,7 +558,7 @@ update_fwd_large( bdescr *bd )
     case ARR_WORDS:
     case COMPACT_NFDATA:
       // nothing to follow
-      continue;
+      return;
 
     case MUT_ARR_PTRS_CLEAN:
     case MUT_ARR_PTRS_DIRTY:
@@ -493,7 +572,7 @@ update_fwd_large( bdescr *bd )
           for (p = (P_)a->payload; p < (P_)&a->payload[a->ptrs]; p++) {
               thread((StgClosure **)p);
           }
-          continue;
+          return;
       }
 
     case SMALL_MUT_ARR_PTRS_CLEAN:
@@ -508,23 +587,23 @@ update_fwd_large( bdescr *bd )
           for (p = (P_)a->payload; p < (P_)&a->payload[a->ptrs]; p++) {
               thread((StgClosure **)p);
           }
-          continue;
+          return;
       }
 
     case STACK:
     {
         StgStack *stack = (StgStack*)p;
         thread_stack(stack->sp, stack->stack + stack->stack_size);
-        continue;
+        return;
     }
 
     case AP_STACK:
         thread_AP_STACK((StgAP_STACK *)p);
-        continue;
+        return;
 
     case PAP:
         thread_PAP((StgPAP *)p);
-        continue;
+        return;
 
     case TREC_CHUNK:
     {
@@ -537,13 +616,20 @@ update_fwd_large( bdescr *bd )
           thread(&e->expected_value);
           thread(&e->new_value);
         }
-        continue;
+        return;
     }
 
     default:
       barf("update_fwd_large: unknown/strange object  %d", (int)(info->type));
     }
-  }
+}
+
+static void
+update_fwd_large( bdescr *bd )
+{
+    for (; bd != NULL; bd = bd->link) {
+        thread_large(bd);
+    }
 }
 
 // ToDo: too big to inline
@@ -744,24 +830,29 @@ thread_obj (const StgInfoTable *info, StgPtr p)
 }
 
 static void
-update_fwd( bdescr *blocks )
+update_fwd_block( bdescr *bd )
 {
     StgPtr p;
-    bdescr *bd;
     const StgInfoTable *info;
 
-    bd = blocks;
+    p = bd->start;
 
-    // cycle through all the blocks in the step
-    for (; bd != NULL; bd = bd->link) {
-        p = bd->start;
+    // linearly scan the objects in this block
+    while (p < bd->free) {
+        ASSERT(LOOKS_LIKE_CLOSURE_PTR(p));
+        info = get_itbl((StgClosure *)p);
+        p = thread_obj(info, p);
+    }
+}
 
-        // linearly scan the objects in this block
-        while (p < bd->free) {
-            ASSERT(LOOKS_LIKE_CLOSURE_PTR(p));
-            info = get_itbl((StgClosure *)p);
-            p = thread_obj(info, p);
-        }
+static void
+update_fwd( bdescr *blocks )
+{
+    bdescr *bd;
+
+    // cycle through all the blocks in the step
+    for (bd = blocks; bd != NULL; bd = bd->link) {
+        update_fwd_block(bd);
     }
 }
 
@@ -939,15 +1030,15 @@ update_bkwd_compact( generation *gen )
     return free_blocks;
 }
 
-void
-compact(StgClosure *static_objects,
-        StgWeak **dead_weak_ptr_list,
-        StgTSO **resurrected_threads)
+// Thread (or with compact_forwarding, update) the pointers from outside
+// the heap.
+static void
+thread_roots (StgClosure *static_objects,
+              StgWeak **dead_weak_ptr_list,
+              StgTSO **resurrected_threads)
 {
-    W_ n, g, blocks;
-    generation *gen;
+    W_ n, g;
 
-    // 1. thread the roots
     markCapabilities((evac_fn)thread_root, NULL);
 
     markScheduler((evac_fn)thread_root, NULL);
@@ -1010,6 +1101,458 @@ compact(StgClosure *static_objects,
 
     // the CAF list (used by GHCi)
     markCAFs((evac_fn)thread_root, NULL);
+}
+
+#if defined(THREADED_RTS)
+/* Note [Parallel compaction]
+   ~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+   The threading algorithm above is inherently sequential: the chain
+   of an object has to be complete before update_fwd_compact() gets to
+   the object, and update_bkwd_compact() relies on visiting the objects
+   in order.  When the parallel GC is enabled (-qg) and the compacted
+   generation is big enough, we use a different algorithm that can be
+   spread over several threads:
+
+     1. Summarise each block of the compacted generation (in parallel):
+        count its live words, and for every COMPACT_CHUNK_W words of
+        the block, the live words in the objects that start before
+        that point (compact_region.prefix).
+
+     2. Work out where each block's live objects go (sequentially, but
+        this is one step per block, not per object).  Objects are laid
+        out exactly as the sequential algorithm would: in order, and
+        moving to the next destination block when an object doesn't
+        fit.  At most one object per block, compact_region.split, starts
+        a new destination block, and we find it using the prefix table.
+
+     3. Update every pointer to the compacted generation (in parallel),
+        instead of threading it.  The new address of an object is the
+        destination of its block plus the live words before it, which
+        live_before() computes from the prefix table and the sizes of
+        at most COMPACT_CHUNK_W words' worth of objects.  The roots are
+        done first, sequentially, with the same code as the threading
+        pass; the heap is done a block (or large object) at a time by
+        the compaction threads.  Nothing moves and no info pointer
+        changes, so the object sizes that live_before() reads stay
+        valid throughout.
+
+     4. Slide the objects to their new addresses (sequentially; this is
+        a linear copy, and a block can only be overwritten once the
+        blocks before it have moved out).
+
+   The compaction threads are started for each compaction, since
+   compaction GCs are rare and long.  The GC is otherwise
+   single-threaded when the oldest generation is marked, so the other
+   GC threads aren't available.
+*/
+
+#define COMPACT_PAR_MIN_BLOCKS 1024
+
+static Mutex     gang_mutex;
+static Condition gang_cond;
+static uint32_t  gang_helpers;      // helper threads running
+static uint32_t  gang_busy;         // helpers still in the current loop
+static uint32_t  gang_round;        // one for each parallel loop
+static bool      gang_exit;
+static void    (*gang_work)(W_ i);
+static W_        gang_n;
+static volatile StgWord gang_next;
+
+static void
+gang_run (void)
+{
+    W_ i;
+
+    while ((i = atomic_inc(&gang_next, 1) - 1) < gang_n) {
+        gang_work(i);
+    }
+}
+
+static void *
+compactHelper (void *arg STG_UNUSED)
+{
+    uint32_t round = 0;
+
+    ACQUIRE_LOCK(&gang_mutex);
+    for (;;) {
+        while (gang_round == round && !gang_exit) {
+            waitCondition(&gang_cond, &gang_mutex);
+        }
+        if (gang_exit) break;
+        round = gang_round;
+        RELEASE_LOCK(&gang_mutex);
+
+        gang_run();
+
+        ACQUIRE_LOCK(&gang_mutex);
+        if (--gang_busy == 0) {
+            broadcastCondition(&gang_cond);
+        }
+    }
+    gang_helpers--;
+    broadcastCondition(&gang_cond);
+    RELEASE_LOCK(&gang_mutex);
+    return NULL;
+}
+
+static void
+start_gang (uint32_t n)
+{
+    OSThreadId tid;
+    uint32_t i;
+
+    initMutex(&gang_mutex);
+    initCondition(&gang_cond);
+    gang_helpers = 0;
+    gang_busy = 0;
+    gang_round = 0;
+    gang_exit = false;
+
+    ACQUIRE_LOCK(&gang_mutex);
+    for (i = 1; i < n; i++) {
+        if (createOSThread(&tid, "ghc_compact", compactHelper, NULL) != 0) {
+            break;
+        }
+        gang_helpers++;
+    }
+    RELEASE_LOCK(&gang_mutex);
+}
+
+static void
+stop_gang (void)
+{
+    ACQUIRE_LOCK(&gang_mutex);
+    gang_exit = true;
+    broadcastCondition(&gang_cond);
+    while (gang_helpers > 0) {
+        waitCondition(&gang_cond, &gang_mutex);
+    }
+    RELEASE_LOCK(&gang_mutex);
+
+    closeCondition(&gang_cond);
+    closeMutex(&gang_mutex);
+}
+
+// Run work(0) .. work(n-1) on the compaction threads and this one.
+static void
+gang_for (void (*work)(W_ i), W_ n)
+{
+    ACQUIRE_LOCK(&gang_mutex);
+    gang_work = work;
+    gang_n = n;
+    gang_next = 0;
+    gang_busy = gang_helpers;
+    gang_round++;
+    broadcastCondition(&gang_cond);
+    RELEASE_LOCK(&gang_mutex);
+
+    gang_run();
+
+    ACQUIRE_LOCK(&gang_mutex);
+    while (gang_busy > 0) {
+        waitCondition(&gang_cond, &gang_mutex);
+    }
+    RELEASE_LOCK(&gang_mutex);
+}
+
+static W_ n_regions;
+
+// The non-compacted blocks and large objects to update, in that order,
+// followed by the regions.
+static bdescr **update_blocks;
+static W_ n_update_blocks, n_update_large;
+
+static void
+summarise_region (W_ i)
+{
+    compact_region *r = &regions[i];
+    bdescr *bd = r->bd;
+    StgPtr p;
+    StgWord live, size, c;
+
+    live = 0;
+    c = 0;
+    p = bd->start;
+    while (p < bd->free) {
+        if (!is_marked(p, bd)) {
+            p++;
+            continue;
+        }
+        while (c <= (StgWord)(p - bd->start) / COMPACT_CHUNK_W) {
+            r->prefix[c++] = live;
+        }
+        size = closure_sizeW((StgClosure *)p);
+        live += size;
+        p += size;
+    }
+    while (c < COMPACT_CHUNKS) {
+        r->prefix[c++] = live;
+    }
+    r->live = live;
+}
+
+static void
+plan_regions (void)
+{
+    compact_region *r;
+    bdescr *bd, *free_bd;
+    StgPtr p, free;
+    StgWord room, live, size, c;
+    W_ i;
+
+    free_bd = regions[0].bd;
+    free = free_bd->start;
+
+    for (i = 0; i < n_regions; i++) {
+        r = &regions[i];
+        r->dest = free;
+        r->split = NULL;
+
+        if (free + r->live <= free_bd->start + BLOCK_SIZE_W) {
+            free += r->live;
+            continue;
+        }
+
+        // Find the first object that doesn't fit.  The objects that
+        // start before chunk c all fit if prefix[c] <= room.
+        bd = r->bd;
+        room = free_bd->start + BLOCK_SIZE_W - free;
+        for (c = 0; c + 1 < COMPACT_CHUNKS && r->prefix[c+1] <= room; c++) {
+            ;
+        }
+        live = r->prefix[c];
+        p = bd->start + c * COMPACT_CHUNK_W;
+        while (p < bd->free) {
+            if (!is_marked(p, bd)) {
+                p++;
+                continue;
+            }
+            size = closure_sizeW((StgClosure *)p);
+            if (live + size > room) break;
+            live += size;
+            p += size;
+        }
+        ASSERT(p < bd->free);
+
+        r->split = p;
+        r->split_live = live;
+        free_bd = free_bd->link;
+        free = free_bd->start;
+        r->dest2 = free;
+        free += r->live - live;
+    }
+}
+
+static void
+update_par (W_ i)
+{
+    compact_region *r;
+    bdescr *bd;
+    StgPtr p;
+
+    if (i < n_update_blocks) {
+        update_fwd_block(update_blocks[i]);
+        return;
+    }
+    i -= n_update_blocks;
+    if (i < n_update_large) {
+        thread_large(update_blocks[n_update_blocks + i]);
+        return;
+    }
+    i -= n_update_large;
+
+    r = &regions[i];
+    bd = r->bd;
+    p = bd->start;
+    while (p < bd->free) {
+        if (!is_marked(p, bd)) {
+            p++;
+            continue;
+        }
+        p = thread_obj(get_itbl((StgClosure *)p), p);
+    }
+}
+
+static W_
+move_regions (void)
+{
+    compact_region *r;
+    bdescr *bd, *free_bd;
+    StgPtr p, free;
+    const StgInfoTable *info;
+    StgWord size;
+    W_ i, free_blocks;
+
+    free_bd = regions[0].bd;
+    free = free_bd->start;
+    free_blocks = 1;
+
+    for (i = 0; i < n_regions; i++) {
+        r = &regions[i];
+        bd = r->bd;
+        ASSERT(free == r->dest);
+
+        p = bd->start;
+        while (p < bd->free) {
+            if (!is_marked(p, bd)) {
+                p++;
+                continue;
+            }
+
+            if (p == r->split) {
+                free_bd->free = free;
+                free_bd = free_bd->link;
+                free = free_bd->start;
+                free_blocks++;
+            }
+
+            info = get_itbl((StgClosure *)p);
+            size = closure_sizeW_((StgClosure *)p, info);
+
+            if (free != p) {
+                move(free,p,size);
+            }
+
+            // relocate TSOs
+            if (info->type == STACK) {
+                move_STACK((StgStack *)p, (StgStack *)free);
+            }
+
+            free += size;
+            p += size;
+        }
+    }
+
+    // free the remaining blocks and count what's left.
+    free_bd->free = free;
+    if (free_bd->link != NULL) {
+        freeChain(free_bd->link);
+        free_bd->link = NULL;
+    }
+
+    return free_blocks;
+}
+
+static void
+add_update_blocks (bdescr *bd, W_ *n)
+{
+    for (; bd != NULL; bd = bd->link) {
+        update_blocks[(*n)++] = bd;
+    }
+}
+
+// See Note [Parallel compaction]
+static void
+compact_par (uint32_t n_threads,
+             StgClosure *static_objects,
+             StgWeak **dead_weak_ptr_list,
+             StgTSO **resurrected_threads)
+{
+    W_ i, n, g, n_blocks, n_large, blocks;
+    generation *gen;
+    bdescr *bd;
+
+    gen = oldest_gen;
+
+    n_regions = 0;
+    for (bd = gen->old_blocks; bd != NULL; bd = bd->link) {
+        n_regions++;
+    }
+    regions = stgMallocBytes(n_regions * sizeof(compact_region),
+                             "compact_par");
+    regions_bitmap = gen->bitmap->start;
+    i = 0;
+    for (bd = gen->old_blocks; bd != NULL; bd = bd->link) {
+        ASSERT(region_of(bd) == &regions[i]);
+        regions[i++].bd = bd;
+    }
+
+    n_blocks = 0;
+    n_large = 0;
+    for (g = 0; g < RtsFlags.GcFlags.generations; g++) {
+        n_blocks += countBlocks(generations[g].blocks);
+        n_large += countBlocks(generations[g].scavenged_large_objects);
+        for (n = 0; n < n_capabilities; n++) {
+            n_blocks += countBlocks(gc_threads[n]->gens[g].todo_bd);
+            n_blocks += countBlocks(gc_threads[n]->gens[g].part_list);
+        }
+    }
+    update_blocks = stgMallocBytes((n_blocks + n_large) * sizeof(bdescr *),
+                                   "compact_par");
+    n_update_blocks = 0;
+    for (g = 0; g < RtsFlags.GcFlags.generations; g++) {
+        add_update_blocks(generations[g].blocks, &n_update_blocks);
+        for (n = 0; n < n_capabilities; n++) {
+            add_update_blocks(gc_threads[n]->gens[g].todo_bd,
+                              &n_update_blocks);
+            add_update_blocks(gc_threads[n]->gens[g].part_list,
+                              &n_update_blocks);
+        }
+    }
+    n_update_large = 0;
+    for (g = 0; g < RtsFlags.GcFlags.generations; g++) {
+        for (bd = generations[g].scavenged_large_objects; bd != NULL;
+             bd = bd->link) {
+            update_blocks[n_update_blocks + n_update_large++] = bd;
+        }
+    }
+
+    start_gang(n_threads);
+    debugTrace(DEBUG_gc, "compact: %d region(s), %d thread(s)",
+               (int)n_regions, (int)gang_helpers + 1);
+
+    // 1. summarise the regions
+    gang_for(summarise_region, n_regions);
+
+    // 2. decide where everything goes
+    plan_regions();
+
+    // 3. update the roots and then the heap
+    compact_forwarding = true;
+    thread_roots(static_objects, dead_weak_ptr_list, resurrected_threads);
+    gang_for(update_par, n_update_blocks + n_update_large + n_regions);
+    compact_forwarding = false;
+
+    stop_gang();
+
+    // 4. move the objects
+    blocks = move_regions();
+    debugTrace(DEBUG_gc,
+               "compact: %d (old: %d blocks, now %d blocks)",
+               gen->no, gen->n_old_blocks, blocks);
+    gen->n_old_blocks = blocks;
+
+    stgFree(update_blocks);
+    stgFree(regions);
+    update_blocks = NULL;
+    regions = NULL;
+}
+#endif /* THREADED_RTS */
+
+void
+compact(StgClosure *static_objects,
+        StgWeak **dead_weak_ptr_list,
+        StgTSO **resurrected_threads)
+{
+    W_ n, g, blocks;
+    generation *gen;
+
+#if defined(THREADED_RTS)
+    if (RtsFlags.ParFlags.parGcEnabled &&
+        oldest_gen->n_old_blocks >= COMPACT_PAR_MIN_BLOCKS) {
+        uint32_t n_threads = RtsFlags.ParFlags.parGcThreads > 0
+            ? RtsFlags.ParFlags.parGcThreads : n_capabilities;
+        if (n_threads > 1) {
+            compact_par(n_threads, static_objects,
+                        dead_weak_ptr_list, resurrected_threads);
+            return;
+        }
+    }
+#endif
+
+    // 1. thread the roots
+    thread_roots(static_objects, dead_weak_ptr_list, resurrected_threads);
 
     // 2. update forward ptrs
     for (g = 0; g < RtsFlags.GcFlags.generations; g++) {
@@ -0,0 +1,214 @@
+/* -----------------------------------------------------------------------------
+ *
+ * (c) The GHC Team 2019
+ *
+ * Returning free megablocks to the OS in the background.
+ *
+ * Documentation on the architecture of the Storage Manager can be
+ * found in the online commentary:
+ *
+ *   https://gitlab.haskell.org/ghc/ghc/wikis/commentary/rts/storage
+ *
+ * ---------------------------------------------------------------------------*/
+
+#include "PosixSource.h"
+#include "Rts.h"
+
+#include "RtsUtils.h"
+#include "Storage.h"
+#include "BlockAlloc.h"
+#include "Decommit.h"
+#include "Trace.h"
+
+#if defined(THREADED_RTS)
+#if defined(mingw32_HOST_OS)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#endif
+
+/* Note [Background decommit]
+   ~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+   At the end of a major GC we work out how much memory the heap is
+   likely to need until the next major GC, and give any free megablocks
+   beyond that back to the OS (see the end of GarbageCollect()).  After
+   a spike in allocation this can be a lot of memory, and returning it
+   all at once means a long run of munmap()/madvise() calls with the SM
+   lock held, right at the end of the GC pause.
+
+   With +RTS --decommit-rate=<size> the GC instead records the number
+   of megablocks it wants to return in pending_decommit_mblocks and
+   wakes up the decommit thread.  The thread returns them a few at a
+   time with returnMemoryToOS(), taking the SM lock for each batch only,
+   and sleeps between batches so that the total rate is about the
+   requested one.  The memory is decommitted with osDecommitMemory(),
+   which prefers MADV_FREE where the OS supports it, so the pages are
+   only actually reclaimed if the OS is short of memory.
+
+   The megablocks stay on the free list until the thread gets to them,
+   so the mutator can still reuse them in the meantime.  If it does,
+   returnMemoryToOS() returns fewer megablocks than we asked for and we
+   drop the rest of the pending count.  The next major GC replaces the
+   pending count with a fresh estimate.
+
+   +RTS --decommit-target=<size> lowers the GC's estimate: memory above
+   the target is returned even if the GC would otherwise have kept it
+   around for the next GC.
+
+   pending_decommit_mblocks is protected by the SM lock, and reported
+   (without taking the lock) by getRTSStats().
+*/
+
+W_ pending_decommit_mblocks = 0;
+
+#if defined(THREADED_RTS)
+
+static Mutex      decommit_mutex;
+static Condition  decommit_cond;
+static OSThreadId decommit_thread;
+
+// Both protected by decommit_mutex; decommit_stop is also read without
+// it while the thread sleeps.
+static volatile bool decommit_stop = false;
+static bool decommit_running = false;
+
+// The decommit thread sleeps in slices of this many microseconds, so
+// that stopDecommitThread() doesn't have to wait for long.
+#define DECOMMIT_SLICE_US 10000
+
+static void
+decommitSleep (uint64_t us)
+{
+#if defined(mingw32_HOST_OS)
+    Sleep((DWORD)(us / 1000));
+#else
+    struct timespec ts;
+    ts.tv_sec  = us / 1000000;
+    ts.tv_nsec = (us % 1000000) * 1000;
+    nanosleep(&ts, NULL);
+#endif
+}
+
+static void *
+decommitThread (void *arg STG_UNUSED)
+{
+    W_ rate, chunk, n, freed;
+    uint64_t sleep_us, t;
+
+    rate = (W_)RtsFlags.GcFlags.decommitRate * BLOCK_SIZE; // bytes/sec
+
+    // Return about one slice's worth of memory at a time, but at least
+    // one megablock, and then sleep for as long as that takes at the
+    // requested rate.
+    chunk = stg_max(1, rate / (MBLOCK_SIZE * (1000000 / DECOMMIT_SLICE_US)));
+    sleep_us = (uint64_t)chunk * MBLOCK_SIZE * 1000000 / rate;
+
+    ACQUIRE_LOCK(&decommit_mutex);
+    while (!decommit_stop) {
+        if (pending_decommit_mblocks == 0) {
+            waitCondition(&decommit_cond, &decommit_mutex);
+            continue;
+        }
+        RELEASE_LOCK(&decommit_mutex);
+
+        ACQUIRE_SM_LOCK;
+        n = stg_min(pending_decommit_mblocks, chunk);
+        freed = returnMemoryToOS(n);
+        if (freed < n) {
+            // the rest have been reused since the GC scheduled them
+            pending_decommit_mblocks = 0;
+        } else {
+            pending_decommit_mblocks -= freed;
+        }
+        RELEASE_SM_LOCK;
+
+        debugTrace(DEBUG_gc, "decommit thread: returned %" FMT_Word
+                   " megablock(s), %" FMT_Word " pending",
+                   freed, pending_decommit_mblocks);
+
+        for (t = 0; t < sleep_us && !decommit_stop; t += DECOMMIT_SLICE_US) {
+            decommitSleep(stg_min(sleep_us - t, DECOMMIT_SLICE_US));
+        }
+
+        ACQUIRE_LOCK(&decommit_mutex);
+    }
+    decommit_running = false;
+    broadcastCondition(&decommit_cond);
+    RELEASE_LOCK(&decommit_mutex);
+    return NULL;
+}
+
+#endif /* THREADED_RTS */
+
+// Called from initStorage(), and again in the child after forkProcess()
+// since the thread does not survive the fork.
+void
+startDecommitThread (void)
+{
+#if defined(THREADED_RTS)
+    decommit_running = false;
+    decommit_stop = false;
+
+    if (RtsFlags.GcFlags.decommitRate == 0) {
+        return;
+    }
+
+    initMutex(&decommit_mutex);
+    initCondition(&decommit_cond);
+
+    if (createOSThread(&decommit_thread, "ghc_decommit",
+                       decommitThread, NULL) != 0) {
+        sysErrorBelch("warning: could not start the decommit thread; "
+                      "returning memory to the OS during GC instead");
+        closeCondition(&decommit_cond);
+        closeMutex(&decommit_mutex);
+        return;
+    }
+    decommit_running = true;
+#endif
+}
+
+void
+stopDecommitThread (void)
+{
+#if defined(THREADED_RTS)
+    if (!decommit_running) {
+        return;
+    }
+
+    ACQUIRE_LOCK(&decommit_mutex);
+    decommit_stop = true;
+    broadcastCondition(&decommit_cond);
+    while (decommit_running) {
+        waitCondition(&decommit_cond, &decommit_mutex);
+    }
+    RELEASE_LOCK(&decommit_mutex);
+
+    closeCondition(&decommit_cond);
+    closeMutex(&decommit_mutex);
+#endif
+}
+
+void
+scheduleReturnMemoryToOS (W_ n)
+{
+    ASSERT_SM_LOCK();
+
+#if defined(THREADED_RTS)
+    if (decommit_running) {
+        pending_decommit_mblocks = n;
+        if (n > 0) {
+            ACQUIRE_LOCK(&decommit_mutex);
+            signalCondition(&decommit_cond);
+            RELEASE_LOCK(&decommit_mutex);
+        }
+        return;
+    }
+#endif
+
+    if (n > 0) {
+        returnMemoryToOS(n);
+    }
+}
@@ -0,0 +1,30 @@
+/* -----------------------------------------------------------------------------
+ *
+ * (c) The GHC Team 2019
+ *
+ * Returning free megablocks to the OS in the background.
+ *
+ * Documentation on the architecture of the Storage Manager can be
+ * found in the online commentary:
+ *
+ *   https://gitlab.haskell.org/ghc/ghc/wikis/commentary/rts/storage
+ *
+ * ---------------------------------------------------------------------------*/
+
+#pragma once
+
+#include "BeginPrivate.h"
+
+void startDecommitThread (void);
+void stopDecommitThread  (void);
+
+// Return n free megablocks to the OS, either right away or, with
+// +RTS --decommit-rate, a few at a time from the decommit thread.
+// The caller must hold the SM lock.
+void scheduleReturnMemoryToOS (W_ n);
+
+// Megablocks scheduled to be returned but not returned yet.
+// Protected by the SM lock.
+extern W_ pending_decommit_mblocks;
+
+#include "EndPrivate.h"
@@ -14,6 +14,7 @@
 #include "PosixSource.h"
 #include "Rts.h"
 
+#include "RtsUtils.h"
 #include "Evac.h"
 #include "Storage.h"
 #include "GC.h"
@@ -27,6 +28,9 @@
 #include "LdvProfile.h"
 #include "CNF.h"
 #include "Scav.h"
+#include "NonMoving.h"
+#include "Pretenure.h"
+#include "StaticRoots.h"
 
 #if defined(THREADED_RTS) && !defined(PARALLEL_GC)
 #define evacuate(p) evacuate1(p)
@@ -39,7 +43,8 @@
         copy_tag(p, info, src, size, stp, tag)
 #endif
 
-/* Used to avoid long recursion due to selector thunks
+/* Used to avoid long recursion due to selector thunks; see
+   Note [Eager selector evaluation]
  */
 #define MAX_THUNK_SELECTOR_DEPTH 16
 
@@ -51,7 +56,7 @@ STATIC_INLINE void evacuate_large(StgPtr p);
    -------------------------------------------------------------------------- */
 
 STATIC_INLINE StgPtr
-alloc_for_copy (uint32_t size, uint32_t gen_no)
+alloc_for_copy (StgClosure *src, uint32_t size, uint32_t gen_no)
 {
     StgPtr to;
     gen_workspace *ws;
@@ -71,6 +76,19 @@ alloc_for_copy (uint32_t size, uint32_t gen_no)
 
     ws = &gct->gens[gen_no];  // zero memory references here
 
+    /* With NUMA, keep the object on the node it came from.  See
+     * Note [NUMA-affine evacuation] in GCUtils.c.
+     */
+    if (RTS_UNLIKELY(ws->node_bds != NULL)) {
+        uint32_t node = Bdescr((P_)src)->node;
+        if (node != gct->node) {
+            to = alloc_for_copy_on_node(ws, size, node);
+            if (to != NULL) {
+                return to;
+            }
+        }
+    }
+
     /* chain a new block onto the to-space for the destination gen if
      * necessary.
      */
@@ -95,7 +113,7 @@ copy_tag(StgClosure **p, const StgInfoTable *info,
     StgPtr to, from;
     uint32_t i;
 
-    to = alloc_for_copy(size,gen_no);
+    to = alloc_for_copy(src,size,gen_no);
 
     from = (StgPtr)src;
     to[0] = (W_)info;
@@ -150,7 +168,7 @@ copy_tag_nolock(StgClosure **p, const StgInfoTable *info,
     StgPtr to, from;
     uint32_t i;
 
-    to = alloc_for_copy(size,gen_no);
+    to = alloc_for_copy(src,size,gen_no);
 
     from = (StgPtr)src;
     to[0] = (W_)info;
@@ -207,7 +225,7 @@ spin:
     info = (W_)src->header.info;
 #endif /* PARALLEL_GC */
 
-    to = alloc_for_copy(size_to_reserve, gen_no);
+    to = alloc_for_copy(src, size_to_reserve, gen_no);
 
     from = (StgPtr)src;
     to[0] = info;
@@ -240,6 +258,72 @@ copy(StgClosure **p, const StgInfoTable *info,
     copy_tag(p,info,src,size,gen_no,0);
 }
 
+/* Copy a MUT_VAR, MVAR or TVAR.  With +RTS --card-table, those going
+ * to an old generation are copied into its card block; see Note [Card
+ * table] in CardTable.c.
+ */
+STATIC_INLINE void
+copy_mut(StgClosure **p, const StgInfoTable *info,
+         StgClosure *src, uint32_t size, uint32_t gen_no)
+{
+#if defined(BLOCK_CARDS)
+    StgPtr to, from;
+    uint32_t i;
+
+    if (RTS_LIKELY(!RtsFlags.GcFlags.cardTable)) {
+        copy(p,info,src,size,gen_no);
+        return;
+    }
+
+    // as in alloc_for_copy()
+    if (gen_no < gct->evac_gen_no) {
+        if (gct->eager_promotion) {
+            gen_no = gct->evac_gen_no;
+        } else {
+            gct->failed_to_evac = true;
+        }
+    }
+
+    if (gen_no == 0) {
+        copy(p,info,src,size,gen_no);
+        return;
+    }
+
+    to = alloc_for_copy_card(&gct->gens[gen_no], size);
+
+    from = (StgPtr)src;
+    to[0] = (W_)info;
+    for (i = 1; i < size; i++) {
+        to[i] = from[i];
+    }
+
+#if defined(PARALLEL_GC)
+    {
+        const StgInfoTable *new_info;
+        new_info = (const StgInfoTable *)cas((StgPtr)&src->header.info, (W_)info, MK_FORWARDING_PTR(to));
+        if (new_info != info) {
+#if defined(PROFILING)
+            // see copy_tag()
+            LDVW(to) = 0;
+#endif
+            return evacuate(p); // does the failed_to_evac stuff
+        } else {
+            *p = (StgClosure*)to;
+        }
+    }
+#else
+    src->header.info = (const StgInfoTable *)MK_FORWARDING_PTR(to);
+    *p = (StgClosure*)to;
+#endif  /* defined(PARALLEL_GC) */
+
+#if defined(PROFILING)
+    SET_EVACUAEE_FOR_LDV(from, size);
+#endif
+#else
+    copy(p,info,src,size,gen_no);
+#endif /* BLOCK_CARDS */
+}
+
 /* -----------------------------------------------------------------------------
    Evacuate a large object
 
@@ -298,6 +382,13 @@ evacuate_large(StgPtr p)
   bd->flags |= BF_EVACUATED;
   initBdescr(bd, new_gen, new_gen->to);
 
+  // promoted in place, without copying
+  if (new_gen_no != gen_no && !(bd->flags & BF_PINNED)) {
+      atomic_inc((StgVolatilePtr)&new_gen->n_promoted_large_objects, 1);
+      atomic_inc((StgVolatilePtr)&new_gen->n_promoted_large_words,
+                 bd->free - bd->start);
+  }
+
   // If this is a block of pinned or compact objects, we don't have to scan
   // these objects, because they aren't allowed to contain any outgoing
   // pointers.  For these blocks, we skip the scavenge stage and put
@@ -516,7 +607,8 @@ loop:
   ASSERTM(LOOKS_LIKE_CLOSURE_PTR(q), "invalid closure, info=%p", q->header.info);
 
   if (!HEAP_ALLOCED_GC(q)) {
-      if (!major_gc) return;
+      // see Note [Static root cache] in StaticRoots.c
+      if (!major_gc || static_roots_cached) return;
 
       info = get_itbl(q);
       switch (info->type) {
@@ -564,6 +656,13 @@ loop:
   bd = Bdescr((P_)q);
 
   if ((bd->flags & (BF_LARGE | BF_MARKED | BF_EVACUATED | BF_COMPACT)) != 0) {
+      // A small pinned object keeps its slot, even though the GC
+      // treats its block as a whole.  See Note [Pinned size classes]
+      // in Storage.c.
+      if (bd->flags & BF_SLOTTED) {
+          markPinnedSlot(bd, (P_)q);
+      }
+
       // pointer into to-space: just return it.  It might be a pointer
       // into a generation that we aren't collecting (> N), or it
       // might just be a pointer into to-space.  The latter doesn't
@@ -578,6 +677,12 @@ loop:
               gct->failed_to_evac = true;
               TICK_GC_FAILED_PROMOTION();
           }
+          // the roots of a concurrent mark: see Note [Concurrent mark]
+          // in NonMoving.c
+          if (RTS_UNLIKELY(nonmoving_seeding) &&
+              bd->gen_no == oldest_gen->no) {
+              nonMovingSeed(q);
+          }
           return;
       }
 
@@ -639,6 +744,11 @@ loop:
       return;
   }
 
+  // See Note [Pretenuring] in Pretenure.c
+  if (RTS_UNLIKELY(pretenuring) && bd->gen_no == 0) {
+      gen_no = pretenureEvac(bd, info, gen_no);
+  }
+
   switch (INFO_PTR_TO_STRUCT(info)->type) {
 
   case WHITEHOLE:
@@ -750,6 +860,7 @@ loop:
       }
       q = r;
       *p = r;
+      gct->inds_removed++;
       goto loop;
   }
 
@@ -758,6 +869,9 @@ loop:
   case MVAR_CLEAN:
   case MVAR_DIRTY:
   case TVAR:
+      copy_mut(p,info,q,sizeW_fromITBL(INFO_PTR_TO_STRUCT(info)),gen_no);
+      return;
+
   case BLOCKING_QUEUE:
   case WEAK:
   case PRIM:
@@ -777,6 +891,7 @@ loop:
     // follow chains of indirections, don't evacuate them
     q = ((StgInd*)q)->indirectee;
     *p = q;
+    gct->inds_removed++;
     goto loop;
 
   case RET_BCO:
@@ -998,6 +1113,7 @@ unchain_thunk_selectors(StgSelector *p, StgClosure *val)
             ((StgInd *)p)->indirectee = val;
             write_barrier();
             SET_INFO((StgClosure *)p, &stg_IND_info);
+            gct->selectors_eliminated++;
         }
 
         // For the purposes of LDV profiling, we have created an
@@ -1008,6 +1124,34 @@ unchain_thunk_selectors(StgSelector *p, StgClosure *val)
     }
 }
 
+/* Note [Eager selector evaluation]
+   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+   A chain of selectors, where the field selected by one is another
+   selector, is evaluated in a loop by eval_thunk_selector().  A
+   selector whose *selectee* is another selector, as in
+
+      fst (fst (fst x))
+
+   needs the inner one evaluated first, and eval_thunk_selector() calls
+   itself to do that.  To bound the C stack it gives up once it is
+   MAX_THUNK_SELECTOR_DEPTH calls deep, and copies the selectors it
+   couldn't evaluate.  A program that builds such selectors faster than
+   they are demanded then retains everything they point to, however
+   little of it they would select.
+
+   With +RTS --eager-selectors, eval_thunk_selector() carries on past
+   that depth without recursing: it saves the state of the selector it
+   is evaluating in a sel_frame on a stack in the gc_thread, evaluates
+   the selectee, and pops the frame again at each point where the inner
+   evaluation would have returned.  The frames keep their selectors
+   WHITEHOLEd, just as the C stack frames of the recursive calls do, so
+   a selector that turns out to select from itself is still caught.
+
+   The GC counts the selectors it eliminates, the ones it has to copy
+   unevaluated, and the indirections it short-cuts, for +RTS -s.
+*/
+
 /* -----------------------------------------------------------------------------
    Evaluate a THUNK_SELECTOR if possible.
 
@@ -1018,6 +1162,18 @@ unchain_thunk_selectors(StgSelector *p, StgClosure *val)
    the evac parameter.
    -------------------------------------------------------------------------- */
 
+static sel_frame *
+push_sel_frame (void)
+{
+    if (gct->sel_sp == gct->sel_size) {
+        gct->sel_size = stg_max(64, gct->sel_size * 2);
+        gct->sel_stack = stgReallocBytes(gct->sel_stack,
+                                         gct->sel_size * sizeof(sel_frame),
+                                         "push_sel_frame");
+    }
+    return &gct->sel_stack[gct->sel_sp++];
+}
+
 static void
 eval_thunk_selector (StgClosure **q, StgSelector *p, bool evac)
                  // NB. for legacy reasons, p & q are swapped around :(
@@ -1028,7 +1184,11 @@ eval_thunk_selector (StgClosure **q, StgSelector *p, bool evac)
     StgClosure *selectee;
     StgSelector *prev_thunk_selector;
     bdescr *bd;
+    sel_frame *f;
+    StgClosure *sel_val;   // result of a selectee evaluated without recursing
+    uint32_t base;         // our frames are the ones above this
 
+    base = gct->sel_sp;
     prev_thunk_selector = NULL;
     // this is a chain of THUNK_SELECTORs that we are going to update
     // to point to the value of the current THUNK_SELECTOR.  Each
@@ -1052,7 +1212,7 @@ selector_chain:
                 gct->failed_to_evac = true;
                 TICK_GC_FAILED_PROMOTION();
             }
-            return;
+            goto done;
         }
         // we don't update THUNK_SELECTORS in the compacted
         // generation, because compaction does not remove the INDs
@@ -1063,9 +1223,12 @@ selector_chain:
         if (bd->flags & BF_MARKED) {
             // must call evacuate() to mark this closure if evac==true
             *q = (StgClosure *)p;
-            if (evac) evacuate(q);
+            if (evac) {
+                evacuate(q);
+                gct->selectors_left++;
+            }
             unchain_thunk_selectors(prev_thunk_selector, (StgClosure *)p);
-            return;
+            goto done;
         }
     }
 
@@ -1103,7 +1266,7 @@ selector_chain:
             *q = (StgClosure *)p;
             if (evac) evacuate(q);
             unchain_thunk_selectors(prev_thunk_selector, (StgClosure *)p);
-            return;
+            goto done;
         }
     }
 #else
@@ -1215,7 +1378,7 @@ selector_loop:
               // eval_thunk_selector(), because we know val is not
               // a THUNK_SELECTOR.
               if (evac) evacuate(q);
-              return;
+              goto done;
           }
 
       case IND:
@@ -1258,7 +1421,25 @@ selector_loop:
           // recursively evaluate this selector.  We don't want to
           // recurse indefinitely, so we impose a depth bound.
           if (gct->thunk_selector_depth >= MAX_THUNK_SELECTOR_DEPTH) {
-              goto bale_out;
+              if (!RtsFlags.GcFlags.eagerSelectors) {
+                  goto bale_out;
+              }
+              // evaluate it without recursing; see
+              // Note [Eager selector evaluation]
+              f = push_sel_frame();
+              f->q = q;
+              f->p = p;
+              f->prev = prev_thunk_selector;
+              f->bd = bd;
+              f->selectee = selectee;
+              f->info_ptr = info_ptr;
+              f->field = field;
+              f->evac = evac;
+              q = &sel_val;
+              p = (StgSelector*)selectee;
+              prev_thunk_selector = NULL;
+              evac = false;
+              goto selector_chain;
           }
 
           gct->thunk_selector_depth++;
@@ -1303,6 +1484,28 @@ bale_out:
     *q = (StgClosure *)p;
     if (evac) {
         copy(q,(const StgInfoTable *)info_ptr,(StgClosure *)p,THUNK_SELECTOR_sizeW(),bd->dest_no);
+        gct->selectors_left++;
     }
     unchain_thunk_selectors(prev_thunk_selector, *q);
+
+done:
+    // carry on with the selector whose selectee we were evaluating, if
+    // there is one; see Note [Eager selector evaluation]
+    if (gct->sel_sp > base) {
+        f = &gct->sel_stack[--gct->sel_sp];
+        q = f->q;
+        p = f->p;
+        prev_thunk_selector = f->prev;
+        bd = f->bd;
+        selectee = f->selectee;
+        info_ptr = f->info_ptr;
+        field = f->field;
+        evac = f->evac;
+
+        // did we actually manage to evaluate it?
+        if (sel_val == selectee) goto bale_out;
+
+        selectee = UNTAG_CLOSURE(sel_val);
+        goto selector_loop;
+    }
 }
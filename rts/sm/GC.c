@@ -37,7 +37,13 @@
 #include "Schedule.h"
 #include "Sanity.h"
 #include "BlockAlloc.h"
+#include "CardTable.h"
+#include "Decommit.h"
+#include "NonMoving.h"
+#include "Pacing.h"
+#include "Pretenure.h"
 #include "ProfHeap.h"
+#include "StaticRoots.h"
 #include "Weak.h"
 #include "Prelude.h"
 #include "RtsSignals.h"
@@ -141,6 +147,28 @@ uint32_t n_gc_threads;
 // For stats:
 static long copied;        // *words* copied & scavenged during this GC
 
+// For +RTS -s with NUMA; see Note [NUMA-affine evacuation]
+W_ gc_to_blocks_by_node[MAX_NUMA_NODES]; // to-space blocks started
+W_ gc_remote_copied_words;    // words copied into another node's to-space
+
+// For +RTS -s with the parallel GC; see Note [Splitting large arrays]
+W_ gc_par_scanned_words;          // words scavenged in parallel GCs
+W_ gc_par_balanced_scanned_words; // ... and the balanced part of it
+W_ gc_split_arrays;               // large arrays split into ranges
+W_ gc_stolen_ranges;              // ... and ranges of them stolen
+
+// For +RTS -s; see Note [Eager selector evaluation] in Evac.c
+W_ gc_selectors_eliminated;       // THUNK_SELECTORs replaced by their value
+W_ gc_selectors_left;             // ... and copied unevaluated
+W_ gc_inds_removed;               // indirections short-cut
+
+// For +RTS -s with the card table; see Note [Card table] in CardTable.c
+Time gc_mut_list_time;            // scavenging the mutable lists
+Time gc_card_scan_time;           // scanning the card blocks
+
+// For +RTS -s; see Note [Static root cache] in StaticRoots.c
+Time gc_static_time;              // static objects and CAFs
+
 #if defined(PROF_SPIN) && defined(THREADED_RTS)
 // spin and yield counts for the quasi-SpinLock in waitForGcThreads
 volatile StgWord64 waitForGcThreads_spin = 0;
@@ -223,6 +251,10 @@ GarbageCollect (uint32_t collect_gen,
 
   ACQUIRE_SM_LOCK;
 
+  // Keep the sweeper thread out until the end of the GC, when
+  // wakeSweepThread() lets it go on.  See Note [Lazy sweeping] in Sweep.c.
+  pauseSweepThread();
+
 #if defined(RTS_USER_SIGNALS)
   if (RtsFlags.MiscFlags.install_signal_handlers) {
     // block signals
@@ -267,7 +299,10 @@ GarbageCollect (uint32_t collect_gen,
   N = collect_gen;
   major_gc = (N == RtsFlags.GcFlags.generations-1);
 
-  if (major_gc) {
+  // See Note [Static root cache] in StaticRoots.c
+  static_roots_cached = major_gc && useStaticRootCache();
+
+  if (major_gc && !static_roots_cached) {
       prev_static_flag = static_flag;
       static_flag =
           static_flag == STATIC_FLAG_A ? STATIC_FLAG_B : STATIC_FLAG_A;
@@ -308,6 +343,23 @@ GarbageCollect (uint32_t collect_gen,
   debugTrace(DEBUG_gc, "GC (gen %d, using %d thread(s))",
              N, n_gc_threads);
 
+  // Pause the concurrent marker, or start a new concurrent mark.  See
+  // Note [Concurrent mark] in NonMoving.c.
+  nonMovingStartGC();
+
+  // Give the blocks cached by each Capability back to the block
+  // allocator, so that memInventory() can see them and freeGroup() can
+  // coalesce them.  See Note [Capability block cache] in BlockAlloc.c.
+  for (n = 0; n < n_capabilities; n++) {
+      flushBlockCache(capabilities[n]);
+  }
+
+  // A major GC needs the last collection of the oldest generation to
+  // be swept completely.  See Note [Lazy sweeping] in Sweep.c.
+  if (major_gc) {
+      finishSweep();
+  }
+
 #if defined(DEBUG)
   // check for memory leaks if DEBUG is on
   memInventory(DEBUG_gc);
@@ -323,6 +375,12 @@ GarbageCollect (uint32_t collect_gen,
   // and put them on the g0->large_object list.
   collect_pinned_object_blocks();
 
+  // Large objects promoted by this GC, for EVENT_HEAP_LARGE_OBJECTS
+  for (g = 0; g < RtsFlags.GcFlags.generations; g++) {
+      generations[g].n_promoted_large_objects = 0;
+      generations[g].n_promoted_large_words = 0;
+  }
+
   // Initialise all the generations that we're collecting.
   for (g = 0; g <= N; g++) {
       prepare_collected_gen(&generations[g]);
@@ -374,6 +432,11 @@ GarbageCollect (uint32_t collect_gen,
           scavenge_capability_mut_lists(capabilities[n]);
 #endif
       }
+#if defined(THREADED_RTS)
+      scavenge_card_blocks1();
+#else
+      scavenge_card_blocks();
+#endif
   } else {
       scavenge_capability_mut_lists(gct->cap);
       for (n = 0; n < n_capabilities; n++) {
@@ -383,11 +446,18 @@ GarbageCollect (uint32_t collect_gen,
               scavenge_capability_mut_lists(capabilities[n]);
           }
       }
+      scavenge_card_blocks();
   }
 
-  // follow roots from the CAF list (used by GHCi)
+  // follow roots from the CAF list (used by GHCi), and the cached CAFs
   gct->evac_gen_no = 0;
-  markCAFs(mark_root, gct);
+  if (RtsFlags.GcFlags.staticRootsInterval > 1) {
+      Time start = getProcessElapsedTime();
+      markCAFs(mark_root, gct);
+      gct->static_time += getProcessElapsedTime() - start;
+  } else {
+      markCAFs(mark_root, gct);
+  }
 
   // follow all the roots that the application knows about.
   gct->evac_gen_no = 0;
@@ -402,6 +472,11 @@ GarbageCollect (uint32_t collect_gen,
 
   markScheduler(mark_root, gct);
 
+  // Finish off the concurrent mark, if there is one.
+  if (major_gc && nonmoving_marking) {
+      nonMovingMarkRoots(mark_root, gct);
+  }
+
   // Mark the weak pointer list, and prepare to detect dead weak pointers.
   markWeakPtrList();
   initWeakForGC();
@@ -424,13 +499,19 @@ GarbageCollect (uint32_t collect_gen,
   {
       scavenge_until_all_done();
 
-      // The other threads are now stopped.  We might recurse back to
-      // here, but from now on this is the only thread.
+      // The other threads are now stopped, unless they are waiting
+      // for us to share out the weak pointers (weak_par).  We might
+      // recurse back to here, but from now on this is the only thread
+      // that looks at anything but the weak pointers.
 
       // must be last...  invariant is that everything is fully
       // scavenged at this point.
       if (traverseWeakPtrList(&dead_weak_ptr_list, &resurrected_threads)) { // returns true if evaced something
-          inc_running();
+          if (weak_par) {
+              runWeakJob(WeakJobScavenge);
+          } else {
+              inc_running();
+          }
           continue;
       }
 
@@ -438,6 +519,10 @@ GarbageCollect (uint32_t collect_gen,
       break;
   }
 
+  if (weak_par) {
+      runWeakJob(WeakJobDone);
+  }
+
   shutdown_gc_threads(gct->thread_index, idle_cap);
 
   // Now see which stable names are still alive.
@@ -470,7 +555,8 @@ GarbageCollect (uint32_t collect_gen,
 
   // NO MORE EVACUATION AFTER THIS POINT!
 
-  // Finally: compact or sweep the oldest generation.
+  // Finally: compact or sweep the oldest generation.  sweep() only
+  // gets it ready to be swept later; see Note [Lazy sweeping] in Sweep.c.
   if (major_gc && oldest_gen->mark) {
       if (oldest_gen->compact)
           compact(gct->scavenged_static_objects,
@@ -493,10 +579,33 @@ GarbageCollect (uint32_t collect_gen,
   {
       uint32_t i;
       uint64_t par_balanced_copied_acc = 0;
+      uint64_t par_scanned = 0, par_balanced_scanned_acc = 0;
       const gc_thread* thread;
 
       for (i=0; i < n_gc_threads; i++) {
           copied += gc_threads[i]->copied;
+          par_scanned += gc_threads[i]->scanned;
+          gc_selectors_eliminated += gc_threads[i]->selectors_eliminated;
+          gc_selectors_left += gc_threads[i]->selectors_left;
+          gc_inds_removed += gc_threads[i]->inds_removed;
+      }
+      if (RtsFlags.GcFlags.cardTable) {
+          for (i=0; i < n_gc_threads; i++) {
+              gc_mut_list_time += gc_threads[i]->mut_list_time;
+              gc_card_scan_time += gc_threads[i]->card_scan_time;
+          }
+      }
+      for (i=0; i < n_gc_threads; i++) {
+          gc_static_time += gc_threads[i]->static_time;
+      }
+      if (RtsFlags.GcFlags.numa) {
+          for (i=0; i < n_gc_threads; i++) {
+              thread = gc_threads[i];
+              gc_remote_copied_words += thread->remote_copied;
+              for (n = 0; n < n_numa_nodes; n++) {
+                  gc_to_blocks_by_node[n] += thread->to_blocks[n];
+              }
+          }
       }
       for (i=0; i < n_gc_threads; i++) {
           thread = gc_threads[i];
@@ -506,6 +615,10 @@ GarbageCollect (uint32_t collect_gen,
                          thread->copied * sizeof(W_));
               debugTrace(DEBUG_gc,"   scanned          %ld",
                          thread->scanned * sizeof(W_));
+              debugTrace(DEBUG_gc,"   split_arrays     %ld",
+                         thread->split_arrays);
+              debugTrace(DEBUG_gc,"   stolen_ranges    %ld",
+                         thread->stolen_ranges);
               debugTrace(DEBUG_gc,"   any_work         %ld",
                          thread->any_work);
               debugTrace(DEBUG_gc,"   no_work          %ld",
@@ -527,6 +640,10 @@ GarbageCollect (uint32_t collect_gen,
               par_max_copied = stg_max(gc_threads[i]->copied, par_max_copied);
               par_balanced_copied_acc +=
                   stg_min(n_gc_threads * gc_threads[i]->copied, copied);
+              par_balanced_scanned_acc +=
+                  stg_min(n_gc_threads * gc_threads[i]->scanned, par_scanned);
+              gc_split_arrays += thread->split_arrays;
+              gc_stolen_ranges += thread->stolen_ranges;
           }
       }
       if (n_gc_threads > 1) {
@@ -534,6 +651,11 @@ GarbageCollect (uint32_t collect_gen,
           par_balanced_copied =
               (par_balanced_copied_acc - copied + (n_gc_threads - 1) / 2) /
               (n_gc_threads - 1);
+          // the same measure, for the words each thread scavenged
+          gc_par_scanned_words += par_scanned;
+          gc_par_balanced_scanned_words +=
+              (par_balanced_scanned_acc - par_scanned
+               + (n_gc_threads - 1) / 2) / (n_gc_threads - 1);
       }
   }
 
@@ -648,6 +770,7 @@ GarbageCollect (uint32_t collect_gen,
         gen->n_large_blocks = gen->n_scavenged_large_blocks;
         gen->n_large_words  = countOccupied(gen->large_objects);
         gen->n_new_large_words = 0;
+        gen->n_pinned_free_words = reusePinnedBlocks(gen->large_objects);
 
         /* COMPACT_NFDATA. The currently live compacts are chained
          * to live_compact_objects, quite like large objects. And
@@ -672,6 +795,8 @@ GarbageCollect (uint32_t collect_gen,
          * scavenged_large_object list (i.e. large objects that have been
          * promoted during this GC) to the large_object list for that step.
          */
+        gen->n_pinned_free_words +=
+            reusePinnedBlocks(gen->scavenged_large_objects);
         for (bd = gen->scavenged_large_objects; bd; bd = next) {
             next = bd->link;
             dbl_link_onto(bd, &gen->large_objects);
@@ -724,10 +849,10 @@ GarbageCollect (uint32_t collect_gen,
       freeChain(mark_stack_top_bd);
   }
 
-  // Free any bitmaps.
+  // Free any bitmaps, except one that is still needed for sweeping.
   for (g = 0; g <= N; g++) {
       gen = &generations[g];
-      if (gen->bitmap != NULL) {
+      if (gen->bitmap != NULL && gen->n_unswept_blocks == 0) {
           freeGroup(gen->bitmap);
           gen->bitmap = NULL;
       }
@@ -739,7 +864,7 @@ GarbageCollect (uint32_t collect_gen,
 
  // mark the garbage collected CAFs as dead
 #if defined(DEBUG)
-  if (major_gc) { gcCAFs(); }
+  if (major_gc && !static_roots_cached) { gcCAFs(); }
 #endif
 
   // Update the stable name hash table
@@ -755,6 +880,25 @@ GarbageCollect (uint32_t collect_gen,
       checkUnload (gct->scavenged_static_objects);
   }
 
+  // Remember the CAFs that this GC found alive, if it walked the static
+  // objects; see Note [Static root cache] in StaticRoots.c
+  if (major_gc && !static_roots_cached &&
+      RtsFlags.GcFlags.staticRootsInterval > 1) {
+      resetStaticRoots();
+      if (n_gc_threads == 1) {
+          addStaticRoots(gct->scavenged_static_objects);
+      } else {
+          // the lists of the idle GC threads are left over from an
+          // earlier GC
+          for (n = 0; n < n_gc_threads; n++) {
+              if (n == gct->thread_index || !idle_cap[n]) {
+                  addStaticRoots(gc_threads[n]->scavenged_static_objects);
+              }
+          }
+      }
+  }
+  static_roots_cached = false;
+
 #if defined(PROFILING)
   // resetStaticObjectForRetainerProfiling() must be called before
   // zeroing below.
@@ -833,15 +977,29 @@ GarbageCollect (uint32_t collect_gen,
           need = stg_min(RtsFlags.GcFlags.maxHeapSize, need);
       }
 
+      /* And with +RTS --decommit-target, give back anything above the
+       * target.  See Note [Background decommit] in Decommit.c.
+       */
+      if (RtsFlags.GcFlags.decommitTarget != 0) {
+          need = stg_min(RtsFlags.GcFlags.decommitTarget, need);
+      }
+
       need = BLOCKS_TO_MBLOCKS(need);
 
       got = mblocks_allocated;
 
-      if (got > need) {
-          returnMemoryToOS(got - need);
-      }
+      scheduleReturnMemoryToOS(got > need ? got - need : 0);
   }
 
+  // The card blocks filled by this GC are scanned from the next one on.
+  commitCardBlocks();
+
+  // Decide which constructors to pretenure in the next GC.
+  pretenureEndGC();
+
+  // Let the concurrent marker carry on, or start it on a new mark.
+  nonMovingEndGC();
+
   // extra GC trace info
   IF_DEBUG(gc, statDescribeGens());
 
@@ -869,6 +1027,9 @@ GarbageCollect (uint32_t collect_gen,
              gc_spin_spin, gc_spin_yield, mut_spin_spin, mut_spin_yield,
              any_work, no_work, scav_find_work);
 
+  // The sweeper thread may carry on now.
+  wakeSweepThread();
+
 #if defined(RTS_USER_SIGNALS)
   if (RtsFlags.MiscFlags.install_signal_handlers) {
     // unblock signals again
@@ -914,8 +1075,22 @@ new_gc_thread (uint32_t n, gc_thread *t)
 #endif
 
     t->thread_index = n;
+    t->node = capNoToNumaNode(n);
     t->free_blocks = NULL;
     t->gc_count = 0;
+    t->range_q = newWSDeque(SCAV_RANGE_POOL);
+    t->ranges = stgMallocBytes(SCAV_RANGE_POOL * sizeof(scav_range),
+                               "new_gc_thread");
+    if (RtsFlags.GcFlags.cardTable) {
+        t->card_bds = stgCallocBytes(RtsFlags.GcFlags.generations,
+                                     sizeof(bdescr*), "new_gc_thread");
+    } else {
+        t->card_bds = NULL;
+    }
+    t->pretenure_counts = pretenuring ? allocHashTable() : NULL;
+    t->sel_stack = NULL;
+    t->sel_sp = 0;
+    t->sel_size = 0;
 
     init_gc_thread(t);
 
@@ -954,6 +1129,13 @@ new_gc_thread (uint32_t n, gc_thread *t)
         ws->scavd_list = NULL;
         ws->n_scavd_blocks = 0;
         ws->n_scavd_words = 0;
+
+        if (RtsFlags.GcFlags.numa) {
+            ws->node_bds = stgCallocBytes(n_numa_nodes, sizeof(bdescr*),
+                                          "new_gc_thread");
+        } else {
+            ws->node_bds = NULL;
+        }
     }
 }
 
@@ -999,6 +1181,20 @@ freeGcThreads (void)
             for (g = 0; g < RtsFlags.GcFlags.generations; g++)
             {
                 freeWSDeque(gc_threads[i]->gens[g].todo_q);
+                if (gc_threads[i]->gens[g].node_bds != NULL) {
+                    stgFree(gc_threads[i]->gens[g].node_bds);
+                }
+            }
+            freeWSDeque(gc_threads[i]->range_q);
+            stgFree(gc_threads[i]->ranges);
+            if (gc_threads[i]->card_bds != NULL) {
+                stgFree(gc_threads[i]->card_bds);
+            }
+            if (gc_threads[i]->pretenure_counts != NULL) {
+                freeHashTable(gc_threads[i]->pretenure_counts, stgFree);
+            }
+            if (gc_threads[i]->sel_stack != NULL) {
+                stgFree(gc_threads[i]->sel_stack);
             }
             stgFree (gc_threads[i]);
         }
@@ -1007,6 +1203,20 @@ freeGcThreads (void)
         for (g = 0; g < RtsFlags.GcFlags.generations; g++)
         {
             freeWSDeque(gc_threads[0]->gens[g].todo_q);
+            if (gc_threads[0]->gens[g].node_bds != NULL) {
+                stgFree(gc_threads[0]->gens[g].node_bds);
+            }
+        }
+        freeWSDeque(gc_threads[0]->range_q);
+        stgFree(gc_threads[0]->ranges);
+        if (gc_threads[0]->card_bds != NULL) {
+            stgFree(gc_threads[0]->card_bds);
+        }
+        if (gc_threads[0]->pretenure_counts != NULL) {
+            freeHashTable(gc_threads[0]->pretenure_counts, stgFree);
+        }
+        if (gc_threads[0]->sel_stack != NULL) {
+            stgFree(gc_threads[0]->sel_stack);
         }
         stgFree (gc_threads);
 #endif
@@ -1067,6 +1277,7 @@ any_work (void)
         // look for work to steal
         for (n = 0; n < n_gc_threads; n++) {
             if (n == gct->thread_index) continue;
+            if (!looksEmptyWSDeque(gc_threads[n]->range_q)) return true;
             for (g = RtsFlags.GcFlags.generations-1; g >= 0; g--) {
                 ws = &gc_threads[n]->gens[g];
                 if (!looksEmptyWSDeque(ws->todo_q)) return true;
@@ -1132,7 +1343,81 @@ loop:
     traceEventGcDone(gct->cap);
 }
 
+/* ----------------------------------------------------------------------------
+   Sharing out the weak pointers; see Note [Parallel weak pointers] in
+   MarkWeak.c
+   ------------------------------------------------------------------------- */
+
 #if defined(THREADED_RTS)
+// The current job, and a count that the leader bumps for each new one
+static volatile StgWord weak_job;
+static volatile StgWord weak_job_seq;
+
+// Workers that have finished the current job
+static volatile StgWord weak_job_idle;
+
+// Workers taking part in this GC, counted by wakeup_gc_threads()
+static uint32_t n_gc_workers;
+#endif
+
+void
+runWeakJob (WeakJob job USED_IF_THREADS)
+{
+#if defined(THREADED_RTS)
+    // The workers must have finished the last job, and so have left
+    // scavenge_until_all_done(), before we touch gc_running_threads.
+    while (weak_job_idle != n_gc_workers) {
+        busy_wait_nop();
+    }
+    weak_job_idle = 0;
+    weak_job = job;
+    if (job == WeakJobScavenge) {
+        gc_running_threads = n_gc_workers + 1;
+    }
+    write_barrier();
+    weak_job_seq++;
+
+    if (job == WeakJobTidy || job == WeakJobCollect) {
+        doWeakJob(job);
+        while (weak_job_idle != n_gc_workers) {
+            busy_wait_nop();
+        }
+    }
+#else
+    barf("runWeakJob");
+#endif
+}
+
+#if defined(THREADED_RTS)
+
+static void
+gcWorkerWeakJobs (void)
+{
+    StgWord seq = 0;
+
+    for (;;) {
+        atomic_inc(&weak_job_idle, 1);
+        while (weak_job_seq == seq) {
+            busy_wait_nop();
+        }
+        seq = weak_job_seq;
+        load_load_barrier();
+
+        switch (weak_job) {
+        case WeakJobTidy:
+        case WeakJobCollect:
+            doWeakJob(weak_job);
+            break;
+        case WeakJobScavenge:
+            scavenge_until_all_done();
+            break;
+        case WeakJobDone:
+            return;
+        default:
+            barf("gcWorkerWeakJobs: %" FMT_Word, weak_job);
+        }
+    }
+}
 
 void
 gcWorkerThread (Capability *cap)
@@ -1164,9 +1449,15 @@ gcWorkerThread (Capability *cap)
     gct->evac_gen_no = 0;
     markCapability(mark_root, gct, cap, true/*prune sparks*/);
     scavenge_capability_mut_lists(cap);
+    scavenge_card_blocks();
 
     scavenge_until_all_done();
 
+    // Stay to help with the weak pointers, if there are enough of them
+    if (weak_par) {
+        gcWorkerWeakJobs();
+    }
+
 #if defined(THREADED_RTS)
     // Now that the whole heap is marked, we discard any sparks that
     // were found to be unreachable.  The main GC thread is currently
@@ -1257,6 +1548,9 @@ start_gc_threads (void)
 {
 #if defined(THREADED_RTS)
     gc_running_threads = 0;
+    weak_job_seq = 0;
+    weak_job_idle = 0;
+    n_gc_workers = 0;
 #endif
 }
 
@@ -1272,6 +1566,7 @@ wakeup_gc_threads (uint32_t me USED_IF_THREADS,
     for (i=0; i < n_gc_threads; i++) {
         if (i == me || idle_cap[i]) continue;
         inc_running();
+        n_gc_workers++;
         debugTrace(DEBUG_gc, "waking up gc thread %d", i);
         if (gc_threads[i]->wakeup != GC_THREAD_STANDING_BY)
             barf("wakeup_gc_threads");
@@ -1341,6 +1636,9 @@ prepare_collected_gen (generation *gen)
     g = gen->no;
     if (g != 0) {
         for (i = 0; i < n_capabilities; i++) {
+            if (nonmoving_marking && gen == oldest_gen) {
+                nonMovingRecordMutList(capabilities[i]->mut_lists[g]);
+            }
             freeChain(capabilities[i]->mut_lists[g]);
             capabilities[i]->mut_lists[g] =
                 allocBlockOnNode(capNoToNumaNode(i));
@@ -1402,9 +1700,17 @@ prepare_collected_gen (generation *gen)
         bd->flags &= ~BF_EVACUATED;
     }
 
-    // mark the large objects as from-space
+    // the card blocks go with the rest of the generation
+    resetCardBlocks(gen);
+
+    // mark the large objects as from-space, and forget which slots of
+    // the pinned size-class blocks are occupied: evacuate() marks the
+    // live ones again.
     for (bd = gen->large_objects; bd; bd = bd->link) {
         bd->flags &= ~BF_EVACUATED;
+        if (bd->flags & BF_SLOTTED) {
+            clearPinnedSlots(bd);
+        }
     }
 
     // mark the compact objects as from-space
@@ -1435,6 +1741,10 @@ prepare_collected_gen (generation *gen)
             // For each block in this step, point to its bitmap from the
             // block descriptor.
             for (bd=gen->old_blocks; bd != NULL; bd = bd->link) {
+                // start from the marks made by the concurrent marker
+                if (nonmoving_marking && gen == oldest_gen) {
+                    nonMovingCopyMarks(bd, bitmap);
+                }
                 bd->u.bitmap = bitmap;
                 bitmap += BLOCK_SIZE_W / BITS_IN(W_);
 
@@ -1442,14 +1752,20 @@ prepare_collected_gen (generation *gen)
                 // for this block.  The invariant is that
                 // BF_MARKED is always unset, except during GC
                 // when it is set on those blocks which will be
-                // compacted.
-                if (!(bd->flags & BF_FRAGMENTED)) {
+                // compacted.  With +RTS -xn objects are never moved,
+                // so fragmented blocks are marked too.
+                if (!(bd->flags & BF_FRAGMENTED) ||
+                    RtsFlags.GcFlags.concurrentMark) {
                     bd->flags |= BF_MARKED;
                 }
 
                 // BF_SWEPT should be marked only for blocks that are being
                 // collected in sweep()
                 bd->flags &= ~BF_SWEPT;
+
+                // the objects left in card blocks go back to using the
+                // mutable list; see Note [Card table] in CardTable.c
+                bd->flags &= ~BF_CARDS;
             }
         }
     }
@@ -1486,6 +1802,13 @@ prepare_uncollected_gen (generation *gen)
         stash_mut_list(capabilities[i], gen->no);
     }
 
+    // the concurrent marker has to look at these objects again
+    if (nonmoving_marking && gen == oldest_gen) {
+        for (i = 0; i < n_capabilities; i++) {
+            nonMovingRecordMutList(capabilities[i]->saved_mut_lists[gen->no]);
+        }
+    }
+
     ASSERT(gen->scavenged_large_objects == NULL);
     ASSERT(gen->n_scavenged_large_blocks == 0);
 }
@@ -1516,6 +1839,9 @@ collect_gct_blocks (void)
 
             prev = NULL;
             for (bd = ws->scavd_list; bd != NULL; bd = bd->link) {
+                if (bd->flags & BF_CARDS) {
+                    addCardBlock(ws->gen, bd);
+                }
                 prev = bd;
             }
             if (prev != NULL) {
@@ -1540,15 +1866,31 @@ collect_gct_blocks (void)
    take a global lock.  Here we collect those blocks from the
    cap->pinned_object_blocks lists and put them on the
    main g0->large_object list.
+
+   We also drop the blocks of the generations we are about to collect
+   from the cap->pinned_reuse lists: the GC may free them, and those
+   that survive are handed out again by reusePinnedBlocks() afterwards.
+   See Note [Pinned size classes] in Storage.c.
    -------------------------------------------------------------------------- */
 
 static void
 collect_pinned_object_blocks (void)
 {
-    uint32_t n;
-    bdescr *bd, *prev;
+    uint32_t n, c;
+    bdescr *bd, *prev, **link;
 
     for (n = 0; n < n_capabilities; n++) {
+        for (c = 0; c < PINNED_SIZE_CLASSES; c++) {
+            link = &capabilities[n]->pinned_reuse[c];
+            for (bd = *link; bd != NULL; bd = PINNED_REUSE_LINK(bd)) {
+                if (bd->gen_no > N) {
+                    *link = bd;
+                    link = &PINNED_REUSE_LINK(bd);
+                }
+            }
+            *link = NULL;
+        }
+
         prev = NULL;
         for (bd = capabilities[n]->pinned_object_blocks; bd != NULL; bd = bd->link) {
             prev = bd;
@@ -1580,10 +1922,21 @@ init_gc_thread (gc_thread *t)
     t->eager_promotion = true;
     t->thunk_selector_depth = 0;
     t->copied = 0;
+    t->remote_copied = 0;
+    memset(t->to_blocks, 0, sizeof(t->to_blocks));
     t->scanned = 0;
+    t->split_arrays = 0;
+    t->stolen_ranges = 0;
+    t->selectors_eliminated = 0;
+    t->selectors_left = 0;
+    t->inds_removed = 0;
+    t->n_ranges = 0;
     t->any_work = 0;
     t->no_work = 0;
     t->scav_find_work = 0;
+    t->mut_list_time = 0;
+    t->card_scan_time = 0;
+    t->static_time = 0;
 }
 
 /* -----------------------------------------------------------------------------
@@ -1657,10 +2010,12 @@ resize_generations (void)
 
         // Auto-enable compaction when the residency reaches a
         // certain percentage of the maximum heap size (default: 30%).
-        if (RtsFlags.GcFlags.compact ||
-            (max > 0 &&
-             oldest_gen->n_blocks >
-             (RtsFlags.GcFlags.compactThreshold * max) / 100)) {
+        // Not with +RTS -xn, which must never move old objects.
+        if (!RtsFlags.GcFlags.concurrentMark &&
+            (RtsFlags.GcFlags.compact ||
+             (max > 0 &&
+              oldest_gen->n_blocks >
+              (RtsFlags.GcFlags.compactThreshold * max) / 100))) {
             oldest_gen->mark = 1;
             oldest_gen->compact = 1;
 //        debugBelch("compaction: on\n", live);
@@ -1711,6 +2066,11 @@ resize_generations (void)
             generations[g].max_blocks = size;
         }
     }
+
+    // See Note [GC pause target] in Pacing.c
+    if (pacing) {
+        pacerResizeGenerations(copied);
+    }
 }
 
 /* -----------------------------------------------------------------------------
@@ -1820,8 +2180,17 @@ resize_nursery (void)
                 blocks = min_nursery;
             }
 
+            if (pacing) {
+                blocks = stg_min(blocks, (long)pacerNurseryBlocks(copied));
+            }
+
             resizeNurseries((W_)blocks);
         }
+        else if (pacing)
+        {
+            // See Note [GC pause target] in Pacing.c
+            resizeNurseries(pacerNurseryBlocks(copied));
+        }
         else
         {
             // we might have added extra blocks to the nursery, so
@@ -1829,6 +2198,12 @@ resize_nursery (void)
             resizeNurseriesFixed();
         }
     }
+
+    // Share out the chunks of the nursery as it is now.  See Note
+    // [Adaptive nursery sizing] in Storage.c.
+    if (RtsFlags.GcFlags.minAllocAreaSizeAuto) {
+        updateNurseryQuotas();
+    }
 }
 
 /* -----------------------------------------------------------------------------
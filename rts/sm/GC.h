@@ -37,6 +37,23 @@ extern StgPtr mark_sp;
 
 extern bool work_stealing;
 
+extern W_ gc_to_blocks_by_node[MAX_NUMA_NODES];
+extern W_ gc_remote_copied_words;
+
+extern W_ gc_par_scanned_words;
+extern W_ gc_par_balanced_scanned_words;
+extern W_ gc_split_arrays;
+extern W_ gc_stolen_ranges;
+
+extern W_ gc_selectors_eliminated;
+extern W_ gc_selectors_left;
+extern W_ gc_inds_removed;
+
+extern Time gc_mut_list_time;
+extern Time gc_card_scan_time;
+
+extern Time gc_static_time;
+
 #if defined(DEBUG)
 extern uint32_t mutlist_MUTVARS, mutlist_MUTARRS, mutlist_MVARS, mutlist_OTHERS,
     mutlist_TVAR,
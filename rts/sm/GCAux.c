@@ -13,6 +13,7 @@
 #include "GC.h"
 #include "Storage.h"
 #include "Compact.h"
+#include "StaticRoots.h"
 #include "Task.h"
 #include "Capability.h"
 #include "Trace.h"
@@ -62,6 +63,10 @@ isAlive(StgClosure *p)
 
     // if it's a pointer into to-space, then we're done
     if (bd->flags & BF_EVACUATED) {
+        // the caller keeps a pointer to it, so keep its pinned slot too
+        if (bd->flags & BF_SLOTTED) {
+            markPinnedSlot(bd, (P_)q);
+        }
         return p;
     }
 
@@ -153,4 +158,7 @@ markCAFs (evac_fn evac, void *user)
         c = (StgIndStatic *)UNTAG_STATIC_LIST_PTR(c);
         evac(user, &c->indirectee);
     }
+    if (static_roots_cached) {
+        markStaticRoots(evac, user);
+    }
 }
@@ -14,6 +14,7 @@
 #pragma once
 
 #include "WSDeque.h"
+#include "Hash.h"
 #include "GetTime.h" // for Ticks
 
 #include "BeginPrivate.h"
@@ -101,11 +102,15 @@ typedef struct gen_workspace_ {
     StgWord      n_part_blocks;      // count of above
     StgWord      n_part_words;
 
-    StgWord pad[1];
+    // With NUMA, the to-space blocks on other nodes that we copy
+    // objects from those nodes into, indexed by node; NULL otherwise.
+    // See Note [NUMA-affine evacuation] in GCUtils.c.
+    bdescr **    node_bds;
 
 } gen_workspace ATTRIBUTE_ALIGNED(64);
 // align so that computing gct->gens[n] is a shift, not a multiply
-// fails if the size is <64, which is why we need the pad above
+// fails if the size is <64, so keep an eye on the size when adding or
+// removing fields (node_bds used to be a pad word)
 
 /* ----------------------------------------------------------------------------
    GC thread object
@@ -116,6 +121,42 @@ typedef struct gen_workspace_ {
    of the GC threads
    ------------------------------------------------------------------------- */
 
+/* A range of cards of a large MUT_ARR_PTRS that any GC thread may
+   scavenge; see Note [Splitting large arrays] in Scav.c */
+typedef struct scav_range_ {
+    StgMutArrPtrs *arr;
+    W_             from;          // first card
+    W_             to;            // one past the last card
+    uint32_t       gen_no;        // generation the array lives in
+    bool           frozen;        // a MUT_ARR_PTRS_FROZEN array
+    bool           marked;        // only the marked cards, for an array
+                                  // on the mutable list
+} scav_range;
+
+/* A THUNK_SELECTOR that eval_thunk_selector() is part way through, while
+   it evaluates the selectee; see Note [Eager selector evaluation] in
+   Evac.c */
+typedef struct sel_frame_ {
+    StgClosure **  q;
+    StgSelector *  p;
+    StgSelector *  prev;          // the chain to update with its value
+    bdescr *       bd;
+    StgClosure *   selectee;
+    StgWord        info_ptr;      // its real info pointer
+    uint32_t       field;
+    bool           evac;
+} sel_frame;
+
+// Arrays with more cards than this are split into ranges.
+#define SCAV_RANGE_MIN_CARDS  64
+
+// Ranges are split until they are no larger than this.
+#define SCAV_RANGE_CARDS      32
+
+// Number of ranges each GC thread can hand out in one GC; once they are
+// used up the thread scavenges the rest of its ranges itself.
+#define SCAV_RANGE_POOL       1024
+
 /* values for the wakeup field */
 #define GC_THREAD_INACTIVE             0
 #define GC_THREAD_STANDING_BY          1
@@ -132,6 +173,7 @@ typedef struct gc_thread_ {
     volatile StgWord wakeup;       // NB not StgWord8; only StgWord is guaranteed atomic
 #endif
     uint32_t thread_index;         // a zero based index identifying the thread
+    uint32_t node;                 // the NUMA node of this thread's cap
 
     bdescr * free_blocks;          // a buffer of free blocks for this thread
                                    //  during GC without accessing the block
@@ -156,6 +198,22 @@ typedef struct gc_thread_ {
     // during GC; see recordMutableGen_GC().
     bdescr **    mut_lists;
 
+    // Ranges of large arrays that other threads can steal, and the pool
+    // they are allocated from (reset at the start of each GC).
+    WSDeque *    range_q;
+    scav_range * ranges;
+    uint32_t     n_ranges;
+
+    // With +RTS --card-table, the block that this thread copies the
+    // MUT_VARs, MVARs and TVARs of each generation into, indexed by
+    // generation; NULL otherwise.  See Note [Card table] in CardTable.c.
+    bdescr **    card_bds;
+
+    // With +RTS --pretenure, the PretenureCounts of this thread, keyed
+    // by info pointer; NULL otherwise.  See Note [Pretenuring] in
+    // Pretenure.c.
+    HashTable *  pretenure_counts;
+
     // --------------------
     // evacuate flags
 
@@ -178,15 +236,33 @@ typedef struct gc_thread_ {
     W_ thunk_selector_depth;       // used to avoid unbounded recursion in
                                    // evacuate() for THUNK_SELECTOR
 
+    // With +RTS --eager-selectors, the selectors being evaluated beyond
+    // that depth
+    sel_frame * sel_stack;
+    uint32_t    sel_sp;
+    uint32_t    sel_size;
+
     // -------------------
     // stats
 
     W_ copied;
+    W_ remote_copied;              // words copied into another node's
+                                   // to-space, see alloc_for_copy_on_node
+    W_ to_blocks[MAX_NUMA_NODES];  // to-space blocks started, by node
     W_ scanned;
+    W_ split_arrays;               // arrays split into ranges
+    W_ stolen_ranges;              // ranges taken from other threads
+    W_ selectors_eliminated;       // THUNK_SELECTORs replaced by their value
+    W_ selectors_left;             // ... and copied unevaluated
+    W_ inds_removed;               // indirections short-cut by evacuate()
     W_ any_work;
     W_ no_work;
     W_ scav_find_work;
 
+    Time mut_list_time;            // elapsed time scavenging mutable lists
+    Time card_scan_time;           // ... and scanning card blocks
+    Time static_time;              // ... and static objects and CAFs
+
     Time gc_start_cpu;   // process CPU time
     Time gc_sync_start_elapsed;  // start of GC sync
     Time gc_start_elapsed;  // process elapsed time
@@ -20,12 +20,15 @@
 #include "GCThread.h"
 #include "GCTDecl.h"
 #include "GCUtils.h"
+#include "Sweep.h"
 #include "Printer.h"
 #include "Trace.h"
 #if defined(THREADED_RTS)
 #include "WSDeque.h"
 #endif
 
+#include <string.h> // for memset()
+
 #if defined(THREADED_RTS)
 SpinLock gc_alloc_block_sync;
 #endif
@@ -117,6 +120,54 @@ grab_local_todo_block (gen_workspace *ws)
     return NULL;
 }
 
+// Take one of this workspace's blocks on other NUMA nodes, so that it
+// can be scavenged.  We only do this when there is no other work, since
+// once a node block has been handed over we need a new one for the next
+// object copied to that node.
+bdescr *
+grab_node_todo_block (gen_workspace *ws)
+{
+    bdescr *bd;
+    uint32_t n;
+
+    if (ws->node_bds == NULL) {
+        return NULL;
+    }
+
+    for (n = 0; n < n_numa_nodes; n++) {
+        bd = ws->node_bds[n];
+        if (bd != NULL) {
+            ws->node_bds[n] = NULL;
+            ASSERT(bd->link == NULL);
+            ASSERT(bd->u.scan < bd->free);
+            return bd;
+        }
+    }
+    return NULL;
+}
+
+#if defined(BLOCK_CARDS)
+// Likewise for the card block of this workspace's generation; see Note
+// [Card table] in CardTable.c.
+bdescr *
+grab_card_todo_block (gen_workspace *ws)
+{
+    bdescr *bd;
+
+    if (gct->card_bds == NULL) {
+        return NULL;
+    }
+
+    bd = gct->card_bds[ws->gen->no];
+    if (bd != NULL) {
+        gct->card_bds[ws->gen->no] = NULL;
+        ASSERT(bd->link == NULL);
+        ASSERT(bd->u.scan < bd->free);
+    }
+    return bd;
+}
+#endif
+
 #if defined(THREADED_RTS)
 bdescr *
 steal_todo_block (uint32_t g)
@@ -134,6 +185,23 @@ steal_todo_block (uint32_t g)
     }
     return NULL;
 }
+
+scav_range *
+steal_scav_range (void)
+{
+    uint32_t n;
+    scav_range *r;
+
+    for (n = 0; n < n_gc_threads; n++) {
+        if (n == gct->thread_index) continue;
+        r = stealWSDeque(gc_threads[n]->range_q);
+        if (r) {
+            gct->stolen_ranges++;
+            return r;
+        }
+    }
+    return NULL;
+}
 #endif
 
 void
@@ -144,11 +212,13 @@ push_scanned_block (bdescr *bd, gen_workspace *ws)
     ASSERT(bd->gen == ws->gen);
     ASSERT(bd->u.scan == bd->free);
 
-    if (bd->blocks == 1 &&
+    if (bd->blocks == 1 && !(bd->flags & BF_CARDS) &&
         bd->start + BLOCK_SIZE_W - bd->free > WORK_UNIT_WORDS)
     {
         // A partially full block: put it on the part_list list.
-        // Only for single objects - see Note [big objects]
+        // Only for single objects - see Note [big objects].  Card
+        // blocks must only get MUT_VARs, MVARs and TVARs, so they
+        // don't go on it.
         bd->link = ws->part_list;
         ws->part_list = bd;
         ws->n_part_blocks += bd->blocks;
@@ -326,6 +396,14 @@ alloc_todo_block (gen_workspace *ws, uint32_t size)
                 bd = gct->free_blocks;
                 gct->free_blocks = bd->link;
             } else {
+                // Sweep some of the oldest generation first, so that we
+                // can reuse the blocks it frees.  See Note [Lazy
+                // sweeping] in Sweep.c.
+                if (oldest_gen->n_unswept_blocks > 0) {
+                    ACQUIRE_SPIN_LOCK(&gc_alloc_block_sync);
+                    sweepSome(16);
+                    RELEASE_SPIN_LOCK(&gc_alloc_block_sync);
+                }
                 allocBlocks_sync(16, &bd);
                 gct->free_blocks = bd->link;
             }
@@ -334,6 +412,7 @@ alloc_todo_block (gen_workspace *ws, uint32_t size)
         bd->flags = BF_EVACUATED;
         bd->u.scan = bd->start;
         initBdescr(bd, ws->gen, ws->gen->to);
+        gct->to_blocks[bd->node] += bd->blocks;
     }
 
     bd->link = NULL;
@@ -349,3 +428,121 @@ alloc_todo_block (gen_workspace *ws, uint32_t size)
 
     return ws->todo_free;
 }
+
+/* Note [NUMA-affine evacuation]
+   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+   With +RTS --numa each capability, and the GC thread that runs on
+   it, is bound to a NUMA node, and its nursery is allocated on that
+   node.  A GC thread normally copies every object it evacuates into its
+   own todo block, which is on its own node.  In a parallel GC the
+   threads steal work from each other freely, so objects that belong to
+   a capability on one node regularly get copied to another node, and
+   long-lived data drifts across sockets.  Every later access to it
+   from its own capability is then a remote memory access.
+
+   So instead, when a GC thread evacuates an object that lives on a
+   different node from the thread, alloc_for_copy() copies it into a
+   to-space block on the object's node.  Each workspace keeps one such
+   block per node in ws->node_bds.  A node block that fills up is pushed
+   onto the workspace's todo queue, like a full todo block, so that any
+   thread can scavenge it.  Node blocks that are only partly full are
+   handed over by scavenge_find_work() once the thread has nothing
+   else to do, so they are always scavenged before the GC finishes.
+
+   Nursery blocks are on the node of the capability that owns them, and
+   older blocks are on the node that their objects were copied to, so
+   objects stay on the node of the capability that allocated them.
+
+   Big objects (see Note [big objects]) still go through the thread's
+   own todo block.
+
+   Counters: gct->to_blocks counts the to-space blocks started on each
+   node, and gct->remote_copied the words copied into another node's
+   to-space; both are reported by +RTS -s when NUMA is enabled.
+*/
+
+StgPtr
+alloc_for_copy_on_node (gen_workspace *ws, uint32_t size, uint32_t node)
+{
+    bdescr *bd;
+    StgPtr p;
+
+    bd = ws->node_bds[node];
+
+    if (bd == NULL || bd->free + size > bd->start + BLOCK_SIZE_W)
+    {
+        if (size > BLOCK_SIZE_W) {
+            // a big object: use the todo block, see Note [big objects]
+            return NULL;
+        }
+
+        if (bd != NULL) {
+            // full: hand it over for scavenging
+            debugTrace(DEBUG_gc, "push node %d todo block %p", node, bd->start);
+            if (!pushWSDeque(ws->todo_q, bd)) {
+                bd->link = ws->todo_overflow;
+                ws->todo_overflow = bd;
+                ws->n_todo_overflow++;
+            }
+        }
+
+        bd = allocBlockOnNode_sync(node);
+        bd->flags = BF_EVACUATED;
+        bd->u.scan = bd->start;
+        bd->link = NULL;
+        initBdescr(bd, ws->gen, ws->gen->to);
+        gct->to_blocks[node]++;
+
+        ws->node_bds[node] = bd;
+    }
+
+    p = bd->free;
+    bd->free += size;
+    gct->copied += size;
+    gct->remote_copied += size;
+    return p;
+}
+
+#if defined(BLOCK_CARDS)
+/* Allocate room in the card block of a generation for a MUT_VAR, MVAR
+   or TVAR; see Note [Card table] in CardTable.c.  The card blocks are
+   handed over for scavenging just like the node blocks above.
+*/
+StgPtr
+alloc_for_copy_card (gen_workspace *ws, uint32_t size)
+{
+    bdescr *bd;
+    StgPtr p;
+
+    bd = gct->card_bds[ws->gen->no];
+
+    if (bd == NULL || bd->free + size > bd->start + BLOCK_SIZE_W)
+    {
+        if (bd != NULL) {
+            // full: hand it over for scavenging
+            debugTrace(DEBUG_gc, "push card todo block %p", bd->start);
+            if (!pushWSDeque(ws->todo_q, bd)) {
+                bd->link = ws->todo_overflow;
+                ws->todo_overflow = bd;
+                ws->n_todo_overflow++;
+            }
+        }
+
+        bd = allocBlockOnNode_sync(gct->node);
+        bd->flags = BF_EVACUATED | BF_CARDS;
+        bd->u.scan = bd->start;
+        bd->link = NULL;
+        initBdescr(bd, ws->gen, ws->gen->to);
+        memset(bd->cards, 0, BLOCK_CARDS);
+        gct->to_blocks[gct->node]++;
+
+        gct->card_bds[ws->gen->no] = bd;
+    }
+
+    p = bd->free;
+    bd->free += size;
+    gct->copied += size;
+    return p;
+}
+#endif
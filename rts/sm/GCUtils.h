@@ -36,10 +36,20 @@ void    freeGroup_sync(bdescr *bd);
 void    push_scanned_block   (bdescr *bd, gen_workspace *ws);
 StgPtr  todo_block_full      (uint32_t size, gen_workspace *ws);
 StgPtr  alloc_todo_block     (gen_workspace *ws, uint32_t size);
+StgPtr  alloc_for_copy_on_node (gen_workspace *ws, uint32_t size,
+                                uint32_t node);
+#if defined(BLOCK_CARDS)
+StgPtr  alloc_for_copy_card  (gen_workspace *ws, uint32_t size);
+#endif
 
 bdescr *grab_local_todo_block  (gen_workspace *ws);
+bdescr *grab_node_todo_block   (gen_workspace *ws);
+#if defined(BLOCK_CARDS)
+bdescr *grab_card_todo_block   (gen_workspace *ws);
+#endif
 #if defined(THREADED_RTS)
 bdescr *steal_todo_block       (uint32_t s);
+scav_range *steal_scav_range   (void);
 #endif
 
 // Returns true if a block is partially full.  This predicate is used to try
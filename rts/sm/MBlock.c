@@ -220,13 +220,64 @@ static void *getCommittedMBlocks(uint32_t n)
     return p;
 }
 
+// Are all the mblocks in [from, to) free, i.e. on the free list or
+// above the high watermark?
+static bool isFreeMBlockRange(W_ from, W_ to)
+{
+    struct free_list *iter = free_list_head;
+    W_ p;
+
+    for (p = from; p < to; p += MBLOCK_SIZE) {
+        if (p >= mblock_high_watermark) {
+            continue;
+        }
+        while (iter != NULL && iter->address + iter->size <= p) {
+            iter = iter->next;
+        }
+        if (iter == NULL || p < iter->address) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// In huge page mode we only give whole huge pages back to the OS, so
+// that we never split one.  A huge page that is still partly in use
+// stays resident; it is decommitted when the rest of it is freed.
+// Must be called before the range is added to the free list.
+// See Note [Huge page backed heap] in posix/OSMem.c.
+static void decommitHugePages(W_ address, W_ size)
+{
+    W_ start, end;
+
+    start = address & ~((W_)HUGE_PAGE_SIZE - 1);
+    if (start < address && !isFreeMBlockRange(start, address)) {
+        start += HUGE_PAGE_SIZE;
+    }
+
+    end = roundUpToAlign(address + size, HUGE_PAGE_SIZE);
+    if (end > address + size &&
+        (end > mblock_address_space.end ||
+         !isFreeMBlockRange(address + size, end))) {
+        end -= HUGE_PAGE_SIZE;
+    }
+
+    if (start < end) {
+        osDecommitMemory((void*)start, end - start);
+    }
+}
+
 static void decommitMBlocks(char *addr, uint32_t n)
 {
     struct free_list *iter, *prev;
     W_ size = MBLOCK_SIZE * (W_)n;
     W_ address = (W_)addr;
 
-    osDecommitMemory(addr, size);
+    if (RtsFlags.GcFlags.hugePages) {
+        decommitHugePages(address, size);
+    } else {
+        osDecommitMemory(addr, size);
+    }
 
     prev = NULL;
     for (iter = free_list_head; iter != NULL; iter = iter->next)
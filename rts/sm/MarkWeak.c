@@ -71,28 +71,96 @@
 
    -------------------------------------------------------------------------- */
 
+/* Note [Parallel weak pointers]
+   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+   A program with millions of weak pointers (every ForeignPtr with a
+   finalizer has one) spends a long time in tidyWeakList(): it goes
+   over all the weak pointers of the collected generations at least
+   twice, looking at each key, and the leader used to do it on its own
+   while the other GC threads waited.
+
+   So markWeakPtrList() deals the weak pointers of the generations
+   being collected out into WEAK_CHUNKS lists, and when there are at
+   least WEAK_PAR_MIN of them and the GC is parallel (weak_par), the GC
+   threads share the work of each pass over them:
+
+     - The workers don't leave after their first scavenge_until_all_done()
+       but wait in gcWorkerWeakJobs() (GC.c) for the leader to hand out
+       jobs with runWeakJob().
+
+     - For a WeakJobTidy or WeakJobCollect, each thread claims chunks
+       from weak_next_chunk and runs tidyWeakList() or
+       collectDeadWeakList() on them, and the leader waits for the
+       others to finish.  tidyWeakList() collects the live weak
+       pointers in a WeakBatch for each generation they are moving to,
+       and puts the batch on the generation's list under gen->sync.
+
+     - For a WeakJobScavenge, all the threads run
+       scavenge_until_all_done() again, with everything the tidying
+       has evacuated.
+
+     - A WeakJobDone sends the workers on their way.
+
+   The stages and the fixpoint are the same as before, still driven by
+   traverseWeakPtrList() on the leader; it is only the passes over the
+   weak pointers that are shared.  The thread lists are short, and the
+   leader still tidies them on its own.
+
+   isAlive() may now be asked about a key while another thread is
+   evacuating it.  It then says the key is dead, which is harmless: the
+   other thread has found a live weak pointer, so there will be another
+   pass, and the fixpoint is only reached by a pass in which nothing at
+   all is evacuated.
+*/
+
+// The weak pointers of the collected generations that have not been
+// found alive yet, in WEAK_CHUNKS lists.
+#define WEAK_CHUNKS 64
+
+typedef struct {
+    StgWeak *list;
+    StgWeak *dead_tl;           // last of the list, for collectDeadWeakPtrs()
+} WeakChunk;
+
+static WeakChunk weak_chunks[WEAK_CHUNKS];
+
+// The next chunk to claim in doWeakJob()
+static volatile StgWord weak_next_chunk;
+
+// Set by a WeakJobTidy that found a live weak pointer
+static volatile bool weak_alive;
+
+// Share the passes over the weak pointers between the GC threads?
+bool weak_par = false;
+
+// Fewer weak pointers than this are not worth the barriers
+#define WEAK_PAR_MIN 4096
+
+// Live weak pointers on their way to the weak_ptr_list of gen
+typedef struct {
+    generation *gen;
+    StgWeak    *hd, *tl;
+} WeakBatch;
+
 /* Which stage of processing various kinds of weak pointer are we at?
  * (see traverseWeakPtrList() below for discussion).
  */
 typedef enum { WeakPtrs, WeakThreads, WeakDone } WeakStage;
 static WeakStage weak_stage;
 
-static void    collectDeadWeakPtrs (generation *gen, StgWeak **dead_weak_ptr_list);
-static bool tidyWeakList (generation *gen);
+static void    collectDeadWeakPtrs (StgWeak **dead_weak_ptr_list);
+static void    collectDeadWeakList (WeakChunk *c);
+static bool tidyWeakLists (void);
+static bool tidyWeakList (WeakChunk *c);
 static bool resurrectUnreachableThreads (generation *gen, StgTSO **resurrected_threads);
 static void    tidyThreadList (generation *gen);
 
 void
 initWeakForGC(void)
 {
-    uint32_t g;
-
-    for (g = 0; g <= N; g++) {
-        generation *gen = &generations[g];
-        gen->old_weak_ptr_list = gen->weak_ptr_list;
-        gen->weak_ptr_list = NULL;
-    }
-
+    // markWeakPtrList() has already moved the weak pointers of the
+    // collected generations to weak_chunks.
     weak_stage = WeakThreads;
 }
 
@@ -120,10 +188,8 @@ traverseWeakPtrList(StgWeak **dead_weak_ptr_list, StgTSO **resurrected_threads)
 
       // Use weak pointer relationships (value is reachable if
       // key is reachable):
-      for (g = 0; g <= N; g++) {
-          if (tidyWeakList(&generations[g])) {
-              flag = true;
-          }
+      if (tidyWeakLists()) {
+          flag = true;
       }
 
       // if we evacuated anything new, we must scavenge thoroughly
@@ -151,14 +217,10 @@ traverseWeakPtrList(StgWeak **dead_weak_ptr_list, StgTSO **resurrected_threads)
 
   case WeakPtrs:
   {
-      uint32_t g;
-
       // resurrecting threads might have made more weak pointers
       // alive, so traverse those lists again:
-      for (g = 0; g <= N; g++) {
-          if (tidyWeakList(&generations[g])) {
-              flag = true;
-          }
+      if (tidyWeakLists()) {
+          flag = true;
       }
 
       /* If we didn't make any changes, then we can go round and kill all
@@ -166,9 +228,7 @@ traverseWeakPtrList(StgWeak **dead_weak_ptr_list, StgTSO **resurrected_threads)
        * of pending finalizers later on.
        */
       if (flag == false) {
-          for (g = 0; g <= N; g++) {
-              collectDeadWeakPtrs(&generations[g], dead_weak_ptr_list);
-          }
+          collectDeadWeakPtrs(dead_weak_ptr_list);
 
           weak_stage = WeakDone;  // *now* we're done,
       }
@@ -182,19 +242,85 @@ traverseWeakPtrList(StgWeak **dead_weak_ptr_list, StgTSO **resurrected_threads)
   }
 }
 
-static void collectDeadWeakPtrs (generation *gen, StgWeak **dead_weak_ptr_list)
+/* -----------------------------------------------------------------------------
+   Passes over the weak pointers in weak_chunks, shared between the GC
+   threads if weak_par.  See Note [Parallel weak pointers].
+   -------------------------------------------------------------------------- */
+
+void
+doWeakJob (WeakJob job)
+{
+    StgWord i;
+
+    for (;;) {
+        i = atomic_inc(&weak_next_chunk, 1) - 1;
+        if (i >= WEAK_CHUNKS) {
+            break;
+        }
+        switch (job) {
+        case WeakJobTidy:
+            if (tidyWeakList(&weak_chunks[i])) {
+                weak_alive = true;
+            }
+            break;
+        case WeakJobCollect:
+            collectDeadWeakList(&weak_chunks[i]);
+            break;
+        default:
+            barf("doWeakJob: %d", job);
+        }
+    }
+}
+
+static void
+startWeakJob (WeakJob job)
+{
+    weak_next_chunk = 0;
+    if (weak_par) {
+        runWeakJob(job);
+    } else {
+        doWeakJob(job);
+    }
+}
+
+static bool tidyWeakLists (void)
+{
+    weak_alive = false;
+    startWeakJob(WeakJobTidy);
+    return weak_alive;
+}
+
+static void collectDeadWeakPtrs (StgWeak **dead_weak_ptr_list)
+{
+    WeakChunk *c;
+    uint32_t i;
+
+    startWeakJob(WeakJobCollect);
+
+    for (i = 0; i < WEAK_CHUNKS; i++) {
+        c = &weak_chunks[i];
+        if (c->list != NULL) {
+            c->dead_tl->link = *dead_weak_ptr_list;
+            *dead_weak_ptr_list = c->list;
+            c->list = NULL;
+        }
+    }
+}
+
+static void collectDeadWeakList (WeakChunk *c)
 {
-    StgWeak *w, *next_w;
-    for (w = gen->old_weak_ptr_list; w != NULL; w = next_w) {
+    StgWeak *w;
+
+    gct->evac_gen_no = 0;
+    c->dead_tl = NULL;
+    for (w = c->list; w != NULL; w = w->link) {
         // If we have C finalizers, keep the value alive for this GC.
         // See Note [MallocPtr finalizers] in GHC.ForeignPtr, and #10904
         if (w->cfinalizers != &stg_NO_FINALIZER_closure) {
             evacuate(&w->value);
         }
         evacuate(&w->finalizer);
-        next_w = w->link;
-        w->link = *dead_weak_ptr_list;
-        *dead_weak_ptr_list = w;
+        c->dead_tl = w;
     }
 }
 
@@ -225,19 +351,33 @@ static bool resurrectUnreachableThreads (generation *gen, StgTSO **resurrected_t
     return flag;
 }
 
-static bool tidyWeakList(generation *gen)
+static void flushWeakBatch (WeakBatch *b)
+{
+    if (b->hd == NULL) {
+        return;
+    }
+    ACQUIRE_SPIN_LOCK(&b->gen->sync);
+    b->tl->link = b->gen->weak_ptr_list;
+    b->gen->weak_ptr_list = b->hd;
+    RELEASE_SPIN_LOCK(&b->gen->sync);
+    b->hd = NULL;
+    b->tl = NULL;
+}
+
+static bool tidyWeakList(WeakChunk *c)
 {
     StgWeak *w, **last_w, *next_w;
     const StgInfoTable *info;
     StgClosure *new;
+    WeakBatch batch = { NULL, NULL, NULL };
     bool flag = false;
-    last_w = &gen->old_weak_ptr_list;
-    for (w = gen->old_weak_ptr_list; w != NULL; w = next_w) {
+    last_w = &c->list;
+    for (w = c->list; w != NULL; w = next_w) {
 
         info = w->header.info;
-        /* N.B. This function is executed only during the serial part of GC
-         * so consequently there is no potential for data races and therefore
-         * no need for memory barriers.
+        /* N.B. No other thread looks at this chunk, and the weak
+         * pointer itself has already been evacuated, so there is no
+         * need for memory barriers.
          */
 
         /* There might be a DEAD_WEAK on the list if finalizeWeak# was
@@ -279,21 +419,21 @@ static bool tidyWeakList(generation *gen)
                     recordMutableGen_GC((StgClosure *)w, new_gen->no);
                 }
 
-                // remove this weak ptr from the old_weak_ptr list
+                // remove this weak ptr from the chunk
                 *last_w = w->link;
                 next_w  = w->link;
 
                 // and put it on the correct weak ptr list.
-                w->link = new_gen->weak_ptr_list;
-                new_gen->weak_ptr_list = w;
-                flag = true;
-
-                if (gen->no != new_gen->no) {
-                    debugTrace(DEBUG_weak,
-                      "moving weak pointer %p from %d to %d",
-                      w, gen->no, new_gen->no);
+                if (new_gen != batch.gen) {
+                    flushWeakBatch(&batch);
+                    batch.gen = new_gen;
                 }
-
+                w->link = batch.hd;
+                if (batch.hd == NULL) {
+                    batch.tl = w;
+                }
+                batch.hd = w;
+                flag = true;
 
                 debugTrace(DEBUG_weak,
                            "weak pointer still alive at %p -> %p",
@@ -311,6 +451,7 @@ static bool tidyWeakList(generation *gen)
         }
     }
 
+    flushWeakBatch(&batch);
     return flag;
 }
 
@@ -392,21 +533,27 @@ void collectFreshWeakPtrs()
 }
 
 /* -----------------------------------------------------------------------------
-   Evacuate every weak pointer object on the weak_ptr_list, and update
-   the link fields.
+   Evacuate every weak pointer object on the weak_ptr_list of the
+   collected generations, and deal them out to weak_chunks.
    -------------------------------------------------------------------------- */
 
 void
 markWeakPtrList ( void )
 {
     uint32_t g;
+    StgWord n;
+    WeakChunk *c;
+
+    for (n = 0; n < WEAK_CHUNKS; n++) {
+        weak_chunks[n].list = NULL;
+    }
 
+    n = 0;
     for (g = 0; g <= N; g++) {
         generation *gen = &generations[g];
-        StgWeak *w, **last_w;
+        StgWeak *w, *next_w;
 
-        last_w = &gen->weak_ptr_list;
-        for (w = gen->weak_ptr_list; w != NULL; w = w->link) {
+        for (w = gen->weak_ptr_list; w != NULL; w = next_w) {
             // w might be WEAK, EVACUATED, or DEAD_WEAK (actually CON_STATIC) here
 
 #if defined(DEBUG)
@@ -420,11 +567,18 @@ markWeakPtrList ( void )
             }
 #endif
 
-            evacuate((StgClosure **)last_w);
-            w = *last_w;
-            last_w = &(w->link);
+            evacuate((StgClosure **)&w);
+            next_w = w->link;
+
+            c = &weak_chunks[n % WEAK_CHUNKS];
+            w->link = c->list;
+            c->list = w;
+            n++;
         }
+        gen->weak_ptr_list = NULL;
     }
+
+    weak_par = n_gc_threads > 1 && n >= WEAK_PAR_MIN;
 }
 
 /* -----------------------------------------------------------------------------
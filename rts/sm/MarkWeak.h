@@ -23,4 +23,21 @@ bool    traverseWeakPtrList    ( StgWeak **dead_weak_ptr_list, StgTSO **resurrec
 void    markWeakPtrList        ( void );
 void    scavengeLiveWeak       ( StgWeak * );
 
+// Work on the weak pointers that the GC threads share; see Note
+// [Parallel weak pointers] in MarkWeak.c
+typedef enum {
+    WeakJobTidy,                // tidyWeakList()
+    WeakJobCollect,             // collectDeadWeakList()
+    WeakJobScavenge,            // scavenge_until_all_done()
+    WeakJobDone                 // no more jobs in this GC
+} WeakJob;
+
+extern bool weak_par;
+
+void    doWeakJob              ( WeakJob job );
+
+// In GC.c: give all the GC threads a job, and wait for them to finish
+// it (except for a WeakJobScavenge, which the caller joins in).
+void    runWeakJob             ( WeakJob job );
+
 #include "EndPrivate.h"
@@ -0,0 +1,736 @@
+/* -----------------------------------------------------------------------------
+ *
+ * (c) The GHC Team 2019
+ *
+ * Concurrent marking of the oldest generation.
+ *
+ * Documentation on the architecture of the Storage Manager can be
+ * found in the online commentary:
+ *
+ *   https://gitlab.haskell.org/ghc/ghc/wikis/commentary/rts/storage
+ *
+ * ---------------------------------------------------------------------------*/
+
+#include "PosixSource.h"
+#include "Rts.h"
+
+#include "RtsUtils.h"
+#include "Storage.h"
+#include "GC.h"
+#include "GCThread.h"
+#include "Compact.h"
+#include "MarkStack.h"
+#include "NonMoving.h"
+#include "Hash.h"
+#include "Trace.h"
+
+#include <string.h> // for memcpy()
+
+/* Note [Concurrent mark]
+   ~~~~~~~~~~~~~~~~~~~~~~
+
+   With +RTS -w the oldest generation is collected by marking the live
+   objects in place and then sweeping the blocks that have no live
+   objects left (see Sweep.c); objects in the oldest generation are
+   never copied.  With a large heap the marking still takes a long
+   time, all of it with the mutator stopped.  +RTS -xn moves most of
+   that work onto a separate marker thread that runs alongside the
+   mutator.
+
+   The oldest generation is collected in a cycle of three phases:
+
+     1. When the scheduler decides that the oldest generation needs to
+        be collected, it collects the generation below it instead (see
+        nonMovingCollectGen()).  That GC is the "seeding" GC: every
+        object in the oldest generation that evacuate() comes across
+        (i.e. everything referenced by the roots and the younger
+        generations) is marked and put on the mark queue.
+
+     2. After the seeding GC, the marker thread takes objects off the
+        queue and marks everything they point to in the oldest
+        generation, while the mutator runs.  Minor GCs carry on as
+        usual; the marker is paused while they run, since they write
+        to the old objects on the mutable lists.
+
+     3. The first GC after the marker has run out of work (or the next
+        forced major GC) becomes a major GC, the "final" GC.  It starts
+        from the marks the marker made (nonMovingCopyMarks()), so that
+        it only has to trace whatever the marker hasn't seen, and then
+        sweeps the oldest generation as usual.
+
+   The marker only follows pointers to objects in the oldest
+   generation.  Objects in the younger generations are traced by the
+   final GC in the normal way, and so are the things the marker can't
+   safely look at while the mutator runs: thread stacks, PAPs and the
+   like are marked but left for the final GC to scan (the "deferred"
+   list), and large objects and static closures are recorded and
+   evacuated by the final GC.  Small pinned objects are recorded one
+   by one rather than by block, because the final GC only keeps the
+   slots of the pinned objects it evacuates.
+
+   The mutator may change an old object after the marker has scanned
+   it, and the new contents might be the only reference to some other
+   old object.  We don't have a separate write barrier for that:
+   writes to old objects are already recorded on the mutable lists
+   for the generational write barrier, which the code generator
+   inlines for writeMutVar# and friends.  So each GC during the cycle
+   saves the entries on the oldest generation's mutable lists in the
+   "dirty" list (nonMovingRecordMutList()), and the final GC scans
+   those again.  This is the incremental-update scheme of Boehm et
+   al.'s mostly-parallel collector, with the final GC as the
+   stop-the-world phase.  Entries for objects that are still clean
+   can be skipped, because they haven't been written to since the
+   last GC.
+
+   Objects are never moved while a mark is running, so the old
+   generation is not compacted and fragmented blocks are not evacuated
+   with -xn.  Memory is only reclaimed by sweeping whole blocks.
+
+   The marker only ever runs with n_gc_threads == 1: -xn implies -w,
+   and the scheduler never uses the parallel GC for a marking
+   generation.  So the seeding GC calls nonMovingSeed() from a single
+   thread, and the state below needs no locking against the GC,
+   except for mark_mutex between the GC and the marker.
+
+   Anything that became unreachable during the cycle survives it
+   ("floating garbage"): such objects are marked, so the final GC
+   thinks they are live.  They are collected in the next cycle.  The
+   same goes for weak pointers and threads that would otherwise be
+   found dead: they are detected one cycle later.
+
+   Mark bits are kept in a hash table from the block descriptor to a
+   bitmap with one bit per word, like the bitmap that the GC itself
+   uses for a marked block.  The GC's own bitmap lives in bd->u, which
+   the GC also uses for the scan pointer of the blocks it's filling,
+   so we can't keep ours there between GCs.
+*/
+
+bool nonmoving_seeding = false;
+bool nonmoving_marking = false;
+
+#if defined(THREADED_RTS)
+
+/* -----------------------------------------------------------------------------
+   Mark state
+   -------------------------------------------------------------------------- */
+
+typedef struct {
+    StgClosure **entries;
+    W_ n;
+    W_ size;
+} MarkList;
+
+static MarkList mark_queue;     // marked, to be scanned by the marker
+static MarkList deferred;       // marked, to be scanned by the final GC
+static MarkList statics;        // static closures found by the marker
+static MarkList larges;         // large and compact objects found
+static MarkList dirty;          // old objects written during the mark
+
+static HashTable *mark_bitmaps = NULL;  // bdescr -> bitmap
+static HashTable *seen = NULL;          // recorded statics and large objects
+
+#define BITMAP_W (BLOCK_SIZE_W / BITS_IN(W_))
+
+// Bitmaps are allocated this many at a time, and all freed together
+// at the end of the mark.
+#define BITMAPS_PER_CHUNK 256
+
+typedef struct BitmapChunk_ {
+    struct BitmapChunk_ *link;
+    uint32_t used;
+    StgWord bits[];
+} BitmapChunk;
+
+static BitmapChunk *bitmap_chunks = NULL;
+
+static W_ n_marked;             // objects marked in this cycle
+
+static void
+pushMarkList (MarkList *l, StgClosure *p)
+{
+    if (l->n == l->size) {
+        l->size = l->size == 0 ? 1024 : l->size * 2;
+        l->entries = stgReallocBytes(l->entries,
+                                     l->size * sizeof(StgClosure *),
+                                     "pushMarkList");
+    }
+    l->entries[l->n++] = p;
+}
+
+static void
+freeMarkList (MarkList *l)
+{
+    if (l->entries != NULL) {
+        stgFree(l->entries);
+    }
+    l->entries = NULL;
+    l->n = 0;
+    l->size = 0;
+}
+
+static void
+initMarkState (void)
+{
+    mark_bitmaps = allocHashTable();
+    seen = allocHashTable();
+    n_marked = 0;
+}
+
+static void
+freeMarkState (void)
+{
+    BitmapChunk *chunk, *next;
+
+    freeMarkList(&mark_queue);
+    freeMarkList(&deferred);
+    freeMarkList(&statics);
+    freeMarkList(&larges);
+    freeMarkList(&dirty);
+
+    if (mark_bitmaps != NULL) {
+        freeHashTable(mark_bitmaps, NULL);
+        mark_bitmaps = NULL;
+    }
+    if (seen != NULL) {
+        freeHashTable(seen, NULL);
+        seen = NULL;
+    }
+    for (chunk = bitmap_chunks; chunk != NULL; chunk = next) {
+        next = chunk->link;
+        stgFree(chunk);
+    }
+    bitmap_chunks = NULL;
+}
+
+static StgWord *
+newBitmap (void)
+{
+    BitmapChunk *chunk = bitmap_chunks;
+
+    if (chunk == NULL || chunk->used == BITMAPS_PER_CHUNK) {
+        chunk = stgCallocBytes(1, sizeof(BitmapChunk) +
+                               BITMAPS_PER_CHUNK * BITMAP_W * sizeof(W_),
+                               "newBitmap");
+        chunk->link = bitmap_chunks;
+        bitmap_chunks = chunk;
+    }
+    return &chunk->bits[BITMAP_W * chunk->used++];
+}
+
+// Set the mark bit of p, returning true if it was already set.
+static bool
+testAndMark (bdescr *bd, StgPtr p)
+{
+    StgWord *bitmap, *word, mask;
+    W_ offset;
+
+    bitmap = lookupHashTable(mark_bitmaps, (StgWord)bd);
+    if (bitmap == NULL) {
+        bitmap = newBitmap();
+        insertHashTable(mark_bitmaps, (StgWord)bd, bitmap);
+    }
+
+    // small objects never span more than one block
+    offset = p - bd->start;
+    ASSERT(offset < BLOCK_SIZE_W);
+    word = &bitmap[offset / BITS_IN(W_)];
+    mask = (StgWord)1 << (offset & (BITS_IN(W_) - 1));
+    if (*word & mask) {
+        return true;
+    }
+    *word |= mask;
+    return false;
+}
+
+static void
+recordOnce (MarkList *l, StgClosure *p, StgWord key)
+{
+    if (lookupHashTable(seen, key) == NULL) {
+        insertHashTable(seen, key, p);
+        pushMarkList(l, p);
+    }
+}
+
+static void
+markPointer (StgClosure *q)
+{
+    bdescr *bd;
+
+    q = UNTAG_CLOSURE(q);
+
+    if (!HEAP_ALLOCED(q)) {
+        recordOnce(&statics, q, (StgWord)q);
+        return;
+    }
+
+    bd = Bdescr((P_)q);
+    if (bd->gen_no != oldest_gen->no) {
+        // the final GC traces the younger generations anyway
+        return;
+    }
+
+    if (bd->flags & (BF_LARGE | BF_COMPACT)) {
+        // A block of small pinned objects holds many objects, and the
+        // final GC only keeps the slots of the ones it evacuates (see
+        // Note [Pinned size classes] in Storage.c), so record each of
+        // those, not just the block.
+        recordOnce(&larges, q,
+                   (bd->flags & BF_SLOTTED) ? (StgWord)q : (StgWord)bd);
+        return;
+    }
+
+    if (!testAndMark(bd, (P_)q)) {
+        n_marked++;
+        pushMarkList(&mark_queue, q);
+    }
+}
+
+static void
+markSRT (StgClosure *srt)
+{
+    recordOnce(&statics, srt, (StgWord)srt);
+}
+
+/* -----------------------------------------------------------------------------
+   Scan one marked object.
+
+   This runs concurrently with the mutator, so we only look at objects
+   whose pointer fields are either immutable or written with a single
+   store that is recorded on the mutable list.  Thunk updates are fine:
+   the indirectee is written before the info pointer, and doesn't
+   overlap the thunk's payload.
+   -------------------------------------------------------------------------- */
+
+static void
+markObject (StgClosure *p)
+{
+    const StgInfoTable *info;
+    StgPtr q, end;
+
+    info = get_itbl(p);
+
+    switch (info->type) {
+
+    case CONSTR_0_1:
+    case CONSTR_0_2:
+    case ARR_WORDS:
+        return;
+
+    case CONSTR_1_0:
+    case CONSTR_1_1:
+        markPointer(p->payload[0]);
+        return;
+
+    case CONSTR_2_0:
+        markPointer(p->payload[0]);
+        markPointer(p->payload[1]);
+        return;
+
+    case CONSTR:
+    case CONSTR_NOCAF:
+    case WEAK:
+        end = (P_)p->payload + info->layout.payload.ptrs;
+        for (q = (P_)p->payload; q < end; q++) {
+            markPointer((StgClosure *)*q);
+        }
+        return;
+
+    case FUN_0_1:
+    case FUN_0_2:
+    case FUN_1_0:
+    case FUN_1_1:
+    case FUN_2_0:
+    case FUN:
+    {
+        StgFunInfoTable *fun_info = itbl_to_fun_itbl(info);
+        if (fun_info->i.srt) {
+            markSRT((StgClosure *)GET_FUN_SRT(fun_info));
+        }
+        end = (P_)p->payload + info->layout.payload.ptrs;
+        for (q = (P_)p->payload; q < end; q++) {
+            markPointer((StgClosure *)*q);
+        }
+        return;
+    }
+
+    case THUNK_0_1:
+    case THUNK_0_2:
+    case THUNK_1_0:
+    case THUNK_1_1:
+    case THUNK_2_0:
+    case THUNK:
+    {
+        StgThunkInfoTable *thunk_info = itbl_to_thunk_itbl(info);
+        if (thunk_info->i.srt) {
+            markSRT((StgClosure *)GET_SRT(thunk_info));
+        }
+        end = (P_)((StgThunk *)p)->payload + info->layout.payload.ptrs;
+        for (q = (P_)((StgThunk *)p)->payload; q < end; q++) {
+            markPointer((StgClosure *)*q);
+        }
+        return;
+    }
+
+    case THUNK_SELECTOR:
+        markPointer(((StgSelector *)p)->selectee);
+        return;
+
+    case IND:
+    case BLACKHOLE:
+        markPointer(((StgInd *)p)->indirectee);
+        return;
+
+    case MUT_VAR_CLEAN:
+    case MUT_VAR_DIRTY:
+        markPointer(((StgMutVar *)p)->var);
+        return;
+
+    case MVAR_CLEAN:
+    case MVAR_DIRTY:
+    {
+        StgMVar *mvar = (StgMVar *)p;
+        markPointer((StgClosure *)mvar->head);
+        markPointer((StgClosure *)mvar->tail);
+        markPointer(mvar->value);
+        return;
+    }
+
+    case TVAR:
+    {
+        StgTVar *tvar = (StgTVar *)p;
+        markPointer(tvar->current_value);
+        markPointer((StgClosure *)tvar->first_watch_queue_entry);
+        return;
+    }
+
+    case MUT_ARR_PTRS_CLEAN:
+    case MUT_ARR_PTRS_DIRTY:
+    case MUT_ARR_PTRS_FROZEN_CLEAN:
+    case MUT_ARR_PTRS_FROZEN_DIRTY:
+    {
+        StgMutArrPtrs *a = (StgMutArrPtrs *)p;
+        end = (P_)a->payload + a->ptrs;
+        for (q = (P_)a->payload; q < end; q++) {
+            markPointer((StgClosure *)*q);
+        }
+        return;
+    }
+
+    case SMALL_MUT_ARR_PTRS_CLEAN:
+    case SMALL_MUT_ARR_PTRS_DIRTY:
+    case SMALL_MUT_ARR_PTRS_FROZEN_CLEAN:
+    case SMALL_MUT_ARR_PTRS_FROZEN_DIRTY:
+    {
+        StgSmallMutArrPtrs *a = (StgSmallMutArrPtrs *)p;
+        end = (P_)a->payload + a->ptrs;
+        for (q = (P_)a->payload; q < end; q++) {
+            markPointer((StgClosure *)*q);
+        }
+        return;
+    }
+
+    case BCO:
+    {
+        StgBCO *bco = (StgBCO *)p;
+        markPointer((StgClosure *)bco->instrs);
+        markPointer((StgClosure *)bco->literals);
+        markPointer((StgClosure *)bco->ptrs);
+        return;
+    }
+
+    default:
+        // TSO, STACK, PAP, AP, AP_STACK, WHITEHOLE, ...: the mutator
+        // may be changing these, so leave them for the final GC.
+        pushMarkList(&deferred, p);
+        return;
+    }
+}
+
+/* -----------------------------------------------------------------------------
+   The marker thread
+   -------------------------------------------------------------------------- */
+
+static Mutex      mark_mutex;
+static Condition  mark_cond;
+static OSThreadId mark_thread;
+
+// Protected by mark_mutex.  pause_requested is also read by the marker
+// without it, after each object, so that a GC doesn't have to wait for
+// long.
+static volatile bool pause_requested = false;
+static volatile bool mark_done = false;
+static bool mark_stop = false;
+static bool marker_running = false;
+
+// Set by nonMovingCollectGen(), so that the next minor GC starts a
+// mark.  Only accessed by the thread doing GC.
+static bool start_pending = false;
+
+static void *
+markThread (void *arg STG_UNUSED)
+{
+    ACQUIRE_LOCK(&mark_mutex);
+    while (!mark_stop) {
+        if (!nonmoving_marking || mark_done || pause_requested) {
+            waitCondition(&mark_cond, &mark_mutex);
+            continue;
+        }
+
+        while (mark_queue.n > 0 && !pause_requested) {
+            markObject(mark_queue.entries[--mark_queue.n]);
+        }
+
+        if (mark_queue.n == 0) {
+            mark_done = true;
+            debugTrace(DEBUG_gc, "concurrent mark done: %" FMT_Word
+                       " objects marked", n_marked);
+        }
+    }
+    marker_running = false;
+    broadcastCondition(&mark_cond);
+    RELEASE_LOCK(&mark_mutex);
+    return NULL;
+}
+
+#endif /* THREADED_RTS */
+
+// Called from initStorage(), and again in the child after forkProcess(),
+// since neither the thread nor its mark survive the fork.
+void
+startNonMovingThread (void)
+{
+#if defined(THREADED_RTS)
+    marker_running = false;
+    mark_stop = false;
+    mark_done = false;
+    pause_requested = false;
+    start_pending = false;
+    nonmoving_seeding = false;
+    nonmoving_marking = false;
+    freeMarkState();
+
+    if (!RtsFlags.GcFlags.concurrentMark) {
+        return;
+    }
+
+    initMutex(&mark_mutex);
+    initCondition(&mark_cond);
+
+    if (createOSThread(&mark_thread, "ghc_mark", markThread, NULL) != 0) {
+        sysErrorBelch("warning: could not start the marker thread; "
+                      "marking the old generation during GC instead");
+        closeCondition(&mark_cond);
+        closeMutex(&mark_mutex);
+        return;
+    }
+    marker_running = true;
+#endif
+}
+
+void
+stopNonMovingThread (void)
+{
+#if defined(THREADED_RTS)
+    if (!marker_running) {
+        return;
+    }
+
+    ACQUIRE_LOCK(&mark_mutex);
+    mark_stop = true;
+    broadcastCondition(&mark_cond);
+    while (marker_running) {
+        waitCondition(&mark_cond, &mark_mutex);
+    }
+    RELEASE_LOCK(&mark_mutex);
+
+    closeCondition(&mark_cond);
+    closeMutex(&mark_mutex);
+    freeMarkState();
+    nonmoving_marking = false;
+#endif
+}
+
+/* -----------------------------------------------------------------------------
+   Hooks for the scheduler and the GC
+   -------------------------------------------------------------------------- */
+
+uint32_t
+nonMovingCollectGen (uint32_t collect_gen)
+{
+#if defined(THREADED_RTS)
+    uint32_t oldest = RtsFlags.GcFlags.generations - 1;
+
+    if (!marker_running) {
+        return collect_gen;
+    }
+
+    if (nonmoving_marking) {
+        if (mark_done) {
+            return oldest;
+        }
+        // The oldest generation keeps growing until the final GC.  If
+        // the marker falls far behind, finish the mark now rather
+        // than let the heap grow without bound.
+        if (collect_gen == oldest &&
+            oldest_gen->n_blocks + oldest_gen->n_large_blocks
+                <= 2 * oldest_gen->max_blocks) {
+            return oldest - 1;
+        }
+        return collect_gen;
+    }
+
+    if (collect_gen == oldest) {
+        start_pending = true;
+        return oldest - 1;
+    }
+#endif
+    return collect_gen;
+}
+
+void
+nonMovingStartGC (void)
+{
+#if defined(THREADED_RTS)
+    if (nonmoving_marking) {
+        // Stop the marker and keep it stopped until nonMovingEndGC().
+        pause_requested = true;
+        ACQUIRE_LOCK(&mark_mutex);
+    }
+
+    if (start_pending) {
+        start_pending = false;
+        // A forced major GC collects everything anyway.
+        if (!major_gc && !nonmoving_marking) {
+            ASSERT(n_gc_threads == 1);
+            initMarkState();
+            nonmoving_seeding = true;
+        }
+    }
+#endif
+}
+
+void
+nonMovingEndGC (void)
+{
+#if defined(THREADED_RTS)
+    if (nonmoving_seeding) {
+        nonmoving_seeding = false;
+        debugTrace(DEBUG_gc, "concurrent mark started: %" FMT_Word
+                   " objects seeded", mark_queue.n);
+        ACQUIRE_LOCK(&mark_mutex);
+        mark_done = false;
+        nonmoving_marking = true;
+        signalCondition(&mark_cond);
+        RELEASE_LOCK(&mark_mutex);
+    } else if (nonmoving_marking) {
+        if (major_gc) {
+            // this was the final GC
+            debugTrace(DEBUG_gc, "concurrent mark finished: %" FMT_Word
+                       " objects marked concurrently", n_marked);
+            freeMarkState();
+            nonmoving_marking = false;
+        }
+        pause_requested = false;
+        signalCondition(&mark_cond);
+        RELEASE_LOCK(&mark_mutex);
+    }
+#endif
+}
+
+// evacuate() found p in the oldest generation during the seeding GC
+void
+nonMovingSeed (StgClosure *p STG_UNUSED)
+{
+#if defined(THREADED_RTS)
+    markPointer(p);
+#endif
+}
+
+void
+nonMovingRecordMutList (bdescr *mut_list STG_UNUSED)
+{
+#if defined(THREADED_RTS)
+    bdescr *bd;
+    StgPtr p;
+    StgClosure *c;
+    const StgInfoTable *info;
+
+    for (bd = mut_list; bd != NULL; bd = bd->link) {
+        for (p = bd->start; p < bd->free; p++) {
+            c = (StgClosure *)*p;
+            info = c->header.info;
+            // not written to since the last GC
+            if (info == &stg_MUT_VAR_CLEAN_info ||
+                info == &stg_MVAR_CLEAN_info ||
+                info == &stg_TVAR_CLEAN_info ||
+                info == &stg_MUT_ARR_PTRS_CLEAN_info ||
+                info == &stg_MUT_ARR_PTRS_FROZEN_CLEAN_info ||
+                info == &stg_SMALL_MUT_ARR_PTRS_CLEAN_info ||
+                info == &stg_SMALL_MUT_ARR_PTRS_FROZEN_CLEAN_info) {
+                continue;
+            }
+            pushMarkList(&dirty, c);
+        }
+    }
+#endif
+}
+
+// Called by the final GC for each block of the oldest generation, with
+// the block's (zeroed) bitmap.
+void
+nonMovingCopyMarks (bdescr *bd STG_UNUSED, StgWord *bitmap STG_UNUSED)
+{
+#if defined(THREADED_RTS)
+    StgWord *marks = lookupHashTable(mark_bitmaps, (StgWord)bd);
+    if (marks != NULL) {
+        memcpy(bitmap, marks, BITMAP_W * sizeof(W_));
+    }
+#endif
+}
+
+// Called by the final GC after the other roots: everything the marker
+// marked but hasn't scanned goes on the mark stack, and the large
+// objects and statics it found are evacuated.
+void
+nonMovingMarkRoots (evac_fn evac STG_UNUSED, void *user STG_UNUSED)
+{
+#if defined(THREADED_RTS)
+    StgClosure *p;
+    bdescr *bd;
+    W_ i;
+
+    for (i = 0; i < mark_queue.n; i++) {
+        push_mark_stack((P_)mark_queue.entries[i]);
+    }
+    for (i = 0; i < deferred.n; i++) {
+        push_mark_stack((P_)deferred.entries[i]);
+    }
+    for (i = 0; i < statics.n; i++) {
+        p = statics.entries[i];
+        evac(user, &p);
+    }
+    for (i = 0; i < larges.n; i++) {
+        p = larges.entries[i];
+        evac(user, &p);
+    }
+
+    // Old objects written to during the mark.  The ones the marker
+    // hasn't reached are traced normally if they are still live.
+    for (i = 0; i < dirty.n; i++) {
+        p = dirty.entries[i];
+        bd = Bdescr((P_)p);
+        if (bd->flags & (BF_LARGE | BF_COMPACT)) {
+            if (lookupHashTable(seen, (bd->flags & BF_SLOTTED) ?
+                                (StgWord)p : (StgWord)bd) != NULL) {
+                evac(user, &p);
+            }
+        } else if ((bd->flags & BF_MARKED) && is_marked((P_)p, bd)) {
+            push_mark_stack((P_)p);
+        }
+    }
+
+    debugTrace(DEBUG_gc, "final mark: %" FMT_Word " unscanned, %"
+               FMT_Word " deferred, %" FMT_Word " dirty",
+               mark_queue.n, deferred.n, dirty.n);
+#endif
+}
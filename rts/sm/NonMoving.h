@@ -0,0 +1,41 @@
+/* -----------------------------------------------------------------------------
+ *
+ * (c) The GHC Team 2019
+ *
+ * Concurrent marking of the oldest generation.
+ *
+ * Documentation on the architecture of the Storage Manager can be
+ * found in the online commentary:
+ *
+ *   https://gitlab.haskell.org/ghc/ghc/wikis/commentary/rts/storage
+ *
+ * ---------------------------------------------------------------------------*/
+
+#pragma once
+
+#include "BeginPrivate.h"
+
+// True during the GC that starts a concurrent mark; evacuate() then
+// hands the oldest-generation objects it sees to nonMovingSeed().
+extern bool nonmoving_seeding;
+
+// True from the end of that GC until the major GC that finishes the mark.
+extern bool nonmoving_marking;
+
+void startNonMovingThread (void);
+void stopNonMovingThread  (void);
+
+// With +RTS -xn, decide which generation to collect instead of
+// collect_gen.  Called by the scheduler before each GC.
+uint32_t nonMovingCollectGen (uint32_t collect_gen);
+
+// Called by GarbageCollect() at the start and the end of every GC.
+void nonMovingStartGC (void);
+void nonMovingEndGC   (void);
+
+void nonMovingSeed          (StgClosure *p);
+void nonMovingRecordMutList (bdescr *mut_list);
+void nonMovingCopyMarks     (bdescr *bd, StgWord *bitmap);
+void nonMovingMarkRoots     (evac_fn evac, void *user);
+
+#include "EndPrivate.h"
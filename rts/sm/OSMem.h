@@ -24,6 +24,14 @@ uint32_t osNumaNodes(void);
 uint64_t osNumaMask(void);
 void osBindMBlocksToNode(void *addr, StgWord size, uint32_t node);
 
+// The size of the huge pages that we ask the OS to back the heap with
+// when +RTS -xH is given.  Must be a multiple of MBLOCK_SIZE.
+#define HUGE_PAGE_SIZE (2*1024*1024)
+
+// The number of bytes of the heap that are currently backed by huge
+// pages, or 0 if the OS can't tell us.
+W_ osHugePageBytes(void);
+
 INLINE_HEADER size_t
 roundDownToPage (size_t x)
 {
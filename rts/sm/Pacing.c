@@ -0,0 +1,267 @@
+/* -----------------------------------------------------------------------------
+ *
+ * (c) The GHC Team 2019
+ *
+ * Sizing the nursery and the generations for a target GC pause time.
+ *
+ * Documentation on the architecture of the Storage Manager can be
+ * found in the online commentary:
+ *
+ *   https://gitlab.haskell.org/ghc/ghc/wikis/commentary/rts/storage
+ *
+ * ---------------------------------------------------------------------------*/
+
+#include "PosixSource.h"
+#include "Rts.h"
+
+#include "RtsUtils.h"
+#include "Storage.h"
+#include "GC.h"
+#include "Trace.h"
+#include "Pacing.h"
+
+/* Note [GC pause target]
+   ~~~~~~~~~~~~~~~~~~~~~~
+
+   The nursery size (-A) and the size of the older generations (-F) are
+   fixed settings, so the pauses they lead to depend on the program.
+   With +RTS -xP<time> the GC sizes them itself, aiming to keep each
+   pause under <time>.
+
+   The cost of a copying collection is mostly the copying, so the model
+   is simply that a collection of generation g takes the words it copies
+   divided by a copy rate.  stat_endGC() calls pacerEndGC() with the
+   bytes copied and the elapsed time of each GC (not counting the time
+   to stop the capabilities), and that keeps a smoothed copy rate for
+   each generation, since a major GC that marks or compacts goes at a
+   different rate from a minor one.  Then, as each GC resizes the heap:
+
+     - the nursery (pacerNurseryBlocks()): a minor GC copies roughly
+       the part of the nursery that survived, which grows with the size
+       of the nursery.  So after each minor GC we predict the pause of
+       the next one from the words this one copied, and scale the
+       nursery by the ratio of the goal to the prediction.  The goal is
+       PACE_GOAL_PCT of the target, to leave room for the variation
+       between one GC and the next.  The nursery is at most halved or
+       doubled at once, never grows past -A, and never shrinks below
+       1/PACE_MIN_NURSERY of it;
+
+     - the intermediate generations, with -G3 or more
+       (pacerResizeGenerations()): in the same way, after a GC of
+       generation g we scale its threshold (max_blocks) by the ratio of
+       the goal to the predicted pause, up to the size that -F gives it;
+
+     - the oldest generation: a major GC copies all the live data, so no
+       threshold makes it shorter.  If it is predicted to take longer
+       than the target, we collect the oldest generation less often
+       instead, by stretching its threshold by the ratio of the
+       prediction to the target, up to PACE_MAX_POSTPONE times what -F
+       gives it, and within -M.  So the pauses over the target are as
+       few as the memory allows.  With -xn the major GC doesn't copy the
+       oldest generation and this is not done.
+
+   Each decision that changes a size is posted as EVENT_GC_PACE at the
+   end of the GC, with the predicted pause it was based on.  -xP has no
+   effect with -G1, whose nursery grows with the live data.
+*/
+
+bool pacing = false;
+
+// The fraction of the target we aim at, in percent
+#define PACE_GOAL_PCT 75
+
+// The smallest nursery, as a fraction of -A
+#define PACE_MIN_NURSERY 16
+
+// The most we postpone a major GC by, as a factor of the threshold
+// that -F gives the oldest generation
+#define PACE_MAX_POSTPONE 4
+
+typedef struct pace_gen_ {
+    double rate;          // bytes copied per second of pause, smoothed
+    W_     size;          // the nursery or threshold we chose, in blocks
+    bool   decided;       // changed by the current GC?
+    W_     old_size;
+    Time   predicted;
+} pace_gen;
+
+// one for each generation; generation 0 is the nursery
+static pace_gen *pace_gens = NULL;
+
+// The threshold that -F gave the older generations at the last major GC
+static W_ default_size = 0;
+
+void
+initPacing (void)
+{
+    if (RtsFlags.GcFlags.pauseTarget == 0) {
+        return;
+    }
+    if (RtsFlags.GcFlags.generations == 1) {
+        errorBelch("WARNING: -xP is incompatible with -G1; disabled");
+        RtsFlags.GcFlags.pauseTarget = 0;
+        return;
+    }
+    pace_gens = stgCallocBytes(RtsFlags.GcFlags.generations,
+                               sizeof(pace_gen), "initPacing");
+    pacing = true;
+}
+
+void
+freePacing (void)
+{
+    stgFree(pace_gens);
+    pace_gens = NULL;
+    pacing = false;
+}
+
+// The pause of a collection of generation g that copies the given
+// number of words, or 0 if we have no copy rate for g yet.
+static Time
+predictPause (uint32_t g, W_ copied)
+{
+    if (pace_gens[g].rate == 0) {
+        return 0;
+    }
+    return (Time)((double)copied * sizeof(W_) * TIME_RESOLUTION
+                  / pace_gens[g].rate);
+}
+
+// Scale a size at which we predict the given pause so that the pause
+// comes to the goal, at most halving or doubling it, within [min,max].
+static W_
+paceSize (W_ size, Time predicted, W_ min, W_ max)
+{
+    const Time goal = RtsFlags.GcFlags.pauseTarget * PACE_GOAL_PCT / 100;
+    W_ new_size;
+
+    if (predicted <= goal / 2) {
+        new_size = size * 2;
+    } else if (predicted >= goal * 2) {
+        new_size = size / 2;
+    } else {
+        new_size = (W_)((double)size * goal / predicted);
+    }
+    return stg_max(min, stg_min(max, new_size));
+}
+
+static void
+decide (uint32_t g, W_ old_size, W_ new_size, Time predicted)
+{
+    pace_gen *p = &pace_gens[g];
+
+    p->size = new_size;
+    if (new_size == old_size) {
+        return;
+    }
+    if (!p->decided) {
+        p->decided = true;
+        p->old_size = old_size;
+    }
+    p->predicted = predicted;
+    debugTrace(DEBUG_gc, "pacing gen %d: predicted pause %" FMT_Int64
+               "us, %" FMT_Word " -> %" FMT_Word " blocks",
+               g, (StgInt64)TimeToUS(predicted), old_size, new_size);
+}
+
+W_
+pacerNurseryBlocks (W_ copied)
+{
+    pace_gen *p = &pace_gens[0];
+    const W_ max = RtsFlags.GcFlags.minAllocAreaSize * (W_)n_capabilities;
+    const W_ min = stg_max(n_nurseries, max / PACE_MIN_NURSERY);
+    W_ size;
+
+    // the number of capabilities may have changed
+    size = p->size == 0 ? max : stg_max(min, stg_min(max, p->size));
+
+    if (N == 0 && p->rate != 0) {
+        Time predicted = predictPause(0, copied);
+        decide(0, size, paceSize(size, predicted, min, max), predicted);
+    } else {
+        p->size = size;
+    }
+    return p->size;
+}
+
+void
+pacerResizeGenerations (W_ copied)
+{
+    const uint32_t oldest = RtsFlags.GcFlags.generations - 1;
+    const W_ max = RtsFlags.GcFlags.maxHeapSize;
+    uint32_t g;
+    W_ min, size;
+    Time predicted;
+
+    if (default_size == 0 || major_gc) {
+        default_size = oldest_gen->max_blocks;
+    }
+    min = stg_min(RtsFlags.GcFlags.minOldGenSize, default_size);
+
+    if (major_gc) {
+        // resize_generations() has just set every threshold to
+        // default_size; put back the ones we chose.
+        for (g = 1; g < oldest; g++) {
+            if (pace_gens[g].size != 0) {
+                generations[g].max_blocks =
+                    stg_min(pace_gens[g].size, default_size);
+            }
+        }
+
+        // See Note [GC pause target]
+        if (RtsFlags.GcFlags.concurrentMark || pace_gens[oldest].rate == 0) {
+            return;
+        }
+        predicted = predictPause(oldest, copied);
+        size = default_size;
+        if (predicted > RtsFlags.GcFlags.pauseTarget) {
+            size = (W_)((double)size * predicted
+                        / RtsFlags.GcFlags.pauseTarget);
+            size = stg_min(size, default_size * PACE_MAX_POSTPONE);
+            if (max != 0) {
+                // the same bound as resize_generations() uses for a
+                // copying collection
+                size = stg_min(size, max / (oldest * 2));
+            }
+            size = stg_max(size, default_size);
+        }
+        decide(oldest, default_size, size, predicted);
+        oldest_gen->max_blocks = size;
+    }
+    else if (N > 0 && pace_gens[N].rate != 0) {
+        size = generations[N].max_blocks;
+        predicted = predictPause(N, copied);
+        decide(N, size, paceSize(size, predicted, min, default_size),
+               predicted);
+        generations[N].max_blocks = pace_gens[N].size;
+    }
+}
+
+void
+pacerEndGC (Capability *cap, uint32_t gen, W_ copied_bytes, Time elapsed)
+{
+    pace_gen *p;
+    double rate;
+    uint32_t g;
+
+    if (!pacing) {
+        return;
+    }
+
+    p = &pace_gens[gen];
+    if (copied_bytes != 0 && elapsed > 0) {
+        rate = (double)copied_bytes * TIME_RESOLUTION / elapsed;
+        p->rate = p->rate == 0 ? rate : (p->rate + rate) / 2;
+    }
+
+    for (g = 0; g < RtsFlags.GcFlags.generations; g++) {
+        p = &pace_gens[g];
+        if (p->decided) {
+            traceEventGcPace(cap, CAPSET_HEAP_DEFAULT, g,
+                             TimeToNS(p->predicted),
+                             p->old_size * BLOCK_SIZE,
+                             p->size * BLOCK_SIZE);
+            p->decided = false;
+        }
+    }
+}
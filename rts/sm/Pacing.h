@@ -0,0 +1,37 @@
+/* -----------------------------------------------------------------------------
+ *
+ * (c) The GHC Team 2019
+ *
+ * Sizing the nursery and the generations for a target GC pause time.
+ *
+ * Documentation on the architecture of the Storage Manager can be
+ * found in the online commentary:
+ *
+ *   https://gitlab.haskell.org/ghc/ghc/wikis/commentary/rts/storage
+ *
+ * ---------------------------------------------------------------------------*/
+
+#pragma once
+
+#include "BeginPrivate.h"
+
+// True with +RTS -xP
+extern bool pacing;
+
+void initPacing (void);
+void freePacing (void);
+
+// The total size of the nurseries for the next GC, in blocks, given
+// the words copied by this one (from resize_nursery()).
+W_ pacerNurseryBlocks (W_ copied);
+
+// Adjust the thresholds of the older generations (from
+// resize_generations()).
+void pacerResizeGenerations (W_ copied);
+
+// Called by stat_endGC() with the bytes copied by a GC and its pause;
+// posts the decisions the GC made.
+void pacerEndGC (Capability *cap, uint32_t gen, W_ copied_bytes,
+                 Time elapsed);
+
+#include "EndPrivate.h"
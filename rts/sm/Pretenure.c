@@ -0,0 +1,299 @@
+/* -----------------------------------------------------------------------------
+ *
+ * (c) The GHC Team 2019
+ *
+ * Pretenuring of constructors that survive to the old generation.
+ *
+ * Documentation on the architecture of the Storage Manager can be
+ * found in the online commentary:
+ *
+ *   https://gitlab.haskell.org/ghc/ghc/wikis/commentary/rts/storage
+ *
+ * ---------------------------------------------------------------------------*/
+
+#include "PosixSource.h"
+#include "Rts.h"
+
+#include "RtsUtils.h"
+#include "Storage.h"
+#include "GC.h"
+#include "GCThread.h"
+#include "GCTDecl.h"
+#include "Hash.h"
+#include "Trace.h"
+#include "Pretenure.h"
+
+#include <stdlib.h> // for qsort()
+
+/* Note [Pretenuring]
+   ~~~~~~~~~~~~~~~~~~
+
+   An object that survives its first GC is copied out of the nursery
+   into the aging area of gen 0, and if it survives a second one it is
+   copied again, into gen 1.  A program that builds big structures that
+   live a long time, such as the Maps of a server's state, pays for the
+   first copy of every node for nothing.
+
+   With +RTS --pretenure the GC finds out which constructors usually
+   get that far, and copies them out of the nursery into gen 1 straight
+   away.  Compiled code allocates by bumping Hp, so the mutator can't
+   allocate them in the old generation in the first place; skipping the
+   aging copy is the part of pretenuring that we can do in the GC.
+
+   The unit is the info table: all the objects built by one constructor
+   count as one allocation site.  evacuate() calls pretenureEvac() for
+   each constructor it copies out of gen 0, and that counts
+
+     - survived: objects copied out of the nursery (their block has
+       dest_no 0);
+     - promoted: objects copied out of the aging area (dest_no > 0).
+
+   Each GC thread counts in a hash table of its own (gct->
+   pretenure_counts), so there is no locking.  At the end of the GC
+   pretenureEndGC() adds the counts to those of the sites, and a site
+   that has seen at least PRETENURE_MIN_SURVIVED survivors, of which at
+   least the threshold percentage (--pretenure=<n>, 80 by default) went
+   on to be promoted, is pretenured: from the next GC on, its objects go
+   from the nursery to gen 1.  The GC threads keep a copy of the
+   decision in their own tables, so that pretenureEvac() only needs the
+   one lookup.
+
+   Nothing tells us when a pretenured site stops producing long-lived
+   objects, so at each major GC all sites start again from nothing.  A
+   site that still qualifies is pretenured again once a few thousand of
+   its objects have been through the aging area.
+
+   Only constructors are pretenured: thunks are usually updated soon
+   after they are built, and most other objects are rare.  With -G1
+   there is nothing to pretenure to, and pretenuring is turned off.
+
+   +RTS -s lists the sites that were pretenured, with the number of
+   objects that were copied straight to gen 1.
+*/
+
+bool pretenuring = false;
+
+// A site needs this many survivors before we decide about it
+#define PRETENURE_MIN_SURVIVED 1000
+
+typedef struct PretenureSite_ {
+    const StgInfoTable *info;
+    W_       survived;          // since the last major GC
+    W_       promoted;
+    bool     pretenure;
+    bool     ever_pretenured;
+    uint64_t total_survived;    // since the start, for the report
+    uint64_t total_promoted;
+    uint64_t total_pretenured;
+} PretenureSite;
+
+// All the sites we have seen, keyed by info pointer
+static HashTable *sites = NULL;
+
+// Sites that have been pretenured at some point
+static uint32_t n_pretenured_sites = 0;
+
+void
+initPretenure (void)
+{
+    if (RtsFlags.GcFlags.pretenureThreshold == 0) {
+        return;
+    }
+    if (RtsFlags.GcFlags.generations == 1) {
+        errorBelch("WARNING: --pretenure is incompatible with -G1; disabled");
+        RtsFlags.GcFlags.pretenureThreshold = 0;
+        return;
+    }
+    sites = allocHashTable();
+    pretenuring = true;
+}
+
+void
+freePretenure (void)
+{
+    if (sites != NULL) {
+        freeHashTable(sites, stgFree);
+        sites = NULL;
+    }
+    pretenuring = false;
+}
+
+uint32_t
+pretenureEvac (bdescr *bd, const StgInfoTable *info, uint32_t gen_no)
+{
+    PretenureCount *c;
+
+    switch (INFO_PTR_TO_STRUCT(info)->type) {
+    case CONSTR:
+    case CONSTR_1_0:
+    case CONSTR_0_1:
+    case CONSTR_2_0:
+    case CONSTR_1_1:
+    case CONSTR_0_2:
+    case CONSTR_NOCAF:
+        break;
+    default:
+        return gen_no;
+    }
+
+    c = lookupHashTable(gct->pretenure_counts, (StgWord)info);
+    if (c == NULL) {
+        c = stgCallocBytes(1, sizeof(PretenureCount), "pretenureEvac");
+        insertHashTable(gct->pretenure_counts, (StgWord)info, c);
+    }
+
+    if (bd->dest_no == 0) {
+        if (c->pretenure) {
+            c->pretenured++;
+            return g0->to->no;
+        }
+        c->survived++;
+    } else {
+        c->promoted++;
+    }
+    return gen_no;
+}
+
+static void
+mergeCount (void *data STG_UNUSED, StgWord key, const void *value)
+{
+    PretenureCount *c = (PretenureCount *)value;
+    PretenureSite *site;
+
+    site = lookupHashTable(sites, key);
+    if (site == NULL) {
+        site = stgCallocBytes(1, sizeof(PretenureSite), "mergeCount");
+        site->info = (const StgInfoTable *)key;
+        insertHashTable(sites, key, site);
+    }
+
+    site->survived += c->survived;
+    site->promoted += c->promoted;
+    site->total_survived += c->survived;
+    site->total_promoted += c->promoted;
+    site->total_pretenured += c->pretenured;
+
+    c->survived = 0;
+    c->promoted = 0;
+    c->pretenured = 0;
+}
+
+static const char *
+siteName (const PretenureSite *site)
+{
+    return GET_CON_DESC(itbl_to_con_itbl(INFO_PTR_TO_STRUCT(site->info)));
+}
+
+static void
+decideSite (void *data STG_UNUSED, StgWord key STG_UNUSED, const void *value)
+{
+    PretenureSite *site = (PretenureSite *)value;
+
+    if (major_gc) {
+        // start again; see Note [Pretenuring]
+        site->pretenure = false;
+        site->survived = 0;
+        site->promoted = 0;
+        return;
+    }
+
+    if (!site->pretenure &&
+        site->survived >= PRETENURE_MIN_SURVIVED &&
+        site->promoted * 100 >=
+            site->survived * RtsFlags.GcFlags.pretenureThreshold)
+    {
+        site->pretenure = true;
+        if (!site->ever_pretenured) {
+            site->ever_pretenured = true;
+            n_pretenured_sites++;
+        }
+        debugTrace(DEBUG_gc, "pretenuring %s: %" FMT_Word " of %"
+                   FMT_Word " survivors promoted",
+                   siteName(site), site->promoted, site->survived);
+    }
+}
+
+static void
+refreshCount (void *data STG_UNUSED, StgWord key, const void *value)
+{
+    PretenureCount *c = (PretenureCount *)value;
+    PretenureSite *site;
+
+    site = lookupHashTable(sites, key);
+    c->pretenure = site->pretenure;
+}
+
+void
+pretenureEndGC (void)
+{
+    uint32_t i;
+
+    if (!pretenuring) {
+        return;
+    }
+
+    // GC threads that sat this GC out have nothing to add, but their
+    // decisions need refreshing all the same.
+    for (i = 0; i < n_capabilities; i++) {
+        mapHashTable(gc_threads[i]->pretenure_counts, NULL, mergeCount);
+    }
+    mapHashTable(sites, NULL, decideSite);
+    for (i = 0; i < n_capabilities; i++) {
+        mapHashTable(gc_threads[i]->pretenure_counts, NULL, refreshCount);
+    }
+}
+
+typedef struct {
+    PretenureSite **sites;
+    uint32_t n;
+} SiteArray;
+
+static void
+collectSite (void *data, StgWord key STG_UNUSED, const void *value)
+{
+    SiteArray *arr = (SiteArray *)data;
+    PretenureSite *site = (PretenureSite *)value;
+
+    if (site->ever_pretenured) {
+        arr->sites[arr->n++] = site;
+    }
+}
+
+static int
+cmpSites (const void *a, const void *b)
+{
+    const PretenureSite *x = *(PretenureSite * const *)a;
+    const PretenureSite *y = *(PretenureSite * const *)b;
+
+    if (x->total_pretenured > y->total_pretenured) return -1;
+    if (x->total_pretenured < y->total_pretenured) return 1;
+    return 0;
+}
+
+uint32_t
+pretenureReport (PretenureReport *out, uint32_t max)
+{
+    SiteArray arr;
+    uint32_t i;
+
+    if (!pretenuring || n_pretenured_sites == 0) {
+        return 0;
+    }
+
+    arr.sites = stgMallocBytes(n_pretenured_sites * sizeof(PretenureSite *),
+                               "pretenureReport");
+    arr.n = 0;
+    mapHashTable(sites, &arr, collectSite);
+    ASSERT(arr.n == n_pretenured_sites);
+    qsort(arr.sites, arr.n, sizeof(PretenureSite *), cmpSites);
+
+    for (i = 0; i < arr.n && i < max; i++) {
+        out[i].name       = siteName(arr.sites[i]);
+        out[i].survived   = arr.sites[i]->total_survived;
+        out[i].promoted   = arr.sites[i]->total_promoted;
+        out[i].pretenured = arr.sites[i]->total_pretenured;
+    }
+
+    stgFree(arr.sites);
+    return n_pretenured_sites;
+}
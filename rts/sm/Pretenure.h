@@ -0,0 +1,54 @@
+/* -----------------------------------------------------------------------------
+ *
+ * (c) The GHC Team 2019
+ *
+ * Pretenuring of constructors that survive to the old generation.
+ *
+ * Documentation on the architecture of the Storage Manager can be
+ * found in the online commentary:
+ *
+ *   https://gitlab.haskell.org/ghc/ghc/wikis/commentary/rts/storage
+ *
+ * ---------------------------------------------------------------------------*/
+
+#pragma once
+
+#include "BeginPrivate.h"
+
+// True with +RTS --pretenure
+extern bool pretenuring;
+
+// The counts kept by each GC thread during a GC, keyed by info pointer
+typedef struct PretenureCount_ {
+    W_   survived;              // copied out of the nursery
+    W_   promoted;              // promoted out of gen 0
+    W_   pretenured;            // copied from the nursery to gen 1
+    bool pretenure;             // copy them to gen 1 straight away?
+} PretenureCount;
+
+// A line of the +RTS -s report
+typedef struct PretenureReport_ {
+    const char *name;           // constructor name
+    uint64_t    survived;
+    uint64_t    promoted;
+    uint64_t    pretenured;
+} PretenureReport;
+
+#define PRETENURE_REPORT_SITES 10
+
+void initPretenure (void);
+void freePretenure (void);
+
+// Called by evacuate() for each object it copies out of gen 0;
+// returns the generation to copy it to.
+uint32_t pretenureEvac (bdescr *bd, const StgInfoTable *info,
+                        uint32_t gen_no);
+
+// Called by GarbageCollect() when all the GC threads have finished.
+void pretenureEndGC (void);
+
+// Fill in the sites that have been pretenured, most objects first, and
+// return how many there were in all.
+uint32_t pretenureReport (PretenureReport *sites, uint32_t max);
+
+#include "EndPrivate.h"
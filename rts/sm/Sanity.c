@@ -824,7 +824,7 @@ markCompactBlocks(bdescr *bd)
 static void
 findMemoryLeak (void)
 {
-    uint32_t g, i;
+    uint32_t g, i, c;
     for (g = 0; g < RtsFlags.GcFlags.generations; g++) {
         for (i = 0; i < n_capabilities; i++) {
             markBlocks(capabilities[i]->mut_lists[g]);
@@ -833,6 +833,7 @@ findMemoryLeak (void)
             markBlocks(gc_threads[i]->gens[g].todo_bd);
         }
         markBlocks(generations[g].blocks);
+        markBlocks(generations[g].bitmap);
         markBlocks(generations[g].large_objects);
         markCompactBlocks(generations[g].compact_objects);
     }
@@ -844,6 +845,11 @@ findMemoryLeak (void)
     for (i = 0; i < n_capabilities; i++) {
         markBlocks(gc_threads[i]->free_blocks);
         markBlocks(capabilities[i]->pinned_object_block);
+        for (c = 0; c < PINNED_SIZE_CLASSES; c++) {
+            if (capabilities[i]->pinned_class_blocks[c] != NULL) {
+                capabilities[i]->pinned_class_blocks[c]->flags |= BF_KNOWN;
+            }
+        }
     }
 
 #if defined(PROFILING)
@@ -867,14 +873,16 @@ void
 checkRunQueue(Capability *cap)
 {
     StgTSO *prev, *tso;
-    prev = END_TSO_QUEUE;
-    uint32_t n;
-    for (n = 0, tso = cap->run_queue_hd; tso != END_TSO_QUEUE;
-         prev = tso, tso = tso->_link, n++) {
-        ASSERT(prev == END_TSO_QUEUE || prev->_link == tso);
-        ASSERT(tso->block_info.prev == prev);
+    uint32_t n, p;
+    for (n = 0, p = 0; p < TSO_PRIORITIES; p++) {
+        prev = END_TSO_QUEUE;
+        for (tso = cap->run_queue_hd[p]; tso != END_TSO_QUEUE;
+             prev = tso, tso = tso->_link, n++) {
+            ASSERT(prev == END_TSO_QUEUE || prev->_link == tso);
+            ASSERT(tso->block_info.prev == prev);
+        }
+        ASSERT(cap->run_queue_tl[p] == prev);
     }
-    ASSERT(cap->run_queue_tl == prev);
     ASSERT(cap->n_run_queue == n);
 }
 
@@ -909,6 +917,7 @@ genBlocks (generation *gen)
     ASSERT(countCompactBlocks(gen->compact_objects) == gen->n_compact_blocks);
     ASSERT(countCompactBlocks(gen->compact_blocks_in_import) == gen->n_compact_blocks_in_import);
     return gen->n_blocks + gen->n_old_blocks +
+        countAllocdBlocks(gen->bitmap) + // still needed for sweeping
         countAllocdBlocks(gen->large_objects) +
         countAllocdCompactBlocks(gen->compact_objects) +
         countAllocdCompactBlocks(gen->compact_blocks_in_import);
@@ -917,7 +926,7 @@ genBlocks (generation *gen)
 void
 memInventory (bool show)
 {
-  uint32_t g, i;
+  uint32_t g, i, c;
   W_ gen_blocks[RtsFlags.GcFlags.generations];
   W_ nursery_blocks, retainer_blocks,
       arena_blocks, exec_blocks, gc_free_blocks = 0;
@@ -947,6 +956,11 @@ memInventory (bool show)
       if (capabilities[i]->pinned_object_block != NULL) {
           nursery_blocks += capabilities[i]->pinned_object_block->blocks;
       }
+      for (c = 0; c < PINNED_SIZE_CLASSES; c++) {
+          if (capabilities[i]->pinned_class_blocks[c] != NULL) {
+              nursery_blocks += capabilities[i]->pinned_class_blocks[c]->blocks;
+          }
+      }
       nursery_blocks += countBlocks(capabilities[i]->pinned_object_blocks);
   }
 
@@ -1008,6 +1022,27 @@ memInventory (bool show)
       }
   }
 
+  if (show && !leak)
+  {
+      FreeSpaceStats fs;
+      getFreeSpaceStats(&fs);
+
+      debugBelch("  largest free : %5" FMT_Word " blocks (%6.1lf MB), "
+                 "%" FMT_Word " free groups\n",
+                 fs.largest_free, MB(fs.largest_free), fs.free_groups);
+      for (i = 0; i < FREE_SPACE_BUCKETS - 1; i++) {
+          if (fs.histogram[i] != 0) {
+              debugBelch("    %3d-%3d blks: %5" FMT_Word " blocks (%6.1lf MB)\n",
+                         1 << i, (1 << (i+1)) - 1,
+                         fs.histogram[i], MB(fs.histogram[i]));
+          }
+      }
+      if (fs.histogram[i] != 0) {
+          debugBelch("    mgroups    : %5" FMT_Word " blocks (%6.1lf MB)\n",
+                     fs.histogram[i], MB(fs.histogram[i]));
+      }
+  }
+
   if (leak) {
       debugBelch("\n");
       findMemoryLeak();
@@ -47,6 +47,8 @@
 
 #include "Storage.h"
 #include "GC.h"
+#include "GetTime.h"
+#include "CardTable.h"
 #include "GCThread.h"
 #include "GCUtils.h"
 #include "Compact.h"
@@ -60,9 +62,12 @@
 #include "LdvProfile.h"
 #include "HeapUtils.h"
 #include "Hash.h"
+#include "StaticRoots.h"
 
 #include "sm/MarkWeak.h"
 
+#include <string.h> // for memcpy()
+
 static void scavenge_stack (StgPtr p, StgPtr stack_end);
 
 static void scavenge_large_bitmap (StgPtr p,
@@ -76,6 +81,7 @@ static void scavenge_large_bitmap (StgPtr p,
 # define scavenge_block(a) scavenge_block1(a)
 # define scavenge_mutable_list(bd,g) scavenge_mutable_list1(bd,g)
 # define scavenge_capability_mut_lists(cap) scavenge_capability_mut_Lists1(cap)
+# define scavenge_card_blocks(a) scavenge_card_blocks1(a)
 #endif
 
 static void do_evacuate(StgClosure **p, void *user STG_UNUSED)
@@ -239,29 +245,256 @@ static StgPtr scavenge_mut_arr_ptrs (StgMutArrPtrs *a)
     return (StgPtr)a + mut_arr_ptrs_sizeW(a);
 }
 
+// The first marked card of a from card m on, or n if there is none
+// before card n.  A big array that has been written in a few places has
+// long runs of clean cards, so we skip them a word at a time.
+STATIC_INLINE W_
+next_marked_card (StgMutArrPtrs *a, W_ m, W_ n)
+{
+    while (m < n) {
+        if (m % sizeof(W_) == 0 && m + sizeof(W_) <= n &&
+            *(StgWord *)mutArrPtrsCard(a,m) == 0) {
+            m += sizeof(W_);
+        } else if (*mutArrPtrsCard(a,m) == 0) {
+            m++;
+        } else {
+            return m;
+        }
+    }
+    return n;
+}
+
+#if defined(PARALLEL_GC)
+
+/* Note [Splitting large arrays]
+   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+   The parallel GC balances work by stealing whole todo blocks (see
+   steal_todo_block()).  A large object is a single unit of work though,
+   so a big array of pointers is scavenged by whichever thread happens
+   to evacuate it, while the other threads go idle.  With a few arrays
+   of millions of elements this can serialise most of the GC.
+
+   So when work stealing is on, scavenge_large() splits a MUT_ARR_PTRS
+   with more than SCAV_RANGE_MIN_CARDS cards into ranges of cards
+   (scav_range).  The thread that found the array pushes a range
+   covering all of it on its range_q; whoever takes a range, the owner
+   or a thief, repeatedly pushes the upper half back until the range is
+   at most SCAV_RANGE_CARDS cards long, and then scavenges it.  So
+   idle threads steal big halves first, just as with todo blocks.
+
+   Each card is scavenged by exactly one thread, which sets its card
+   mark, so the only shared state is the array header:
+
+     - Before pushing the first range the owner sets the header to the
+       CLEAN variant, and for a mutable array in an old generation it
+       records the array on the mutable list, as scavenge_large() always
+       does for mutable arrays.
+
+     - A range that fails to evacuate something marks the array DIRTY.
+       For a frozen array the thread whose CAS moves the header from
+       FROZEN_CLEAN to FROZEN_DIRTY also records it on the mutable list,
+       so it is recorded once.
+
+   A minor GC finds the dirty MUT_ARR_PTRS of the older generations on
+   the mutable lists, and scavenges just their marked cards.  The cards
+   of an array with more than SCAV_RANGE_MIN_CARDS cards are handed out
+   in ranges in the same way (split_marked_array()), with r->marked set
+   so that the clean cards in them are skipped.  Otherwise a single
+   huge array that the program writes all over would still be scanned
+   by one thread.  The array stays on the mutable list, as it always
+   does.
+
+   Ranges come from a per-thread pool of SCAV_RANGE_POOL entries that is
+   reset at the start of each GC; when it runs out, or the range_q is
+   full, the thread simply scavenges the whole range itself.
+
+   The scanned words of each thread are summed per GC into
+   gc_par_scanned_words and gc_par_balanced_scanned_words, measured the
+   same way as the copied words (Note [Work Balance] in Stats.c), and
+   reported by +RTS -s as the scavenge balance.
+*/
+
+static void
+scavenge_range_cards (scav_range *r)
+{
+    StgMutArrPtrs *a = r->arr;
+    W_ m;
+    StgPtr p, q;
+    bool any_failed = false;
+    bool saved_eager_promotion = gct->eager_promotion;
+
+    gct->evac_gen_no = r->gen_no;
+    // see scavenge_one(): we don't eagerly promote objects pointed to
+    // by a mutable array, but we do for a frozen one.
+    gct->eager_promotion = r->frozen;
+
+    for (m = r->from; m < r->to; m++) {
+        if (r->marked) {
+            m = next_marked_card(a, m, r->to);
+            if (m == r->to) break;
+        }
+        p = (StgPtr)&a->payload[m << MUT_ARR_PTRS_CARD_BITS];
+        if (m == mutArrPtrsCards(a->ptrs) - 1) {
+            q = (StgPtr)&a->payload[a->ptrs];
+        } else {
+            q = p + (1 << MUT_ARR_PTRS_CARD_BITS);
+        }
+        gct->scanned += q - p;
+        for (; p < q; p++) {
+            evacuate((StgClosure**)p);
+        }
+        if (gct->failed_to_evac) {
+            any_failed = true;
+            *mutArrPtrsCard(a,m) = 1;
+            gct->failed_to_evac = false;
+        } else {
+            *mutArrPtrsCard(a,m) = 0;
+        }
+    }
+
+    if (any_failed) {
+        if (!r->frozen) {
+            SET_INFO((StgClosure *)a, &stg_MUT_ARR_PTRS_DIRTY_info);
+        } else if (cas((StgVolatilePtr)&a->header.info,
+                       (StgWord)&stg_MUT_ARR_PTRS_FROZEN_CLEAN_info,
+                       (StgWord)&stg_MUT_ARR_PTRS_FROZEN_DIRTY_info)
+                   == (StgWord)&stg_MUT_ARR_PTRS_FROZEN_CLEAN_info
+                   && r->gen_no > 0) {
+            recordMutableGen_GC((StgClosure *)a, r->gen_no);
+        }
+    }
+
+    gct->eager_promotion = saved_eager_promotion;
+}
+
+// Scavenge a range of an array, first handing out its upper halves to
+// other threads.
+static void
+scavenge_range (scav_range *r)
+{
+    scav_range *upper;
+    W_ mid;
+
+    while (r->to - r->from > SCAV_RANGE_CARDS &&
+           gct->n_ranges < SCAV_RANGE_POOL) {
+        mid = r->from + (r->to - r->from) / 2;
+        upper = &gct->ranges[gct->n_ranges];
+        *upper = *r;
+        upper->from = mid;
+        if (!pushWSDeque(gct->range_q, upper)) break;
+        gct->n_ranges++;
+        r->to = mid;
+    }
+    scavenge_range_cards(r);
+}
+
+// Split a large array into ranges that other GC threads can steal.
+// Returns false if the object should be scavenged as usual.
+static bool
+split_large_array (StgPtr p, uint32_t gen_no)
+{
+    StgMutArrPtrs *a = (StgMutArrPtrs *)p;
+    scav_range *r;
+    bool frozen;
+
+    switch (get_itbl((StgClosure *)p)->type) {
+    case MUT_ARR_PTRS_CLEAN:
+    case MUT_ARR_PTRS_DIRTY:
+        frozen = false;
+        break;
+    case MUT_ARR_PTRS_FROZEN_CLEAN:
+    case MUT_ARR_PTRS_FROZEN_DIRTY:
+        frozen = true;
+        break;
+    default:
+        return false;
+    }
+
+    if (mutArrPtrsCards(a->ptrs) <= SCAV_RANGE_MIN_CARDS ||
+        gct->n_ranges >= SCAV_RANGE_POOL) {
+        return false;
+    }
+
+    if (frozen) {
+        SET_INFO((StgClosure *)a, &stg_MUT_ARR_PTRS_FROZEN_CLEAN_info);
+    } else {
+        SET_INFO((StgClosure *)a, &stg_MUT_ARR_PTRS_CLEAN_info);
+        if (gen_no > 0) {
+            recordMutableGen_GC((StgClosure *)a, gen_no);
+        }
+    }
+
+    r = &gct->ranges[gct->n_ranges++];
+    r->arr    = a;
+    r->from   = 0;
+    r->to     = mutArrPtrsCards(a->ptrs);
+    r->gen_no = gen_no;
+    r->frozen = frozen;
+    r->marked = false;
+
+    gct->split_arrays++;
+    // the header and card table; the payload is counted by the ranges
+    gct->scanned += mut_arr_ptrs_sizeW(a) - a->ptrs;
+
+    scavenge_range(r);
+    return true;
+}
+
+// Split the marked cards of a dirty MUT_ARR_PTRS from the mutable list
+// of gen_no into ranges.  Returns false if the array should be
+// scavenged as usual.
+static bool
+split_marked_array (StgMutArrPtrs *a, uint32_t gen_no)
+{
+    scav_range *r;
+
+    if (mutArrPtrsCards(a->ptrs) <= SCAV_RANGE_MIN_CARDS ||
+        gct->n_ranges >= SCAV_RANGE_POOL) {
+        return false;
+    }
+
+    SET_INFO((StgClosure *)a, &stg_MUT_ARR_PTRS_CLEAN_info);
+    recordMutableGen_GC((StgClosure *)a, gen_no);
+
+    r = &gct->ranges[gct->n_ranges++];
+    r->arr    = a;
+    r->from   = 0;
+    r->to     = mutArrPtrsCards(a->ptrs);
+    r->gen_no = gen_no;
+    r->frozen = false;
+    r->marked = true;
+
+    gct->split_arrays++;
+    scavenge_range(r);
+    return true;
+}
+
+#endif /* PARALLEL_GC */
+
 // scavenge only the marked areas of a MUT_ARR_PTRS
 static StgPtr scavenge_mut_arr_ptrs_marked (StgMutArrPtrs *a)
 {
-    W_ m;
+    W_ m, n;
     StgPtr p, q;
     bool any_failed;
 
     any_failed = false;
-    for (m = 0; m < mutArrPtrsCards(a->ptrs); m++)
+    n = mutArrPtrsCards(a->ptrs);
+    for (m = next_marked_card(a, 0, n); m < n;
+         m = next_marked_card(a, m + 1, n))
     {
-        if (*mutArrPtrsCard(a,m) != 0) {
-            p = (StgPtr)&a->payload[m << MUT_ARR_PTRS_CARD_BITS];
-            q = stg_min(p + (1 << MUT_ARR_PTRS_CARD_BITS),
-                        (StgPtr)&a->payload[a->ptrs]);
-            for (; p < q; p++) {
-                evacuate((StgClosure**)p);
-            }
-            if (gct->failed_to_evac) {
-                any_failed = true;
-                gct->failed_to_evac = false;
-            } else {
-                *mutArrPtrsCard(a,m) = 0;
-            }
+        p = (StgPtr)&a->payload[m << MUT_ARR_PTRS_CARD_BITS];
+        q = stg_min(p + (1 << MUT_ARR_PTRS_CARD_BITS),
+                    (StgPtr)&a->payload[a->ptrs]);
+        for (; p < q; p++) {
+            evacuate((StgClosure**)p);
+        }
+        if (gct->failed_to_evac) {
+            any_failed = true;
+            gct->failed_to_evac = false;
+        } else {
+            *mutArrPtrsCard(a,m) = 0;
         }
     }
 
@@ -371,7 +604,8 @@ scavenge_thunk_srt(const StgInfoTable *info)
 {
     StgThunkInfoTable *thunk_info;
 
-    if (!major_gc) return;
+    // see Note [Static root cache] in StaticRoots.c
+    if (!major_gc || static_roots_cached) return;
 
     thunk_info = itbl_to_thunk_itbl(info);
     if (thunk_info->i.srt) {
@@ -385,7 +619,7 @@ scavenge_fun_srt(const StgInfoTable *info)
 {
     StgFunInfoTable *fun_info;
 
-    if (!major_gc) return;
+    if (!major_gc || static_roots_cached) return;
 
     fun_info = itbl_to_fun_itbl(info);
     if (fun_info->i.srt) {
@@ -394,6 +628,104 @@ scavenge_fun_srt(const StgInfoTable *info)
     }
 }
 
+/* Note [Prefetching in scavenge_block]
+   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+   Scavenging a heap of small constructors (Map, IntMap, lists) is
+   dominated by cache misses: for every pointer field, evacuate() reads
+   the header of an object in from-space that is usually not in the
+   cache, and the CPU waits for each one in turn.
+
+   With +RTS --gc-prefetch=<n>, scavenge_block() keeps a second cursor,
+   ahead, a little in front of the scan pointer.  For each object it
+   passes, it issues a prefetch for every closure that the object's
+   pointer fields refer to, and records the number of fields in a small
+   FIFO (prefetch_q).  The cursor is kept about <n> pointer fields ahead
+   of the scan pointer, so by the time evacuate() gets to a field the
+   object it points to should already be on its way into the cache.
+   Evacuation still happens in the usual order, so nothing else about
+   scavenging changes.
+
+   Only objects whose pointer fields are easy to find (constructors,
+   functions, thunks and byte arrays) are prefetched; the cursor stops
+   at anything else until the scan pointer has passed it.  The to-space
+   objects the cursor reads are complete, because this thread copied
+   them (or, for a stolen block, the thread that gave the block away
+   finished copying them first).
+*/
+
+#define GC_PREFETCH_Q 64   // entries in prefetch_q, max --gc-prefetch
+
+#if defined(__GNUC__)
+#define prefetch_for_evac(c) __builtin_prefetch(UNTAG_CLOSURE(c), 1, 3)
+#else
+#define prefetch_for_evac(c)
+#endif
+
+// Prefetch the targets of the pointer fields of the object at p.
+// Returns the size of the object and sets *n_ptrs, or returns 0 if p
+// isn't an object we know how to prefetch for.
+static uint32_t
+prefetch_ptrs (StgPtr p, uint32_t *n_ptrs)
+{
+    const StgInfoTable *info = get_itbl((StgClosure *)p);
+    StgClosure **fields;
+    uint32_t i, ptrs, size;
+
+    switch (info->type) {
+    case CONSTR_0_1:
+    case CONSTR_0_2:
+    case FUN_0_1:
+    case FUN_0_2:
+    case THUNK_0_1:
+    case THUNK_0_2:
+        *n_ptrs = 0;
+        return closure_sizeW_((StgClosure *)p, info);
+    case CONSTR_1_0:
+    case CONSTR_1_1:
+    case CONSTR_2_0:
+    case CONSTR:
+    case CONSTR_NOCAF:
+    case FUN_1_0:
+    case FUN_1_1:
+    case FUN_2_0:
+    case FUN:
+        fields = ((StgClosure *)p)->payload;
+        break;
+    case THUNK_1_0:
+    case THUNK_1_1:
+    case THUNK_2_0:
+    case THUNK:
+        fields = ((StgThunk *)p)->payload;
+        break;
+    case ARR_WORDS:
+        *n_ptrs = 0;
+        return arr_words_sizeW((StgArrBytes *)p);
+    default:
+        return 0;
+    }
+
+    switch (info->type) {
+    case CONSTR_1_0: case CONSTR_1_1: case FUN_1_0: case FUN_1_1:
+    case THUNK_1_0: case THUNK_1_1:
+        ptrs = 1;
+        break;
+    case CONSTR_2_0: case FUN_2_0: case THUNK_2_0:
+        ptrs = 2;
+        break;
+    default:
+        ptrs = info->layout.payload.ptrs;
+        break;
+    }
+
+    size = closure_sizeW_((StgClosure *)p, info);
+    for (i = 0; i < ptrs; i++) {
+        prefetch_for_evac(fields[i]);
+    }
+    *n_ptrs = ptrs;
+    return size;
+}
+
 /* -----------------------------------------------------------------------------
    Scavenge a block from the given scan pointer up to bd->free.
 
@@ -414,6 +746,12 @@ scavenge_block (bdescr *bd)
   bool saved_eager_promotion;
   gen_workspace *ws;
 
+  // See Note [Prefetching in scavenge_block]
+  const uint32_t prefetch_depth = RtsFlags.GcFlags.prefetchDepth;
+  uint32_t prefetch_q[GC_PREFETCH_Q];
+  uint32_t pq_head = 0, pq_len = 0, pq_ptrs = 0;
+  StgPtr ahead;
+
   debugTrace(DEBUG_gc, "scavenging block %p (gen %d) @ %p",
              bd->start, bd->gen_no, bd->u.scan);
 
@@ -425,6 +763,7 @@ scavenge_block (bdescr *bd)
   ws = &gct->gens[bd->gen->no];
 
   p = bd->u.scan;
+  ahead = p;
 
   // we might be evacuating into the very object that we're
   // scavenging, so we have to check the real bd->free pointer each
@@ -433,9 +772,36 @@ scavenge_block (bdescr *bd)
 
     ASSERT(bd->link == NULL);
     ASSERT(LOOKS_LIKE_CLOSURE_PTR(p));
+
+    if (prefetch_depth > 0) {
+        uint32_t size, n_ptrs;
+        if (ahead < p) {
+            // the cursor got stuck behind the scan pointer
+            ahead = p;
+            pq_len = pq_ptrs = 0;
+        }
+        while (pq_ptrs < prefetch_depth && pq_len < GC_PREFETCH_Q &&
+               (ahead < bd->free ||
+                (bd == ws->todo_bd && ahead < ws->todo_free))) {
+            size = prefetch_ptrs(ahead, &n_ptrs);
+            if (size == 0) break;
+            prefetch_q[(pq_head + pq_len) % GC_PREFETCH_Q] = n_ptrs;
+            pq_len++;
+            pq_ptrs += n_ptrs;
+            ahead += size;
+        }
+        if (pq_len > 0) {
+            // the object at p is the oldest one in the queue
+            pq_ptrs -= prefetch_q[pq_head];
+            pq_head = (pq_head + 1) % GC_PREFETCH_Q;
+            pq_len--;
+        }
+    }
+
     info = get_itbl((StgClosure *)p);
 
     ASSERT(gct->thunk_selector_depth == 0);
+    ASSERT(gct->sel_sp == 0);
 
     q = p;
     switch (info->type) {
@@ -1628,6 +1994,16 @@ scavenge_mutable_list(bdescr *bd, generation *gen)
             case MUT_ARR_PTRS_DIRTY:
             {
                 bool saved_eager_promotion;
+
+#if defined(PARALLEL_GC)
+                // See Note [Splitting large arrays]
+                if (work_stealing &&
+                    split_marked_array((StgMutArrPtrs *)p, gen_no)) {
+                    gct->evac_gen_no = gen_no;
+                    continue;
+                }
+#endif
+
                 saved_eager_promotion = gct->eager_promotion;
                 gct->eager_promotion = false;
 
@@ -1661,6 +2037,13 @@ void
 scavenge_capability_mut_lists (Capability *cap)
 {
     uint32_t g;
+    Time start = 0;
+
+    // only timed for +RTS -s with --card-table, to compare with the
+    // card scan
+    if (RtsFlags.GcFlags.cardTable) {
+        start = getProcessElapsedTime();
+    }
 
     /* Mutable lists from each generation > N
      * we want to *scavenge* these roots, not evacuate them: they're not
@@ -1673,6 +2056,88 @@ scavenge_capability_mut_lists (Capability *cap)
         freeChain_sync(cap->saved_mut_lists[g]);
         cap->saved_mut_lists[g] = NULL;
     }
+
+    if (RtsFlags.GcFlags.cardTable) {
+        gct->mut_list_time += getProcessElapsedTime() - start;
+    }
+}
+
+/* -----------------------------------------------------------------------------
+   Scanning the card blocks.
+
+   With +RTS --card-table, the MUT_VARs, MVARs and TVARs in the card
+   blocks of the generations > N that have been written to since the
+   last GC are roots, like the mutable lists.  They are found in the
+   dirty cards of the blocks rather than on a list; see Note [Card
+   table] in CardTable.c.
+   -------------------------------------------------------------------------- */
+
+#if defined(BLOCK_CARDS)
+static void
+scavenge_card_block (bdescr *bd)
+{
+    StgWord8 cards[BLOCK_CARDS];
+    const StgInfoTable *info;
+    StgPtr p, end;
+    uint32_t c;
+
+    memcpy(cards, bd->cards, BLOCK_CARDS);
+    memset(bd->cards, 0, BLOCK_CARDS);
+
+    // nothing after the last dirty card needs looking at
+    for (c = BLOCK_CARDS; c > 0 && cards[c-1] == 0; c--) {}
+    end = stg_min(bd->free, bd->start + c * CARD_SIZE_W);
+
+    // The block only has fixed-size objects in it, so we can walk it
+    // from the start.  Clean objects don't point into a younger
+    // generation, so only the dirty ones in dirty cards are scavenged.
+    for (p = bd->start; p < end; p += closure_sizeW((StgClosure *)p)) {
+        ASSERT(LOOKS_LIKE_CLOSURE_PTR(p));
+        if (cards[CARD_OF(p)] == 0) {
+            continue;
+        }
+        info = ((StgClosure *)p)->header.info;
+        if (info == &stg_MUT_VAR_DIRTY_info ||
+            info == &stg_MVAR_DIRTY_info ||
+            info == &stg_TVAR_DIRTY_info) {
+            if (scavenge_one(p)) {
+                // didn't manage to promote everything, so keep the
+                // card dirty.
+                bd->cards[CARD_OF(p)] = 1;
+            }
+        }
+    }
+}
+#endif
+
+void
+scavenge_card_blocks (void)
+{
+#if defined(BLOCK_CARDS)
+    bdescr **bds;
+    W_ i, n;
+    uint32_t g;
+    Time start;
+
+    if (!RtsFlags.GcFlags.cardTable) {
+        return;
+    }
+
+    start = getProcessElapsedTime();
+
+    // in reverse generation order, as for the mutable lists
+    for (g = RtsFlags.GcFlags.generations-1; g > N; g--) {
+        gct->evac_gen_no = g;
+        while ((bds = claimCardBlocks(&generations[g], &n)) != NULL) {
+            for (i = 0; i < n; i++) {
+                ASSERT(bds[i]->flags & BF_CARDS);
+                scavenge_card_block(bds[i]);
+            }
+        }
+    }
+
+    gct->card_scan_time += getProcessElapsedTime() - start;
+#endif
 }
 
 /* -----------------------------------------------------------------------------
@@ -1688,8 +2153,13 @@ scavenge_static(void)
 {
   StgClosure *flagged_p, *p;
   const StgInfoTable *info;
+  Time start = 0;
 
   debugTrace(DEBUG_gc, "scavenging static objects");
+  // only timed for +RTS -s with --cache-static-roots
+  if (RtsFlags.GcFlags.staticRootsInterval > 1) {
+      start = getProcessElapsedTime();
+  }
 
   /* Always evacuate straight to the oldest generation for static
    * objects */
@@ -1776,6 +2246,10 @@ scavenge_static(void)
 
     ASSERT(gct->failed_to_evac == false);
   }
+
+  if (RtsFlags.GcFlags.staticRootsInterval > 1) {
+      gct->static_time += getProcessElapsedTime() - start;
+  }
 }
 
 /* -----------------------------------------------------------------------------
@@ -1901,7 +2375,7 @@ scavenge_stack(StgPtr p, StgPtr stack_end)
         p = scavenge_small_bitmap(p, size, bitmap);
 
     follow_srt:
-        if (major_gc && info->i.srt) {
+        if (major_gc && !static_roots_cached && info->i.srt) {
             StgClosure *srt = (StgClosure*)GET_SRT(info);
             evacuate(&srt);
         }
@@ -1991,6 +2465,14 @@ scavenge_large (gen_workspace *ws)
         }
         RELEASE_SPIN_LOCK(&ws->gen->sync);
 
+#if defined(PARALLEL_GC)
+        // See Note [Splitting large arrays]
+        if (work_stealing && split_large_array(p, ws->gen->no)) {
+            gct->evac_gen_no = ws->gen->no;
+            continue;
+        }
+#endif
+
         if (scavenge_one(p)) {
             if (ws->gen->no > 0) {
                 recordMutableGen_GC((StgClosure *)p, ws->gen->no);
@@ -2061,6 +2543,23 @@ loop:
             did_something = true;
             break;
         }
+
+        // Nothing else to do in this gen: scavenge our partly full
+        // blocks on other NUMA nodes (Note [NUMA-affine evacuation]).
+        if ((bd = grab_node_todo_block(ws)) != NULL) {
+            scavenge_block(bd);
+            did_something = true;
+            break;
+        }
+
+#if defined(BLOCK_CARDS)
+        // ... and our card block (Note [Card table] in CardTable.c).
+        if ((bd = grab_card_todo_block(ws)) != NULL) {
+            scavenge_block(bd);
+            did_something = true;
+            break;
+        }
+#endif
     }
 
     if (did_something) {
@@ -2068,8 +2567,28 @@ loop:
         goto loop;
     }
 
+#if defined(PARALLEL_GC)
+    // ranges of large arrays that nobody has stolen yet
+    {
+        scav_range *r = popWSDeque(gct->range_q);
+        if (r != NULL) {
+            scavenge_range(r);
+            did_anything = true;
+            goto loop;
+        }
+    }
+#endif
+
 #if defined(THREADED_RTS)
     if (work_stealing) {
+#if defined(PARALLEL_GC)
+        scav_range *r = steal_scav_range();
+        if (r != NULL) {
+            scavenge_range(r);
+            did_anything = true;
+            goto loop;
+        }
+#endif
         // look for work to steal
         for (g = RtsFlags.GcFlags.generations-1; g >= 0; g--) {
             if ((bd = steal_todo_block(g)) != NULL) {
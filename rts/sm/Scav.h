@@ -17,10 +17,12 @@
 
 void    scavenge_loop (void);
 void    scavenge_capability_mut_lists (Capability *cap);
+void    scavenge_card_blocks (void);
 
 #if defined(THREADED_RTS)
 void    scavenge_loop1 (void);
 void    scavenge_capability_mut_Lists1 (Capability *cap);
+void    scavenge_card_blocks1 (void);
 #endif
 
 #include "EndPrivate.h"
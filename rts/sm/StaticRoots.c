@@ -0,0 +1,159 @@
+/* -----------------------------------------------------------------------------
+ *
+ * (c) The GHC Team 2019
+ *
+ * A cache of the CAFs reachable from the static objects, so that most
+ * major GCs don't have to walk them.
+ *
+ * Documentation on the architecture of the Storage Manager can be
+ * found in the online commentary:
+ *
+ *   https://gitlab.haskell.org/ghc/ghc/wikis/commentary/rts/storage
+ *
+ * ---------------------------------------------------------------------------*/
+
+#include "PosixSource.h"
+#include "Rts.h"
+
+#include "RtsUtils.h"
+#include "Storage.h"
+#include "LinkerInternals.h"
+#include "ProfHeap.h"
+#include "Trace.h"
+#include "StaticRoots.h"
+
+/* Note [Static root cache]
+   ~~~~~~~~~~~~~~~~~~~~~~~~
+
+   A minor GC ignores static objects: a CAF that has been entered is on
+   the mutable list of the oldest generation (see newCAF()), and that is
+   the only way from a static object into the heap.  A major GC has to
+   find out which CAFs are still alive, so evacuate() chains every
+   static object it meets onto gct->static_objects, and
+   scavenge_static() follows their SRTs and fields in turn.  In a big
+   program most of that graph is the same from one major GC to the
+   next, and walking it can be a noticeable part of the pause.
+
+   With +RTS --cache-static-roots=<n> only one major GC in n walks the
+   static objects.  Afterwards we keep the CAFs it found alive (the
+   IND_STATICs on the GC threads' scavenged_static_objects lists) in an
+   array here, and newCAF() and newGCdCAF() (for object code loaded by
+   the linker) append each CAF that is entered after that, so the array
+   holds every CAF that may be alive.  The other
+   major GCs don't toggle static_flag, evacuate() ignores static
+   objects just as it does in a minor GC, and markCAFs() evacuates the
+   indirectees of the CAFs in the array instead.  The static link
+   fields are left as the last walk set them, so the next walk finds
+   them as it expects.
+
+   The price is that a CAF that becomes unreachable is only collected
+   by the next walk, up to n-1 major GCs later.  The DEBUG RTS only
+   checks for entries to GC'd CAFs (gcCAFs()) after a walk.
+
+   The static objects are always walked while there is object code to
+   unload, since checkUnload() needs the list of live static objects,
+   and when retainer profiling, which uses the static link fields.  So
+   the array never keeps a CAF of unloaded code: the walk that lets
+   checkUnload() free the code also rebuilds the array without it.
+
+   With the cache enabled, +RTS -s shows the time the GC spends on
+   static objects and CAFs, and how many major GCs used the cache.
+*/
+
+bool static_roots_cached = false;
+
+W_ static_walks_skipped = 0;
+
+// The CAFs found by the last walk, then those entered since.  Protected
+// by the SM lock; only read by the GC.
+static StgIndStatic **static_roots = NULL;
+static W_ n_static_roots = 0;
+static W_ static_roots_size = 0;
+
+// Major GCs since the static objects were last walked
+static uint32_t gcs_since_walk = 0;
+
+static void
+addStaticRoot (StgIndStatic *caf)
+{
+    if (n_static_roots == static_roots_size) {
+        static_roots_size = stg_max(1024, static_roots_size * 2);
+        static_roots = stgReallocBytes(static_roots,
+                                       static_roots_size
+                                           * sizeof(StgIndStatic *),
+                                       "addStaticRoot");
+    }
+    static_roots[n_static_roots++] = caf;
+}
+
+void
+freeStaticRoots (void)
+{
+    stgFree(static_roots);
+    static_roots = NULL;
+    n_static_roots = 0;
+    static_roots_size = 0;
+}
+
+void
+recordNewCAF (StgIndStatic *caf)
+{
+    addStaticRoot(caf);
+}
+
+bool
+useStaticRootCache (void)
+{
+    uint32_t interval = RtsFlags.GcFlags.staticRootsInterval;
+
+    if (interval <= 1 || unloaded_objects != NULL) {
+        gcs_since_walk = 0;
+        return false;
+    }
+#if defined(PROFILING)
+    if (doingRetainerProfiling()) {
+        gcs_since_walk = 0;
+        return false;
+    }
+#endif
+
+    if (++gcs_since_walk >= interval) {
+        gcs_since_walk = 0;
+        return false;
+    }
+    static_walks_skipped++;
+    debugTrace(DEBUG_gc, "using %" FMT_Word " cached CAFs", n_static_roots);
+    return true;
+}
+
+void
+markStaticRoots (evac_fn evac, void *user)
+{
+    W_ i;
+
+    for (i = 0; i < n_static_roots; i++) {
+        evac(user, &static_roots[i]->indirectee);
+    }
+}
+
+void
+resetStaticRoots (void)
+{
+    n_static_roots = 0;
+}
+
+void
+addStaticRoots (StgClosure *static_objects)
+{
+    StgClosure *p, *link;
+    const StgInfoTable *info;
+
+    for (p = static_objects; p != END_OF_STATIC_OBJECT_LIST; p = link) {
+        p = UNTAG_STATIC_LIST_PTR(p);
+        info = get_itbl(p);
+        if (info->type == IND_STATIC) {
+            addStaticRoot((StgIndStatic *)p);
+        }
+        link = *STATIC_LINK(info, p);
+    }
+}
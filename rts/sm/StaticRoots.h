@@ -0,0 +1,44 @@
+/* -----------------------------------------------------------------------------
+ *
+ * (c) The GHC Team 2019
+ *
+ * A cache of the CAFs reachable from the static objects, so that most
+ * major GCs don't have to walk them.
+ *
+ * Documentation on the architecture of the Storage Manager can be
+ * found in the online commentary:
+ *
+ *   https://gitlab.haskell.org/ghc/ghc/wikis/commentary/rts/storage
+ *
+ * ---------------------------------------------------------------------------*/
+
+#pragma once
+
+#include "BeginPrivate.h"
+
+// True during a major GC that takes its CAFs from the cache instead of
+// walking the static objects.
+extern bool static_roots_cached;
+
+// Major GCs that used the cache, for +RTS -s
+extern W_ static_walks_skipped;
+
+void freeStaticRoots (void);
+
+// Remember a CAF that has just been entered.  The caller must hold the
+// SM lock.
+void recordNewCAF (StgIndStatic *caf);
+
+// Called at the start of a major GC: may we use the cache this time?
+bool useStaticRootCache (void);
+
+// Evacuate the indirectees of the cached CAFs (from markCAFs()).
+void markStaticRoots (evac_fn evac, void *user);
+
+// Replace the cache with the CAFs on a list of scavenged static
+// objects, after a GC that walked them.  Call resetStaticRoots() first,
+// then addStaticRoots() for the list of each GC thread.
+void resetStaticRoots (void);
+void addStaticRoots (StgClosure *static_objects);
+
+#include "EndPrivate.h"
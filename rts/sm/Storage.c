@@ -19,6 +19,13 @@
 #include "RtsUtils.h"
 #include "Stats.h"
 #include "BlockAlloc.h"
+#include "CardTable.h"
+#include "Decommit.h"
+#include "NonMoving.h"
+#include "Pacing.h"
+#include "Pretenure.h"
+#include "StaticRoots.h"
+#include "Sweep.h"
 #include "Weak.h"
 #include "Sanity.h"
 #include "Arena.h"
@@ -71,6 +78,16 @@ uint32_t n_nurseries;
  */
 volatile StgWord next_nursery[MAX_NUMA_NODES];
 
+/*
+ * Nursery chunks held back for capabilities that have not taken their
+ * quota yet (+RTS -Aauto).  See Note [Adaptive nursery sizing].
+ */
+static volatile StgWord nursery_reserved = 0;
+
+static W_   countFreeNurseryChunks (void);
+static void reserveNurseryChunks   (void);
+static void setNurseryQuotas       (void);
+
 #if defined(THREADED_RTS)
 /*
  * Storage manager mutex:  protects all the above state from
@@ -94,12 +111,16 @@ initGeneration (generation *gen, int g)
     gen->n_blocks = 0;
     gen->n_words = 0;
     gen->live_estimate = 0;
+    gen->n_unswept_blocks = 0;
     gen->old_blocks = NULL;
     gen->n_old_blocks = 0;
     gen->large_objects = NULL;
     gen->n_large_blocks = 0;
     gen->n_large_words = 0;
     gen->n_new_large_words = 0;
+    gen->n_pinned_free_words = 0;
+    gen->n_promoted_large_objects = 0;
+    gen->n_promoted_large_words = 0;
     gen->compact_objects = NULL;
     gen->n_compact_blocks = 0;
     gen->compact_blocks_in_import = NULL;
@@ -119,7 +140,6 @@ initGeneration (generation *gen, int g)
     gen->threads = END_TSO_QUEUE;
     gen->old_threads = END_TSO_QUEUE;
     gen->weak_ptr_list = NULL;
-    gen->old_weak_ptr_list = NULL;
 }
 
 void
@@ -174,13 +194,31 @@ initStorage (void)
   if (RtsFlags.GcFlags.compact || RtsFlags.GcFlags.sweep) {
       if (RtsFlags.GcFlags.generations == 1) {
           errorBelch("WARNING: compact/sweep is incompatible with -G1; disabled");
+          RtsFlags.GcFlags.concurrentMark = false;
       } else {
           oldest_gen->mark = 1;
-          if (RtsFlags.GcFlags.compact)
+          // -xn never moves objects, so it overrides -c
+          if (RtsFlags.GcFlags.compact && !RtsFlags.GcFlags.concurrentMark)
               oldest_gen->compact = 1;
       }
   }
 
+  /* See Note [Card table] in CardTable.c */
+  if (RtsFlags.GcFlags.cardTable) {
+#if !defined(BLOCK_CARDS)
+      errorBelch("WARNING: --card-table is not supported on this platform; disabled");
+      RtsFlags.GcFlags.cardTable = false;
+#else
+      if (RtsFlags.GcFlags.concurrentMark) {
+          errorBelch("WARNING: --card-table is incompatible with -xn; disabled");
+          RtsFlags.GcFlags.cardTable = false;
+      }
+#endif
+  }
+  initCardTable();
+  initPretenure();
+  initPacing();
+
   generations[0].max_blocks = 0;
 
   dyn_caf_list = (StgIndStatic*)END_OF_CAF_LIST;
@@ -215,6 +253,10 @@ initStorage (void)
                      RtsFlags.GcFlags.minAllocAreaSize * BLOCK_SIZE,
                      MBLOCK_SIZE,
                      BLOCK_SIZE);
+
+  startDecommitThread();
+  startNonMovingThread();
+  startSweepThread();
 }
 
 void storageAddCapabilities (uint32_t from, uint32_t to)
@@ -263,6 +305,17 @@ void storageAddCapabilities (uint32_t from, uint32_t to)
      */
     assignNurseriesToCapabilities(from,to);
 
+    // New capabilities start with an even share of what the others have
+    // not claimed; the next GC sizes them properly.
+    if (RtsFlags.GcFlags.minAllocAreaSizeAuto) {
+        for (n = from; n < to; n++) {
+            capabilities[n]->nursery_alloc_mark =
+                capabilities[n]->total_allocated;
+        }
+        setNurseryQuotas();
+        reserveNurseryChunks();
+    }
+
     // allocate a block for each mut list
     for (n = from; n < to; n++) {
         for (g = 1; g < RtsFlags.GcFlags.generations; g++) {
@@ -282,6 +335,9 @@ void storageAddCapabilities (uint32_t from, uint32_t to)
 void
 exitStorage (void)
 {
+    stopDecommitThread();
+    stopNonMovingThread();
+    stopSweepThread();
     updateNurseriesStats();
     stat_exit();
 }
@@ -299,6 +355,10 @@ freeStorage (bool free_heap)
     freeThreadLocalKey(&gctKey);
 #endif
     freeGcThreads();
+    freeCardTable();
+    freePretenure();
+    freePacing();
+    freeStaticRoots();
 }
 
 /* -----------------------------------------------------------------------------
@@ -453,6 +513,13 @@ newCAF(StgRegTable *reg, StgIndStatic *caf)
                              regTableToCapability(reg), oldest_gen->no);
         }
 
+        // See Note [Static root cache] in StaticRoots.c
+        if (RtsFlags.GcFlags.staticRootsInterval > 1) {
+            ACQUIRE_SM_LOCK;
+            recordNewCAF(caf);
+            RELEASE_SM_LOCK;
+        }
+
 #if defined(DEBUG)
         // In the DEBUG rts, we keep track of live CAFs by chaining them
         // onto a list debug_caf_list.  This is so that we can tell if we
@@ -530,6 +597,13 @@ StgInd* newGCdCAF (StgRegTable *reg, StgIndStatic *caf)
                          regTableToCapability(reg), oldest_gen->no);
     }
 
+    // See Note [Static root cache] in StaticRoots.c
+    if (RtsFlags.GcFlags.staticRootsInterval > 1) {
+        ACQUIRE_SM_LOCK;
+        recordNewCAF(caf);
+        RELEASE_SM_LOCK;
+    }
+
     return bh;
 }
 
@@ -612,6 +686,7 @@ assignNurseriesToCapabilities (uint32_t from, uint32_t to)
         node = capabilities[i]->node;
         assignNurseryToCapability(capabilities[i], next_nursery[node]);
         next_nursery[node] += n_numa_nodes;
+        capabilities[i]->nursery_chunks = 1;
     }
 }
 
@@ -643,6 +718,10 @@ resetNurseries (void)
     }
     assignNurseriesToCapabilities(0, n_capabilities);
 
+    if (RtsFlags.GcFlags.minAllocAreaSizeAuto) {
+        reserveNurseryChunks();
+    }
+
 #if defined(DEBUG)
     bdescr *bd;
     for (n = 0; n < n_nurseries; n++) {
@@ -744,8 +823,8 @@ resizeNurseries (W_ blocks)
     resizeNurseriesEach(blocks / n_nurseries);
 }
 
-bool
-getNewNursery (Capability *cap)
+static bool
+takeNurseryChunk (Capability *cap)
 {
     StgWord i;
     uint32_t node = cap->node;
@@ -782,6 +861,159 @@ getNewNursery (Capability *cap)
     }
 }
 
+/* Note [Adaptive nursery sizing]
+   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+   With a fixed -A every capability gets the same nursery, so an idle
+   capability sits on memory that a busy one could use to GC less often.
+   With +RTS -Aauto the nursery is split into chunks (as with -n; the
+   chunk size defaults to 1/8 of -A) and each capability has a quota of
+   chunks that is recomputed at every GC in updateNurseryQuotas():
+
+     - the words each capability allocated since the last GC are taken
+       from cap->total_allocated (which covers both the nursery and
+       allocate(), see Note [allocation accounting]) and averaged with
+       the previous figure in cap->nursery_alloc_rate;
+
+     - every capability gets one chunk, and the rest of the chunks are
+       shared out in proportion to the smoothed rates.  The total is
+       still -A times the number of capabilities.
+
+   Between collections getNewNursery() gives a capability chunks freely
+   until it reaches its quota.  Chunks that other capabilities are still
+   entitled to are counted in nursery_reserved; a capability over its
+   quota can only borrow the chunks above that count, and if there are
+   none we GC.  The reservation is only approximate, since capabilities
+   take chunks concurrently, but it only decides when to GC.
+
+   The chosen quotas are emitted as EVENT_NURSERY_SIZE at every GC.
+*/
+
+bool
+getNewNursery (Capability *cap)
+{
+    bool borrowing = false;
+
+    if (RtsFlags.GcFlags.minAllocAreaSizeAuto) {
+        if (cap->nursery_chunks >= cap->nursery_quota) {
+            if (countFreeNurseryChunks() <= nursery_reserved) {
+                return false;
+            }
+            borrowing = true;
+        }
+    }
+
+    if (!takeNurseryChunk(cap)) {
+        return false;
+    }
+
+    if (RtsFlags.GcFlags.minAllocAreaSizeAuto) {
+        cap->nursery_chunks++;
+        if (!borrowing) {
+            atomic_dec(&nursery_reserved);
+        }
+    }
+    return true;
+}
+
+// The number of nursery chunks not yet handed out to a capability.
+// Only a snapshot, as other capabilities may be taking chunks.
+static W_
+countFreeNurseryChunks (void)
+{
+    uint32_t n;
+    W_ i, free = 0;
+
+    for (n = 0; n < n_numa_nodes; n++) {
+        i = next_nursery[n];
+        if (i < n_nurseries) {
+            free += (n_nurseries - i + n_numa_nodes - 1) / n_numa_nodes;
+        }
+    }
+    return free;
+}
+
+// Reserve the chunks each capability is still owed under its quota.
+// Called with all the capabilities stopped.
+static void
+reserveNurseryChunks (void)
+{
+    uint32_t i;
+    W_ reserved = 0;
+
+    for (i = 0; i < n_capabilities; i++) {
+        if (capabilities[i]->nursery_quota > capabilities[i]->nursery_chunks) {
+            reserved += capabilities[i]->nursery_quota
+                - capabilities[i]->nursery_chunks;
+        }
+    }
+    nursery_reserved = reserved;
+}
+
+// Share out the nursery chunks in proportion to the smoothed allocation
+// rates, after giving every capability one chunk.
+static void
+setNurseryQuotas (void)
+{
+    uint32_t i;
+    W_ spare;
+    StgWord64 total_rate = 0;
+
+    spare = n_nurseries > n_capabilities ? n_nurseries - n_capabilities : 0;
+
+    for (i = 0; i < n_capabilities; i++) {
+        total_rate += capabilities[i]->nursery_alloc_rate;
+    }
+
+    for (i = 0; i < n_capabilities; i++) {
+        Capability *cap = capabilities[i];
+        if (total_rate == 0) {
+            cap->nursery_quota = 1 + spare / n_capabilities;
+        } else {
+            cap->nursery_quota = 1 + (W_)((StgWord64)spare
+                                          * cap->nursery_alloc_rate
+                                          / total_rate);
+        }
+    }
+}
+
+//
+// Recompute each capability's nursery quota from its allocation since
+// the last GC (+RTS -Aauto).  Called during GC, after
+// updateNurseriesStats() and once the nursery has been resized.
+//
+void
+updateNurseryQuotas (void)
+{
+    uint32_t i;
+    W_ allocated;
+
+    for (i = 0; i < n_capabilities; i++) {
+        Capability *cap = capabilities[i];
+        allocated = cap->total_allocated - cap->nursery_alloc_mark;
+        cap->nursery_alloc_mark = cap->total_allocated;
+        if (cap->nursery_alloc_rate == 0) {
+            cap->nursery_alloc_rate = allocated;
+        } else {
+            cap->nursery_alloc_rate = (cap->nursery_alloc_rate + allocated) / 2;
+        }
+    }
+
+    setNurseryQuotas();
+
+    for (i = 0; i < n_capabilities; i++) {
+        Capability *cap = capabilities[i];
+        debugTrace(DEBUG_gc, "cap %d: nursery quota %" FMT_Word
+                   " chunks, allocating %" FMT_Word " words per GC",
+                   i, cap->nursery_quota, cap->nursery_alloc_rate);
+        traceEventNurserySize(cap,
+                              (W_)cap->nursery_quota
+                                * RtsFlags.GcFlags.nurseryChunkSize
+                                * BLOCK_SIZE,
+                              cap->nursery_alloc_rate * sizeof(W_));
+    }
+}
+
 /* -----------------------------------------------------------------------------
    move_STACK is called to update the TSO structure after it has been
    moved from one place to another.
@@ -882,8 +1114,8 @@ allocateMightFail (Capability *cap, W_ n)
         // Only credit allocation after we've passed the size check above
         accountAllocation(cap, n);
 
+        bd = allocGroupCap(cap,req_blocks);
         ACQUIRE_SM_LOCK
-        bd = allocGroupOnNode(cap->node,req_blocks);
         dbl_link_onto(bd, &g0->large_objects);
         g0->n_large_blocks += bd->blocks; // might be larger than req_blocks
         g0->n_new_large_words += n;
@@ -911,10 +1143,8 @@ allocateMightFail (Capability *cap, W_ n)
         if (bd == NULL) {
             // The nursery is empty: allocate a fresh block (we can't
             // fail here).
-            ACQUIRE_SM_LOCK;
-            bd = allocBlockOnNode(cap->node);
+            bd = allocBlockCap(cap);
             cap->r.rNursery->n_blocks++;
-            RELEASE_SM_LOCK;
             initBdescr(bd, g0, g0);
             bd->flags = 0;
             // If we had to allocate a new block, then we'll GC
@@ -968,7 +1198,9 @@ allocateMightFail (Capability *cap, W_ n)
 
    We allocate small pinned objects into a single block, allocating a
    new block when the current one overflows.  The block is chained
-   onto the large_object_list of generation 0.
+   onto the large_object_list of generation 0.  Objects of up to
+   PINNED_SLOT_MAX_W words go into size-class blocks instead, see
+   Note [Pinned size classes].
 
    NOTE: The GC can't in general handle pinned objects.  This
    interface is only safe to use for ByteArrays, which have no
@@ -987,6 +1219,242 @@ allocateMightFail (Capability *cap, W_ n)
    this returns NULL on heap overflow.
    ------------------------------------------------------------------------- */
 
+/* Note [Pinned size classes]
+   ~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+   A block of pinned objects is kept alive by the GC as a whole, as long
+   as any object in it is live.  A program that pins lots of small
+   buffers and keeps a few of them can end up with a heap that is
+   mostly dead pinned objects, with nothing to reclaim the space.
+
+   So small pinned objects (up to PINNED_SLOT_MAX_W words) are
+   allocated in blocks that each hold a single size class, in slots of
+   that size.  There are 4 classes per power of two, so a slot wastes
+   at most a quarter of its size.  PINNED_SLOT_MAX_W is small enough
+   that a block holds at least 3 slots of every class, so the space left
+   over at the end of a block is less than a quarter of it too.  Each
+   block has a small header (see Storage.h) with a bitmap of the
+   occupied slots:
+
+     - allocatePinned() sets the bit of every slot it hands out.
+
+     - at the start of GC, prepare_collected_gen() clears the bitmaps of
+       the blocks in the generations being collected, and evacuate()
+       sets the bit of every live object it finds in them (as does
+       isAlive(), for weak pointer keys).  Since a block is evacuated
+       as a whole this costs one bit-set per live object.
+
+     - after GC, reusePinnedBlocks() looks at the blocks that survived
+       and hands those with at least a quarter of their slots free to
+       the capabilities (on the same NUMA node), on cap->pinned_reuse.
+       allocatePinned() fills the free slots of these blocks before
+       taking a fresh block.
+
+   A bit is only ever cleared at a GC that finds the object dead, so a
+   clear bit always means a free slot, even in a block of an older
+   generation whose bitmap was computed a while ago.  New objects put
+   in a reused block belong to that block's generation.  That's fine
+   since they are byte arrays, with no pointers for the write barrier
+   to track.
+
+   The block being filled for each class is held in
+   cap->pinned_class_blocks and marked BF_EVACUATED, as with
+   pinned_object_block below.  Reused blocks are already on the
+   large_objects list of some generation.  So at the start of each GC
+   the reuse lists drop the blocks of the generations being collected
+   (see collect_pinned_object_blocks()), and those that survive are
+   found again afterwards.
+
+   Nobody walks a pinned block linearly (see above), so the header and
+   the dead objects in free slots do no harm.  gen->n_pinned_free_words
+   counts the free slots as of the last GC of each generation, and is
+   reported as pinned_slop_bytes in the GC stats.  It overestimates a
+   little between collections of the generation, as slots get reused.
+
+   Pinned objects larger than PINNED_SLOT_MAX_W words but below the
+   large object threshold still share one block per capability,
+   bump-allocated.
+*/
+
+STATIC_INLINE uint32_t
+pinnedSizeClass (W_ n)
+{
+    uint32_t msb;
+
+    if (n <= 8) {
+        return n < 2 ? 0 : n - 2;
+    }
+    // 4 classes per power of two above 8 words
+    for (msb = 3; ((n - 1) >> (msb + 1)) != 0; msb++) {}
+    return 7 + (msb - 3) * 4 + (((n - 1) >> (msb - 2)) & 3);
+}
+
+STATIC_INLINE W_
+pinnedClassWords (uint32_t c)
+{
+    if (c < 7) {
+        return c + 2;
+    }
+    return (W_)(5 + (c - 7) % 4) << ((c - 7) / 4 + 1);
+}
+
+STATIC_INLINE W_
+pinnedSlots (bdescr *bd)
+{
+    return (BLOCK_SIZE_W - PINNED_HDR_W) / PINNED_SLOT_WORDS(bd);
+}
+
+// Get a block for pinned objects, preferably from the nursery.
+static bdescr *
+allocPinnedBlock (Capability *cap)
+{
+    bdescr *bd;
+
+    // We could just allocate a block, but that means taking a global
+    // lock and we really want to avoid that (benchmarks that allocate a
+    // lot of pinned objects scale really badly if we do this).
+    //
+    // So first, we try taking the next block from the nursery, in
+    // the same way as allocate().
+    bd = cap->r.rCurrentNursery->link;
+    if (bd == NULL) {
+        // The nursery is empty: allocate a fresh block (we can't fail
+        // here).
+        bd = allocBlockCap(cap);
+        initBdescr(bd, g0, g0);
+    } else {
+        newNurseryBlock(bd);
+        // we have a block in the nursery: steal it
+        cap->r.rCurrentNursery->link = bd->link;
+        if (bd->link != NULL) {
+            bd->link->u.back = cap->r.rCurrentNursery;
+        }
+        cap->r.rNursery->n_blocks -= bd->blocks;
+    }
+    return bd;
+}
+
+// Find a free slot in a size-class block at or after its next-slot
+// index, or return NULL if there is none.
+static StgPtr
+takePinnedSlot (bdescr *bd)
+{
+    StgWord *bitmap = PINNED_BITMAP(bd);
+    W_ size = PINNED_SLOT_WORDS(bd);
+    W_ n_slots = pinnedSlots(bd);
+    W_ i, w, bit;
+
+    for (i = PINNED_NEXT_SLOT(bd); i < n_slots; i++) {
+        w = i / BITS_IN(W_);
+        bit = (W_)1 << (i % BITS_IN(W_));
+        if (bitmap[w] == ~(W_)0) {
+            // skip the rest of a full bitmap word
+            i = (w + 1) * BITS_IN(W_) - 1;
+            continue;
+        }
+        if (!(bitmap[w] & bit)) {
+            bitmap[w] |= bit;
+            PINNED_NEXT_SLOT(bd) = i + 1;
+            return bd->start + PINNED_HDR_W + i * size;
+        }
+    }
+    PINNED_NEXT_SLOT(bd) = n_slots;
+    return NULL;
+}
+
+void
+clearPinnedSlots (bdescr *bd)
+{
+    memset(PINNED_BITMAP(bd), 0, PINNED_BITMAP_W * sizeof(W_));
+}
+
+static StgPtr
+allocatePinnedSlot (Capability *cap, W_ n)
+{
+    uint32_t c = pinnedSizeClass(n);
+    bdescr *bd;
+    StgPtr p;
+
+    accountAllocation(cap, n);
+    cap->total_allocated += n;
+
+    // fill the holes left in blocks that survived the last GC first
+    while ((bd = cap->pinned_reuse[c]) != NULL) {
+        p = takePinnedSlot(bd);
+        if (p != NULL) {
+            return p;
+        }
+        cap->pinned_reuse[c] = PINNED_REUSE_LINK(bd);
+    }
+
+    bd = cap->pinned_class_blocks[c];
+    if (bd != NULL) {
+        p = takePinnedSlot(bd);
+        if (p != NULL) {
+            return p;
+        }
+        // full: it goes to g0->large_objects at the next GC, like the
+        // blocks in allocatePinned() below.
+        dbl_link_onto(bd, &cap->pinned_object_blocks);
+    }
+
+    bd = allocPinnedBlock(cap);
+    bd->flags = BF_PINNED | BF_LARGE | BF_EVACUATED | BF_SLOTTED;
+    // the whole block counts as occupied for countOccupied() & co.
+    bd->free = bd->start + BLOCK_SIZE_W;
+    PINNED_SLOT_WORDS(bd) = pinnedClassWords(c);
+    PINNED_REUSE_LINK(bd) = NULL;
+    PINNED_NEXT_SLOT(bd) = 0;
+    clearPinnedSlots(bd);
+    cap->pinned_class_blocks[c] = bd;
+
+    return takePinnedSlot(bd);
+}
+
+//
+// Called by the GC for a list of pinned blocks that it has just
+// evacuated, once their slot bitmaps are complete.  Hands the
+// size-class blocks with enough free slots to the capabilities, and
+// returns the total number of free words in the size-class blocks.
+//
+StgWord
+reusePinnedBlocks (bdescr *bd)
+{
+    static uint32_t next_cap = 0;
+    StgWord free_words = 0;
+    W_ n_slots, free_slots, i;
+    uint32_t c, n, node_caps;
+    Capability *cap;
+
+    for (; bd != NULL; bd = bd->link) {
+        if (!(bd->flags & BF_SLOTTED)) continue;
+
+        n_slots = pinnedSlots(bd);
+        free_slots = n_slots;
+        for (i = 0; i < PINNED_BITMAP_W; i++) {
+            free_slots -= __builtin_popcountll((StgWord64)PINNED_BITMAP(bd)[i]);
+        }
+        free_words += free_slots * PINNED_SLOT_WORDS(bd);
+
+        if (free_slots * 4 < n_slots) continue;
+
+        // give it to one of the capabilities on the block's node, in turn
+        node_caps = (enabled_capabilities + n_numa_nodes - 1 - bd->node)
+                        / n_numa_nodes;
+        if (node_caps == 0) {
+            n = next_cap++ % enabled_capabilities;
+        } else {
+            n = bd->node + (next_cap++ % node_caps) * n_numa_nodes;
+        }
+        cap = capabilities[n];
+        c = pinnedSizeClass(PINNED_SLOT_WORDS(bd));
+        PINNED_NEXT_SLOT(bd) = 0;
+        PINNED_REUSE_LINK(bd) = cap->pinned_reuse[c];
+        cap->pinned_reuse[c] = bd;
+    }
+    return free_words;
+}
+
 StgPtr
 allocatePinned (Capability *cap, W_ n)
 {
@@ -1005,6 +1473,10 @@ allocatePinned (Capability *cap, W_ n)
         }
     }
 
+    if (n <= PINNED_SLOT_MAX_W) {
+        return allocatePinnedSlot(cap, n);
+    }
+
     accountAllocation(cap, n);
     bd = cap->pinned_object_block;
 
@@ -1021,30 +1493,7 @@ allocatePinned (Capability *cap, W_ n)
             dbl_link_onto(bd, &cap->pinned_object_blocks);
         }
 
-        // We need to find another block.  We could just allocate one,
-        // but that means taking a global lock and we really want to
-        // avoid that (benchmarks that allocate a lot of pinned
-        // objects scale really badly if we do this).
-        //
-        // So first, we try taking the next block from the nursery, in
-        // the same way as allocate().
-        bd = cap->r.rCurrentNursery->link;
-        if (bd == NULL) {
-            // The nursery is empty: allocate a fresh block (we can't fail
-            // here).
-            ACQUIRE_SM_LOCK;
-            bd = allocBlockOnNode(cap->node);
-            RELEASE_SM_LOCK;
-            initBdescr(bd, g0, g0);
-        } else {
-            newNurseryBlock(bd);
-            // we have a block in the nursery: steal it
-            cap->r.rCurrentNursery->link = bd->link;
-            if (bd->link != NULL) {
-                bd->link->u.back = cap->r.rCurrentNursery;
-            }
-            cap->r.rNursery->n_blocks -= bd->blocks;
-        }
+        bd = allocPinnedBlock(cap);
 
         cap->pinned_object_block = bd;
         bd->flags  = BF_PINNED | BF_LARGE | BF_EVACUATED;
@@ -1334,6 +1783,17 @@ StgWord calcTotalLargeObjectsW (void)
     return totalW;
 }
 
+StgWord calcTotalPinnedSlopW (void)
+{
+    uint32_t g;
+    StgWord totalW = 0;
+
+    for (g = 0; g < RtsFlags.GcFlags.generations; g++) {
+        totalW += generations[g].n_pinned_free_words;
+    }
+    return totalW;
+}
+
 StgWord calcTotalCompactW (void)
 {
     uint32_t g;
@@ -62,6 +62,7 @@ void     resizeNurseries      (StgWord blocks);
 void     resizeNurseriesFixed (void);
 StgWord  countNurseryBlocks   (void);
 bool     getNewNursery        (Capability *cap);
+void     updateNurseryQuotas  (void);
 
 /* -----------------------------------------------------------------------------
    Should we GC?
@@ -95,6 +96,57 @@ INLINE_HEADER void newNurseryBlock (bdescr *bd) {
 void    updateNurseriesStats (void);
 StgWord calcTotalAllocated   (void);
 
+/* -----------------------------------------------------------------------------
+   Pinned size-class blocks
+
+   Pinned objects of up to PINNED_SLOT_MAX_W words are allocated in
+   blocks that hold objects of a single size class in fixed-size slots.
+   The first PINNED_HDR_W words of such a block (flagged BF_SLOTTED) are
+   a header:
+
+     start[0]   slot size in words
+     start[1]   next block on the capability's reuse list
+     start[2]   index of the next slot to try when allocating
+     start[3..] bitmap of occupied slots
+
+   See Note [Pinned size classes] in Storage.c
+   -------------------------------------------------------------------------- */
+
+// small enough that a block holds at least 3 slots of the top class
+#define PINNED_SLOT_MAX_W    128
+#define PINNED_SIZE_CLASSES  23
+
+// enough for one bit per slot of the smallest class (2 words)
+#define PINNED_BITMAP_W      (BLOCK_SIZE_W / 2 / BITS_IN(W_))
+#define PINNED_HDR_W         (3 + PINNED_BITMAP_W)
+
+#define PINNED_SLOT_WORDS(bd)  ((bd)->start[0])
+#define PINNED_REUSE_LINK(bd)  (*(bdescr **)&(bd)->start[1])
+#define PINNED_NEXT_SLOT(bd)   ((bd)->start[2])
+#define PINNED_BITMAP(bd)      (&(bd)->start[3])
+
+//
+// Called by the GC for every live object in a BF_SLOTTED block.  GC
+// threads may mark slots in the same block concurrently.
+//
+INLINE_HEADER void markPinnedSlot (bdescr *bd, StgPtr p)
+{
+    W_ i = (p - (bd->start + PINNED_HDR_W)) / PINNED_SLOT_WORDS(bd);
+    StgWord *w = &PINNED_BITMAP(bd)[i / BITS_IN(W_)];
+    StgWord bit = (StgWord)1 << (i % BITS_IN(W_));
+#if defined(THREADED_RTS)
+    StgWord old;
+    while (!((old = *w) & bit)) {
+        if (cas((StgVolatilePtr)w, old, old | bit) == old) break;
+    }
+#else
+    *w |= bit;
+#endif
+}
+
+void    clearPinnedSlots   (bdescr *bd);
+StgWord reusePinnedBlocks  (bdescr *bd);
+
 /* -----------------------------------------------------------------------------
    Stats 'n' DEBUG stuff
    -------------------------------------------------------------------------- */
@@ -109,6 +161,7 @@ StgWord genLiveWords  (generation *gen);
 StgWord genLiveBlocks (generation *gen);
 
 StgWord calcTotalLargeObjectsW (void);
+StgWord calcTotalPinnedSlopW (void);
 StgWord calcTotalCompactW (void);
 
 /* ----------------------------------------------------------------------------
@@ -1,12 +1,12 @@
 /* -----------------------------------------------------------------------------
  *
- * (c) The GHC Team 2008 
+ * (c) The GHC Team 2008
  *
  * Simple mark/sweep, collecting whole blocks.
  *
  * Documentation on the architecture of the Garbage Collector can be
  * found in the online commentary:
- * 
+ *
  *   https://gitlab.haskell.org/ghc/ghc/wikis/commentary/rts/storage/gc
  *
  * ---------------------------------------------------------------------------*/
@@ -14,73 +14,342 @@
 #include "PosixSource.h"
 #include "Rts.h"
 
+#include "RtsUtils.h"
+#include "Storage.h"
 #include "BlockAlloc.h"
 #include "Sweep.h"
 #include "Trace.h"
 
+/* Note [Lazy sweeping]
+   ~~~~~~~~~~~~~~~~~~~~
+
+   With +RTS -w (and -xn) a major GC marks the live objects of the
+   oldest generation in a bitmap and leaves them where they are.  The
+   blocks with no live objects left in them can then be freed, and the
+   others are flagged BF_SWEPT, because they contain dead objects that
+   the sanity checker must not look at.  Finding the empty blocks means
+   reading each block's part of the bitmap, and freeing them means a
+   freeGroup() each.  On a big heap that is a noticeable part of the
+   pause, and none of it needs to happen while the mutator is stopped.
+
+   So sweep() only does what the GC needs straight away: it sets
+   gen->live_estimate from a linear scan of the bitmap, for
+   resize_generations(), and flags the marked blocks BF_SWEPT.  The
+   marked blocks then go onto the front of gen->blocks as usual, and
+   gen->n_unswept_blocks counts how many of them are still to be swept.
+   gen->bitmap is kept until they all have been.  sweepSome() sweeps
+   them a batch at a time:
+
+     - in the threaded RTS, from the sweeper thread once the mutator
+       is running again, taking the SM lock for each batch;
+
+     - during a minor GC, from alloc_todo_block() before it takes more
+       blocks for to-space, so that it can reuse the ones the sweep
+       frees.  The GC holds the SM lock, and the GC threads take
+       gc_alloc_block_sync around the call.
+
+   The next major GC finishes off whatever is left with finishSweep()
+   before it does anything else with the oldest generation.
+
+   Nothing live points into the dead objects, so a minor GC never looks
+   at them and doesn't care whether their blocks have been swept yet.
+   Minor GCs do put new blocks on the front of gen->blocks, so rather
+   than the list head we remember the block in front of the next one to
+   sweep.  Empty blocks count towards gen->n_blocks and gen->n_words
+   until they are swept.  The sweep debt, the unswept blocks in bytes,
+   is reported by getRTSStats().
+
+   The sweeper thread only runs between GCs: every GC, minor or major,
+   calls pauseSweepThread() to set sweep_active to false as soon as it
+   has the SM lock, and wakeSweepThread() sets it again at the very end
+   of the GC.  Otherwise the sweeper could take the SM lock whenever
+   the GC drops it (to run a heap census, or to start the finalizers)
+   and sweep blocks under the feet of the GC.
+*/
+
+// The generation being swept, the next block to sweep, and the block
+// in front of that in gen->blocks, or NULL if it was at the front when
+// we last looked.  Protected by the SM lock, and by gc_alloc_block_sync
+// during GC.
+static generation *sweep_gen  = NULL;
+static bdescr     *sweep_next = NULL;
+static bdescr     *sweep_prev = NULL;
+
+// for the debugTrace at the end
+static W_ sweep_blocks, sweep_freed, sweep_fragd;
+
+#if defined(THREADED_RTS)
+
+static Mutex      sweep_mutex;
+static Condition  sweep_cond;
+static OSThreadId sweep_thread;
+
+// Protected by the SM lock.
+static bool sweep_active = false;
+
+// All protected by sweep_mutex; sweep_stop is also read without it.
+static volatile bool sweep_stop = false;
+static bool sweep_running = false;
+static bool sweep_wakeup = false;
+
+// Blocks swept by the sweeper thread each time it takes the SM lock
+#define SWEEP_BATCH 64
+
+static void *
+sweepThread (void *arg STG_UNUSED)
+{
+    bool more;
+
+    ACQUIRE_LOCK(&sweep_mutex);
+    while (!sweep_stop) {
+        if (!sweep_wakeup) {
+            waitCondition(&sweep_cond, &sweep_mutex);
+            continue;
+        }
+        sweep_wakeup = false;
+        RELEASE_LOCK(&sweep_mutex);
+
+        do {
+            ACQUIRE_SM_LOCK;
+            if (sweep_active) {
+                sweepSome(SWEEP_BATCH);
+            }
+            more = sweep_active && sweep_gen != NULL;
+            RELEASE_SM_LOCK;
+            // give the mutator a chance at the SM lock
+            yieldThread();
+        } while (more && !sweep_stop);
+
+        ACQUIRE_LOCK(&sweep_mutex);
+    }
+    sweep_running = false;
+    broadcastCondition(&sweep_cond);
+    RELEASE_LOCK(&sweep_mutex);
+    return NULL;
+}
+
+#endif /* THREADED_RTS */
+
+// Called from initStorage(), and again in the child after forkProcess()
+// since the thread does not survive the fork.
+void
+startSweepThread (void)
+{
+#if defined(THREADED_RTS)
+    sweep_running = false;
+    sweep_stop = false;
+    sweep_wakeup = false;
+
+    if (!RtsFlags.GcFlags.sweep || !oldest_gen->mark) {
+        return;
+    }
+
+    initMutex(&sweep_mutex);
+    initCondition(&sweep_cond);
+
+    if (createOSThread(&sweep_thread, "ghc_sweep",
+                       sweepThread, NULL) != 0) {
+        sysErrorBelch("warning: could not start the sweeper thread; "
+                      "sweeping during GC instead");
+        closeCondition(&sweep_cond);
+        closeMutex(&sweep_mutex);
+        return;
+    }
+    sweep_running = true;
+
+    // in the child after a fork, there may be a sweep to finish
+    ACQUIRE_SM_LOCK;
+    wakeSweepThread();
+    RELEASE_SM_LOCK;
+#endif
+}
+
+void
+stopSweepThread (void)
+{
+#if defined(THREADED_RTS)
+    if (!sweep_running) {
+        return;
+    }
+
+    ACQUIRE_LOCK(&sweep_mutex);
+    sweep_stop = true;
+    broadcastCondition(&sweep_cond);
+    while (sweep_running) {
+        waitCondition(&sweep_cond, &sweep_mutex);
+    }
+    RELEASE_LOCK(&sweep_mutex);
+
+    closeCondition(&sweep_cond);
+    closeMutex(&sweep_mutex);
+#endif
+}
+
+void
+wakeSweepThread (void)
+{
+    ASSERT_SM_LOCK();
+
+#if defined(THREADED_RTS)
+    if (sweep_gen == NULL || !sweep_running) {
+        return;
+    }
+    sweep_active = true;
+    ACQUIRE_LOCK(&sweep_mutex);
+    sweep_wakeup = true;
+    signalCondition(&sweep_cond);
+    RELEASE_LOCK(&sweep_mutex);
+#endif
+}
+
+void
+pauseSweepThread (void)
+{
+    ASSERT_SM_LOCK();
+
+#if defined(THREADED_RTS)
+    sweep_active = false;
+#endif
+}
+
 void
 sweep(generation *gen)
 {
-    bdescr *bd, *prev, *next;
-    uint32_t i;
-    W_ freed, resid, fragd, blocks, live;
-    
+    bdescr *bd;
+    StgWord *bitmap;
+    W_ i, n, resid, blocks;
+
     ASSERT(countBlocks(gen->old_blocks) == gen->n_old_blocks);
+    ASSERT(sweep_gen == NULL && gen->n_unswept_blocks == 0);
 
-    live = 0; // estimate of live data in this gen
-    freed = 0;
-    fragd = 0;
+    // Blocks that have not been marked are freed by GarbageCollect(),
+    // and their part of the bitmap is all zeroes, so the bitmap can be
+    // scanned in one go to estimate the live data.
+    resid = 0;
+    if (gen->bitmap != NULL) {
+        bitmap = gen->bitmap->start;
+        n = gen->n_old_blocks * (BLOCK_SIZE_W / BITS_IN(W_));
+        for (i = 0; i < n; i++) {
+            if (bitmap[i] != 0) resid++;
+        }
+    }
+    gen->live_estimate = resid * BITS_IN(W_);
+
+    // The marked blocks will be at the front of gen->blocks, in this
+    // order, once GarbageCollect() has freed the unmarked ones.
+    sweep_next = NULL;
     blocks = 0;
-    prev = NULL;
-    for (bd = gen->old_blocks; bd != NULL; bd = next)
+    for (bd = gen->old_blocks; bd != NULL; bd = bd->link)
     {
-        next = bd->link;
-
-        if (!(bd->flags & BF_MARKED)) { 
-            prev = bd;
+        if (!(bd->flags & BF_MARKED)) {
             continue;
         }
+        if (sweep_next == NULL) {
+            sweep_next = bd;
+        }
+        bd->flags |= BF_SWEPT;
+        blocks += bd->blocks;
+    }
+
+    gen->n_unswept_blocks = blocks;
+    sweep_prev = NULL;
+    sweep_blocks = blocks;
+    sweep_freed = 0;
+    sweep_fragd = 0;
+    if (blocks > 0) {
+        sweep_gen = gen;
+    }
+
+    debugTrace(DEBUG_gc, "sweeping: %" FMT_Word " blocks to sweep, "
+               "live estimate: %" FMT_Word " words",
+               blocks, gen->live_estimate);
+}
+
+W_
+sweepSome (W_ n)
+{
+    generation *gen;
+    bdescr *bd, *next, *p;
+    uint32_t i;
+    W_ resid, freed;
+
+    gen = sweep_gen;
+    if (gen == NULL) {
+        return 0;
+    }
+
+    freed = 0;
+    while (n > 0 && gen->n_unswept_blocks > 0)
+    {
+        bd = sweep_next;
+        next = bd->link;
+        ASSERT(bd->flags & BF_SWEPT);
 
-        blocks++;
         resid = 0;
         for (i = 0; i < BLOCK_SIZE_W / BITS_IN(W_); i++)
         {
             if (bd->u.bitmap[i] != 0) resid++;
         }
-        live += resid * BITS_IN(W_);
+
+        gen->n_unswept_blocks -= bd->blocks;
+        n--;
 
         if (resid == 0)
         {
-            freed++;
-            gen->n_old_blocks--;
-            if (prev == NULL) {
-                gen->old_blocks = next;
+            if (sweep_prev != NULL) {
+                sweep_prev->link = next;
+            } else if (gen->blocks == bd) {
+                gen->blocks = next;
             } else {
-                prev->link = next;
+                // a minor GC has put blocks in front of it
+                for (p = gen->blocks; p->link != bd; p = p->link) {}
+                p->link = next;
+                sweep_prev = p;
             }
+            gen->n_blocks -= bd->blocks;
+            gen->n_words -= bd->free - bd->start;
+            freed += bd->blocks;
             freeGroup(bd);
         }
         else
         {
-            prev = bd;
+            sweep_prev = bd;
             if (resid < (BLOCK_SIZE_W * 3) / (BITS_IN(W_) * 4)) {
-                fragd++;
+                sweep_fragd++;
                 bd->flags |= BF_FRAGMENTED;
             }
-
-            bd->flags |= BF_SWEPT;
         }
+
+        sweep_next = next;
     }
 
-    gen->live_estimate = live;
+    sweep_freed += freed;
 
-    debugTrace(DEBUG_gc, "sweeping: %d blocks, %d were copied, %d freed (%d%%), %d are fragmented, live estimate: %ld%%",
-          gen->n_old_blocks + freed,
-          gen->n_old_blocks - blocks + freed,
-          freed,
-          blocks == 0 ? 0 : (freed * 100) / blocks,
-          fragd, 
-          (unsigned long)((blocks - freed) == 0 ? 0 : ((live / BLOCK_SIZE_W) * 100) / (blocks - freed)));
+    if (gen->n_unswept_blocks == 0) {
+        debugTrace(DEBUG_gc, "sweeping done: %" FMT_Word " blocks, "
+                   "%" FMT_Word " freed (%" FMT_Word "%%), "
+                   "%" FMT_Word " are fragmented",
+                   sweep_blocks, sweep_freed,
+                   sweep_blocks == 0 ? 0 : (sweep_freed * 100) / sweep_blocks,
+                   sweep_fragd);
 
-    ASSERT(countBlocks(gen->old_blocks) == gen->n_old_blocks);
+        freeGroup(gen->bitmap);
+        gen->bitmap = NULL;
+        sweep_gen = NULL;
+        sweep_next = NULL;
+        sweep_prev = NULL;
+    }
+
+    return freed;
+}
+
+void
+finishSweep (void)
+{
+    ASSERT_SM_LOCK();
+
+    if (sweep_gen != NULL) {
+        sweepSome(sweep_gen->n_unswept_blocks);
+        ASSERT(sweep_gen == NULL);
+    }
 }
@@ -13,4 +13,25 @@
 
 #pragma once
 
-RTS_PRIVATE void sweep(generation *gen);
+#include "BeginPrivate.h"
+
+// Get the oldest generation ready to be swept, at the end of marking.
+// The sweeping itself happens later; see Note [Lazy sweeping] in Sweep.c.
+void sweep (generation *gen);
+
+// Sweep up to n blocks, returning the number of blocks freed.  The
+// caller must hold the SM lock, or gc_alloc_block_sync during GC.
+W_ sweepSome (W_ n);
+
+// Sweep whatever is left.  The caller must hold the SM lock.
+void finishSweep (void);
+
+void startSweepThread (void);
+void stopSweepThread  (void);
+
+// Stop the sweeper thread from sweeping, at the start of a GC, and let
+// it carry on at the end.  The caller must hold the SM lock.
+void pauseSweepThread (void);
+void wakeSweepThread (void);
+
+#include "EndPrivate.h"
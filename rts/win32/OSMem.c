@@ -49,6 +49,12 @@ osMemInit(void)
     allocs = NULL;
     free_blocks = NULL;
 
+    if (RtsFlags.GcFlags.hugePages) {
+        errorBelch("warning: huge pages (-xH) are not supported on this "
+                   "platform, ignoring");
+        RtsFlags.GcFlags.hugePages = false;
+    }
+
     /* Resolve and cache VirtualAllocExNuma. */
     if (osNumaAvailable() && RtsFlags.GcFlags.numa)
     {
@@ -508,6 +514,11 @@ void osReleaseHeapMemory (void)
 
 #endif
 
+W_ osHugePageBytes(void)
+{
+    return 0;
+}
+
 bool osBuiltWithNumaSupport(void)
 {
     return true;
@@ -0,0 +1,37 @@
+module Main where
+
+import Control.Concurrent
+import Control.Monad
+import GHC.Clock
+import System.Environment
+import System.IO
+import Text.Printf
+
+-- Measure the latency of waking up threads on another capability.
+-- Each of S threads on capabilities 1.. does N round trips through a
+-- pair of MVars with a partner thread on capability 0, so every round
+-- trip sends a wakeup message each way, and capability 0 gets messages
+-- from all the others at once.  Each reply is checked, and the mean
+-- round trip goes to stderr.
+
+main = do
+  [s, n] <- map read <$> getArgs
+  caps <- getNumCapabilities
+  dones <- forM [1 .. s] $ \i -> do
+    ping <- newEmptyMVar
+    pong <- newEmptyMVar
+    done <- newEmptyMVar
+    _ <- forkOn 0 $ replicateM_ n $ takeMVar ping >>= putMVar pong
+    _ <- forkOn (1 + i `mod` max 1 (caps - 1)) $ do
+      t0 <- getMonotonicTimeNSec
+      oks <- forM [1 .. n] $ \j -> do
+        putMVar ping (j :: Int)
+        (== j) <$> takeMVar pong
+      t1 <- getMonotonicTimeNSec
+      putMVar done (and oks, t1 - t0)
+    return done
+  (oks, ts) <- unzip <$> mapM takeMVar dones
+  let mean = fromIntegral (sum ts) / fromIntegral (s * n) :: Double
+  hPrintf stderr "%d threads, %d capabilities: %.0f ns per round trip\n"
+    s caps mean
+  putStrLn (if and oks then "done" else "wrong reply")
@@ -0,0 +1,101 @@
+-- A small reader for the binary eventlog format described in
+-- includes/rts/EventLogFormat.h, for tests that check the events the
+-- RTS posts.  It fails on anything malformed: an undeclared event
+-- type, an event running past the end of the file, or data after
+-- EVENT_DATA_END.
+module ReadEventlog
+  ( Event(..)
+  , readEventlog
+  , word16At, word32At, word64At
+  ) where
+
+import Data.Bits
+import qualified Data.ByteString as B
+import qualified Data.Map as M
+import Data.Word
+
+data Event = Event
+  { evTag     :: !Int
+  , evTime    :: !Word64
+  , evPayload :: !B.ByteString
+  }
+
+-- | The payload sizes of the event types declared in the header
+-- (Nothing for variable-sized events), and the events in the order
+-- they appear.
+readEventlog :: FilePath -> IO (M.Map Int (Maybe Int), [Event])
+readEventlog file = do
+  bs <- B.readFile file
+  either (fail . ((file ++ ": ") ++)) return (parseEventlog bs)
+
+parseEventlog :: B.ByteString -> Either String (M.Map Int (Maybe Int), [Event])
+parseEventlog bs0 = do
+  bs1 <- expect32 0x68647262 "EVENT_HEADER_BEGIN" bs0
+  bs2 <- expect32 0x68657462 "EVENT_HET_BEGIN" bs1
+  (types, bs3) <- eventTypes M.empty bs2
+  bs4 <- expect32 0x68647265 "EVENT_HEADER_END" bs3
+  bs5 <- expect32 0x64617462 "EVENT_DATA_BEGIN" bs4
+  evs <- events types bs5
+  return (types, evs)
+
+eventTypes :: M.Map Int (Maybe Int) -> B.ByteString
+           -> Either String (M.Map Int (Maybe Int), B.ByteString)
+eventTypes types bs
+  | B.length bs >= 4 && word32At 0 bs == 0x68657465 -- EVENT_HET_END
+  = Right (types, B.drop 4 bs)
+  | otherwise = do
+      bs1 <- expect32 0x65746200 "EVENT_ET_BEGIN" bs
+      need 8 bs1
+      let num  = word16At 0 bs1
+          size = word16At 2 bs1
+          bs2  = B.drop (8 + word32At 4 bs1) bs1   -- the description
+      need 4 bs2
+      let bs3 = B.drop (4 + word32At 0 bs2) bs2    -- the extensions
+      bs4 <- expect32 0x65746500 "EVENT_ET_END" bs3
+      let size' = if size == 0xffff then Nothing else Just size
+      eventTypes (M.insert num size' types) bs4
+
+events :: M.Map Int (Maybe Int) -> B.ByteString -> Either String [Event]
+events types bs = do
+  need 2 bs
+  let tag = word16At 0 bs
+  if tag == 0xffff -- EVENT_DATA_END
+    then if B.length bs == 2 then Right []
+                             else Left "data after EVENT_DATA_END"
+    else case M.lookup tag types of
+      Nothing -> Left ("undeclared event type " ++ show tag)
+      Just msize -> do
+        need 10 bs
+        let time = word64At 2 bs
+            bs1  = B.drop 10 bs
+        (size, bs2) <- case msize of
+          Just size -> Right (size, bs1)
+          Nothing   -> do need 2 bs1
+                          Right (word16At 0 bs1, B.drop 2 bs1)
+        need size bs2
+        rest <- events types (B.drop size bs2)
+        Right (Event tag time (B.take size bs2) : rest)
+
+expect32 :: Int -> String -> B.ByteString -> Either String B.ByteString
+expect32 marker what bs = do
+  need 4 bs
+  if word32At 0 bs == marker then Right (B.drop 4 bs)
+                             else Left ("expected " ++ what)
+
+need :: Int -> B.ByteString -> Either String ()
+need n bs
+  | B.length bs >= n = Right ()
+  | otherwise        = Left "unexpected end of the eventlog"
+
+-- Fields are big-endian.
+wordAt :: Int -> Int -> B.ByteString -> Word64
+wordAt n i bs =
+  foldl (\w k -> (w `shiftL` 8) .|. fromIntegral (B.index bs (i + k))) 0
+        [0 .. n-1]
+
+word16At, word32At :: Int -> B.ByteString -> Int
+word16At i = fromIntegral . wordAt 2 i
+word32At i = fromIntegral . wordAt 4 i
+
+word64At :: Int -> B.ByteString -> Word64
+word64At = wordAt 8
@@ -0,0 +1,27 @@
+-- Allocate pinned and large objects of assorted sizes from several
+-- capabilities at once, with a tiny per-capability block cache so that
+-- it is refilled and drained frequently.
+module Main (main) where
+
+import Control.Concurrent
+import Control.Monad
+import Foreign
+
+main :: IO ()
+main = do
+  n <- getNumCapabilities
+  dones <- forM [1..n] $ \i -> do
+    done <- newEmptyMVar
+    _ <- forkOn i $ do
+      rs <- forM [1..5000] $ \j -> do
+        let sz = (i * j * 37) `mod` 40000 + 1
+        fp <- mallocForeignPtrBytes sz
+        withForeignPtr fp $ \p -> do
+          pokeByteOff p (sz-1) (fromIntegral j :: Word8)
+          peekByteOff p (sz-1) :: IO Word8
+      putMVar done $! sum (map fromIntegral rs :: [Int])
+    return done
+  rs <- mapM takeMVar dones
+  print (all (== expected) rs)
+  where
+    expected = sum [ j `mod` 256 | j <- [1..5000] ]
@@ -0,0 +1,25 @@
+-- Keep lots of IORefs in the old generation with +RTS --card-table, and
+-- write young values into some of them between minor GCs, so that the
+-- card blocks are the only thing keeping those values alive.
+module Main (main) where
+
+import Control.Monad
+import Data.IORef
+import qualified Data.Map.Strict as M
+import System.Mem
+
+n :: Int
+n = 100000
+
+main :: IO ()
+main = do
+  refs <- forM [0 .. n-1] $ \i -> newIORef (M.singleton i (show i))
+  performMajorGC
+  forM_ [1 .. 10 :: Int] $ \r -> do
+    forM_ (zip [0 ..] refs) $ \(i, ref) ->
+      when (i `mod` 13 == r) $
+        writeIORef ref $! M.insert (n + r) (show (n + r)) (M.singleton i (show i))
+    performMinorGC
+  ms <- mapM readIORef refs
+  print ( sum (map M.size ms)
+        , and [ all (\(k, v) -> v == show k) (M.toList m) | m <- ms ] )
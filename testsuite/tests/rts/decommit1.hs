@@ -0,0 +1,25 @@
+-- Grow the heap, drop everything and check that the background decommit
+-- thread gets through the memory the GC scheduled to be returned.
+module Main (main) where
+
+import Control.Concurrent
+import Control.Monad
+import GHC.Stats
+import System.Mem
+
+main :: IO ()
+main = do
+  let xs = [1 .. 2000000] :: [Int]
+  print (sum xs + length xs)
+  performMajorGC
+  performMajorGC
+  done <- waitForDecommit (500 :: Int)
+  print done
+
+waitForDecommit :: Int -> IO Bool
+waitForDecommit 0 = return False
+waitForDecommit n = do
+  pending <- pending_decommit_bytes <$> getRTSStats
+  if pending == 0
+    then return True
+    else threadDelay 10000 >> waitForDecommit (n - 1)
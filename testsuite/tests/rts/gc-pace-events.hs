@@ -0,0 +1,24 @@
+-- Read back the eventlog of pause-target1, run with a pause target far
+-- below any real GC pause, and check the EVENT_GC_PACE events: the
+-- event must have the size the header declares, and the pacer must
+-- have shrunk the nursery.
+module Main (main) where
+
+import qualified Data.Map as M
+import ReadEventlog
+import System.Environment
+
+eventGcPace :: Int
+eventGcPace = 185
+
+main :: IO ()
+main = do
+  [file] <- getArgs
+  (types, evs) <- readEventlog file
+  print (M.lookup eventGcPace types)
+  let paces = [ (word16At 4 p, word64At 14 p, word64At 22 p)
+              | Event tag _ p <- evs, tag == eventGcPace ]
+  print (all (\(gen, _, _) -> gen < 3) paces)
+  print (all (\(_, old, new) -> old `mod` 4096 == 0 && new `mod` 4096 == 0)
+             paces)
+  print (any (\(gen, old, new) -> gen == 0 && new < old) paces)
@@ -0,0 +1,38 @@
+-- Build a large search tree of small constructors, keep it alive
+-- across a number of major GCs, and report the GC CPU time on stderr.
+-- The Makefile runs it with and without +RTS --gc-prefetch, and checks
+-- that the output is the same.
+module Main (main) where
+
+import Control.Monad
+import Data.List (foldl')
+import GHC.Stats
+import System.IO
+import System.Mem
+import Text.Printf
+
+data Tree = Leaf | Node !Int Tree Tree
+
+insert :: Int -> Tree -> Tree
+insert k Leaf = Node k Leaf Leaf
+insert k t@(Node k' l r)
+  | k < k'    = Node k' (insert k l) r
+  | k > k'    = Node k' l (insert k r)
+  | otherwise = t
+
+total :: Tree -> Int
+total Leaf = 0
+total (Node k l r) = k + total l + total r
+
+main :: IO ()
+main = do
+  -- a pseudo-random order, so that the tree is scattered in the heap
+  let keys = take 500000 (iterate (\x -> (x * 1103515245 + 12345) `mod` 2147483648) 1)
+      t = foldl' (flip insert) Leaf keys
+  total t `seq` return ()
+  before <- getRTSStats
+  replicateM_ 20 performMajorGC
+  after <- getRTSStats
+  print (total t)
+  hPrintf stderr "GC CPU time: %.3fs\n"
+    (fromIntegral (gc_cpu_ns after - gc_cpu_ns before) / 1e9 :: Double)
@@ -0,0 +1,15 @@
+-- Run with the heap backed by huge pages (+RTS -xH), growing the heap
+-- well beyond a few huge pages and then shrinking it again, so that
+-- megablocks are both committed and returned to the OS.  See the
+-- hugepages1 rule in the Makefile for the check of the hugepage_bytes
+-- stat.
+module Main (main) where
+
+import qualified Data.Map.Strict as M
+
+main :: IO ()
+main = do
+  let m = M.fromList [ (k, k * 2) | k <- [1 .. 500000 :: Int] ]
+  print (M.foldl' (+) 0 m)
+  let m' = M.filter (< 1000) m
+  print (M.size m')
@@ -0,0 +1,21 @@
+-- A thread on capability 1 is woken over and over from capability 0,
+-- so that the worker of capability 1 keeps going idle and spinning
+-- (+RTS --idle-spin) before it is given work again.  The idle worker
+-- counts in the +RTS -s stats are checked by the idle-spin1 rule in the
+-- Makefile.
+module Main (main) where
+
+import Control.Concurrent
+import Control.Monad
+
+main :: IO ()
+main = do
+  ping <- newEmptyMVar
+  pong <- newEmptyMVar
+  _ <- forkOn 1 $ forever $ takeMVar ping >>= putMVar pong . (+ 1)
+  n <- foldM (\acc i -> do putMVar ping i
+                           r <- takeMVar pong
+                           return $! acc + r - i)
+             0 [1 .. 20000 :: Int]
+  print n
+  putStrLn "done"
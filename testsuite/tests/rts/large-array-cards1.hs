@@ -0,0 +1,36 @@
+-- Dirty a few cards of a large array held in the old generation, in
+-- the first and last cards and on either side of a word of the card
+-- table, and check that minor GCs find the new elements through the
+-- marked cards.
+module Main (main) where
+
+import Control.Exception
+import Control.Monad
+import qualified Data.Map.Strict as M
+import GHC.IOArray
+import System.Mem
+
+n :: Int
+n = 100000   -- 782 cards of 128 elements
+
+dirty :: Int -> [Int]
+dirty r = [0, 1, 127, 128, 63*128 + 5, 64*128, 64*128 + 1, n-1,
+           (r * 997) `mod` n]
+
+main :: IO ()
+main = do
+  arr <- newIOArray (0, n-1) 0
+  forM_ [0 .. n-1] $ \i -> writeIOArray arr i $! i
+  performMajorGC
+  written <- foldM (\m r -> do
+      -- new elements, only reachable from the array
+      forM_ (dirty r) $ \i -> writeIOArray arr i $! i + r * n
+      performMinorGC
+      -- and some garbage, so that the nursery gets reused
+      _ <- evaluate (length (show [1 .. r * 1000]))
+      return $! M.union (M.fromList [ (i, i + r * n) | i <- dirty r ]) m)
+    M.empty [1 .. 50]
+  performMinorGC
+  xs <- mapM (readIOArray arr) [0 .. n-1]
+  print (M.size written)
+  print (and (zipWith (\i x -> x == M.findWithDefault i i written) [0 ..] xs))
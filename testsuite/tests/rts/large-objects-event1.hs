@@ -0,0 +1,32 @@
+-- Read back the eventlog of large-array-cards1 and check the
+-- EVENT_HEAP_LARGE_OBJECTS events: the eventlog must be well-formed,
+-- the event must have the size the header declares, and the 800kB
+-- array must be seen as a large object promoted into the old
+-- generation.
+module Main (main) where
+
+import qualified Data.Map as M
+import ReadEventlog
+import System.Environment
+
+eventHeapLargeObjects :: Int
+eventHeapLargeObjects = 184
+
+main :: IO ()
+main = do
+  [file] <- getArgs
+  (types, evs) <- readEventlog file
+  print (M.lookup eventHeapLargeObjects types)
+  let large = [ ( word16At 4 p
+                , word64At 6 p, word64At 14 p
+                , word64At 22 p, word64At 30 p )
+              | Event tag _ p <- evs, tag == eventHeapLargeObjects ]
+  print (not (null large))
+  print (all (\(gen, _, _, _, _) -> gen < 2) large)
+  print (all (\(_, objs, bytes, pobjs, pbytes) ->
+                 pobjs <= objs && pbytes <= bytes && bytes >= objs * 3000)
+             large)
+  print (any (\(gen, objs, bytes, _, _) ->
+                 gen == 1 && objs >= 1 && bytes >= 800000) large)
+  print (any (\(gen, _, _, pobjs, pbytes) ->
+                 gen == 1 && pobjs >= 1 && pbytes >= 800000) large)
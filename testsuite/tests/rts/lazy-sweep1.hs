@@ -0,0 +1,30 @@
+-- Collect the old generation with +RTS -w, which sweeps it lazily, and
+-- check that the objects that survive are intact while the blocks around
+-- them are being freed.
+module Main (main) where
+
+import Control.Monad
+import Data.IORef
+import qualified Data.Map.Strict as M
+import GHC.Stats
+import System.Mem
+
+n :: Int
+n = 200000
+
+main :: IO ()
+main = do
+  ref <- newIORef $! M.fromList [ (i, show i) | i <- [0 .. n-1] ]
+  forM_ [1 .. 5 :: Int] $ \r -> do
+    -- leave plenty of empty blocks behind
+    modifyIORef' ref (M.filterWithKey (\k _ -> k `mod` 7 /= r))
+    performMajorGC
+    -- some minor GCs while the sweep is still going on
+    forM_ [1 .. 20 :: Int] $ \i ->
+      modifyIORef' ref (M.insert (n + r * 100 + i) (show (n + r * 100 + i)))
+    performMinorGC
+  m <- readIORef ref
+  s <- getRTSStats
+  print ( M.size m
+        , all (\(k, v) -> v == show k) (M.toList m)
+        , sweep_debt_bytes s <= max_mem_in_use_bytes s )
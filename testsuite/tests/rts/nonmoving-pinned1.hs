@@ -0,0 +1,53 @@
+-- Keep many small pinned objects alive across concurrent marks of the
+-- oldest generation (+RTS -xn) while allocating more pinned data, and
+-- check that none of them is overwritten: a block of small pinned
+-- objects must keep the slot of every live object in it, not just the
+-- first one the marker saw.
+{-# LANGUAGE MagicHash, UnboxedTuples #-}
+module Main (main) where
+
+import Control.Monad
+import Data.IORef
+import GHC.Exts
+import GHC.IO
+
+data Pinned = Pinned (MutableByteArray# RealWorld)
+
+newPinned :: Int -> Int -> IO Pinned
+newPinned (I# n) (I# v) = IO $ \s ->
+  case newPinnedByteArray# n s of
+    (# s1, mba #) -> case setByteArray# mba 0# n v s1 of
+      s2 -> (# s2, Pinned mba #)
+
+checkPinned :: Int -> Int -> Pinned -> IO Bool
+checkPinned (I# n) (I# v) (Pinned mba) = IO $ \s -> go 0# s
+  where
+    go i s
+      | isTrue# (i >=# n) = (# s, True #)
+      | otherwise = case readInt8Array# mba i s of
+          (# s1, x #) | isTrue# (x ==# v) -> go (i +# 1#) s1
+                      | otherwise -> (# s1, False #)
+
+-- the fill byte of an object, small enough to read back as an Int8#
+fill :: Int -> Int
+fill i = i `mod` 100
+
+size :: Int -> Int
+size i = 16 + 8 * (i `mod` 13)
+
+main :: IO ()
+main = do
+  live <- forM [0 .. 19999] $ \i -> newPinned (size i) (fill i)
+  ref <- newIORef live
+  forM_ [1 .. 30 :: Int] $ \r -> do
+    -- pinned garbage, so that freed slots are handed out again
+    forM_ [0 .. 19999] $ \i -> newPinned (size i) (fill (i + r))
+    -- and some new live objects only reachable from an old IORef
+    xs <- readIORef ref
+    y <- newPinned (size r) (fill r)
+    writeIORef ref (y : xs)
+  xs <- readIORef ref
+  let (new, old) = splitAt 30 xs
+  oks <- zipWithM (\i p -> checkPinned (size i) (fill i) p) [0 ..] old
+  oks' <- zipWithM (\r p -> checkPinned (size r) (fill r) p) [30, 29 ..] new
+  print (length xs, and oks, and oks')
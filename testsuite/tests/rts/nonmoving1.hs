@@ -0,0 +1,38 @@
+-- Mutate old IORefs, MVars and arrays while the oldest generation is
+-- being marked concurrently (+RTS -xn), and check that nothing
+-- reachable is lost.  Major GCs are left to the RTS, so that they go
+-- through the concurrent mark instead of being forced.
+module Main (main) where
+
+import Control.Concurrent
+import Control.Exception
+import Control.Monad
+import Data.IORef
+import qualified Data.Map.Strict as M
+import GHC.IOArray
+
+n :: Int
+n = 200000
+
+main :: IO ()
+main = do
+  ref <- newIORef $! M.fromList [ (i, show i) | i <- [0 .. n-1] ]
+  mv <- newMVar [0 :: Int]
+  arr <- newIOArray (0, 999) []
+  forM_ [1 .. 40] $ \r -> do
+    -- new values that are only reachable from old objects
+    m <- readIORef ref
+    let m' = M.union (M.fromList [ (i, show (i + r)) | i <- [n, n+7 .. 2*n] ]) m
+    writeIORef ref $! M.insert r (show r) m'
+    modifyMVar_ mv (return . (r :))
+    forM_ [0 .. 999] $ \i -> writeIOArray arr i [i, r]
+    -- and some garbage, to keep the GC busy
+    _ <- evaluate (length (show (M.toList (M.filter ((== 1) . length) m'))))
+    return ()
+  m <- readIORef ref
+  xs <- readMVar mv
+  ys <- mapM (readIOArray arr) [0 .. 999]
+  print ( M.size m
+        , all (\i -> M.lookup i m == Just (show i)) [0 .. n-1]
+        , xs == [40, 39 .. 0]
+        , ys == [ [i, 40] | i <- [0 .. 999] ] )
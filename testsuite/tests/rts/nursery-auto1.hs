@@ -0,0 +1,26 @@
+-- One capability allocates heavily while the others mostly sleep, so
+-- that +RTS -Aauto moves most of the allocation area to the busy one.
+module Main (main) where
+
+import Control.Concurrent
+import Control.Monad
+import Data.List (foldl')
+
+main :: IO ()
+main = do
+  n <- getNumCapabilities
+  busy <- newEmptyMVar
+  _ <- forkOn 0 $ putMVar busy $! foldl' (+) 0 (map length chunks)
+  idle <- forM [1..n-1] $ \i -> do
+    done <- newEmptyMVar
+    _ <- forkOn i $ do
+      xs <- forM [1..20] $ \j -> do
+        threadDelay 1000
+        return $! length (replicate (i * j) ())
+      putMVar done $! sum xs
+    return done
+  print =<< takeMVar busy
+  rs <- mapM takeMVar idle
+  print (rs == [ i * 210 | i <- [1..n-1] ])
+  where
+    chunks = [ [1 .. k `mod` 1000] :: [Int] | k <- [1 .. 20000 :: Int] ]
@@ -0,0 +1,40 @@
+-- Compact a large old generation on several threads (+RTS -c with the
+-- parallel GC enabled), and check that every object survives with the
+-- right contents and every pointer still leads to the right place.
+module Main (main) where
+
+import Control.Concurrent
+import Control.Monad
+import Data.IORef
+import qualified Data.Map.Strict as M
+import GHC.IOArray
+import System.Mem
+
+n :: Int
+n = 300000
+
+main :: IO ()
+main = do
+  ref <- newIORef $! M.fromList [ (i, show i) | i <- [0 .. n-1] ]
+  arr <- newIOArray (0, 999) []
+  mv <- newMVar (0 :: Int)
+  -- a thread with a deep stack, whose stack gets moved too
+  done <- newEmptyMVar
+  _ <- forkIO $ do
+         let go :: Int -> IO Int
+             go 0 = readMVar mv
+             go k = do { r <- go (k-1); return $! r + 1 }
+         r <- go 10000
+         putMVar done r
+  forM_ [1 .. 5 :: Int] $ \r -> do
+    -- leave holes for the compactor to close up
+    modifyIORef' ref (M.filterWithKey (\k _ -> k `mod` 7 /= r))
+    forM_ [0 .. 999] $ \i -> writeIOArray arr i [i, r]
+    performMajorGC
+  m <- readIORef ref
+  ys <- mapM (readIOArray arr) [0 .. 999]
+  r <- takeMVar done
+  print ( M.size m
+        , all (\(k, v) -> v == show k) (M.toList m)
+        , ys == [ [i, 5] | i <- [0 .. 999] ]
+        , r )
@@ -0,0 +1,14 @@
+-- Builds up a large Map and keeps changing it, so that with +RTS -xP
+-- the nursery and the generations are resized as the live data grows.
+-- See the pause-target1 rule in the Makefile.
+module Main (main) where
+
+import Data.List (foldl')
+import qualified Data.Map.Strict as M
+
+main :: IO ()
+main = do
+  let m = foldl' (\acc i -> M.insert (i `mod` 50000) i acc) M.empty
+                 [1 .. 1000000 :: Int]
+  print (M.size m)
+  print (M.foldl' (+) 0 m)
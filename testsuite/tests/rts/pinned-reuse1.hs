@@ -0,0 +1,38 @@
+-- Pin lots of small buffers of assorted sizes, keep one in 50, and
+-- then pin a lot more so that the free slots around the survivors are
+-- reused.  Check that none of the survivors were overwritten, and that
+-- the GC stats see the pinned slop.
+module Main (main) where
+
+import Control.Monad
+import Data.Word
+import Foreign
+import GHC.Stats
+import System.Mem
+
+fill :: Int -> IO (ForeignPtr Word8, Int)
+fill i = do
+  let sz = i `mod` 200 + 1
+  fp <- mallocForeignPtrBytes sz
+  withForeignPtr fp $ \p ->
+    forM_ [0 .. sz-1] $ \j -> pokeByteOff p j (fromIntegral (i + j) :: Word8)
+  return (fp, i)
+
+check :: (ForeignPtr Word8, Int) -> IO Bool
+check (fp, i) = withForeignPtr fp $ \p -> do
+  let sz = i `mod` 200 + 1
+  bs <- forM [0 .. sz-1] $ \j -> peekByteOff p j
+  return (bs == [ fromIntegral (i + j) | j <- [0 .. sz-1] ])
+
+main :: IO ()
+main = do
+  kept <- fmap concat $ forM [1 .. 50000 :: Int] $ \i -> do
+    b <- fill i
+    return [ b | i `mod` 50 == 0 ]
+  performMajorGC
+  stats <- getRTSStats
+  print (gcdetails_pinned_slop_bytes (gc stats) > 0)
+  forM_ [1 .. 200000 :: Int] $ \i -> void (fill i)
+  performMajorGC
+  oks <- mapM check kept
+  print (and oks, length kept)
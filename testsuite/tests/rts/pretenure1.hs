@@ -0,0 +1,22 @@
+-- Build Maps that live long enough to be promoted with +RTS --pretenure,
+-- so that Data.Map's Bin gets pretenured, and check that they are
+-- intact afterwards.
+module Main (main) where
+
+import Control.Monad
+import Data.IORef
+import qualified Data.Map.Strict as M
+import System.Mem
+
+main :: IO ()
+main = do
+  ref <- newIORef []
+  forM_ [1 .. 20 :: Int] $ \r -> do
+    let m = M.fromList [ (i, r * i) | i <- [1 .. 20000 :: Int] ]
+    m `seq` modifyIORef ref (m :)
+    -- some short-lived garbage too
+    print (sum (M.elems (M.map (+ r) (M.fromList [ (i, i) | i <- [1 .. 1000 :: Int] ]))))
+    when (r `mod` 5 == 0) performMinorGC
+  ms <- readIORef ref
+  print (and [ M.foldrWithKey (\k v ok -> ok && v == r * k) True m
+             | (r, m) <- zip [20, 19 .. 1] ms ])
@@ -0,0 +1,52 @@
+-- Selector thunks nested far deeper than the GC would normally
+-- evaluate them, each selecting from the next.  With +RTS
+-- --eager-selectors the GC evaluates the whole nest, so once nothing
+-- else refers to the structure they select from, its outer half is no
+-- longer retained: check that the live data drops by at least that
+-- much.  The selector counts in the +RTS -s stats are checked by the
+-- selector-eager1 rule in the Makefile.
+module Main (main) where
+
+import Control.Exception
+import Data.IORef
+import GHC.Stats
+import System.Mem
+
+data T = T T Int | E
+
+build :: Int -> T
+build 0 = E
+build n = T (build (n - 1)) (n + 1000)
+
+-- so that the outermost selector thunk is built but not evaluated
+data Box = Box T
+
+-- a lazy pattern, so that each step is a selector thunk
+down :: Int -> T -> Box
+down 0 t = Box t
+down n t = down (n - 1) (let T l _ = t in l)
+
+value :: T -> Int
+value (T _ v) = v
+value E = 0
+
+liveBytes :: IO Integer
+liveBytes = do
+  performMajorGC
+  toInteger . gcdetails_live_bytes . gc <$> getRTSStats
+
+main :: IO ()
+main = do
+  ref <- newIORef (build 10000)
+  t <- readIORef ref
+  total t `seq` return ()
+  Box s <- evaluate (down 5000 t)
+  before <- liveBytes
+  writeIORef ref E
+  after <- liveBytes
+  -- the outer 5000 nodes take at least 5000 * 5 words
+  print (before - after > 5000 * 5 * 8 `div` 2)
+  print (value s)
+  where
+    total E = 0 :: Int
+    total (T l v) = v + total l
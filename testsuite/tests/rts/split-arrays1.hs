@@ -0,0 +1,32 @@
+-- Keep a few large arrays of pointers, some mutable and some frozen,
+-- alive across parallel GCs so that they are split into ranges and
+-- scavenged by several GC threads, and check that every element
+-- survives.
+module Main (main) where
+
+import Control.Monad
+import Data.IORef
+import GHC.Arr
+import GHC.IOArray
+import System.Mem
+
+n :: Int
+n = 1000000
+
+main :: IO ()
+main = do
+  marr <- newIOArray (0, n-1) Nothing
+  forM_ [0 .. n-1] $ \i -> writeIOArray marr i (Just (show i))
+  let farr = listArray (0, n-1) [ [i, i+1] | i <- [0 .. n-1] ] :: Array Int [Int]
+  ref <- newIORef farr
+  forM_ [1 .. 3 :: Int] $ \_ -> performMajorGC
+  -- new young objects pointed to from the old mutable array
+  forM_ [0, 2 .. n-1] $ \i -> writeIOArray marr i (Just (show (i * 2)))
+  performMinorGC
+  performMajorGC
+  ok1 <- fmap and $ forM [0 .. n-1] $ \i -> do
+    x <- readIOArray marr i
+    return (x == Just (show (if even i then i * 2 else i)))
+  arr <- readIORef ref
+  let ok2 = and [ arr ! i == [i, i+1] | i <- [0 .. n-1] ]
+  print (ok1, ok2)
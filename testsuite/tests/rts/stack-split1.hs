@@ -0,0 +1,20 @@
+-- A deep non-tail recursion that allocates, so that with +RTS -kw its
+-- stack is split at the heap checks on the way down, and the threads
+-- return through the underflow frames on the way up.
+module Main (main) where
+
+import Control.Concurrent
+import Control.Monad
+
+sumTo :: Int -> Integer
+sumTo 0 = 0
+sumTo n = toInteger n + sumTo (n - 1)
+{-# NOINLINE sumTo #-}
+
+main :: IO ()
+main = do
+  print (sumTo 1000000)
+  done <- newEmptyMVar
+  forM_ [1 .. 4] $ \i -> forkIO $ putMVar done $! sumTo (i * 100000)
+  rs <- replicateM 4 (takeMVar done)
+  print (sum rs)
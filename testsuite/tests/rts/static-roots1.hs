@@ -0,0 +1,24 @@
+-- CAFs entered between the major GCs that walk the static objects
+-- with +RTS --cache-static-roots, which must be kept alive by the
+-- major GCs in between that don't.
+module Main (main) where
+
+import Control.Monad
+import System.Mem
+
+table :: [Int]
+table = map (* 3) [1 .. 100000]
+{-# NOINLINE table #-}
+
+squares :: [Int]
+squares = [ i * i | i <- [1 .. 1000] ]
+{-# NOINLINE squares #-}
+
+main :: IO ()
+main = do
+  print (sum table)
+  forM_ [1 .. 7 :: Int] $ \i -> do
+    performMajorGC
+    when (i == 3) $ print (sum squares)
+    print (table !! (i * 1000))
+  print (length table + length squares)
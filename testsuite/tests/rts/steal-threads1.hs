@@ -0,0 +1,28 @@
+-- Forks many threads from the main thread, so that with
+-- --load-balance=steal the idle capabilities steal them from its run
+-- queue, and kills some of them while they may be waiting to be stolen.
+module Main (main) where
+
+import Control.Concurrent
+import Control.Exception
+import Control.Monad
+import Data.List (foldl')
+
+work :: Int -> Int
+work n = foldl' (+) 0 [1 .. n]
+{-# NOINLINE work #-}
+
+main :: IO ()
+main = do
+  rs <- forM [1 .. 64] $ \i -> do
+    r <- newEmptyMVar
+    _ <- forkIO $ putMVar r $! work (i * 100000)
+    return r
+  xs <- mapM takeMVar rs
+  print (sum xs)
+
+  ts <- forM [1 .. 64] $ \i ->
+    forkIO $ forever $ evaluate (work i) >> yield
+  threadDelay 10000
+  mapM_ killThread ts
+  putStrLn "done"
@@ -0,0 +1,37 @@
+-- Threads of a higher priority run first, forked threads inherit the
+-- priority of their parent, and with --starvation-limit a busy thread
+-- of a high priority doesn't starve one of a low priority.
+module Main (main) where
+
+import Control.Concurrent
+import Control.Monad
+import GHC.Conc (ThreadPriority(..), setThreadPriority)
+
+main :: IO ()
+main = do
+  me <- myThreadId
+  go <- newEmptyMVar
+  order <- newMVar []
+  done <- newEmptyMVar
+
+  -- Fork a thread of each priority, all blocked on go, and only
+  -- release them once main has the lowest priority itself, so that
+  -- however main is descheduled in between they become runnable
+  -- together.
+  forM_ [LowPriority, NormalPriority, HighPriority] $ \p -> do
+    setThreadPriority me p
+    forkIO $ do
+      readMVar go
+      modifyMVar_ order (return . (p :))
+      putMVar done ()
+  setThreadPriority me LowPriority
+  putMVar go ()
+  replicateM_ 3 (takeMVar done)
+  mapM_ print . reverse =<< readMVar order
+
+  setThreadPriority me HighPriority
+  spinner <- forkIO $ forever yield
+  setThreadPriority me LowPriority
+  replicateM_ 10 yield
+  killThread spinner
+  putStrLn "done"
@@ -0,0 +1,32 @@
+-- The allocation and run time that the scheduler counts for each
+-- thread, with +RTS --thread-usage.
+module Main (main) where
+
+import Control.Concurrent
+import Control.Exception
+import Control.Monad
+import GHC.Conc
+
+main :: IO ()
+main = do
+  worker <- forkIO $ do
+    -- the counter doesn't affect what threadUsage reports
+    setAllocationCounter 1000000000
+    _ <- evaluate (sum (map (length . show) [1 .. 100000 :: Int]))
+    return ()
+  let wait = do
+        s <- threadStatus worker
+        unless (s == ThreadFinished) (yield >> wait)
+  wait
+
+  u <- threadUsage worker
+  print (threadUsageAllocated u > 1000000,
+         threadUsageAllocated u < 1000000000)
+  print (threadUsageRunTime u > 0)
+
+  me <- myThreadId
+  i <- threadUsageId <$> threadUsage me
+  us <- listThreadUsage
+  print (any ((== i) . threadUsageId) us,
+         any ((== threadUsageId u) . threadUsageId) us)
+  putStrLn "done"
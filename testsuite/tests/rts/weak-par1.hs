@@ -0,0 +1,35 @@
+-- Enough weak pointers for the GC threads to share them out, where the
+-- values of half of the live ones keep the keys of the others alive,
+-- and C finalizers for the finalizer thread.
+module Main (main) where
+
+import Control.Monad
+import Data.IORef
+import Data.Maybe
+import Foreign.ForeignPtr
+import Foreign.Marshal.Alloc
+import System.Mem
+import System.Mem.Weak
+
+n :: Int
+n = 40000
+
+main :: IO ()
+main = do
+  keys <- forM [0 .. n - 1] newIORef
+  -- the value of the weak pointer of key i is key i+1, for even i
+  ws <- forM (zip3 [0 ..] keys (tail keys ++ [head keys])) $ \(i, k, next) ->
+    if even (i :: Int) then mkWeak k next Nothing
+                       else mkWeak k k Nothing
+  -- keep every fourth key, and so the one after it too
+  let kept = [ k | (i, k) <- zip [0 :: Int ..] keys, i `mod` 4 == 0 ]
+  length kept `seq` return ()
+
+  forM_ [1 .. 1000 :: Int] $ \_ ->
+    newForeignPtr finalizerFree =<< mallocBytes 64
+  performMajorGC
+  performMajorGC
+
+  alive <- mapM deRefWeak ws
+  print (length (filter isJust alive))
+  print . sum =<< mapM readIORef kept
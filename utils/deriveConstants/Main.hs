@@ -447,8 +447,10 @@ wanteds os = concat
           ,closureField  C    "StgTSO"      "trec"
           ,closureField  C    "StgTSO"      "flags"
           ,closureField  C    "StgTSO"      "dirty"
+          ,closureField  C    "StgTSO"      "priority"
           ,closureField  C    "StgTSO"      "bq"
           ,closureField  Both "StgTSO"      "alloc_limit"
+          ,closureField  C    "StgTSO"      "allocated"
           ,closureField_ Both "StgTSO_cccs" "StgTSO" "prof.cccs"
           ,closureField  Both "StgTSO"      "stackobj"
 